@@ -0,0 +1,404 @@
+// esat_headless.cc
+// Jose Maria Martinez
+// Implementation of the ESAT functions used by the projects without window,
+// used instead of ESAT.lib on Linux to run and profile them on servers.
+//
+// The window doesn't exist, WindowFrame waits for the next frame of
+// ESAT_HEADLESS_FPS (60 by default, 0 doesn't wait) and the draw commands
+// are only counted. The sprites are decoded to memory so their size and
+// pixels are the real ones. The input is read from the script given by
+// ESAT_HEADLESS_INPUT, one event per line:
+//   # frame command arguments
+//   30 move 374 448     moves the mouse
+//   31 mouse 374 448 0  moves the mouse and presses a button (0 by default)
+//   40 key F1           presses a special key (Escape, Space, Enter, F1..F12...)
+//   41 char a           presses a key
+//   600 quit            closes the window
+// Each event is down during its frame. ESAT_HEADLESS_FRAMES closes the
+// window after that many frames.
+
+#include <ESAT/time.h>
+#include <ESAT/window.h>
+#include <ESAT/draw.h>
+#include <ESAT/input.h>
+#include <ESAT/sprite.h>
+#define STB_IMAGE_IMPLEMENTATION
+#include "STB/stb_image.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace {
+
+enum class HeadlessEventType
+{
+  k_Move = 0,
+  k_MouseDown = 1,
+  k_SpecialKey = 2,
+  k_Key = 3,
+  k_Quit = 4,
+  k_PADDING = 255
+};
+
+struct HeadlessEvent
+{
+  unsigned int frame;
+  HeadlessEventType type;
+  int code;
+  double x;
+  double y;
+};
+
+struct HeadlessSprite
+{
+  int width;
+  int height;
+  std::vector<unsigned char> pixels;
+};
+
+struct HeadlessState
+{
+  bool opened = false;
+  unsigned int width = 0;
+  unsigned int height = 0;
+  unsigned int frame = 0;
+  unsigned int max_frames = 0;
+  unsigned int fps = 60;
+  std::chrono::steady_clock::time_point next_frame;
+  std::vector<HeadlessEvent> events;
+  //First event of the current frame, the events are sorted by frame
+  size_t first_event = 0;
+  double mouse_x = 0.0;
+  double mouse_y = 0.0;
+  unsigned long long draw_commands = 0;
+  unsigned long long sprites_drawn = 0;
+  unsigned int sprites_alive = 0;
+};
+
+HeadlessState g_state;
+
+const struct { const char* name; ESAT::SpecialKey key; } kSpecialKeyNames[] = {
+  { "Space", ESAT::kSpecialKey_Space }, { "Enter", ESAT::kSpecialKey_Enter },
+  { "Tab", ESAT::kSpecialKey_Tab }, { "Escape", ESAT::kSpecialKey_Escape },
+  { "Delete", ESAT::kSpecialKey_Delete }, { "Backspace", ESAT::kSpecialKey_Backspace },
+  { "Up", ESAT::kSpecialKey_Up }, { "Down", ESAT::kSpecialKey_Down },
+  { "Right", ESAT::kSpecialKey_Right }, { "Left", ESAT::kSpecialKey_Left },
+  { "Control", ESAT::kSpecialKey_Control }, { "Alt", ESAT::kSpecialKey_Alt },
+  { "Shift", ESAT::kSpecialKey_Shift },
+  { "F1", ESAT::kSpecialKey_F1 }, { "F2", ESAT::kSpecialKey_F2 }, { "F3", ESAT::kSpecialKey_F3 },
+  { "F4", ESAT::kSpecialKey_F4 }, { "F5", ESAT::kSpecialKey_F5 }, { "F6", ESAT::kSpecialKey_F6 },
+  { "F7", ESAT::kSpecialKey_F7 }, { "F8", ESAT::kSpecialKey_F8 }, { "F9", ESAT::kSpecialKey_F9 },
+  { "F10", ESAT::kSpecialKey_F10 }, { "F11", ESAT::kSpecialKey_F11 }, { "F12", ESAT::kSpecialKey_F12 },
+};
+
+/** @brief Reads the input script
+*
+* Wrong lines are reported and skipped.
+*
+* @param file path of the script
+* @return void
+*/
+void LoadScript(const char* file)
+{
+  FILE* input = fopen(file, "r");
+  if (!input)
+  {
+    printf("ESAT headless: couldn't open the input script %s\n", file);
+    return;
+  }
+  char line[256];
+  unsigned int line_number = 0;
+  while (fgets(line, sizeof(line), input))
+  {
+    line_number++;
+    char command[32];
+    char argument[32] = "";
+    HeadlessEvent event = { 0, HeadlessEventType::k_Quit, 0, 0.0, 0.0 };
+    if (line[0] == '#' || sscanf(line, "%u %31s", &event.frame, command) != 2) continue;
+
+    bool valid = true;
+    if (strcmp(command, "move") == 0)
+    {
+      event.type = HeadlessEventType::k_Move;
+      valid = sscanf(line, "%*u %*s %lf %lf", &event.x, &event.y) == 2;
+    }
+    else if (strcmp(command, "mouse") == 0)
+    {
+      event.type = HeadlessEventType::k_MouseDown;
+      valid = sscanf(line, "%*u %*s %lf %lf %d", &event.x, &event.y, &event.code) >= 2;
+    }
+    else if (strcmp(command, "key") == 0)
+    {
+      event.type = HeadlessEventType::k_SpecialKey;
+      valid = false;
+      if (sscanf(line, "%*u %*s %31s", argument) == 1)
+      {
+        for (const auto& special : kSpecialKeyNames)
+        {
+          if (strcmp(special.name, argument) == 0)
+          {
+            event.code = special.key;
+            valid = true;
+          }
+        }
+      }
+    }
+    else if (strcmp(command, "char") == 0)
+    {
+      event.type = HeadlessEventType::k_Key;
+      valid = sscanf(line, "%*u %*s %31s", argument) == 1;
+      event.code = argument[0];
+    }
+    else if (strcmp(command, "quit") != 0)
+    {
+      valid = false;
+    }
+
+    if (valid)
+    {
+      g_state.events.push_back(event);
+    }
+    else
+    {
+      printf("ESAT headless: skipped line %u of %s\n", line_number, file);
+    }
+  }
+  fclose(input);
+
+  //Stable so the events of a frame keep the order of the script
+  for (size_t i = 1; i < g_state.events.size(); i++)
+  {
+    for (size_t j = i; j > 0 && g_state.events[j - 1].frame > g_state.events[j].frame; j--)
+    {
+      std::swap(g_state.events[j - 1], g_state.events[j]);
+    }
+  }
+}
+
+/** @brief Applies the events of the current frame that last more than it
+*
+* Moves the mouse and closes the window.
+*
+* @return void
+*/
+void ApplyFrameEvents()
+{
+  while (g_state.first_event < g_state.events.size() &&
+         g_state.events[g_state.first_event].frame < g_state.frame)
+  {
+    g_state.first_event++;
+  }
+  for (size_t i = g_state.first_event; i < g_state.events.size() && g_state.events[i].frame == g_state.frame; i++)
+  {
+    const HeadlessEvent& event = g_state.events[i];
+    if (event.type == HeadlessEventType::k_Move || event.type == HeadlessEventType::k_MouseDown)
+    {
+      g_state.mouse_x = event.x;
+      g_state.mouse_y = event.y;
+    }
+    if (event.type == HeadlessEventType::k_Quit) g_state.opened = false;
+  }
+  if (g_state.max_frames && g_state.frame >= g_state.max_frames) g_state.opened = false;
+}
+
+/** @brief Checks if an event happens in the current frame
+*
+* @param type type of the event
+* @param code key or button of the event
+* @return bool true if it's in the script at the current frame
+*/
+bool IsEventInFrame(const HeadlessEventType type, const int code)
+{
+  for (size_t i = g_state.first_event; i < g_state.events.size() && g_state.events[i].frame == g_state.frame; i++)
+  {
+    if (g_state.events[i].type == type && g_state.events[i].code == code) return true;
+  }
+  return false;
+}
+
+}
+
+namespace ESAT {
+
+double Time()
+{
+  using namespace std::chrono;
+  return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+void Sleep(unsigned int ms)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void WindowInit(unsigned int width, unsigned int height)
+{
+  g_state.opened = true;
+  g_state.width = width;
+  g_state.height = height;
+  g_state.frame = 0;
+  const char* fps = getenv("ESAT_HEADLESS_FPS");
+  if (fps) g_state.fps = static_cast<unsigned int>(atoi(fps));
+  const char* frames = getenv("ESAT_HEADLESS_FRAMES");
+  if (frames) g_state.max_frames = static_cast<unsigned int>(atoi(frames));
+  const char* script = getenv("ESAT_HEADLESS_INPUT");
+  if (script) LoadScript(script);
+  g_state.next_frame = std::chrono::steady_clock::now();
+  ApplyFrameEvents();
+}
+
+void WindowFrame()
+{
+  if (g_state.fps)
+  {
+    g_state.next_frame += std::chrono::microseconds(1000000 / g_state.fps);
+    std::this_thread::sleep_until(g_state.next_frame);
+  }
+  g_state.frame++;
+  ApplyFrameEvents();
+}
+
+void WindowDestroy()
+{
+  g_state.opened = false;
+}
+
+bool WindowIsOpened()
+{
+  return g_state.opened;
+}
+
+unsigned int WindowHeight()
+{
+  return g_state.height;
+}
+
+unsigned int WindowWidth()
+{
+  return g_state.width;
+}
+
+void WindowSetMouseVisibility(bool /*visible*/)
+{
+
+}
+
+void DrawBegin() { g_state.draw_commands++; }
+void DrawEnd() { g_state.draw_commands++; }
+void DrawSetStrokeColor(unsigned char /*R*/, unsigned char /*G*/, unsigned char /*B*/, unsigned char /*Alpha*/) { g_state.draw_commands++; }
+void DrawSetFillColor(unsigned char /*R*/, unsigned char /*G*/, unsigned char /*B*/, unsigned char /*Alpha*/) { g_state.draw_commands++; }
+void DrawClear(unsigned char /*R*/, unsigned char /*G*/, unsigned char /*B*/, unsigned char /*Alpha*/) { g_state.draw_commands++; }
+void DrawLine(float /*x1*/, float /*y1*/, float /*x2*/, float /*y2*/) { g_state.draw_commands++; }
+void DrawPath(float* /*pairs_of_points*/, int /*num_points*/) { g_state.draw_commands++; }
+void DrawSolidPath(float* /*pairs_of_points*/, int /*num_points*/, bool /*stroke*/) { g_state.draw_commands++; }
+void DrawSetTextFont(const char* /*name*/) { g_state.draw_commands++; }
+void DrawSetTextSize(float /*size*/) { g_state.draw_commands++; }
+void DrawSetTextBlur(float /*blur_radius*/) { g_state.draw_commands++; }
+void DrawText(float /*x*/, float /*y*/, const char* /*text*/) { g_state.draw_commands++; }
+
+bool IsKeyPressed(char key) { return IsEventInFrame(HeadlessEventType::k_Key, key); }
+bool IsKeyDown(char key) { return IsEventInFrame(HeadlessEventType::k_Key, key); }
+bool IsKeyUp(char /*key*/) { return false; }
+bool IsSpecialKeyPressed(SpecialKey key) { return IsEventInFrame(HeadlessEventType::k_SpecialKey, key); }
+bool IsSpecialKeyDown(SpecialKey key) { return IsEventInFrame(HeadlessEventType::k_SpecialKey, key); }
+bool IsSpecialKeyUp(SpecialKey /*key*/) { return false; }
+char GetNextPressedKey() { return 0; }
+void ResetBufferdKeyInput() {}
+double MousePositionX() { return g_state.mouse_x; }
+double MousePositionY() { return g_state.mouse_y; }
+double MouseWheelX() { return 0.0; }
+double MouseWheelY() { return 0.0; }
+bool MouseButtonPressed(int button_id) { return IsEventInFrame(HeadlessEventType::k_MouseDown, button_id); }
+bool MouseButtonDown(int button_id) { return IsEventInFrame(HeadlessEventType::k_MouseDown, button_id); }
+bool MouseButtonUp(int /*button_id*/) { return false; }
+
+SpriteHandle SpriteFromFile(const char* path)
+{
+  int width;
+  int height;
+  int bpp;
+  unsigned char* pixels = stbi_load(path, &width, &height, &bpp, 4);
+  if (!pixels) return nullptr;
+  SpriteHandle sprite = SpriteFromMemory(width, height, pixels);
+  stbi_image_free(pixels);
+  return sprite;
+}
+
+SpriteHandle SpriteFromMemory(int width, int height, const unsigned char* data_RGBA)
+{
+  if (width <= 0 || height <= 0) return nullptr;
+  HeadlessSprite* sprite = new HeadlessSprite();
+  sprite->width = width;
+  sprite->height = height;
+  sprite->pixels.assign(static_cast<size_t>(width) * height * 4, 0);
+  if (data_RGBA) memcpy(sprite->pixels.data(), data_RGBA, sprite->pixels.size());
+  g_state.sprites_alive++;
+  return sprite;
+}
+
+void SpriteUpdateFromMemory(SpriteHandle img, const unsigned char* data_RGBA)
+{
+  HeadlessSprite* sprite = static_cast<HeadlessSprite*>(img);
+  if (sprite && data_RGBA) memcpy(sprite->pixels.data(), data_RGBA, sprite->pixels.size());
+}
+
+SpriteHandle SubSprite(SpriteHandle orig, int x, int y, int width, int height)
+{
+  const HeadlessSprite* source = static_cast<const HeadlessSprite*>(orig);
+  if (!source || x < 0 || y < 0 || x + width > source->width || y + height > source->height) return nullptr;
+  HeadlessSprite* sprite = static_cast<HeadlessSprite*>(SpriteFromMemory(width, height, nullptr));
+  if (!sprite) return nullptr;
+  for (int row = 0; row < height; row++)
+  {
+    memcpy(&sprite->pixels[static_cast<size_t>(row) * width * 4],
+           &source->pixels[(static_cast<size_t>(y + row) * source->width + x) * 4], static_cast<size_t>(width) * 4);
+  }
+  return sprite;
+}
+
+void SpriteRelease(SpriteHandle img)
+{
+  if (!img) return;
+  delete static_cast<HeadlessSprite*>(img);
+  g_state.sprites_alive--;
+}
+
+int SpriteHeight(SpriteHandle img)
+{
+  return img ? static_cast<HeadlessSprite*>(img)->height : 0;
+}
+
+int SpriteWidth(SpriteHandle img)
+{
+  return img ? static_cast<HeadlessSprite*>(img)->width : 0;
+}
+
+void SpriteGetPixel(SpriteHandle img, int x, int y, unsigned char outRGBA[4])
+{
+  const HeadlessSprite* sprite = static_cast<const HeadlessSprite*>(img);
+  if (!sprite || x < 0 || y < 0 || x >= sprite->width || y >= sprite->height)
+  {
+    memset(outRGBA, 0, 4);
+    return;
+  }
+  memcpy(outRGBA, &sprite->pixels[(static_cast<size_t>(y) * sprite->width + x) * 4], 4);
+}
+
+void DrawSprite(SpriteHandle /*img*/, float /*x*/, float /*y*/) { g_state.sprites_drawn++; }
+void DrawSpriteWithMatrix(SpriteHandle /*img*/, const float /*tranform_matrix*/[9]) { g_state.sprites_drawn++; }
+void DrawSpriteWithMatrix(SpriteHandle /*img*/, const Mat3& /*m*/) { g_state.sprites_drawn++; }
+void DrawSprite(SpriteHandle /*img*/, const SpriteTransform& /*st*/) { g_state.sprites_drawn++; }
+
+} /* ESAT */
+
+int main(int argc, char** argv)
+{
+  const double start = ESAT::Time();
+  const int result = ESAT::main(argc, argv);
+  printf("ESAT headless: %u frames in %.1f ms, %llu draw commands, %llu sprites drawn, %u sprites alive\n",
+         g_state.frame, ESAT::Time() - start, g_state.draw_commands, g_state.sprites_drawn, g_state.sprites_alive);
+  return result;
+}
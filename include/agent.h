@@ -6,7 +6,12 @@
 #include <cstdint>
 #include "common_def.h"
 #include "path.h"
+#include "path_handle.h"
+#include "inbox.h"
+#include "timer_wheel.h"
+#include "ai_lod.h"
 #include <ESAT/sprite.h>
+#include <vector>
 
 enum class MovementType
 {
@@ -53,7 +58,9 @@ struct PatternCommand
 };
 
 class PathFinder;
-struct AgentMessage;
+class AgentStore;
+class World;
+class MovingTargetSearch;
 
 /** @brief Agent entity
 *
@@ -102,6 +109,19 @@ public:
   * @return *Agent
   */
   Agent(const AgentType agent_type, const float x, const float y);
+  /** @brief Agent constructor
+  *
+  * Agent constructor that creates the agent in a world, the other
+  * constructors create it in the GameState.
+  *
+  * @return *Agent
+  * @param world world where the agent lives
+  * @param agent_type role of the agent
+  * @param x start x coordinate of the agent
+  * @param y start y coordinate of the agent
+  * @param pf to a pathfinder agent of the same world, nullptr if this agent can't use pathfinding
+  */
+  Agent(World* world, const AgentType agent_type, const float x, const float y, PathFinder* pf);
   /** @brief Destroys the Agent
   *
   * Destructor of the agent entity
@@ -111,12 +131,26 @@ public:
   ~Agent();
   /** @brief Updates the agent
   *
-  * Updates the body and mind of the agent based on a delta time
+  * Updates the body and mind of the agent based on a delta time. The agent
+  * chooses its target but is moved with the rest of the agents by
+  * AgentStore::integrate once all of them are updated.
   *
   * @param dt time that has passed in the game world
   * @return void
   */
   void update(const u32 dt);
+  /** @brief Wakes up the agent
+  *
+  * Updates the agent with the time passed since it was woken up the last
+  * time and returns when it has something to do again, that is when its
+  * mind has to think, one of its movement timers expires or it's about to
+  * reach its target. Until then updating it would change nothing.
+  *
+  * @param now time of the game world
+  * @param dt time that has passed since the last tick
+  * @return u32 ms until the agent must be woken up, kNoTimer if never
+  */
+  u32 wake(const u32 now, const u32 dt);
   /** @brief gets the x position_ of the agent
   *
   * Returns the x position_ of the agent.
@@ -131,6 +165,20 @@ public:
   * @return float y position_
   */
   float y() const;
+  /** @brief gets the type of the agent
+  *
+  * Returns the type of the agent.
+  *
+  * @return AgentType type of the agent
+  */
+  AgentType type() const;
+  /** @brief gets the id of the agent
+  *
+  * Returns the id of the agent, agents created before have lower ids.
+  *
+  * @return u32 id of the agent
+  */
+  u32 id() const;
 
   /** @brief Calculates a path from origin to dst
   *
@@ -146,12 +194,43 @@ public:
   *
   * Calculates a path for the agent from origin to dst using the A*
   * algorithm taking into account the map loaded at the game state.
+  * A request already sent and not answered is replaced by this one, only
+  * the answer of the last request is used.
   *
   * @param origin x start point of the path
   * @param dst destination of the path
+  * @param deadline ms of game time the path is wanted for, 0 without limit
   * @return void
   */
-  void prepareAStarMessage(const Float2& origin, const Float2& dst);
+  void prepareAStarMessage(const Float2& origin, const Float2& dst, const u32 deadline = 0);
+  /** @brief Cancels the path asked to the path finder
+  *
+  * The path finder stops calculating it and an answer already on its way
+  * is ignored. A path that was already finished stays in the agent.
+  *
+  * @return void
+  */
+  void cancelPathRequest();
+  /** @brief Asks the path finder for a path without blocking
+  *
+  * Like prepareAStarMessage but the answer comes through the handle instead
+  * of a message, and startAStar must be called once the handle is k_Ready.
+  * The path is calculated into the path of the agent, it replaces the other
+  * requests of the agent and is cancelled if the agent is destroyed.
+  *
+  * @param origin x start point of the path
+  * @param dst destination of the path
+  * @param deadline ms of game time the path is wanted for, 0 without limit
+  * @return PathHandle handle of the request, not valid without path finder
+  */
+  PathHandle requestPath(const Float2& origin, const Float2& dst, const u32 deadline = 0);
+  /** @brief gets the priority of the paths the agent asks for
+  *
+  * The hero goes before the rest of the agents.
+  *
+  * @return PathPriority priority of the requests of the agent
+  */
+  PathPriority pathPriority() const;
   /** @brief sets the agent to follow the path he has
   *
   * Sets the agent to follow the path he has. This function must be used
@@ -167,10 +246,20 @@ public:
   * @return SpriteHandle
   */
   ESAT::SpriteHandle representation() const;
+  /** @brief gets the path of the sprite of a type of agent
+  *
+  * The agents share the sprites of the AssetCache, the projects can
+  * preload them with this path before creating the agents.
+  *
+  * @param type type of agent
+  * @return const char* path of the sprite, nullptr if the type has none
+  */
+  static const char* spritePath(const AgentType type);
   /** @brief function to receive a message from another agent
   *
-  * Function to send a message to the agent. This message will be
-  * treated at the updateMind function.
+  * Function to send a message to the agent. The message is posted to the
+  * dispatcher of the game state and treated at the updateMind function
+  * after it has been delivered.
   *
   * @param msg content of the message sent
   * @param id of the one who sent the message
@@ -178,13 +267,57 @@ public:
   * @return void
   */
   void sendMessage(const AgentMessage& msg, const u32 id);
+  /** @brief gets the size of the agent in cells of the map
+  *
+  * Returns the clearance the agent needs in the collision map of the game state,
+  * calculated from the size of its representation. Agents without representation
+  * or without map use one cell.
+  *
+  * @return u8 size of the agent in cells
+  */
+  u8 clearance() const;
+  /** @brief Sets the size of the agent in cells of the map
+  *
+  * Used without window to replay a session recorded with representations,
+  * 0 goes back to the size calculated from the representation.
+  *
+  * @param clearance size of the agent in cells
+  * @return void
+  */
+  void set_clearance(const u8 clearance);
+  /** @brief checks if the agent asks its paths to a path finder
+  *
+  * @return bool true if the agent was created with a path finder
+  */
+  bool hasPathFinder() const;
+  /** @brief checks if the agent is in a fight
+  *
+  * @return bool true if the agent is chasing or fleeing
+  */
+  bool inCombat() const;
+  /** @brief gets the level of detail tier of the agent
+  *
+  * @return AILodTier tier that sets how often the agent thinks
+  */
+  AILodTier lodTier() const;
+  /** @brief Sets the level of detail tier of the agent
+  *
+  * Changes how often the mind thinks. When it changes the time until the
+  * next thought is taken from the id of the agent, so the agents that
+  * change to the same tier are spread over its period.
+  *
+  * @param tier new tier of the agent
+  * @param mind_time time between thoughts of the tier in ms
+  * @return bool true if the tier or its time changed
+  */
+  bool set_lod_tier(const AILodTier tier, const u32 mind_time);
 
 private:
   u32 id_ = 0;
+  World* world_ = nullptr;
 
 
   //The epsilon will vary depending on the speed * kEpsilonFactor
-  float epsilon_;
   const float kEpsilonFactor = 0.01f;
 
   MovementType move_type_;
@@ -195,22 +328,27 @@ private:
 
   ESAT::SpriteHandle representation_;
 
-  //Agent* target;
-  Float2 position_;
-  Float2 target_position_;
-  Float2 velocity_;
+  //Position, target, velocity, speed and epsilon live in the store
+  AgentStore* store_ = nullptr;
+  u32 slot_ = 0;
 
-  u32 mind_time_ = 1;
+  u32 mind_time_ = 100;
   u32 mind_acum_ = 0;
+  AILodTier lod_tier_ = AILodTier::k_High;
+
+  //Time of the last wake up
+  u32 last_wake_ = 0;
+  bool woken_ = false;
 
   //float vision_range_ = 200;
 
-  //speed as m/s 
-  float speed_;
   const float kSpeedUp = 2.0f;
 
   bool initialized_;
 
+  //State of the random sequence of the agent
+  u32 random_state_;
+
   //Determinist variables
   int determinist_idx_;
   static const int determinist_size_ = 2;
@@ -225,6 +363,8 @@ private:
   Agent* objective_ = nullptr;
   u32 tracking_retarget_time_;
   u32 accum_time_tracking_;
+  //Search of the chase through the collision map, reset when the chase ends
+  MovingTargetSearch* chase_search_ = nullptr;
   //Random variables
   u32 next_random_time_;
   u32 accum_time_random_;
@@ -234,14 +374,20 @@ private:
   float flee_distance_ = 200.0f;
   float chase_distance_ = 225.0f;
   float lost_focus_distance_ = 300.0f;
+  //Agents found by the last query of the agent grid
+  std::vector<Agent*> nearby_agents_;
   u32 resting_time_ = 4000; //4s
   u32 time_rested_ = 0;
 
   Path* path_ = nullptr;
   PathFinder* path_finder_agent_ = nullptr;
+  //Number of the last request sent to the path finder, older answers are ignored
+  u32 path_request_ = 0;
+  //Size in cells set by set_clearance, 0 uses the representation
+  u8 clearance_ = 0;
 
   //Message variables
-  AgentMessage* mail_box_ = nullptr;
+  Inbox inbox_;
 
 #ifdef DEBUG
   u32 time_for_print_ = 3000; //3s
@@ -272,7 +418,8 @@ private:
   /** @brief Updates the body of the agent
   *
   * Updates the physic representation of the agent. Deals with
-  * the movement and updates the sensors.
+  * the movement and updates the sensors. The movement itself is
+  * integrated by the agent store.
   *
   * @param dt time that has passed in the game world
   * @return void
@@ -299,6 +446,15 @@ private:
   * @return void
   */
   void FSM_Fleeing(u32 dt);
+  /** @brief Searches the path to the objective of the chase
+  *
+  * Uses the moving target search of the agent, kept for the whole chase so
+  * each search reuses what the previous ones learned. Only used when the
+  * world has a collision map, the search is added to its chase statistics.
+  *
+  * @return bool true if there's a path and the agent is at its first point
+  */
+  bool chasePath();
   /** @brief Final state machine for resting behaviour
   *
   * Agent behaviour while it's resitng
@@ -359,32 +515,21 @@ private:
   * @return void
   */
   void MOV_AStar(const u32 dt);
-  /** @brief moves the agent
+  /** @brief returns a random number of the agent
   *
-  * Moves the agent based on the velocity it has at the moment. The agent
-  * will be moved using the e = v * t equation. Being v the velocity_ of the agent
-  * and t the delta time elapsed at the game world in seconds.
+  * Every agent has its own sequence seeded with the seed of the game state
+  * and its id, so the numbers don't depend on the order the agents are updated.
   *
-  * @param dt time that has passed in the game world
-  * @return void
+  * @return float random number between 0 and 1
   */
-  void move(const uint32_t dt);
-  /** @brief Sets the orientation of the agent
+  float random();
+  /** @brief gets the position of the agent
   *
-  * Calculates the normalized velocity_ we need to reach our destination
+  * Returns the position of the agent stored at the agent store.
   *
-  * @param destination to which we are going to move
-  * @return void
-  */
-  void setOrientation(const Float2& destination);
-  /** @brief Calculates our velocity
-  *
-  *  Sets the orientation of the agent and escalates the resultant velocity_
-  *  based on the speed_ of the agent.
-  *
-  * @return void
+  * @return Float2 position of the agent
   */
-  void calculateVelocity();
+  Float2 position() const;
   /** @brief Checks if the position_ has been reached
   *
   * Checks whether or not the agent has reached it's destination.
@@ -392,6 +537,21 @@ private:
   * @return bool true if the position_ has been reached
   */
   bool positionReached() const;
+  /** @brief returns when the agent has something to do
+  *
+  * @param dt time that has passed since the last tick
+  * @return u32 ms until the mind or the movement needs to run, kNoTimer if never
+  */
+  u32 wakeDelay(const u32 dt) const;
+  /** @brief returns when the agent may reach its target
+  *
+  * The estimation is early by a tick so the agent is always awake the
+  * tick it sees the target reached.
+  *
+  * @param dt time that has passed since the last tick
+  * @return u32 ms until the agent may reach its target, kNoTimer if never
+  */
+  u32 arrivalDelay(const u32 dt) const;
   /** @brief sets the next position_ of the agent
   *
   * Updates the destination the agent needs to reach.
@@ -407,20 +567,31 @@ private:
   * return does not mean that the other agent is smaller, it could be the same size.
   * If an agent needs to know if he is smaller please use the isSmaller function.
   *
-  * @param a agent to compare with
+  * @param type type of the agent to compare with
   * @return bool true in case we are bigger than the other agent, false otherwise
   */
-  bool isBigger(Agent* a);
+  bool isBigger(const AgentType type) const;
   /** @brief checks if the agent is smaller than another agent
   *
   * checks if the agent is smaller than another agent. Take into account that a false
   * return does not mean that the other agent is bigger, it could be the same size.
   * If an agent needs to know if he is bigger please use the isBigger function.
   *
-  * @param a agent to compare with
+  * @param type type of the agent to compare with
   * @return bool true in case we are smaller than the other agent, false otherwise
   */
-  bool isSmaller(Agent* a);
+  bool isSmaller(const AgentType type) const;
+  /** @brief finds the first agent in range we are bigger or smaller than
+  *
+  * Looks at the agent grid of the game state for the agents of the types we
+  * are bigger (or smaller) than within radius and returns the one created
+  * first, the same one a scan of all the agents in order would find.
+  *
+  * @param bigger true to look for agents we are bigger than, false for smaller
+  * @param radius distance of the search
+  * @return Agent* agent found, nullptr if there is none
+  */
+  Agent* firstInRange(const bool bigger, const float radius);
 
 };
 
@@ -0,0 +1,219 @@
+// agent_store.h
+// Jose Maria Martinez
+// Header of the structure of arrays with the movement data of the agents
+#ifndef __AGENT_STORE_H__
+#define __AGENT_STORE_H__
+
+#include "platform_types.h"
+#include "Math/float2.h"
+#include <vector>
+
+/** @brief AgentStore class
+*
+* Stores the movement data of every agent (position, velocity, target, speed and
+* epsilon) in contiguous arrays, one per component, indexed by the slot of the
+* agent. The movement of all the agents is integrated in one pass that works
+* with four agents at a time using SSE when it's available. The positions are
+* double buffered, the integration reads the positions of the previous tick
+* and writes the ones of the next tick, which become visible with swapBuffers.
+*
+*/
+class AgentStore
+{
+public:
+  /** @brief AgentStore constructor
+  *
+  * Default AgentStore constructor, the store is empty
+  *
+  * @return *AgentStore
+  */
+  AgentStore();
+  /** @brief AgentStore destructor
+  *
+  * Default AgentStore destructor
+  *
+  * @return void
+  */
+  ~AgentStore();
+  /** @brief Adds an agent to the store
+  *
+  * Reserves a slot for an agent stopped at position. The slots of removed
+  * agents are reused.
+  *
+  * @param position initial position of the agent
+  * @return u32 slot of the agent
+  */
+  u32 add(const Float2& position);
+  /** @brief Removes an agent from the store
+  *
+  * The slot stops moving and can be given to a new agent
+  *
+  * @param slot slot of the agent
+  * @return void
+  */
+  void remove(const u32 slot);
+  /** @brief returns the number of slots
+  *
+  * @return u32 slots used and free
+  */
+  u32 size() const;
+  /** @brief returns the position of an agent
+  *
+  * @param slot slot of the agent
+  * @return Float2 position of the agent
+  */
+  Float2 position(const u32 slot) const;
+  /** @brief returns the x coordinate of an agent
+  *
+  * @param slot slot of the agent
+  * @return float x coordinate
+  */
+  float x(const u32 slot) const;
+  /** @brief returns the y coordinate of an agent
+  *
+  * @param slot slot of the agent
+  * @return float y coordinate
+  */
+  float y(const u32 slot) const;
+  /** @brief returns the x coordinates of every slot
+  *
+  * For the passes over every agent, valid until the store changes of size
+  *
+  * @return const float* size() x coordinates, check isActive for the free slots
+  */
+  const float* xs() const;
+  /** @brief returns the y coordinates of every slot
+  *
+  * For the passes over every agent, valid until the store changes of size
+  *
+  * @return const float* size() y coordinates, check isActive for the free slots
+  */
+  const float* ys() const;
+  /** @brief returns the point an agent moves to
+  *
+  * @param slot slot of the agent
+  * @return Float2 target of the agent
+  */
+  Float2 target(const u32 slot) const;
+  /** @brief returns the velocity of an agent at the last integration
+  *
+  * @param slot slot of the agent
+  * @return Float2 velocity in units per second
+  */
+  Float2 velocity(const u32 slot) const;
+  /** @brief Sets the point an agent moves to
+  *
+  * @param slot slot of the agent
+  * @param target new target
+  * @return void
+  */
+  void set_target(const u32 slot, const Float2& target);
+  /** @brief Sets the speed of an agent
+  *
+  * @param slot slot of the agent
+  * @param speed speed in units per second
+  * @param epsilon distance at which the target is considered reached
+  * @return void
+  */
+  void set_speed(const u32 slot, const float speed, const float epsilon);
+  /** @brief checks if an agent is at its target
+  *
+  * The result is kept updated by the integration and the setters, so it's
+  * only a read.
+  *
+  * @param slot slot of the agent
+  * @return bool true if the distance to the target is less than epsilon
+  */
+  bool positionReached(const u32 slot) const;
+  /** @brief checks if a slot belongs to an agent
+  *
+  * @param slot slot of the store
+  * @return bool false for the slots removed and not reused yet
+  */
+  bool isActive(const u32 slot) const;
+  /** @brief returns how long an agent needs to reach its target
+  *
+  * Time the agent needs to get closer than epsilon to its target from the
+  * current position moving straight at its speed.
+  *
+  * @param slot slot of the agent
+  * @return float time in ms, negative if the agent has no speed
+  */
+  float timeToTarget(const u32 slot) const;
+  /** @brief Moves every agent
+  *
+  * Points the velocity of each agent to its target with its speed, moves
+  * it for dt and updates if it reached the target. The results are the same
+  * with and without SSE. Same as integrateRange of every slot and swapBuffers.
+  *
+  * @param dt time that has passed in the game world
+  * @return void
+  */
+  void integrate(const u32 dt);
+  /** @brief Moves the agents of a range of slots
+  *
+  * Writes the next positions of the slots, different ranges can be integrated
+  * by different threads at the same time. The positions read by the rest of
+  * the functions don't change until swapBuffers is called.
+  *
+  * @param first first slot
+  * @param last slot after the last one
+  * @param dt time that has passed in the game world
+  * @return void
+  */
+  void integrateRange(const u32 first, const u32 last, const u32 dt);
+  /** @brief Makes the positions of the last integration the current ones
+  *
+  * @return void
+  */
+  void swapBuffers();
+
+private:
+
+  std::vector<float> position_x_;
+
+  std::vector<float> position_y_;
+
+  //Positions written by the integration
+  std::vector<float> next_position_x_;
+
+  std::vector<float> next_position_y_;
+
+  std::vector<float> velocity_x_;
+
+  std::vector<float> velocity_y_;
+
+  std::vector<float> target_x_;
+
+  std::vector<float> target_y_;
+
+  std::vector<float> speed_;
+
+  std::vector<float> epsilon_;
+
+  //1 if the agent is at its target
+  std::vector<u8> reached_;
+
+  //1 if the slot belongs to an agent
+  std::vector<u8> active_;
+
+  std::vector<u32> free_slots_;
+  /** @brief Integrates the agents of a range one by one
+  *
+  * Same operations as the SSE path for the agents that don't fill a group of four
+  *
+  * @param first first slot
+  * @param last slot after the last one
+  * @param time_in_seconds dt in seconds
+  * @return void
+  */
+  void integrateScalar(const u32 first, const u32 last, const float time_in_seconds);
+  /** @brief Recalculates if an agent reached its target
+  *
+  * @param slot slot of the agent
+  * @return void
+  */
+  void updateReached(const u32 slot);
+};
+
+#endif
@@ -0,0 +1,189 @@
+// ai_lod.h
+// Jose Maria Martinez
+// Header of the level of detail that decides how often the agents think
+#ifndef __AI_LOD_H__
+#define __AI_LOD_H__
+
+#include "platform_types.h"
+#include "Math/float2.h"
+#include "spatial_grid.h"
+#include <vector>
+
+class Agent;
+
+enum class AILodTier
+{
+  k_High = 0,
+  k_Medium = 1,
+  k_Low = 2,
+  k_PADDING = 255
+};
+
+const u8 kNumLodTiers = 3;
+
+/** @brief AILodStats struct
+*
+* Agents in each tier and what their wake ups cost during a rebalance period
+*
+*/
+struct AILodStats
+{
+  u32 agents[kNumLodTiers];
+  u32 wakes[kNumLodTiers];
+  double ms[kNumLodTiers];
+};
+
+/** @brief AILod class
+*
+* Assigns to every agent a tier that sets how often its mind thinks. Heroes,
+* the agents close to them and the fights inside the viewport think at the
+* high rate. The fights out of the viewport, the rest of the agents inside
+* it and the ones not far from a hero think at the medium rate and the rest
+* at the low one. An agent is in a fight if it's chasing, fleeing or close
+* to an agent that is. The tiers are rebalanced once per period
+* and an agent that changes tier starts thinking at a phase taken from its
+* id, so the agents of a slow tier don't think all in the same tick. Only the
+* mind is affected, the agents keep moving every tick.
+*
+*/
+class AILod
+{
+public:
+  /** @brief AILod constructor
+  *
+  * Default AILod constructor, rebalances every second with think periods
+  * of 100, 300 and 1000 ms
+  *
+  * @return *AILod
+  */
+  AILod();
+  /** @brief AILod destructor
+  *
+  * Default AILod destructor
+  *
+  * @return void
+  */
+  ~AILod();
+  /** @brief Sets the area the player sees
+  *
+  * The agents inside think at least at the medium rate. An empty area
+  * disables it.
+  *
+  * @param min top left corner of the viewport
+  * @param max bottom right corner of the viewport
+  * @return void
+  */
+  void set_viewport(const Float2& min, const Float2& max);
+  /** @brief returns the top left corner of the viewport
+  *
+  * @return Float2 top left corner
+  */
+  Float2 viewportMin() const;
+  /** @brief returns the bottom right corner of the viewport
+  *
+  * @return Float2 bottom right corner
+  */
+  Float2 viewportMax() const;
+  /** @brief Sets the distances of the tiers
+  *
+  * @param high_radius distance to a hero to think at the high rate and to a
+  * fight to be part of it
+  * @param medium_radius distance to a hero to think at the medium rate
+  * @return void
+  */
+  void set_radius(const float high_radius, const float medium_radius);
+  /** @brief Sets how often the mind of each tier thinks
+  *
+  * @param tier tier to change
+  * @param mind_time time between thoughts in ms
+  * @return s16 kErrorCode_InvalidOrigin if the tier doesn't exist
+  */
+  s16 set_mind_time(const AILodTier tier, const u32 mind_time);
+  /** @brief returns how often the mind of a tier thinks
+  *
+  * @param tier tier wanted
+  * @return u32 time between thoughts in ms
+  */
+  u32 mindTime(const AILodTier tier) const;
+  /** @brief Sets how often the tiers are rebalanced
+  *
+  * @param period time between rebalances in ms
+  * @return void
+  */
+  void set_rebalance_period(const u32 period);
+  /** @brief Checks if the tiers have to be rebalanced
+  *
+  * @param now time of the game world
+  * @return bool true if a period has passed since the last rebalance
+  */
+  bool isRebalanceDue(const u32 now) const;
+  /** @brief Assigns the tier of every agent
+  *
+  * Also closes the stats of the period that ends.
+  *
+  * @param agents agents of the game
+  * @param now time of the game world
+  * @param changed where the agents that changed tier are added
+  * @return void
+  */
+  void rebalance(const std::vector<Agent*>& agents, const u32 now, std::vector<Agent*>* changed);
+  /** @brief Adds the cost of a wake up to the stats
+  *
+  * @param tier tier of the agent woken up
+  * @param ms time the wake up took
+  * @return void
+  */
+  void record(const AILodTier tier, const double ms);
+  /** @brief returns the stats of the last rebalance period
+  *
+  * @return const AILodStats& agents per tier and cost of their wake ups
+  */
+  const AILodStats& stats() const;
+  /** @brief Prints the stats of the last rebalance period
+  *
+  * @return void
+  */
+  void printStats() const;
+
+private:
+  Float2 viewport_min_;
+  Float2 viewport_max_;
+
+  float high_radius_;
+  float medium_radius_;
+
+  u32 mind_time_[kNumLodTiers];
+
+  u32 rebalance_period_;
+  u32 last_rebalance_;
+
+  AILodStats current_;
+  AILodStats last_;
+
+  //Heroes and agents in a fight, the points of interest of the rebalance
+  std::vector<Agent*> interest_agents_;
+  SpatialGrid interest_grid_;
+  std::vector<Agent*> nearby_agents_;
+  /** @brief Decides the tier of an agent
+  *
+  * @param agent agent to classify
+  * @return AILodTier tier of the agent
+  */
+  AILodTier classify(Agent* agent);
+  /** @brief Checks if there is a point of interest of a type close to a position
+  *
+  * @param position position to check
+  * @param type type of the points of interest wanted
+  * @param radius maximum distance
+  * @return bool true if one is at radius or less
+  */
+  bool isNear(const Float2& position, const AgentType type, const float radius);
+  /** @brief Checks if an agent is inside the viewport
+  *
+  * @param agent agent to check
+  * @return bool true if the viewport is set and contains the agent
+  */
+  bool isVisible(const Agent* agent) const;
+};
+
+#endif
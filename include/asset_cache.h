@@ -0,0 +1,203 @@
+// asset_cache.h
+// Jose Maria Martinez
+// Header of the cache of the sprites loaded from files
+#ifndef __ASSET_CACHE_H__
+#define __ASSET_CACHE_H__
+
+#include "platform_types.h"
+#include <ESAT/sprite.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+/** @brief SpriteBackend struct
+*
+* Functions the cache uses to create a sprite from the decoded RGBA pixels
+* and to release it. By default they are the ones of ESAT, a program
+* without window can use others that don't need a window.
+*
+*/
+struct SpriteBackend
+{
+  ESAT::SpriteHandle(*create)(int width, int height, const unsigned char* data_RGBA);
+  void(*release)(ESAT::SpriteHandle sprite);
+};
+
+/** @brief AssetCacheStats struct
+*
+* Loads done by the cache since it was created. bytes_saved are the pixels
+* of the sprites shared instead of loaded again.
+*
+*/
+struct AssetCacheStats
+{
+  u32 decodes = 0;
+  u32 hits = 0;
+  double decode_ms = 0.0;
+  u64 bytes_saved = 0;
+  u64 resident_bytes = 0;
+  u32 resident_assets = 0;
+};
+
+/** @brief AssetCache class
+*
+* Shares the sprites loaded from files. Every path is decoded once and
+* its sprite lives while something has it acquired. The images can be
+* preloaded, a loader thread decodes them and the sprite is created when
+* it's acquired, so the sprites are always created in the thread that
+* acquires them, the one with the window.
+*
+*/
+class AssetCache
+{
+public:
+  /** @brief Gets the instance of the AssetCache
+  *
+  * There is one cache per process so every world shares the sprites.
+  *
+  * @return AssetCache& instance
+  */
+  static AssetCache& instance();
+  /** @brief Changes how the sprites are created and released
+  *
+  * Must be called before any sprite is acquired.
+  *
+  * @param backend functions used to create and release the sprites
+  * @return void
+  */
+  void set_backend(const SpriteBackend& backend);
+  /** @brief Starts to decode an image in the loader thread
+  *
+  * Does nothing if the path is already loaded or being loaded.
+  *
+  * @param path path of the image
+  * @return void
+  */
+  void preload(const char* path);
+  /** @brief Gets the sprite of an image
+  *
+  * The first time a path is acquired it's decoded, waiting for the loader
+  * thread if it was preloaded, and its sprite is created. Every sprite
+  * acquired must be released.
+  *
+  * @param path path of the image
+  * @return ESAT::SpriteHandle sprite shared by every user of the path, nullptr if it couldn't be loaded
+  */
+  ESAT::SpriteHandle acquire(const char* path);
+  /** @brief Releases a sprite acquired from the cache
+  *
+  * The sprite is destroyed once every user has released it.
+  *
+  * @param sprite sprite acquired
+  * @return void
+  */
+  void release(ESAT::SpriteHandle sprite);
+  /** @brief Gets the size of the image of a sprite acquired from the cache
+  *
+  * @param sprite sprite acquired
+  * @param width width of the image
+  * @param height height of the image
+  * @return bool false if the sprite was not acquired from the cache
+  */
+  bool size(ESAT::SpriteHandle sprite, s32* width, s32* height) const;
+  /** @brief returns the loads done by the cache
+  *
+  * @return AssetCacheStats loads and bytes of the cache
+  */
+  AssetCacheStats stats() const;
+  /** @brief Prints the loads done by the cache
+  *
+  * @return void
+  */
+  void printStats() const;
+
+private:
+  /** @brief AssetCache constructor
+  *
+  * Uses the sprites of ESAT, the loader thread starts with the first preload
+  *
+  * @return *AssetCache
+  */
+  AssetCache();
+  /** @brief AssetCache destructor
+  *
+  * Stops the loader thread and frees the images decoded and not acquired
+  *
+  * @return void
+  */
+  ~AssetCache();
+  /** @brief AssetCache copy constructor
+  *
+  * The cache cannot be copied
+  *
+  * @return *AssetCache
+  */
+  AssetCache(const AssetCache& other) = delete;
+  /** @brief AssetCache copy operation
+  *
+  * The cache cannot be copied
+  *
+  * @return AssetCache&
+  */
+  AssetCache& operator=(const AssetCache& other) = delete;
+
+  /** @brief AssetEntry struct
+  *
+  * Path known by the cache, pixels is set between the decode and the
+  * creation of the sprite.
+  *
+  */
+  struct AssetEntry
+  {
+    ESAT::SpriteHandle sprite = nullptr;
+    u32 references = 0;
+    s32 width = 0;
+    s32 height = 0;
+    unsigned char* pixels = nullptr;
+    bool decoding = false;
+  };
+
+  /** @brief Decodes an image into its entry
+  *
+  * Called without the lock taken, the entry must be marked as decoding.
+  *
+  * @param path path of the image
+  * @return void
+  */
+  void decode(const std::string& path);
+  /** @brief Decodes the preloaded images until the cache is destroyed
+  *
+  * @return void
+  */
+  void loaderLoop();
+
+  SpriteBackend backend_;
+
+  std::unordered_map<std::string, AssetEntry> entries_;
+
+  //Path of every sprite created, to find its entry when it's released
+  std::unordered_map<ESAT::SpriteHandle, std::string> paths_;
+
+  //Paths waiting for the loader thread
+  std::deque<std::string> queue_;
+
+  std::thread loader_;
+
+  bool quit_;
+
+  AssetCacheStats stats_;
+
+  mutable std::mutex mutex_;
+
+  //stb_image keeps the reason of the last failure in a global, the decodes run one at a time
+  std::mutex decode_mutex_;
+
+  //Signaled when a path is queued and when a decode finishes
+  std::condition_variable queued_;
+  std::condition_variable decoded_;
+};
+
+#endif
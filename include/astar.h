@@ -6,10 +6,15 @@
 
 #include "platform_types.h"
 #include "Math/float2.h"
+#include "path_stats.h"
 #include <vector>
+#include <queue>
+#include <atomic>
+#include <mutex>
 
 class Map;
 class Path;
+class OccupancyGrid;
 /** @brief AStarNode struct
 *
 * Struct that represents a node generated by the A* algorithm
@@ -65,6 +70,203 @@ enum class AStarStatus
   k_Calculating = 1,
   k_PADDING = 255
 };
+
+enum class AStarMode
+{
+  k_Classic = 0,
+  k_Bidirectional = 1,
+  k_BidirectionalDijkstra = 2,
+  k_CoarseToFine = 3,
+  k_HashDistributed = 4,
+  k_PADDING = 255
+};
+
+enum class DynamicObstacles
+{
+  k_Ignore = 0,
+  k_Blocked = 1,
+  k_ExtraCost = 2,
+  k_PADDING = 255
+};
+//Biggest cost added to the steps into cells with agents
+const u16 kMaxDynamicExtraCost = 1000;
+/** @brief AStarCounters struct
+*
+* Work done by a search, or by one of its frontiers or threads
+*
+*/
+struct AStarCounters
+{
+  u64 expanded = 0;
+  u64 generated = 0;
+  u64 duplicates = 0;
+  u64 reopened = 0;
+  u64 peak_open = 0;
+};
+/** @brief AStarOpenEntry struct
+*
+* Entry of the open list of a frontier. Entries are never updated, when a better
+* g is found for a cell a new entry is pushed and the old one is discarded when popped.
+*
+*/
+struct AStarOpenEntry
+{
+  u32 f;
+  u32 g;
+  s32 cell;
+  /** @brief Orders the entries so the lowest f is on top of the queue
+  *
+  * Orders the entries so the lowest f is on top of the queue, ties are broken
+  * towards the highest g (the deepest node).
+  *
+  * @return bool true if this entry must be popped after other
+  */
+  bool operator<(const AStarOpenEntry& other) const;
+};
+/** @brief AStarFrontier struct
+*
+* Search state of one of the two frontiers of the bidirectional search. The cells
+* are indexed as x + y * width of the collision map. The g values are atomic as
+* the opposite frontier reads them to detect the meeting point when both frontiers
+* run in different threads.
+*
+*/
+struct AStarFrontier
+{
+  std::atomic<u32>* g = nullptr;
+  s32* parent = nullptr;
+  u8* closed = nullptr;
+  s32 capacity = 0;
+  std::priority_queue<AStarOpenEntry> open;
+  s32 root = -1;
+  s32 target = -1;
+  //Lower bound of the cost of any path still reachable through this frontier
+  std::atomic<u32> min_key;
+  //Only written by the thread that expands the frontier
+  AStarCounters counters;
+  /** @brief AStarFrontier constructor
+  *
+  * Default AStarFrontier constructor, it has no memory until reset is called
+  *
+  * @return *AStarFrontier
+  */
+  AStarFrontier();
+  /** @brief AStarFrontier destructor
+  *
+  * Frees the memory of the frontier
+  *
+  * @return *AStarFrontier
+  */
+  ~AStarFrontier();
+  /** @brief Prepares the frontier for a new search
+  *
+  * Grows the buffers if the map has more cells than the previous one and
+  * sets every cell as not reached.
+  *
+  * @param cells number of cells of the collision map
+  * @return bool false if the memory could not be allocated
+  */
+  bool reset(const s32 cells);
+  /** @brief frees the memory of the frontier
+  *
+  * Frees the memory of the frontier
+  *
+  * @return void
+  */
+  void release();
+};
+/** @brief AStarMessage struct
+*
+* Node generated by a worker of the hash distributed search for a cell owned
+* by another worker.
+*
+*/
+struct AStarMessage
+{
+  s32 cell;
+  s32 parent;
+  u32 g;
+};
+/** @brief AStarMessageQueue struct
+*
+* Lock free ring of messages with a single producer and a single consumer. Every
+* pair of workers of the hash distributed search has its own ring, so the inbox
+* of a worker is a lock free queue with many producers and one consumer.
+*
+*/
+struct AStarMessageQueue
+{
+  AStarMessage* buffer = nullptr;
+  u32 capacity = 0;
+  //Read by the consumer and written by the producer, kept in different cache lines
+  std::atomic<u32> head;
+  u8 head_padding[60];
+  std::atomic<u32> tail;
+  u8 tail_padding[60];
+  /** @brief AStarMessageQueue constructor
+  *
+  * Default AStarMessageQueue constructor, it has no memory until reset is called
+  *
+  * @return *AStarMessageQueue
+  */
+  AStarMessageQueue();
+  /** @brief AStarMessageQueue destructor
+  *
+  * Frees the buffer of the queue
+  *
+  * @return *AStarMessageQueue
+  */
+  ~AStarMessageQueue();
+  /** @brief Empties the queue
+  *
+  * Allocates the buffer the first time and discards the messages in it
+  *
+  * @param size number of messages the ring can store, must be a power of 2
+  * @return bool false if the memory could not be allocated
+  */
+  bool reset(const u32 size);
+  /** @brief Adds a message, only called by the producer
+  *
+  * @param message message to add
+  * @return bool false if the queue is full
+  */
+  bool push(const AStarMessage& message);
+  /** @brief Takes the oldest message, only called by the consumer
+  *
+  * @param message where the message is stored
+  * @return bool false if the queue is empty
+  */
+  bool pop(AStarMessage* message);
+};
+/** @brief AStarWorker struct
+*
+* State of a thread of the hash distributed search. A worker only expands the
+* cells it owns, the rest are sent to their owners.
+*
+*/
+struct AStarWorker
+{
+  std::priority_queue<AStarOpenEntry> open;
+  //Messages that didn't fit in the ring of each destination
+  std::vector<std::vector<AStarMessage>> outbox;
+  //An active worker is counted in the busy counter of the search
+  bool active = false;
+  AStarCounters counters;
+  u64 messages = 0;
+};
+/** @brief AStarParallelStats struct
+*
+* Statistics of the last hash distributed search
+*
+*/
+struct AStarParallelStats
+{
+  u32 threads;
+  u32 cost;
+  u64 expansions;
+  u64 max_thread_expansions;
+  u64 messages;
+};
 /** @brief AStar class
 *
 * Class that runs the A* algorithm to search for the best path between an origin and a
@@ -91,7 +293,8 @@ public:
   /** @brief Generates the best path path from origin to destination
   *
   * Generates the best path from origin to destination without interruptions and stores it
-  * in path. The results this function can give are the following ones.
+  * in path. The search used is the one set with set_mode.
+  * The results this function can give are the following ones.
   * kErrorCode_InvalidPointer-> The path passed is incorrect
   * kErrorCode_InvalidOrigin-> The origin passed is incorrect for the map
   * kErrorCode_InvalidDestination-> The destination is invalid for the map
@@ -111,7 +314,8 @@ public:
   /** @brief Generates the best path path from origin to destination
   *
   * Generates the best path from origin to destination if it has time and stores it
-  * in path. The results this function can give are the following ones.
+  * in path. The search used is the one set with set_mode.
+  * The results this function can give are the following ones.
   * kErrorCode_InvalidPointer-> The path passed is incorrect
   * kErrorCode_InvalidOrigin-> The origin passed is incorrect for the map
   * kErrorCode_InvalidDestination-> The destination is invalid for the map
@@ -131,6 +335,183 @@ public:
   * @return s16 result of the operation
   */
   s16 generatePath(Float2 origin, Float2 dst, Path* path, const Map& collisionData, double timeout);
+  /** @brief sets the search used by generatePath
+  *
+  * Sets the search used by generatePath:
+  * k_Classic -> Unidirectional A*
+  * k_Bidirectional -> A* from the origin and from the destination at the same time,
+  *   the search stops once no path through the frontiers can improve the best
+  *   meeting point found so the result is still the optimal one.
+  * k_BidirectionalDijkstra -> Same as k_Bidirectional without heuristic.
+  * k_CoarseToFine -> A* at the coarsest level of the map, then at each finer level
+  *   inside a corridor around the path of the previous level. If the corridor does
+  *   not contain a path the level is searched again without it. The path is
+  *   calculated at level 0 so use Map::buildLevels before.
+  * k_HashDistributed -> A* expanded by several threads (HDA*), each cell is owned
+  *   by the thread its hash selects and the nodes are sent to their owner, check
+  *   set_num_threads. The path is the optimal one.
+  * The mode can't be changed while a path is being calculated, in that case
+  * kErrorCode_Timeout is returned.
+  *
+  * @param mode search that will be used
+  * @return s16 result of the operation
+  */
+  s16 set_mode(AStarMode mode);
+  /** @brief returns the search used by generatePath
+  *
+  * Returns the search used by generatePath
+  *
+  * @return AStarMode mode of the search
+  */
+  AStarMode mode() const;
+  /** @brief sets if the bidirectional frontiers run in their own threads
+  *
+  * When enabled the forward and backward frontiers of the bidirectional modes
+  * are expanded by two threads that share the meeting point. It has no effect
+  * on the classic mode.
+  *
+  * @param threaded true to expand each frontier in its own thread
+  * @return void
+  */
+  void set_threaded(bool threaded);
+  /** @brief sets the width of the corridor of the coarse to fine search
+  *
+  * Sets how many cells of the coarser level around the coarser path are
+  * searched at the next level. Wider corridors give paths closer to the optimal one
+  * at the cost of more expanded nodes.
+  *
+  * @param radius cells of the coarser level around its path, 1 by default
+  * @return void
+  */
+  void set_corridor_radius(u8 radius);
+  /** @brief sets the threads of the hash distributed search
+  *
+  * Sets how many threads expand the nodes in k_HashDistributed mode, the caller
+  * thread is one of them. It can't be changed while a path is being calculated,
+  * in that case kErrorCode_Timeout is returned.
+  *
+  * @param num_threads threads of the search, 0 uses one per core
+  * @return s16 result of the operation
+  */
+  s16 set_num_threads(u32 num_threads);
+  /** @brief returns the statistics of the last hash distributed search
+  *
+  * Returns the threads, cost of the path, expanded nodes and messages between
+  * threads of the last search done in k_HashDistributed mode.
+  *
+  * @return AStarParallelStats statistics of the search
+  */
+  AStarParallelStats parallelStats() const;
+  /** @brief returns the statistics of the paths calculated
+  *
+  * Every path that finished since the last resetStats, whatever its result.
+  * The calls that returned kErrorCode_Timeout are part of the query they
+  * continue.
+  *
+  * @return const PathStats& statistics of the paths
+  */
+  const PathStats& stats() const;
+  /** @brief returns the statistics of the last path that finished
+  *
+  * @return PathQueryStats statistics of the path
+  */
+  PathQueryStats lastQuery() const;
+  /** @brief Removes the paths counted by stats
+  *
+  * @return void
+  */
+  void resetStats();
+  /** @brief calculates the octile distance between two cells
+  *
+  * Exact cost between two cells of a map without obstacles using the step costs
+  * of the search. It never overestimates so the searches that use it stay optimal.
+  *
+  * @param cell cell index of the first cell
+  * @param target cell index of the second cell
+  * @param width width of the collision map
+  * @return u32 estimated cost
+  */
+  u32 octileHeuristic(const s32 cell, const s32 target, const s32 width) const;
+  /** @brief gets a neighbour of a cell and the cost of the step to it
+  *
+  * The searches of the grid expand the 8 neighbours of a cell with these steps.
+  *
+  * @param cell cell index of the cell
+  * @param direction neighbour, from 0 to 7
+  * @param width width of the collision map
+  * @param neighbour_x x of the neighbour, it can be outside of the map
+  * @param neighbour_y y of the neighbour, it can be outside of the map
+  * @return u32 cost of the step
+  */
+  u32 neighbour(const s32 cell, const s32 direction, const s32 width, s32* neighbour_x, s32* neighbour_y) const;
+  /** @brief sets if the search prints its progress
+  *
+  * The progress is not printed by default, printing every path costs more
+  * than many of the searches.
+  *
+  * @param logging true to print when a path starts and finishes
+  * @return void
+  */
+  void set_logging(bool logging);
+  /** @brief sets the size of the agent the paths are calculated for
+  *
+  * Sets the clearance (size in cells of the collision map) the cells of the path
+  * need, check Map::clearance. Every search uses the precalculated clearance of the
+  * map so bigger agents cost the same as agents of one cell. A clearance of 0 is
+  * treated as 1. It can't be changed while a path is being calculated, in that case
+  * kErrorCode_Timeout is returned.
+  *
+  * @param clearance size in cells of the agent, 1 by default
+  * @return s16 result of the operation
+  */
+  s16 set_clearance(u8 clearance);
+  /** @brief sets how the searches treat the cells occupied by agents
+  *
+  * With k_Blocked the cells with agents can't be crossed, with k_ExtraCost
+  * entering them costs extra_cost more (a straight step costs 10). The cell
+  * of the destination is never affected, the agent may be going to another
+  * agent. A path calculated in several calls sees the agents as they are at
+  * each call. k_CoarseToFine only applies them to the cells of the map, not
+  * to its levels. It can't be changed while a path is being calculated, in
+  * that case kErrorCode_Timeout is returned.
+  *
+  * @param occupancy agents in the cells of the map searched, nullptr with k_Ignore
+  * @param mode k_Ignore by default
+  * @param extra_cost cost added by k_ExtraCost, at most kMaxDynamicExtraCost
+  * @return s16 kErrorCode_InvalidPointer without grid for k_Blocked or k_ExtraCost
+  */
+  s16 set_dynamic_obstacles(const OccupancyGrid* occupancy, DynamicObstacles mode, u16 extra_cost = 20);
+  /** @brief restricts the searches to a corridor of zones
+  *
+  * The cells outside the zones marked in the corridor are treated as blocked,
+  * check ZoneGraph::findCorridor. The corridor is read during the searches,
+  * it must live until it's changed. k_CoarseToFine only applies it to the
+  * cells of the map, not to its levels. It can't be changed while a path is
+  * being calculated, in that case kErrorCode_Timeout is returned.
+  *
+  * @param corridor 1 for each zone of Map::zones() that can be crossed, nullptr to search the whole map
+  * @return s16 result of the operation
+  */
+  s16 set_zone_corridor(const std::vector<u8>* corridor);
+  /** @brief returns the corridor of zones the searches are restricted to
+  *
+  * @return const std::vector<u8>* corridor set with set_zone_corridor, nullptr without one
+  */
+  const std::vector<u8>* zoneCorridor() const;
+  /** @brief Abandons the path being calculated
+  *
+  * Frees the nodes and open lists of a path that returned kErrorCode_Timeout,
+  * the buffers sized for the map are kept for the next path. The path is not
+  * counted in the statistics. Nothing is done if no path is being calculated.
+  *
+  * @return void
+  */
+  void cancel();
+  /** @brief checks if a path is being calculated
+  *
+  * @return bool true if the last path returned kErrorCode_Timeout
+  */
+  bool isCalculating() const;
 
 private:
 
@@ -139,6 +520,56 @@ private:
   std::vector<AStarNode*> closed_list_;
 
   u16 base_step_cost_;
+
+  u8 clearance_;
+
+  bool logging_;
+
+  PathStats stats_;
+
+  PathQueryStats last_query_;
+
+  //Time when the path being calculated was asked for the first time
+  double query_start_;
+  /** @brief Calculates a path without time limit
+  *
+  * Search of generatePath, it doesn't count the query.
+  *
+  * @param origin origin point from we want to start the path
+  * @param dst destination point at we want to end the path
+  * @param path path that will contain the result
+  * @param collisionData collision information of the map
+  * @return s16 result of the operation, check generatePath
+  */
+  s16 searchPath(Float2 origin, Float2 dst, Path* path, const Map& collisionData);
+  /** @brief Calculates a path within a time
+  *
+  * Search of generatePath with timeout, it doesn't count the query.
+  *
+  * @param origin origin point from we want to start the path
+  * @param dst destination point at we want to end the path
+  * @param path path that will contain the result
+  * @param collisionData collision information of the map
+  * @param timeout time the algorithm has to find the path
+  * @return s16 result of the operation, check generatePath
+  */
+  s16 searchPath(Float2 origin, Float2 dst, Path* path, const Map& collisionData, double timeout);
+  /** @brief Starts counting a query
+  *
+  * Resets the counters of the frontiers, the workers are reset when the
+  * hash distributed search starts.
+  *
+  * @return void
+  */
+  void beginQuery();
+  /** @brief Adds the query that finished to the statistics
+  *
+  * Adds the counters of the frontiers or workers used by the mode.
+  *
+  * @param result result of the query
+  * @return void
+  */
+  void endQuery(const s16 result);
   /** @brief checks if an equivalent node is in the closed list
   *
   * Checks if an equivalent node is in the closed list (which means if it has the same position).
@@ -186,14 +617,316 @@ private:
   * @return void
   */
   u32 calculateHeuristic(const Float2& origin, const Float2& dst) const;
+  /** @brief Applies the agents of the occupancy grid to a step
+  *
+  * @param cell cell the step enters
+  * @param goal cell of the destination
+  * @param step_cost cost of the step, increased with k_ExtraCost
+  * @return bool false if the step is blocked by agents
+  */
+  bool applyDynamicObstacles(const Float2& cell, const Float2& goal, u16* step_cost) const;
+  /** @brief Applies the agents of the occupancy grid to a step of the searches of the grid
+  *
+  * @param cell cell index the step enters
+  * @param goal cell index of the destination
+  * @param width width of the collision map
+  * @param step_cost cost of the step, increased with k_ExtraCost
+  * @return bool false if the step is blocked by agents
+  */
+  bool applyDynamicObstacles(const s32 cell, const s32 goal, const s32 width, u32* step_cost) const;
+  /** @brief checks if a cell is inside the zone corridor
+  *
+  * @param collisionData map whose zones the corridor marks
+  * @param cell cell the step enters
+  * @return bool true without corridor or if the zone of the cell is in it
+  */
+  bool isInZoneCorridor(const Map& collisionData, const Float2& cell) const;
+  /** @brief checks if a cell of the searches of the grid is inside the zone corridor
+  *
+  * @param collisionData map whose zones the corridor marks
+  * @param x x of the cell the step enters
+  * @param y y of the cell the step enters
+  * @return bool true without corridor or if the zone of the cell is in it
+  */
+  bool isInZoneCorridor(const Map& collisionData, const s32 x, const s32 y) const;
 
   AStarStatus actual_state_;
 
+  const OccupancyGrid* occupancy_;
+
+  DynamicObstacles dynamic_obstacles_;
+
+  u16 dynamic_extra_cost_;
+
+  const std::vector<u8>* zone_corridor_;
+
   AStarNode* node_goal = nullptr;
 
   AStarNode* node_start = nullptr;
 
   AStarNode* node_current = nullptr;
+
+  AStarMode mode_;
+
+  bool threaded_;
+
+  AStarFrontier forward_;
+
+  AStarFrontier backward_;
+
+  //Cost of the best path found between the frontiers and the cell where they met
+  std::atomic<u32> best_cost_;
+
+  s32 meeting_cell_;
+
+  std::mutex meeting_mutex_;
+
+  std::atomic<bool> frontiers_done_;
+
+  //Coarse to fine search state
+  u8 search_level_;
+
+  u8 corridor_radius_;
+
+  bool corridor_active_;
+
+  std::vector<u8> corridor_;
+
+  s32 origin_cell_;
+
+  s32 dst_cell_;
+
+  //Hash distributed search state
+  u32 num_threads_;
+
+  u32 hda_threads_;
+
+  std::vector<AStarWorker> workers_;
+
+  //Ring from worker i to worker j at i * hda_threads_ + j
+  AStarMessageQueue* queues_;
+
+  u32 num_queues_;
+
+  std::vector<u32> hda_g_;
+
+  std::vector<s32> hda_parent_;
+
+  //Zobrist keys of the columns and rows of blocks of cells
+  std::vector<u32> zobrist_x_;
+
+  std::vector<u32> zobrist_y_;
+
+  //Active workers plus messages sent and not yet received
+  std::atomic<s64> busy_;
+
+  std::atomic<bool> hda_done_;
+
+  std::atomic<bool> hda_timeout_;
+  /** @brief Starts a coarse to fine search
+  *
+  * Starts the search at the coarsest level of the map between origin and dst
+  * (in collision map coordinates). The possible results are:
+  * kErrorCode_Memory -> The buffers of the search could not be allocated
+  * kErrorCode_Ok -> The search can be advanced with stepCoarseToFine
+  *
+  * @param origin cell where the path starts
+  * @param dst cell where the path ends
+  * @param collisionData collision information of the map
+  * @return s16 result of the operation
+  */
+  s16 startCoarseToFine(const Float2& origin, const Float2& dst, const Map& collisionData);
+  /** @brief Advances the coarse to fine search
+  *
+  * Advances the search of the current level and, once it finishes, starts the
+  * next finer level until level 0 is solved or there is no path (timeout < 0
+  * means no limit). The possible results are:
+  * kErrorCode_Timeout -> The search is not finished, call it again to continue
+  * kErrorCode_Memory -> The buffers of the search could not be allocated
+  * kErrorCode_PathNotFound -> There is not a path from origin to dst
+  * kErrorCode_Ok -> The path is stored at path
+  *
+  * @param path path that will contain the result
+  * @param collisionData collision information of the map
+  * @param timeout time in ms the search can run
+  * @return s16 result of the operation
+  */
+  s16 stepCoarseToFine(Path* path, const Map& collisionData, double timeout);
+  /** @brief Starts the search of a level
+  *
+  * Prepares the forward frontier to search search_level_ between the cells
+  * of origin_cell_ and dst_cell_ at that level, restricted to the corridor if
+  * corridor_active_ is set.
+  *
+  * @param collisionData collision information of the map
+  * @return bool false if the memory could not be allocated
+  */
+  bool startLevel(const Map& collisionData);
+  /** @brief Expands one node of the search of a level
+  *
+  * Pops the best node of the forward frontier and relaxes its neighbours that
+  * are free at search_level_ and inside the corridor.
+  *
+  * @param collisionData collision information of the map
+  * @return s16 kErrorCode_Ok when the goal is reached, kErrorCode_PathNotFound
+  *   when the level has no path and kErrorCode_Timeout while it is searching
+  */
+  s16 expandLevel(const Map& collisionData);
+  /** @brief Marks the corridor of the next finer level
+  *
+  * Marks the cells of the next finer level covered by the cells around the
+  * path found at search_level_.
+  *
+  * @param collisionData collision information of the map
+  * @return void
+  */
+  void buildCorridor(const Map& collisionData);
+  /** @brief Writes the path found at level 0
+  *
+  * Follows the parents from the goal and stores the points at path.
+  *
+  * @param path path that will contain the result
+  * @param parent parent of each cell, -1 at the origin
+  * @param target cell where the path ends
+  * @param collisionData collision information of the map
+  * @return s16 result of the operation
+  */
+  s16 buildForwardPath(Path* path, const s32* parent, const s32 target, const Map& collisionData);
+  /** @brief Starts a hash distributed search
+  *
+  * Prepares the workers, rings and costs for a search between origin and dst
+  * (in collision map coordinates) and gives the origin to its owner.
+  * The possible results are:
+  * kErrorCode_Memory -> The buffers of the search could not be allocated
+  * kErrorCode_Ok -> The search can be advanced with stepHashDistributed
+  *
+  * @param origin cell where the path starts
+  * @param dst cell where the path ends
+  * @param collisionData collision information of the map
+  * @return s16 result of the operation
+  */
+  s16 startHashDistributed(const Float2& origin, const Float2& dst, const Map& collisionData);
+  /** @brief Advances the hash distributed search
+  *
+  * Runs the workers until no worker is active and no message is in flight,
+  * or until the timeout expires (timeout < 0 means no limit).
+  * When the search ends the path is written. The possible results are:
+  * kErrorCode_Timeout -> The search is not finished, call it again to continue
+  * kErrorCode_PathNotFound -> There is not a path from origin to dst
+  * kErrorCode_Ok -> The path is stored at path
+  *
+  * @param path path that will contain the result
+  * @param collisionData collision information of the map
+  * @param timeout time in ms the search can run
+  * @return s16 result of the operation
+  */
+  s16 stepHashDistributed(Path* path, const Map& collisionData, double timeout);
+  /** @brief Loop of a worker of the hash distributed search
+  *
+  * Receives the messages of the worker, expands its best node and goes idle
+  * when it has nothing that can improve the best path. The worker that sees
+  * the busy counter at 0 ends the search.
+  *
+  * @param id index of the worker
+  * @param collisionData collision information of the map
+  * @param start_time time at which the current call started
+  * @param timeout time in ms the search can run, negative for no limit
+  * @return void
+  */
+  void runHashDistributedWorker(const u32 id, const Map& collisionData, double start_time, double timeout);
+  /** @brief Updates the cost of a cell owned by a worker
+  *
+  * Stores the new cost and parent of the cell if it improves the known one,
+  * pushes it to the open list of the worker and updates the best path cost
+  * when the cell is the destination.
+  *
+  * @param id index of the worker that owns the cell
+  * @param message cell, parent and cost reached
+  * @param width width of the collision map
+  * @return void
+  */
+  void relaxOwnedCell(const u32 id, const AStarMessage& message, const s32 width);
+  /** @brief Sends a node to the worker that owns its cell
+  *
+  * @param id index of the sender
+  * @param owner index of the receiver
+  * @param message cell, parent and cost reached
+  * @return void
+  */
+  void sendToOwner(const u32 id, const u32 owner, const AStarMessage& message);
+  /** @brief returns the worker that owns a cell
+  *
+  * The cells are grouped in blocks, each block is hashed with the Zobrist keys
+  * of its column and row so the neighbours of a cell are usually owned by the
+  * same worker.
+  *
+  * @param cell cell index
+  * @param width width of the collision map
+  * @return u32 index of the owner
+  */
+  u32 cellOwner(const s32 cell, const s32 width) const;
+  /** @brief Starts a bidirectional search
+  *
+  * Prepares both frontiers for a search between origin and dst (in collision
+  * map coordinates). The possible results are:
+  * kErrorCode_Memory -> The frontiers could not allocate their buffers
+  * kErrorCode_Ok -> The search can be advanced with stepBidirectional
+  *
+  * @param origin cell where the path starts
+  * @param dst cell where the path ends
+  * @param collisionData collision information of the map
+  * @return s16 result of the operation
+  */
+  s16 startBidirectional(const Float2& origin, const Float2& dst, const Map& collisionData);
+  /** @brief Advances the bidirectional search
+  *
+  * Expands the frontiers until they are proven to have found the best path,
+  * until there is no path or until the timeout expires (timeout < 0 means no limit).
+  * When the search ends the path is written. The possible results are:
+  * kErrorCode_Timeout -> The search is not finished, call it again to continue
+  * kErrorCode_PathNotFound -> There is not a path from origin to dst
+  * kErrorCode_Ok -> The path is stored at path
+  *
+  * @param path path that will contain the result
+  * @param collisionData collision information of the map
+  * @param timeout time in ms the search can run
+  * @return s16 result of the operation
+  */
+  s16 stepBidirectional(Path* path, const Map& collisionData, double timeout);
+  /** @brief Expands one node of a frontier
+  *
+  * Pops the best node of the frontier and relaxes its neighbours, updating the
+  * meeting point if a neighbour was already reached by the other frontier.
+  *
+  * @param frontier frontier to expand
+  * @param other opposite frontier
+  * @param collisionData collision information of the map
+  * @return bool false once the frontier can't improve the best path
+  */
+  bool expandFrontier(AStarFrontier& frontier, const AStarFrontier& other, const Map& collisionData);
+  /** @brief Expands a frontier until the search ends
+  *
+  * Loop run by each thread of the threaded bidirectional search.
+  *
+  * @param frontier frontier to expand
+  * @param other opposite frontier
+  * @param collisionData collision information of the map
+  * @param start_time time at which the current call started
+  * @param timeout time in ms the search can run, negative for no limit
+  * @return void
+  */
+  void runFrontier(AStarFrontier& frontier, const AStarFrontier& other,
+                   const Map& collisionData, double start_time, double timeout);
+  /** @brief Writes the path through the meeting cell
+  *
+  * Joins the branch of the forward frontier and the branch of the backward
+  * frontier at the meeting cell and stores the points at path.
+  *
+  * @param path path that will contain the result
+  * @param collisionData collision information of the map
+  * @return s16 result of the operation
+  */
+  s16 buildBidirectionalPath(Path* path, const Map& collisionData);
   /** @brief AStar copy constructor
   *
   * The AStar cannot be copied
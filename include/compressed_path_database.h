@@ -0,0 +1,167 @@
+// compressed_path_database.h
+// Jose Maria Martinez
+// Header of the compressed path database
+#ifndef __COMPRESSED_PATH_DATABASE_H__
+#define __COMPRESSED_PATH_DATABASE_H__
+
+#include "platform_types.h"
+#include "mapped_file.h"
+#include "Math/float2.h"
+
+class Map;
+class Path;
+
+//Version of the file format, files with another version are rejected
+const u32 kCPDVersion = 1;
+//First move stored for targets that can't be reached from the source
+const u8 kCPDNoMove = 8;
+
+/** @brief Header of a compressed path database file
+*
+* It's followed by cells + 1 offsets of the first run of each source and
+* by the runs, each run is the first target it covers << 4 | first move.
+*
+*/
+struct CPDHeader
+{
+  char magic[4];
+  u32 version;
+  s32 width;
+  s32 height;
+  u64 map_hash;
+  u32 num_runs;
+  u32 padding;
+};
+
+/** @brief Compressed path database
+*
+* Stores for every pair of free cells of a map the first move of an optimal
+* path between them. The moves of each source are stored in row order of the
+* targets compressed in runs, occupied targets are not needed so they
+* extend the current run. Paths are extracted following the first moves
+* without any search, the database is built offline and memory mapped.
+*
+*/
+class CompressedPathDatabase
+{
+public:
+  /** @brief CompressedPathDatabase constructor
+  *
+  * Default constructor, no database is loaded
+  *
+  * @return *CompressedPathDatabase
+  */
+  CompressedPathDatabase();
+  /** @brief Destroys the CompressedPathDatabase
+  *
+  * Destructor of the database, unmaps the file if it was loaded
+  *
+  * @return void
+  */
+  ~CompressedPathDatabase();
+  /** @brief Builds the database of a map
+  *
+  * Runs a Dijkstra search from every free cell of the map using the same
+  * moves and costs as the A* and writes the compressed first moves to a file.
+  * The sources are distributed between the threads. The cost grows with
+  * the square of the number of cells so it is meant for small maps.
+  * The possible results of this operation are:
+  * kErrorCode_InvalidPointer -> The file was nullptr
+  * kErrorCode_PathNotCreated -> The map has no collision data
+  * kErrorCode_Memory -> The program was unable of allocating memory
+  * kErrorCode_File -> The file could not be written
+  * kErrorCode_Ok -> Everything went fine
+  *
+  * @param map map whose paths will be stored
+  * @param file path of the database that will be written
+  * @param num_threads threads used to build it, 0 uses one per core
+  * @return s16 status of the operation
+  */
+  static s16 build(const Map& map, const char* file, u32 num_threads);
+  /** @brief Loads a database
+  *
+  * Maps a database file in memory. The size and hash of the map must be the
+  * ones the database was built with.
+  * The possible results of this operation are:
+  * kErrorCode_InvalidPointer -> The file was nullptr
+  * kErrorCode_File -> The file does not exist, is corrupted or belongs to another map
+  * kErrorCode_Ok -> Everything went fine
+  *
+  * @param file path of the database
+  * @param map map the database will be used with
+  * @return s16 status of the operation
+  */
+  s16 load(const char* file, const Map& map);
+  /** @brief Unloads the database
+  *
+  * @return void
+  */
+  void unload();
+  /** @brief returns if there's a database loaded
+  *
+  * @return bool true if a database is loaded
+  */
+  bool isLoaded() const;
+  /** @brief returns the first move from a source to a target
+  *
+  * @param source cell index of the origin
+  * @param target cell index of the destination
+  * @return u8 index of the direction, in the order used by the A*, or kCPDNoMove
+  */
+  u8 firstMove(const s32 source, const s32 target) const;
+  /** @brief generates a path from origin to dst
+  *
+  * Extracts a path following the first moves of the database, the positions
+  * use the same scale as the A*.
+  * The possible values it can return are:
+  *  kErrorCode_PathNotCreated if there's no database or the path has too many points
+  *  kErrorCode_InvalidOrigin if the origin is not a valid position
+  *  kErrorCode_InvalidDestination if dst is not a valid position
+  *  kErrorCode_PathNotFound if there's not a path that connects origin and dst
+  *  kErrorCode_Ok the path was correctly extracted
+  *
+  * @param origin origin point from which the path will be calculated
+  * @param dst destination of the path
+  * @param path Path in which the result will be stored
+  * @param map map the database was loaded for
+  * @return s16
+  */
+  s16 generatePath(Float2 origin, Float2 dst, Path* path, const Map& map) const;
+  /** @brief sets if generatePath prints why a path failed
+  *
+  * Nothing is printed by default, the result is returned and counted by
+  * the PathStats of the PathFinder.
+  *
+  * @param logging true to print the paths that fail
+  * @return void
+  */
+  void set_logging(bool logging);
+
+private:
+
+  MappedFile file_;
+
+  bool logging_;
+
+  const CPDHeader* header_;
+
+  const u32* row_offsets_;
+
+  const u32* runs_;
+  /** @brief CompressedPathDatabase copy constructor
+  *
+  * The database cannot be copied
+  *
+  * @return *CompressedPathDatabase
+  */
+  CompressedPathDatabase(const CompressedPathDatabase& other) = delete;
+  /** @brief CompressedPathDatabase copy operation
+  *
+  * The database cannot be copied
+  *
+  * @return *CompressedPathDatabase
+  */
+  CompressedPathDatabase operator=(const CompressedPathDatabase& other) = delete;
+};
+
+#endif
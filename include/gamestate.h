@@ -5,19 +5,15 @@
 #ifndef __GAME_STATE_H__
 #define __GAME_STATE_H__
 
-#include <agent.h>
-#include <cstdint>
-#include <vector>
-#include "map.h"
-
-class PathFinder;
+#include "world.h"
 
 /** @brief GameState entity
 *
-* Game State of our game based in a Singleton pattern. 
+* Game State of our game based in a Singleton pattern. It's the world of
+* the projects with window.
 *
 */
-class GameState {
+class GameState : public World {
 
 private:
   /** @brief Game state constructor
@@ -63,14 +59,8 @@ public:
 
   uint32_t num_agents_;
 
-  std::vector<Agent*> agents_;
-
-  PathFinder* pf_agent_;
-
   uint32_t frequency_;
 
-  Map map_;
-
 };
 
 #endif
\ No newline at end of file
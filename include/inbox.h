@@ -0,0 +1,88 @@
+// inbox.h
+// Jose Maria Martinez
+// Header of the inbox where an agent receives its messages
+#ifndef __INBOX_H__
+#define __INBOX_H__
+
+#include "message.h"
+
+//Must be a power of two
+const u32 kInboxCapacity = 8;
+
+/** @brief Inbox class
+*
+* Ring buffer with the messages received by an agent and not read yet. The
+* capacity is fixed so every agent has the same small footprint no matter how
+* many agents there are, the messages that don't fit are kept by the
+* dispatcher until there is room.
+*
+*/
+class Inbox
+{
+public:
+  /** @brief Inbox constructor
+  *
+  * Default Inbox constructor, the inbox starts empty
+  *
+  * @return *Inbox
+  */
+  Inbox();
+  /** @brief Inbox destructor
+  *
+  * Default Inbox destructor
+  *
+  * @return void
+  */
+  ~Inbox();
+  /** @brief Adds a message at the end of the inbox
+  *
+  * @param msg message received
+  * @return s16 kErrorCode_Memory if the inbox is full
+  */
+  s16 push(const AgentMessage& msg);
+  /** @brief Takes the oldest message of the inbox
+  *
+  * @param msg where the message is copied
+  * @return bool false if the inbox is empty
+  */
+  bool pop(AgentMessage* msg);
+  /** @brief Empties the inbox
+  *
+  * @return void
+  */
+  void clear();
+  /** @brief Number of messages waiting to be read
+  *
+  * @return u32 number of messages
+  */
+  u32 size() const;
+  /** @brief Checks if the inbox is full
+  *
+  * @return bool true if no more messages fit
+  */
+  bool isFull() const;
+
+private:
+  AgentMessage messages_[kInboxCapacity];
+
+  //Both grow forever, the slot is obtained masking them
+  u32 head_;
+  u32 tail_;
+
+  /** @brief Inbox copy constructor
+  *
+  * The inbox cannot be copied
+  *
+  * @return *Inbox
+  */
+  Inbox(const Inbox& other) = delete;
+  /** @brief Inbox copy operation
+  *
+  * The inbox cannot be copied
+  *
+  * @return Inbox&
+  */
+  Inbox& operator=(const Inbox& other) = delete;
+};
+
+#endif
@@ -7,6 +7,28 @@
 #include "ESAT/sprite.h"
 #include "platform_types.h"
 #include "Math/float2.h"
+#include "zone_graph.h"
+#include <vector>
+#include <string>
+
+//Biggest clearance stored, agents bigger than this can't fit anywhere
+const u8 kMaxClearance = 255;
+//Maps with more cells than this calculate the clearance in several threads
+const s32 kParallelClearanceCells = 256 * 256;
+/** @brief MapLevel struct
+*
+* Coarser copy of the collision data of a map. Every cell of a level covers
+* scale_x * scale_y cells of the collision data loaded with loadMap (level 0).
+*
+*/
+struct MapLevel
+{
+  s32 width;
+  s32 height;
+  s32 scale_x;
+  s32 scale_y;
+  bool* collision_data;
+};
 /** @brief Map class
 *
 * Class in charge of storing the background representation of the map
@@ -48,11 +70,61 @@ public:
   * @return bool true if it is valid false otherwise
   */
   bool isOccupied(const float x, const float y) const;
+  /** @brief checks if a cell of a level is occupied
+  *
+  * Checks if a cell of a level of the map is occupied. Level 0 is the collision
+  * data loaded with loadMap, the rest are the ones added with buildLevels.
+  * Positions outside the level or levels that don't exist count as occupied.
+  *
+  * @param x x coordinate of the cell in the level
+  * @param y y coordinate of the cell in the level
+  * @param level level of the map to check
+  * @return bool true if it is occupied false otherwise
+  */
+  bool isOccupied(const s32 x, const s32 y, const u8 level) const;
+  /** @brief returns the clearance of a cell
+  *
+  * Returns the size in cells of the biggest free square whose top left corner
+  * is the cell, 0 if the cell is occupied or outside the map. The value is
+  * limited to kMaxClearance.
+  *
+  * @param x x coordinate of the cell
+  * @param y y coordinate of the cell
+  * @return u8 clearance of the cell
+  */
+  u8 clearance(const s32 x, const s32 y) const;
+  /** @brief checks if an agent of a size can stand at a cell
+  *
+  * Checks if a square agent of clearance cells with its top left corner at the
+  * cell would overlap an occupied cell. It costs the same as isOccupied, a
+  * clearance of 0 or 1 gives the same result as isOccupied.
+  *
+  * @param x x coordinate of the cell
+  * @param y y coordinate of the cell
+  * @param clearance size in cells of the agent
+  * @return bool true if the agent does not fit false otherwise
+  */
+  bool isBlocked(const s32 x, const s32 y, const u8 clearance) const;
+  /** @brief changes the collision data of a cell
+  *
+  * Sets a cell of the collision data as occupied or free and updates the clearance
+  * and the coarser levels around it. The possible results of this operation are:
+  * kErrorCode_PathNotCreated -> There is no map loaded
+  * kErrorCode_InvalidOrigin -> The cell is outside the map
+  * kErrorCode_Ok -> Everything went fine
+  *
+  * @param x x coordinate of the cell
+  * @param y y coordinate of the cell
+  * @param occupied true to block the cell, false to free it
+  * @return status of the operation
+  */
+  s16 setOccupied(const s32 x, const s32 y, const bool occupied);
   /** @brief Loads the map
   *
   * Tries to load a map with an image source for the background and an image source
   * for the collisions ( white = free, black = occupied). If another map was already
   * loaded it will be freed. The possible results of this operation are:
+  * The clearance of every cell is calculated once the collisions are loaded.
   * kErrorCode_InvalidPointer -> The source or the background were nullptr
   * kErrorCode_Memory -> The program was unable of allocating memory
   * kErrorCode_Ok -> Everything went fine
@@ -62,6 +134,115 @@ public:
   * @return status of the operation
   */
   s16 loadMap(const char* src, const char* background);
+  /** @brief Loads the collision data of a map
+  *
+  * Loads only the collisions of a map, without background, so it can be used by
+  * tools that have no window. The source can be an image (white = free, black = occupied)
+  * or a text file with a line per row ('*' = occupied, any other character = free).
+  * The ratio is 1 until a background is loaded with loadMap. If another map was
+  * already loaded it will be freed. The possible results of this operation are:
+  * kErrorCode_InvalidPointer -> The source was nullptr
+  * kErrorCode_File -> The text file could not be read or is empty
+  * kErrorCode_Memory -> The program was unable of allocating memory
+  * kErrorCode_Ok -> Everything went fine
+  *
+  * @param src path of the collision data
+  * @return status of the operation
+  */
+  s16 loadCollision(const char* src);
+  /** @brief Sets the size of the original map
+  *
+  * loadMap takes it from the background, this sets it without loading the
+  * background so a program without window uses the same coordinates. The
+  * possible results of this operation are:
+  * kErrorCode_PathNotCreated -> There is no map loaded
+  * kErrorCode_InvalidOrigin -> The size is not positive
+  * kErrorCode_Ok -> Everything went fine
+  *
+  * @param width width of the original map
+  * @param height height of the original map
+  * @return status of the operation
+  */
+  s16 set_original_size(const s32 width, const s32 height);
+  /** @brief returns the path the collision data was loaded from
+  *
+  * Returns the path the collision data was loaded from, empty if there is no map
+  *
+  * @return const char* path of the collision data
+  */
+  const char* source() const;
+  /** @brief returns a hash of the collision data
+  *
+  * Returns a 64 bits FNV-1a hash of the size and the collision data of level 0.
+  * It identifies the content of the map for data precalculated from it. The hash
+  * is cached and recalculated only after the map changes.
+  *
+  * @return u64 hash of the collision data
+  */
+  u64 contentHash() const;
+  /** @brief Builds the coarser levels of the map
+  *
+  * Removes the previous levels and derives num_levels - 1 levels from the collision
+  * data, each one with half the resolution of the previous. A cell of a level is free
+  * if any of the cells it covers is free, so a path that exists at a level always
+  * exists at every coarser level. The possible results of this operation are:
+  * kErrorCode_PathNotCreated -> There is no map loaded
+  * kErrorCode_Memory -> The program was unable of allocating memory
+  * kErrorCode_Ok -> Everything went fine
+  *
+  * @param num_levels total number of levels, counting the collision data
+  * @return status of the operation
+  */
+  s16 buildLevels(const u8 num_levels);
+  /** @brief returns the number of levels of the map
+  *
+  * Returns the number of levels of the map, counting the collision data
+  *
+  * @return u8 number of levels
+  */
+  u8 numLevels() const;
+  /** @brief returns the description of a level
+  *
+  * Returns the size and scale of a level of the map. The collision data is
+  * not part of the description (it is nullptr), use isOccupied to query it.
+  *
+  * @param level level of the map, it must be lower than numLevels
+  * @return MapLevel description of the level
+  */
+  MapLevel level(const u8 level) const;
+  /** @brief Builds the zones of the map from an image
+  *
+  * Every color of the image is a zone id, the cell takes the color of the
+  * pixel at its center so the image can have any size. The free cells of the
+  * same color that touch are a zone, split by sectors of sector_size cells.
+  * The zones must be built again after changing cells with setOccupied. The
+  * possible results of this operation are:
+  * kErrorCode_InvalidPointer -> The source was nullptr
+  * kErrorCode_PathNotCreated -> There is no map loaded
+  * kErrorCode_Memory -> The program was unable of allocating memory or loading the image
+  * kErrorCode_Ok -> Everything went fine
+  *
+  * @param src path of the image of the zones
+  * @param sector_size side in cells of the sectors
+  * @return status of the operation
+  */
+  s16 loadZones(const char* src, const s32 sector_size = kZoneSectorSize);
+  /** @brief Builds the zones of the map without an image
+  *
+  * The zones are the free cells that touch inside each sector of sector_size
+  * cells. The possible results are the ones of loadZones without the image.
+  *
+  * @param sector_size side in cells of the sectors
+  * @return status of the operation
+  */
+  s16 buildZones(const s32 sector_size = kZoneSectorSize);
+  /** @brief returns the zones of the map
+  *
+  * Returns the zones built by loadZones or buildZones, empty if there are none
+  *
+  * @return const ZoneGraph& zones, portals and distances between portals
+  */
+  const ZoneGraph& zones() const;
   /** @brief returns the ratio between the original map and the collisions map
   *
   * Returns the ratio between the original map and the collisions map
@@ -69,6 +250,20 @@ public:
   * @return Float2 ratio
   */
   Float2 ratio() const;
+  /** @brief returns the width of the collisions map
+  *
+  * Returns the number of cells of a row of the collisions map
+  *
+  * @return s32 width in cells
+  */
+  s32 width() const;
+  /** @brief returns the height of the collisions map
+  *
+  * Returns the number of cells of a column of the collisions map
+  *
+  * @return s32 height in cells
+  */
+  s32 height() const;
   /** @brief returns the image of the original map
   *
   * Returns the image of the original map
@@ -107,6 +302,74 @@ private:
 
   Float2 ratio_;
 
+  std::vector<MapLevel> levels_;
+
+  ZoneGraph zones_;
+
+  std::string source_;
+
+  mutable u64 content_hash_;
+
+  mutable bool content_hash_dirty_;
+  /** @brief reads a text collision file
+  *
+  * Reads a text file with a line per row of the map. '*' is an occupied cell and
+  * any other character a free one. Lines shorter than the first one are completed
+  * with occupied cells.
+  *
+  * @param src path of the text file
+  * @param width number of cells of a row
+  * @param height number of rows
+  * @return unsigned char* 0xff for free cells and 0 for occupied ones, nullptr if
+  *   the file could not be read. It must be released with free.
+  */
+  static unsigned char* loadTextCollision(const char* src, s32* width, s32* height);
+
+  //Free cells to the right of each cell (itself included), limited to kMaxClearance
+  u8* free_run_;
+
+  u8* clearance_;
+  /** @brief calculates the clearance of a region
+  *
+  * Updates the free runs of the rows and then the clearance of the cells of
+  * the region. Maps bigger than kParallelClearanceCells are split in bands of
+  * rows calculated by different threads.
+  *
+  * @param min_x first column of the region
+  * @param min_y first row of the region
+  * @param max_x last column of the region
+  * @param max_y last row of the region
+  * @return void
+  */
+  void computeClearance(const s32 min_x, const s32 min_y, const s32 max_x, const s32 max_y);
+  /** @brief updates the coarser levels after a change of a cell
+  *
+  * Recalculates the cell of each coarser level that covers the cell of the
+  * collision data.
+  *
+  * @param x x coordinate of the cell
+  * @param y y coordinate of the cell
+  * @return void
+  */
+  void updateLevels(const s32 x, const s32 y);
+  /** @brief adds a level reducing the coarsest one
+  *
+  * Appends a level whose cells cover factor_x * factor_y cells of the coarsest
+  * level.
+  *
+  * @param factor_x cells of the coarsest level covered by a new cell in the x axis
+  * @param factor_y cells of the coarsest level covered by a new cell in the y axis
+  * @return status of the operation
+  */
+  s16 addLevel(const s32 factor_x, const s32 factor_y);
+  /** @brief frees the coarser levels
+  *
+  * Frees the levels added with buildLevels
+  *
+  * @return void
+  */
+  void freeLevels();
+
   
 };
 
@@ -0,0 +1,92 @@
+// mapped_file.h
+// Jose Maria Martinez
+// Header of the read only memory mapped file class
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#include "platform_types.h"
+
+/** @brief Memory mapped file
+*
+* Maps a file in memory as read only, the pages are loaded by the system
+* when they are accessed so big precalculated data can be opened
+* instantly and shared between processes.
+*
+*/
+class MappedFile
+{
+public:
+  /** @brief MappedFile constructor
+  *
+  * Default mapped file constructor, no file is mapped
+  *
+  * @return *MappedFile
+  */
+  MappedFile();
+  /** @brief Destroys the MappedFile
+  *
+  * Destructor of the mapped file, unmaps the file if it was opened
+  *
+  * @return void
+  */
+  ~MappedFile();
+  /** @brief Maps a file
+  *
+  * Maps the whole file as read only. If another file was mapped it is closed.
+  * The possible results of this operation are:
+  * kErrorCode_InvalidPointer -> The path was nullptr
+  * kErrorCode_File -> The file does not exist, is empty or couldn't be mapped
+  * kErrorCode_Ok -> Everything went fine
+  *
+  * @param path path of the file
+  * @return s16 status of the operation
+  */
+  s16 open(const char* path);
+  /** @brief Unmaps the file
+  *
+  * Unmaps the file, the pointer returned by data is no longer valid
+  *
+  * @return void
+  */
+  void close();
+  /** @brief returns the content of the file
+  *
+  * @return const u8* first byte of the file, nullptr if there's no file mapped
+  */
+  const u8* data() const;
+  /** @brief returns the size of the file
+  *
+  * @return u64 size in bytes of the file
+  */
+  u64 size() const;
+
+private:
+
+  const u8* data_;
+
+  u64 size_;
+
+#ifdef _WIN32
+  void* file_;
+
+  void* mapping_;
+#else
+  s32 file_;
+#endif
+  /** @brief MappedFile copy constructor
+  *
+  * The mapped file cannot be copied
+  *
+  * @return *MappedFile
+  */
+  MappedFile(const MappedFile& other) = delete;
+  /** @brief MappedFile copy operation
+  *
+  * The mapped file cannot be copied
+  *
+  * @return *MappedFile
+  */
+  MappedFile operator=(const MappedFile& other) = delete;
+};
+
+#endif
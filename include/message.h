@@ -1,16 +1,51 @@
+// message.h
+// Jose Maria Martinez
+// Header of the messages the agents send between them
 #ifndef __AGENT_MESSAGE_H__
 #define __AGENT_MESSAGE_H__
 
+#include "platform_types.h"
 #include "Math/float2.h"
 
-class AgentMessage
+class Path;
+
+enum class AgentMessageType
 {
-public:
-  AgentMessage();
+  k_Nothing = -1,
+  k_AskForPath = 0,
+  k_PathIsReady = 1,
+  k_PathNotFound = 2,
+  k_CancelPath = 3,
+  k_PathExpired = 4
+};
 
-private:
-  Float2 position_;
+enum class PathPriority
+{
+  k_Ambient = 0,
+  k_Normal = 1,
+  k_Hero = 2,
+  k_PADDING = 255
+};
 
+/** @brief AgentMessage struct
+*
+* Message sent from an agent to another one, sender is the id of the agent
+* that sent it. The path requests carry their priority, the game time after
+* which the path is not wanted (0 without limit) and a number given by the
+* requester, the answer has the same number so old answers can be told apart.
+*
+*/
+struct AgentMessage
+{
+  Float2 position;
+  Float2 dst;
+  AgentMessageType type = AgentMessageType::k_Nothing;
+  Path* path = nullptr;
+  u8 clearance = 1;
+  u32 sender = 0;
+  PathPriority priority = PathPriority::k_Normal;
+  u32 deadline = 0;
+  u32 request = 0;
 };
 
 #endif
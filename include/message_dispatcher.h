@@ -0,0 +1,108 @@
+// message_dispatcher.h
+// Jose Maria Martinez
+// Header of the dispatcher that delivers the messages between agents
+#ifndef __MESSAGE_DISPATCHER_H__
+#define __MESSAGE_DISPATCHER_H__
+
+#include "message.h"
+#include <mutex>
+#include <vector>
+
+class Inbox;
+
+/** @brief PendingMessage struct
+*
+* Message posted during a tick waiting to be delivered to its inbox
+*
+*/
+struct PendingMessage
+{
+  Inbox* recipient;
+  u32 recipient_id;
+  AgentMessage msg;
+};
+
+/** @brief MessageDispatcher class
+*
+* Collects the messages the agents send during a tick and delivers them all
+* at once at the end of it. Posting is safe from the threads that update the
+* agents, the messages are delivered ordered by sender so the result doesn't
+* depend on which thread posted first. Messages that don't fit in a full
+* inbox wait for the next delivery.
+*
+*/
+class MessageDispatcher
+{
+public:
+  /** @brief MessageDispatcher constructor
+  *
+  * Default MessageDispatcher constructor
+  *
+  * @return *MessageDispatcher
+  */
+  MessageDispatcher();
+  /** @brief MessageDispatcher destructor
+  *
+  * Default MessageDispatcher destructor
+  *
+  * @return void
+  */
+  ~MessageDispatcher();
+  /** @brief Posts a message
+  *
+  * The message will be in the recipient inbox after the next delivery.
+  *
+  * @param msg message sent, msg.sender must be the id of the sender
+  * @param recipient inbox of the agent that receives the message
+  * @param recipient_id id of the agent to wake up when it's delivered, 0 for none
+  * @return s16 kErrorCode_InvalidPointer if recipient is null
+  */
+  s16 post(const AgentMessage& msg, Inbox* recipient, const u32 recipient_id);
+  /** @brief Delivers the messages posted
+  *
+  * Pushes every pending message into its inbox ordered by sender, keeping
+  * the order in which each sender posted them.
+  *
+  * @param woken where the ids of the recipients that got messages are added
+  * @return void
+  */
+  void deliver(std::vector<u32>* woken);
+  /** @brief Drops the messages of an inbox
+  *
+  * Must be called before an inbox is destroyed so nothing is delivered to it.
+  *
+  * @param recipient inbox that won't receive messages anymore
+  * @return void
+  */
+  void cancel(const Inbox* recipient);
+  /** @brief Number of messages waiting to be delivered
+  *
+  * @return u32 number of messages
+  */
+  u32 pending() const;
+
+private:
+  std::vector<PendingMessage> pending_;
+
+  //Reused between deliveries for the messages that didn't fit
+  std::vector<PendingMessage> retained_;
+
+  mutable std::mutex mutex_;
+
+  /** @brief MessageDispatcher copy constructor
+  *
+  * The dispatcher cannot be copied
+  *
+  * @return *MessageDispatcher
+  */
+  MessageDispatcher(const MessageDispatcher& other) = delete;
+  /** @brief MessageDispatcher copy operation
+  *
+  * The dispatcher cannot be copied
+  *
+  * @return MessageDispatcher&
+  */
+  MessageDispatcher& operator=(const MessageDispatcher& other) = delete;
+};
+
+#endif
@@ -0,0 +1,213 @@
+// moving_target_search.h
+// Jose Maria Martinez
+// Header of the search that follows a moving target reusing what it learned
+#ifndef __MOVING_TARGET_SEARCH_H__
+#define __MOVING_TARGET_SEARCH_H__
+
+#include "platform_types.h"
+#include "Math/float2.h"
+#include "path.h"
+#include "astar.h"
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+
+class Map;
+
+/** @brief MovingTargetReplan struct
+*
+* Result of one search. baseline_expanded is what an A* with the octile
+* heuristic expanded for the same search, only if measured is true.
+*
+*/
+struct MovingTargetReplan
+{
+  u32 expanded = 0;
+  bool measured = false;
+  u32 baseline_expanded = 0;
+  u32 cost = 0;
+  s16 result = 0;
+};
+
+/** @brief ChaseStats struct
+*
+* Searches of the chasing agents of a world. The agents are updated by the
+* threads of the world, so the counters are atomic.
+*
+*/
+struct ChaseStats
+{
+  //Runs the A* of MovingTargetReplan::baseline_expanded too, doubling the cost of the searches
+  bool measure_savings;
+  std::atomic<u64> replans;
+  std::atomic<u64> expanded;
+  //Replans whose baseline was measured, with their expansions and the ones of the baseline
+  std::atomic<u64> measured;
+  std::atomic<u64> measured_expanded;
+  std::atomic<u64> baseline_expanded;
+  /** @brief ChaseStats constructor
+  *
+  * Creates the statistics without searches and without measuring the savings
+  *
+  * @return *ChaseStats
+  */
+  ChaseStats();
+  /** @brief Adds a search
+  *
+  * @param replan result of the search
+  * @return void
+  */
+  void add(const MovingTargetReplan& replan);
+  /** @brief Removes every search counted
+  *
+  * @return void
+  */
+  void reset();
+  /** @brief Prints the searches and the expansions saved per search
+  *
+  * @return void
+  */
+  void print() const;
+};
+
+/** @brief MovingTargetSearch class
+*
+* Moving Target Adaptive A* (Koenig, Likhachev and Sun). The searches go from
+* the agent to the target and after each one the cells expanded learn a
+* better heuristic, the cost of the path minus their cost from the agent.
+* The agent can move between searches without losing what was learned and,
+* when the target moves, the learned heuristics are lowered by the heuristic
+* of the new target cell so they stay admissible. The corrections are done
+* when a search reaches a cell, so a search never visits the whole map.
+*
+* Every chasing agent has its own search, which only keeps the heuristics
+* learned by the cells it expanded. The costs of a search are kept by the
+* thread that runs it and reused by the searches of all its agents, so the
+* agents can search from different threads. The neighbours, the step costs
+* and the octile heuristic are the ones of AStar. Obstacles removed from
+* the map after a search can make the learned heuristics too high, the
+* paths are still valid but may not be the shortest ones until reset is
+* called.
+*
+*/
+class MovingTargetSearch
+{
+public:
+  /** @brief MovingTargetSearch constructor
+  *
+  * Creates the search without heuristics learned
+  *
+  * @return *MovingTargetSearch
+  */
+  MovingTargetSearch();
+  /** @brief MovingTargetSearch destructor
+  *
+  * Frees the memory of the search
+  *
+  * @return void
+  */
+  ~MovingTargetSearch();
+  /** @brief Searches a path from the agent to the target
+  *
+  * The possible values it can return are:
+  *  kErrorCode_Memory if the costs of the cells of the thread could not be allocated
+  *  kErrorCode_PathNotFound if origin or target are blocked or there's no path
+  *  kErrorCode_Ok the path was calculated, at most the first kMaxPoints points
+  *
+  * @param origin position of the agent
+  * @param target position of the target
+  * @param map collision map, a different one or a new size resets the search
+  * @param clearance size in cells of the agent
+  * @param measure_savings true to also count what an A* expands, check ChaseStats
+  * @return s16 result of the search
+  */
+  s16 search(const Float2& origin, const Float2& target, const Map& map, const u8 clearance,
+             const bool measure_savings);
+  /** @brief gets the path of the last search
+  *
+  * @return Path* path from the cell of the agent, only valid if the last search returned kErrorCode_Ok
+  */
+  Path* path();
+  /** @brief gets the result of the last search
+  *
+  * @return MovingTargetReplan expansions and cost of the last search
+  */
+  MovingTargetReplan lastReplan() const;
+  /** @brief Forgets the heuristics learned and the path of the last search
+  *
+  * The memory of the heuristics is kept for the next chase
+  *
+  * @return void
+  */
+  void reset();
+
+private:
+  /** @brief MovingTargetSearch copy constructor
+  *
+  * The search cannot be copied
+  *
+  * @return *MovingTargetSearch
+  */
+  MovingTargetSearch(const MovingTargetSearch& other) = delete;
+  /** @brief MovingTargetSearch copy operation
+  *
+  * The search cannot be copied
+  *
+  * @return MovingTargetSearch&
+  */
+  MovingTargetSearch& operator=(const MovingTargetSearch& other) = delete;
+  /** @brief returns the heuristic of a cell for the current target
+  *
+  * The heuristic learned by the cell lowered by the moves of the target
+  * since then, never below the octile distance.
+  *
+  * @param cell cell of the collision map
+  * @param grid search that provides the octile heuristic
+  * @return u32 heuristic of the cell
+  */
+  u32 heuristic(const s32 cell, const AStar& grid) const;
+  /** @brief Learns from a search that found a path
+  *
+  * The cells expanded learn the cost of the path minus their cost and,
+  * once learned_ reaches prune_size_, the cells whose heuristic was lost
+  * by the moves of the target are forgotten.
+  *
+  * @param g cost from the agent of each cell reached by the search
+  * @param expanded cells expanded by the search
+  * @param cost cost of the path
+  * @param grid search that provides the octile heuristic
+  * @return void
+  */
+  void learn(const std::vector<u32>& g, const std::vector<s32>& expanded, const u32 cost, const AStar& grid);
+  /** @brief Writes the path of the last search
+  *
+  * @param parent parent of each cell reached by the last search
+  * @param map collision map of the search
+  * @return s16 result of the operation
+  */
+  s16 buildPath(const std::vector<s32>& parent, const Map& map);
+
+  const Map* map_;
+
+  s32 width_;
+
+  s32 height_;
+
+  /*Heuristic learned by each cell expanded plus the heuristic lost by the
+  target up to that search, the rest of cells use the octile distance*/
+  std::unordered_map<s32, u64> learned_;
+
+  //Heuristic lost by the moves of the target since the first search
+  u64 delta_h_;
+
+  //Size of learned_ that removes the heuristics the target already took away
+  size_t prune_size_;
+
+  s32 goal_;
+
+  Path path_;
+
+  MovingTargetReplan last_replan_;
+};
+
+#endif
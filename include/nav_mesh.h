@@ -0,0 +1,307 @@
+// nav_mesh.h
+// Jose Maria Martinez
+// Header of the navigation mesh built from the collision data of a map
+#ifndef __NAV_MESH_H__
+#define __NAV_MESH_H__
+
+#include "platform_types.h"
+#include "mapped_file.h"
+#include "Math/float2.h"
+#include <vector>
+
+class Map;
+class Path;
+
+//Version of the file format, files with another version are rejected
+const u32 kNavMeshVersion = 1;
+
+/** @brief Header of a navigation mesh file
+*
+* It's followed by the polygons, the links, height + 1 offsets of the first
+* entry of each row and the entries, the polygons that cover each row
+* ordered by their column.
+*
+*/
+struct NavMeshHeader
+{
+  char magic[4];
+  u32 version;
+  s32 width;
+  s32 height;
+  u64 map_hash;
+  u32 num_polygons;
+  u32 num_links;
+  u32 num_row_entries;
+  u32 padding;
+};
+
+/** @brief NavMeshPolygon struct
+*
+* Rectangle of free cells, its links are links[first_link] to
+* links[first_link + num_links - 1]
+*
+*/
+struct NavMeshPolygon
+{
+  s32 x;
+  s32 y;
+  s32 width;
+  s32 height;
+  u32 first_link;
+  u32 num_links;
+};
+
+/** @brief NavMeshLink struct
+*
+* Edge shared with a neighbour polygon, from (x0, y0) to (x1, y1) in cell
+* corners. It's vertical or horizontal and at least a cell long.
+*
+*/
+struct NavMeshLink
+{
+  u32 polygon;
+  s32 x0;
+  s32 y0;
+  s32 x1;
+  s32 y1;
+};
+
+/** @brief Navigation mesh
+*
+* Splits the free cells of a map in rectangles, convex polygons joined by the
+* edges they share, so an open map has a few hundred polygons instead of
+* hundreds of thousands of cells. The paths are searched with an A* over the
+* polygons and the waypoints are pulled tight with the funnel algorithm, so
+* only the corners the path turns around are stored.
+*
+* The mesh is laid out in memory as its file, it can be built when the map
+* is loaded or offline and memory mapped. It's made for agents of one cell,
+* the lines of the paths keep the whole agent inside the free cells. Polygons
+* that only touch by a corner are not joined.
+*
+*/
+class NavMesh
+{
+public:
+  /** @brief NavMesh constructor
+  *
+  * Default constructor, no mesh is loaded
+  *
+  * @return *NavMesh
+  */
+  NavMesh();
+  /** @brief Destroys the NavMesh
+  *
+  * Destructor of the mesh, unmaps the file if it was loaded
+  *
+  * @return void
+  */
+  ~NavMesh();
+  /** @brief Builds the mesh of a map
+  *
+  * Covers the free cells with rectangles, each one as wide as possible and
+  * then as tall as possible, in row order. The previous mesh is removed.
+  * The possible results of this operation are:
+  * kErrorCode_PathNotCreated -> The map has no collision data
+  * kErrorCode_Memory -> The program was unable of allocating memory
+  * kErrorCode_Ok -> Everything went fine
+  *
+  * @param map map whose free cells will be covered
+  * @return s16 status of the operation
+  */
+  s16 build(const Map& map);
+  /** @brief Writes the mesh to a file
+  *
+  * The possible results of this operation are:
+  * kErrorCode_InvalidPointer -> The file was nullptr
+  * kErrorCode_PathNotCreated -> There is no mesh
+  * kErrorCode_File -> The file could not be written
+  * kErrorCode_Ok -> Everything went fine
+  *
+  * @param file path of the mesh that will be written
+  * @return s16 status of the operation
+  */
+  s16 save(const char* file) const;
+  /** @brief Loads a mesh
+  *
+  * Maps a mesh file in memory. The size and hash of the map must be the
+  * ones the mesh was built with. The previous mesh is removed.
+  * The possible results of this operation are:
+  * kErrorCode_InvalidPointer -> The file was nullptr
+  * kErrorCode_File -> The file does not exist, is corrupted or belongs to another map
+  * kErrorCode_Ok -> Everything went fine
+  *
+  * @param file path of the mesh
+  * @param map map the mesh will be used with
+  * @return s16 status of the operation
+  */
+  s16 load(const char* file, const Map& map);
+  /** @brief Loads a mesh from memory
+  *
+  * Copies the bytes of a mesh file, like the ones stored in a PathStore. The
+  * size and hash of the map must be the ones the mesh was built with. The
+  * previous mesh is removed. The possible results of this operation are:
+  * kErrorCode_File -> The data is corrupted or belongs to another map
+  * kErrorCode_Memory -> The program was unable of allocating memory
+  * kErrorCode_Ok -> Everything went fine
+  *
+  * @param data bytes of the mesh, as they are stored in the file
+  * @param map map the mesh will be used with
+  * @return s16 status of the operation
+  */
+  s16 load(const std::vector<u8>& data, const Map& map);
+  /** @brief Removes the mesh
+  *
+  * @return void
+  */
+  void unload();
+  /** @brief returns if there's a mesh
+  *
+  * @return bool true if a mesh was built or loaded
+  */
+  bool isLoaded() const;
+  /** @brief returns the number of polygons
+  *
+  * @return u32 polygons of the mesh
+  */
+  u32 numPolygons() const;
+  /** @brief returns the bytes of the mesh
+  *
+  * @return const u8* the mesh as it's stored in the file, nullptr if there's no mesh
+  */
+  const u8* data() const;
+  /** @brief returns the number of bytes of the mesh
+  *
+  * @return u64 size of the file of the mesh, 0 if there's no mesh
+  */
+  u64 dataSize() const;
+  /** @brief returns the number of links
+  *
+  * @return u32 links of the mesh, two per edge shared by two polygons
+  */
+  u32 numLinks() const;
+  /** @brief returns the polygon that covers a cell
+  *
+  * @param x column of the cell
+  * @param y row of the cell
+  * @return s32 index of the polygon, -1 if the cell is blocked or outside the map
+  */
+  s32 polygonAt(const s32 x, const s32 y) const;
+  /** @brief generates a path from origin to dst
+  *
+  * Searches the polygons between the cells of origin and dst and stores
+  * the corners of the shortest line through them, the positions use the
+  * same scale as the A*. The search buffers are members, a mesh can't
+  * be searched from several threads at the same time.
+  * The possible values it can return are:
+  *  kErrorCode_PathNotCreated if there's no mesh or the path has too many points
+  *  kErrorCode_InvalidOrigin if the origin is not a valid position
+  *  kErrorCode_InvalidDestination if dst is not a valid position
+  *  kErrorCode_PathNotFound if there's not a path that connects origin and dst
+  *  kErrorCode_Ok the path was correctly extracted
+  *
+  * @param origin origin point from which the path will be calculated
+  * @param dst destination of the path
+  * @param path Path in which the result will be stored
+  * @param map map the mesh was built for
+  * @return s16
+  */
+  s16 generatePath(Float2 origin, Float2 dst, Path* path, const Map& map);
+  /** @brief returns the polygons expanded by the last path
+  *
+  * @return u32 polygons taken from the open list
+  */
+  u32 lastExpanded() const;
+  /** @brief sets if generatePath prints why a path failed
+  *
+  * Nothing is printed by default, the result is returned and counted by
+  * the PathStats of the PathFinder.
+  *
+  * @param logging true to print the paths that fail
+  * @return void
+  */
+  void set_logging(bool logging);
+
+private:
+  /** @brief NavMesh copy constructor
+  *
+  * The mesh cannot be copied
+  *
+  * @return *NavMesh
+  */
+  NavMesh(const NavMesh& other) = delete;
+  /** @brief NavMesh copy operation
+  *
+  * The mesh cannot be copied
+  *
+  * @return NavMesh
+  */
+  NavMesh operator=(const NavMesh& other) = delete;
+  /** @brief Points the mesh at its data
+  *
+  * Checks that the data is a complete mesh of the size of the header.
+  *
+  * @param data bytes of the mesh, as they are stored in the file
+  * @param size number of bytes
+  * @return bool false if the data is not a valid mesh
+  */
+  bool attach(const u8* data, const u64 size);
+  /** @brief returns the ends of a portal of a link
+  *
+  * The portals are the lines the center of an agent of one cell crosses,
+  * half a cell from the ends of the shared edge. Left and right are seen
+  * from the polygon of the link.
+  *
+  * @param from polygon the link belongs to
+  * @param link index of the link
+  * @param offset distance of the portal to the shared edge towards the neighbour, -0.5 is the last line of centers of from and 0.5 the first of the neighbour
+  * @param left end of the portal at the left of the crossing
+  * @param right end of the portal at the right of the crossing
+  * @return void
+  */
+  void portal(const u32 from, const u32 link, const float offset, Float2* left, Float2* right) const;
+  /** @brief Pulls the path tight through the portals of the polygons
+  *
+  * Simple stupid funnel algorithm, the corners are added to corners.
+  *
+  * @param portals left and right end of each portal crossed, the first and the last ones are the start and the end
+  * @param corners points of the path, start and end included
+  * @return void
+  */
+  void pullString(const std::vector<Float2>& portals, std::vector<Float2>* corners) const;
+
+  MappedFile file_;
+
+  //Mesh built by build, with the same layout as the file
+  std::vector<u8> data_;
+
+  const NavMeshHeader* header_;
+
+  const NavMeshPolygon* polygons_;
+
+  const NavMeshLink* links_;
+
+  const u32* row_offsets_;
+
+  const u32* row_polygons_;
+
+  //Search buffers, sized for the polygons of the mesh
+  std::vector<float> g_;
+
+  std::vector<u32> parent_;
+
+  //Link of the parent crossed to enter each polygon
+  std::vector<u32> parent_link_;
+
+  std::vector<u32> search_;
+
+  std::vector<Float2> entry_;
+
+  u32 counter_;
+
+  u32 last_expanded_;
+
+  bool logging_;
+};
+
+#endif
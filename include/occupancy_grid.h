@@ -0,0 +1,149 @@
+// occupancy_grid.h
+// Jose Maria Martinez
+// Header of the cells of the collision map occupied by the agents
+#ifndef __OCCUPANCY_GRID_H__
+#define __OCCUPANCY_GRID_H__
+
+#include "platform_types.h"
+#include "Math/float2.h"
+#include <vector>
+
+class Map;
+class AgentStore;
+
+/** @brief OccupancyGrid class
+*
+* Dynamic layer over the collision map with the number of agents standing in
+* each of its cells. The grid remembers the cell of every slot of the agent
+* store, so an update only writes the counters of the agents that changed of
+* cell. A bit per cell mirrors the counters, it's what the searches read and
+* keeps a map of 1000x1000 cells in 128KB.
+*
+* The agents are counted by the cell of their position, their size is not
+* taken into account.
+*
+*/
+class OccupancyGrid
+{
+public:
+  /** @brief OccupancyGrid constructor
+  *
+  * The grid is empty until the first update with a map
+  *
+  * @return *OccupancyGrid
+  */
+  OccupancyGrid();
+  /** @brief OccupancyGrid destructor
+  *
+  * Default OccupancyGrid destructor
+  *
+  * @return void
+  */
+  ~OccupancyGrid();
+  /** @brief Moves the agents that changed of cell
+  *
+  * The agents outside the map and the slots removed from the store aren't
+  * counted. A map with a different size or ratio than the last update
+  * counts every agent again.
+  *
+  * @param store movement data of the agents
+  * @param map collision map the grid covers, nothing is counted without collision data
+  * @return void
+  */
+  void update(const AgentStore& store, const Map& map);
+  /** @brief Removes every agent from the grid
+  *
+  * @return void
+  */
+  void clear();
+  /** @brief checks if there are agents in a cell
+  *
+  * @param x column of the cell in the collision map
+  * @param y row of the cell in the collision map
+  * @return bool true if an agent stands in the cell, false outside the map
+  */
+  bool isOccupied(const s32 x, const s32 y) const;
+  /** @brief returns the number of agents in a cell
+  *
+  * @param x column of the cell in the collision map
+  * @param y row of the cell in the collision map
+  * @return u16 agents in the cell, 0 outside the map
+  */
+  u16 count(const s32 x, const s32 y) const;
+  /** @brief Finds the closest free cell around a position
+  *
+  * Looks at the rings of cells around the cell of the position, from the
+  * closest one, for a cell without agents where an agent of the clearance
+  * can stand.
+  *
+  * @param map collision map of the last update
+  * @param position position in world units
+  * @param clearance size in cells of the agent, check Map::isBlocked
+  * @param radius rings of cells looked at, 0 only looks at the cell of the position
+  * @param free_position center of the cell found in world units
+  * @return bool false if there is no free cell in the radius
+  */
+  bool findFreePosition(const Map& map, const Float2& position, const u8 clearance, const s32 radius,
+                        Float2* free_position) const;
+  /** @brief returns the agents that changed of cell in the last update
+  *
+  * @return u32 counters written by the last update
+  */
+  u32 lastChanges() const;
+
+private:
+  /** @brief OccupancyGrid copy constructor
+  *
+  * The grid cannot be copied
+  *
+  * @return *OccupancyGrid
+  */
+  OccupancyGrid(const OccupancyGrid& other) = delete;
+  /** @brief OccupancyGrid copy operation
+  *
+  * The grid cannot be copied
+  *
+  * @return OccupancyGrid&
+  */
+  OccupancyGrid& operator=(const OccupancyGrid& other) = delete;
+  /** @brief Adds an agent to a cell
+  *
+  * @param cell index of the cell, x + y * width
+  * @return void
+  */
+  void add(const s32 cell);
+  /** @brief Removes an agent from a cell
+  *
+  * @param cell index of the cell, x + y * width
+  * @return void
+  */
+  void remove(const s32 cell);
+  /** @brief checks if a cell is free for an agent
+  *
+  * @param map collision map
+  * @param x column of the cell
+  * @param y row of the cell
+  * @param clearance size in cells of the agent
+  * @return bool true if the cell has no agents and is not blocked for the clearance
+  */
+  bool isFree(const Map& map, const s32 x, const s32 y, const u8 clearance) const;
+
+  s32 width_;
+
+  s32 height_;
+
+  Float2 ratio_;
+
+  //Agents in each cell
+  std::vector<u16> count_;
+
+  //A bit per cell, set while its count is not 0
+  std::vector<u64> occupied_;
+
+  //Cell of each slot of the agent store, -1 if it's not counted
+  std::vector<s32> slot_cell_;
+
+  u32 last_changes_;
+};
+
+#endif
@@ -174,6 +174,15 @@ public:
   * @return Float2 last point of the path
   */
   Float2 const* lastPoint();
+  /** @brief Gets a point of the path without walking to it.
+  *
+  * Gets the point at an index, in the order they were added. In case the
+  * path is not ready or there is no point at the index it will return nullptr.
+  *
+  * @param index index of the point
+  * @return Float2 point of the path
+  */
+  Float2 const* pointAt(u16 index) const;
 
   u16 total_points_;
 private:
@@ -6,37 +6,102 @@
 
 #include "astar.h"
 #include "map.h"
+#include "compressed_path_database.h"
+#include "nav_mesh.h"
+#include "path_store.h"
+#include "inbox.h"
+#include "path_handle.h"
+#include <mutex>
+#include <vector>
 
 class Path;
 class Map;
+class World;
 
-enum class AgentMessageType
+enum class PathBackend
 {
-  k_Nothing = -1,
-  k_AskForPath = 0,
-  k_PathIsReady = 1,
-  k_PathNotFound = 2
+  k_AStar = 0,
+  k_CompressedPathDatabase = 1,
+  k_NavMesh = 2,
+  k_PADDING = 255
+};
+
+enum class PFAgentState
+{
+  k_Waiting = 0,
+  k_Calculating = 1,
+  k_PADDING = 255
 };
 
-struct AgentMessage
+/** @brief PathRequest struct
+*
+* Path asked by an agent. deadline is the game time after which the path is
+* not wanted, 0 without limit, and order is the arrival order of the request.
+* The requests made with requestPath have no requester when they are not
+* for an agent, and are answered through their handle instead of a message.
+*
+*/
+struct PathRequest
 {
-  Float2 position;
+  u32 requester = 0;
+  u32 request = 0;
+  PathPriority priority = PathPriority::k_Normal;
+  u32 deadline = 0;
+  u32 order = 0;
+  Float2 origin;
   Float2 dst;
-  AgentMessageType type = AgentMessageType::k_Nothing;
   Path* path = nullptr;
+  u8 clearance = 1;
+  std::shared_ptr<PathHandleState> handle;
 };
 
-enum class PFAgentState
+/** @brief PathRequestOptions struct
+*
+* Options of PathFinder::requestPath. deadline is in ms of game time from
+* the request, 0 without limit. requester is the id of the agent the path is
+* for, so its other requests are replaced, or 0 for none. Without path the
+* path is kept by the handle.
+*
+*/
+struct PathRequestOptions
 {
-  k_Waiting = 0,
-  k_Calculating = 1,
-  k_PADDING = 255
+  PathPriority priority = PathPriority::k_Normal;
+  u32 deadline = 0;
+  u8 clearance = 1;
+  u32 requester = 0;
+  Path* path = nullptr;
+};
+
+/** @brief PathRequestCounters struct
+*
+* What happened to the requests received by a pathfinder
+*
+*/
+struct PathRequestCounters
+{
+  u32 received = 0;
+  //Answered with k_PathIsReady or k_PathNotFound
+  u32 answered = 0;
+  //Replaced by a newer request of the same agent
+  u32 superseded = 0;
+  u32 cancelled = 0;
+  //Answered with k_PathExpired
+  u32 expired = 0;
+  //Requests or answers of agents that no longer exist
+  u32 dropped = 0;
 };
 
 /** @brief PathFinder agentt
 *
 * This class is an agent that can be asked for paths. He utilizes the
-* A* algorithm to calculate them
+* A* algorithm to calculate them.
+*
+* Every agent has at most one request: a new request of the same agent
+* replaces the one waiting or abandons the one being calculated, and
+* k_CancelPath removes it. The requests wait until their deadline, then the
+* agent receives k_PathExpired. The next one calculated is the one with the
+* highest priority, then the closest deadline, then the oldest. A request
+* being calculated is not interrupted by a more urgent one.
 *
 */
 class PathFinder
@@ -48,7 +113,16 @@ public:
   *
   * @return *PathFinder
   */
-  PathFinder::PathFinder();
+  PathFinder();
+  /** @brief Pathfinder Agent constructor
+  *
+  * Creates the pathfinder in a world, it searches in the map of the world
+  * and answers to its agents. The default constructor uses the GameState.
+  *
+  * @param world world where the pathfinder lives
+  * @return *PathFinder
+  */
+  PathFinder(World* world);
   /** @brief Destroys the PathFinder
   *
   * Destructor of the pathfinder agent entity
@@ -73,10 +147,11 @@ public:
   * @param path Path in which the result will be stored
   * @param origin origin point from which the path will be calculated
   * @param dst Path in which the result will be stored
-  * @param timeout Total time to calculate the path
+  * @param timeout time in ms this call can calculate the path
+  * @param clearance size in cells of the agent that will follow the path
   * @return s16
   */
-  s16 generatePath(Path* path, Float2 origin, Float2 dst, u32 timeout);
+  s16 generatePath(Path* path, Float2 origin, Float2 dst, u32 timeout, u8 clearance = 1);
   /** @brief generates a path from origin to dst
   *
   * Starts the generation of a path.
@@ -92,9 +167,135 @@ public:
   * @param path Path in which the result will be stored
   * @param origin origin point from which the path will be calculated
   * @param dst Path in which the result will be stored
+  * @param clearance size in cells of the agent that will follow the path
   * @return s16
   */
-  s16 generatePath(Path* path, Float2 origin, Float2 dst);
+  s16 generatePath(Path* path, Float2 origin, Float2 dst, u8 clearance = 1);
+  /** @brief Asks for a path without blocking
+  *
+  * The request is scheduled with the ones received as messages at the next
+  * update and calculated in the time slices of the updates, with the search
+  * set by set_mode and set_backend, so k_HashDistributed spreads it over
+  * its threads. It can be called from any thread, the agents updated by
+  * the pool of the world included.
+  *
+  * @param origin origin point from which the path will be calculated
+  * @param dst destination of the path
+  * @param options priority, deadline, size and requester of the path
+  * @return PathHandle handle to poll, cancel or await the path
+  */
+  PathHandle requestPath(const Float2& origin, const Float2& dst, const PathRequestOptions& options);
+  /** @brief sets the search used to calculate the paths
+  *
+  * Sets the search of the A* used by the agent, check AStar::set_mode for
+  * the available ones. It can't be changed while a path is being calculated,
+  * in that case kErrorCode_Timeout is returned.
+  *
+  * @param mode search that will be used
+  * @return s16 result of the operation
+  */
+  s16 set_mode(AStarMode mode);
+  /** @brief sets the algorithm used to calculate the paths
+  *
+  * With k_CompressedPathDatabase the paths are extracted from the database
+  * stored next to the collision data of the map (source of the map + ".cpd").
+  * The database is loaded the first time it's needed and every time the map
+  * changes. If there's no database for the current map, or the path is for
+  * an agent bigger than a cell, the A* is used. With k_NavMesh the paths are
+  * searched on the navigation mesh of the map, loaded from the source of the
+  * map + ".nav" or built when there's no file for the map. It can't be
+  * changed while a path is being calculated, in that case kErrorCode_Timeout
+  * is returned.
+  *
+  * @param backend algorithm that will be used
+  * @return s16 result of the operation
+  */
+  s16 set_backend(PathBackend backend);
+  /** @brief sets how the paths treat the cells occupied by agents
+  *
+  * The A* reads the occupancy grid of the world, check
+  * AStar::set_dynamic_obstacles. The database doesn't know about the agents,
+  * so it's not used while the agents are taken into account. It can't be
+  * changed while a path is being calculated, in that case kErrorCode_Timeout
+  * is returned.
+  *
+  * @param mode k_Ignore by default
+  * @param extra_cost cost added by k_ExtraCost to the steps into cells with agents
+  * @return s16 result of the operation
+  */
+  s16 set_dynamic_obstacles(DynamicObstacles mode, u16 extra_cost = 20);
+  /** @brief sets if the A* is restricted to the corridor of zones of each path
+  *
+  * Each path is first solved on the zones of the map, check Map::loadZones,
+  * and the A* only visits the zones of that route, so its open list is
+  * bounded by the corridor instead of the map. The paths can be a bit longer
+  * than the shortest ones. Agents bigger than a cell, maps without zones or
+  * routes that can't be solved search the whole map. It can't be changed
+  * while a path is being calculated, in that case kErrorCode_Timeout is returned.
+  *
+  * @param use_zones false by default
+  * @return s16 result of the operation
+  */
+  s16 set_use_zones(bool use_zones);
+  /** @brief sets the persistent store of the paths
+  *
+  * The paths of agents of one cell that ignore the agents are looked for in
+  * the store before any search, and the routes found kPathStoreHotRoute
+  * times by the A* are stored, so a restart serves them without searching.
+  * Only the shortest paths are stored, not the ones of k_CoarseToFine, of
+  * the zones or of the navigation mesh. The navigation meshes built are
+  * stored too. The store isn't owned by the PathFinder and must live while
+  * it's set. It can't be changed while a
+  * path is being calculated, in that case kErrorCode_Timeout is returned.
+  *
+  * @param store open store, nullptr by default to use none
+  * @return s16 result of the operation
+  */
+  s16 set_store(PathStore* store);
+  /** @brief returns the statistics of the paths calculated
+  *
+  * Every path that finished since the last resetStats, with the A* or with
+  * the database. The paths of the database only have latency and result.
+  *
+  * @return const PathStats& statistics of the paths
+  */
+  const PathStats& stats() const;
+  /** @brief Removes the paths counted by stats
+  *
+  * @return void
+  */
+  void resetStats();
+  /** @brief sets if the searches print their progress
+  *
+  * Check AStar::set_logging, CompressedPathDatabase::set_logging and
+  * NavMesh::set_logging, it's disabled by default. The PathFinder also
+  * prints when a map has no path database or navigation mesh.
+  *
+  * @param logging true to print when a path starts and finishes
+  * @return void
+  */
+  void set_logging(bool logging);
+  /** @brief Removes the requests of an agent
+  *
+  * Called by the agents when they are destroyed, the path of the request
+  * belongs to them so it can't wait for a k_CancelPath. A path being
+  * calculated for the agent is abandoned and its memory freed. The
+  * requests of the agent made with requestPath are cancelled too.
+  *
+  * @param requester id of the agent
+  * @return u32 number of requests removed
+  */
+  u32 cancelRequests(const u32 requester);
+  /** @brief returns the number of requests waiting to be calculated
+  *
+  * @return u32 requests waiting, the one being calculated is not counted
+  */
+  u32 pendingRequests() const;
+  /** @brief returns what happened to the requests received
+  *
+  * @return const PathRequestCounters& counters of the requests
+  */
+  const PathRequestCounters& requestCounters() const;
   /** @brief Updates the agent
   *
   * Updates the body and mind of the agent based on a delta time
@@ -106,7 +307,10 @@ public:
   /** @brief Updates the mind of the agent
   *
   * Method in charge of the decision making of the agent.
-  * Calculates the paths requested by the agents.
+  * Reads the requests and cancellations received, expires the requests
+  * past their deadline and calculates the paths requested by the agents.
+  * The coroutines waiting for a handle finished in this update are resumed
+  * at its end.
   *
   * @param dt time that has passed in the game world
   * @return void
@@ -124,8 +328,9 @@ public:
   void updateBody(const u32 dt);
   /** @brief function to receive a message from another agent
   *
-  * Function to send a message to the agent. This message will be
-  * treated at the updateMind function.
+  * Function to send a message to the agent. The message is posted to the
+  * dispatcher of the game state and treated at the updateMind function
+  * after it has been delivered.
   *
   * @param msg content of the message sent
   * @param id of the one who sent the message
@@ -138,25 +343,63 @@ private:
 
   u32 id_;
 
+  World* world_;
+
   PFAgentState actual_state_;
 
   AStar* a_star_;
 
+  PathBackend backend_;
+
+  DynamicObstacles dynamic_obstacles_;
+
+  bool use_zones_;
+
+  bool logging_;
+
+  //Zones the A* of the current path can visit
+  std::vector<u8> zone_corridor_;
+
+  CompressedPathDatabase* cpd_;
+
+  //Hash of the map the database was loaded for
+  u64 cpd_map_hash_;
+
+  bool cpd_checked_;
+
+  NavMesh* nav_mesh_;
+
+  //Hash of the map the navigation mesh belongs to
+  u64 nav_mesh_map_hash_;
+
+  bool nav_mesh_checked_;
+
+  //Not owned, can be nullptr
+  PathStore* store_;
+
+  PathStats stats_;
+
   bool initialized_;
 
-  u32 num_agents_;
+  //Request being calculated, only valid while k_Calculating
+  PathRequest active_;
+
+  std::vector<PathRequest> pending_;
 
-  //Calculated path
-  s32 requestor_;
+  u32 next_order_;
 
-  Float2 origin_;
+  PathRequestCounters request_counters_;
 
-  Float2 dst_;
+  //Requests of requestPath not scheduled yet, they can come from any thread
+  std::vector<PathRequest> requested_;
 
-  Path* path_;
+  std::mutex requested_mutex_;
+
+  //Handles finished whose coroutines haven't been resumed
+  std::vector<std::shared_ptr<PathHandleState>> finished_handles_;
 
   //Message variables
-  AgentMessage* mail_box_ = nullptr;
+  Inbox inbox_;
   /** @brief Pathfinder Agent copy constructor
   *
   * The pathfinder agent cannot be copied
@@ -171,6 +414,108 @@ private:
   * @return *PathFinder
   */
   PathFinder operator=(const PathFinder& pf) = delete;
+  /** @brief returns if the path can be taken from the database
+  *
+  * Loads the database of the map if it changed since the last check.
+  *
+  * @param map map where the path will be calculated
+  * @param clearance size in cells of the agent that will follow the path
+  * @return bool true if the database of the map is loaded and can be used
+  */
+  bool useDatabase(const Map& map, u8 clearance);
+  /** @brief returns if the path can be searched on the navigation mesh
+  *
+  * Loads or builds the mesh of the map if it changed since the last check.
+  *
+  * @param map map where the path will be calculated
+  * @param clearance size in cells of the agent that will follow the path
+  * @return bool true if the mesh of the map is ready and can be used
+  */
+  bool useNavMesh(const Map& map, u8 clearance);
+  /** @brief Gives the A* the corridor of zones of a new path
+  *
+  * Does nothing while the A* is calculating a path, that one keeps its corridor.
+  *
+  * @param origin origin of the path in world units
+  * @param dst destination of the path in world units
+  * @param clearance size in cells of the agent that will follow the path
+  * @return void
+  */
+  void prepareZoneCorridor(const Float2& origin, const Float2& dst, u8 clearance);
+  /** @brief Calculates a path with the backend that can solve it
+  *
+  * Tries the path database, the store, the navigation mesh and the A* in
+  * that order and adds the path to the statistics. Only the A* can time
+  * out, a search that timed out continues with the A*.
+  *
+  * @param path Path in which the result will be stored
+  * @param origin origin of the path in world units
+  * @param dst destination of the path in world units
+  * @param clearance size in cells of the agent that will follow the path
+  * @param timeout time in ms the A* can calculate, negative to calculate the whole path
+  * @return s16 result of the backend, check generatePath
+  */
+  s16 calculatePath(Path* path, const Float2& origin, const Float2& dst, u8 clearance, double timeout);
+  /** @brief Looks for the path of a route in the store
+  *
+  * The paths taken from the store are added to the statistics.
+  *
+  * @param path Path in which the result will be stored
+  * @param origin origin of the path in world units
+  * @param dst destination of the path in world units
+  * @param clearance size in cells of the agent that will follow the path
+  * @return bool true if path has the stored path
+  */
+  bool findStoredPath(Path* path, const Float2& origin, const Float2& dst, u8 clearance);
+  /** @brief Counts a path found by the A* in the store
+  *
+  * The paths of the approximate searches, k_CoarseToFine or restricted to
+  * a corridor of zones, are not counted.
+  *
+  * @param path path found
+  * @param origin origin of the path in world units
+  * @param dst destination of the path in world units
+  * @param clearance size in cells of the agent that will follow the path
+  * @return void
+  */
+  void recordStoredPath(const Path& path, const Float2& origin, const Float2& dst, u8 clearance);
+  /** @brief Adds a request, replacing the previous one of its agent
+  *
+  * @param request request received
+  * @return void
+  */
+  void schedule(PathRequest request);
+  /** @brief Cancels the requests whose handles were cancelled or destroyed
+  *
+  * @return void
+  */
+  void dropAbandonedHandles();
+  /** @brief Answers the requests whose deadline has passed with k_PathExpired
+  *
+  * @param now time of the game world
+  * @return void
+  */
+  void expireRequests(const u32 now);
+  /** @brief Moves the most urgent request waiting to active_
+  *
+  * @return bool false if there are no requests waiting
+  */
+  bool startNextRequest();
+  /** @brief Abandons the request being calculated
+  *
+  * @return void
+  */
+  void abandonActive();
+  /** @brief Sends the answer of a request to its agent
+  *
+  * The agents are not told about the requests cancelled or replaced, the
+  * handles are.
+  *
+  * @param request request answered
+  * @param type k_PathIsReady, k_PathNotFound, k_PathExpired or k_CancelPath
+  * @return void
+  */
+  void answer(const PathRequest& request, const AgentMessageType type);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,153 @@
+// path_handle.h
+// Jose Maria Martinez
+// Header of the handle of a path requested to the path finder
+#ifndef __PATH_HANDLE_H__
+#define __PATH_HANDLE_H__
+
+#include "platform_types.h"
+#include "path.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+//The handles can be awaited from coroutines when the compiler supports them (C++20)
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#define PATH_HANDLE_COROUTINES
+#include <coroutine>
+#endif
+
+enum class PathHandleStatus
+{
+  k_Pending = 0,
+  k_Calculating = 1,
+  k_Ready = 2,
+  k_NotFound = 3,
+  k_Expired = 4,
+  k_Cancelled = 5,
+  k_PADDING = 255
+};
+
+/** @brief PathHandleState struct
+*
+* State shared by the handles of a request and the path finder. The status
+* is written by the path finder, the handles only ask for the cancellation.
+* path is the path given with the request or own_path.
+*
+*/
+struct PathHandleState
+{
+  std::atomic<PathHandleStatus> status;
+  std::atomic<bool> cancelled;
+  Path own_path;
+  Path* path = nullptr;
+  std::mutex mutex;
+#ifdef PATH_HANDLE_COROUTINES
+  //Coroutine waiting for the path, resumed by the path finder
+  std::coroutine_handle<> waiting;
+#endif
+  /** @brief PathHandleState constructor
+  *
+  * Creates the state of a request that is waiting
+  *
+  * @return *PathHandleState
+  */
+  PathHandleState();
+  /** @brief Sets the result of the request
+  *
+  * @param result k_Ready, k_NotFound, k_Expired or k_Cancelled
+  * @return void
+  */
+  void finish(const PathHandleStatus result);
+  /** @brief Resumes the coroutine waiting for the result, if any
+  *
+  * Called by the path finder once it's not using its requests.
+  *
+  * @return void
+  */
+  void resume();
+};
+
+/** @brief PathHandle class
+*
+* Handle of a path asked with PathFinder::requestPath. It's a shared pointer
+* to the state of the request, copies refer to the same request. Polling it
+* is safe from any thread. A request whose path belongs to the handle is
+* abandoned once every handle is destroyed.
+*
+*/
+class PathHandle
+{
+public:
+  /** @brief PathHandle constructor
+  *
+  * Creates a handle without request, its status is k_Cancelled
+  *
+  * @return *PathHandle
+  */
+  PathHandle();
+  /** @brief checks if the handle has a request
+  *
+  * @return bool false for handles created without path finder
+  */
+  bool valid() const;
+  /** @brief returns the status of the request
+  *
+  * A cancelled request is k_Cancelled right away, although the path finder
+  * abandons it at its next update.
+  *
+  * @return PathHandleStatus status of the request
+  */
+  PathHandleStatus poll() const;
+  /** @brief checks if the request has finished
+  *
+  * @return bool true if the status is k_Ready, k_NotFound, k_Expired or k_Cancelled
+  */
+  bool ready() const;
+  /** @brief Cancels the request
+  *
+  * The path finder abandons it at its next update, freeing its search.
+  *
+  * @return void
+  */
+  void cancel();
+  /** @brief gets the path of the request
+  *
+  * @return Path* path calculated, nullptr until the status is k_Ready
+  */
+  Path* path() const;
+#ifdef PATH_HANDLE_COROUTINES
+  /** @brief PathAwaiter struct
+  *
+  * Suspends a coroutine until the request finishes. The coroutine is resumed
+  * at the end of the update of the path finder, in its thread.
+  *
+  */
+  struct PathAwaiter
+  {
+    std::shared_ptr<PathHandleState> state;
+    bool await_ready() const;
+    bool await_suspend(std::coroutine_handle<> coroutine);
+    PathHandleStatus await_resume() const;
+  };
+  /** @brief Waits for the request from a coroutine
+  *
+  * @return PathAwaiter awaiter that gives the final status
+  */
+  PathAwaiter operator co_await() const;
+#endif
+
+private:
+  friend class PathFinder;
+  /** @brief PathHandle constructor
+  *
+  * Creates a handle of a request, only used by the path finder
+  *
+  * @param state state of the request
+  * @return *PathHandle
+  */
+  explicit PathHandle(const std::shared_ptr<PathHandleState>& state);
+
+  std::shared_ptr<PathHandleState> state_;
+};
+
+#endif
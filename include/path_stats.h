@@ -0,0 +1,180 @@
+// path_stats.h
+// Jose Maria Martinez
+// Header of the statistics of the paths calculated
+
+#ifndef __PATH_STATS_H__
+#define __PATH_STATS_H__
+
+#include "platform_types.h"
+
+//Buckets of the histograms, bucket b counts the values in [2^(b-1), 2^b)
+const u32 kPathStatsBuckets = 40;
+
+//Results counted, the error codes go from 0 to -20
+const u32 kPathStatsResults = 21;
+
+enum class PathStatsMetric
+{
+  k_Expanded = 0,
+  k_Generated = 1,
+  k_Duplicates = 2,
+  k_Reopened = 3,
+  k_PeakOpen = 4,
+  k_LatencyUs = 5,
+  k_Count = 6,
+  k_PADDING = 255
+};
+
+/** @brief PathQueryStats struct
+*
+* Statistics of one path calculated. The open peak of the searches with more
+* than one open list is the sum of the peaks of each one.
+*
+*/
+struct PathQueryStats
+{
+  u64 expanded = 0;
+  //Nodes added to the open list
+  u64 generated = 0;
+  //Successors discarded because their cell already had an equal or better cost
+  u64 duplicates = 0;
+  //Closed nodes reached again with a better cost and added to the open list
+  u64 reopened = 0;
+  u64 peak_open = 0;
+  //Time from the first call of the path to its result, with every timeout between them
+  double latency_ms = 0.0;
+  s16 result = 0;
+};
+
+/** @brief PathStatsHistogram struct
+*
+* Distribution of a metric in power of two buckets
+*
+*/
+struct PathStatsHistogram
+{
+  u64 count = 0;
+  u64 total = 0;
+  u64 max = 0;
+  u64 buckets[kPathStatsBuckets] = {};
+  /** @brief Adds a value to the histogram
+  *
+  * @param value value to add
+  * @return void
+  */
+  void add(const u64 value);
+  /** @brief Adds the values of other histogram
+  *
+  * @param other histogram to add
+  * @return void
+  */
+  void merge(const PathStatsHistogram& other);
+  /** @brief returns a percentile of the values
+  *
+  * The result is the upper limit of the bucket of the percentile, or the
+  * maximum value if it's lower.
+  *
+  * @param percentile percentile between 0 and 100
+  * @return u64 upper limit of the percentile, 0 without values
+  */
+  u64 percentile(const u32 percentile) const;
+  /** @brief returns the mean of the values
+  *
+  * @return double mean, 0 without values
+  */
+  double mean() const;
+};
+
+/** @brief PathStats class
+*
+* Counters and histograms of the paths calculated by a search. Only the
+* queries that finished are added, the ones still calculating are not.
+* It's not thread safe, each search has its own statistics and they are
+* merged to see several of them together.
+*
+*/
+class PathStats
+{
+public:
+  /** @brief PathStats constructor
+  *
+  * Creates the statistics without queries
+  *
+  * @return *PathStats
+  */
+  PathStats();
+  /** @brief Adds a query that finished
+  *
+  * @param query statistics of the query
+  * @return void
+  */
+  void add(const PathQueryStats& query);
+  /** @brief Adds the queries of other statistics
+  *
+  * @param other statistics to add
+  * @return void
+  */
+  void merge(const PathStats& other);
+  /** @brief Removes every query
+  *
+  * @return void
+  */
+  void reset();
+  /** @brief returns the number of queries added
+  *
+  * @return u64 queries
+  */
+  u64 queries() const;
+  /** @brief returns how many queries ended with a result
+  *
+  * @param result error code of the queries
+  * @return u64 queries, 0 for codes that are not counted
+  */
+  u64 results(const s16 result) const;
+  /** @brief returns the histogram of a metric
+  *
+  * @param metric metric wanted
+  * @return const PathStatsHistogram& histogram of the metric
+  */
+  const PathStatsHistogram& histogram(const PathStatsMetric metric) const;
+  /** @brief Prints the results and the percentiles of every metric
+  *
+  * @return void
+  */
+  void print() const;
+  /** @brief Writes the statistics in a csv file
+  *
+  * One row per metric with its percentiles, then one row per result.
+  *
+  * @param file path of the file
+  * @return s16 kErrorCode_Ok or kErrorCode_File if it couldn't be written
+  */
+  s16 writeCsv(const char* file) const;
+  /** @brief Writes the statistics in a json file
+  *
+  * @param file path of the file
+  * @return s16 kErrorCode_Ok or kErrorCode_File if it couldn't be written
+  */
+  s16 writeJson(const char* file) const;
+  /** @brief returns the name of a metric
+  *
+  * @param metric metric
+  * @return const char* name used in the files
+  */
+  static const char* metricName(const PathStatsMetric metric);
+  /** @brief returns the name of a result
+  *
+  * @param result error code
+  * @return const char* name of the error code, "Unknown" for the rest
+  */
+  static const char* resultName(const s16 result);
+
+private:
+  u64 queries_;
+
+  u64 results_[kPathStatsResults];
+
+  PathStatsHistogram histograms_[static_cast<u32>(PathStatsMetric::k_Count)];
+};
+
+#endif
@@ -0,0 +1,289 @@
+// path_store.h
+// Jose Maria Martinez
+// Header of the persistent store of paths and data precalculated from the maps
+#ifndef __PATH_STORE_H__
+#define __PATH_STORE_H__
+
+#include "platform_types.h"
+#include "Math/float2.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class Map;
+class Path;
+struct sqlite3;
+struct sqlite3_stmt;
+
+//Times a route has to be found in a session before its path is stored
+const u16 kPathStoreHotRoute = 2;
+//Writes of each transaction of the writer thread
+const u32 kPathStoreBatch = 256;
+//Milliseconds a row waits for the rest of its batch before it's written anyway
+const u32 kPathStoreFlushInterval = 1000;
+
+enum class PathStoreWriteType
+{
+  k_Path = 0,
+  k_Layer = 1,
+  k_Result = 2,
+  k_PADDING = 255
+};
+
+/** @brief PathStoreWrite struct
+*
+* Row waiting for the writer thread. The paths keep their origin and
+* destination cells and their points in cells, the layers and results
+* their name.
+*
+*/
+struct PathStoreWrite
+{
+  PathStoreWriteType type;
+  u64 map_hash;
+  s32 origin;
+  s32 dst;
+  std::string name;
+  std::vector<u8> data;
+  double value;
+};
+
+/** @brief PathStoreCounters struct
+*
+* What the store did since it was opened
+*
+*/
+struct PathStoreCounters
+{
+  //Paths found in the store
+  u64 hits = 0;
+  //Paths looked for and not found
+  u64 misses = 0;
+  u64 writes = 0;
+  u64 transactions = 0;
+  //Writes that failed, the rows are lost
+  u64 failed_writes = 0;
+};
+
+/** @brief PathStore class
+*
+* Database of SQLite that keeps between runs the paths of the routes asked
+* the most, data baked from the maps like the navigation meshes and the
+* results of the benchmarks. Everything is keyed by Map::contentHash, so a
+* map that changes doesn't use the rows of its old content.
+*
+* The database uses WAL so the simulation reads with its own connection
+* while a writer thread writes. The writes are queued and the writer
+* thread does them in transactions of kPathStoreBatch rows, or of the rows
+* queued when the oldest one has waited kPathStoreFlushInterval ms, flush is
+* called or the store is closed. Every query is a statement prepared when the
+* store is opened.
+*
+* findPath, recordPath and findLayer share the connection and the counts of
+* the caller, they must be called from one thread. storeLayer and storeResult
+* can be called from any thread.
+*
+*/
+class PathStore
+{
+public:
+  /** @brief PathStore constructor
+  *
+  * Default constructor, the store is closed
+  *
+  * @return *PathStore
+  */
+  PathStore();
+  /** @brief PathStore destructor
+  *
+  * Writes the rows queued and closes the database
+  *
+  * @return void
+  */
+  ~PathStore();
+  /** @brief Opens the database
+  *
+  * Creates the file and its tables if they don't exist and starts the
+  * writer thread. The previous database is closed. The possible results of
+  * this operation are:
+  * kErrorCode_InvalidPointer -> The file was nullptr
+  * kErrorCode_File -> The database could not be opened or prepared
+  * kErrorCode_Ok -> Everything went fine
+  *
+  * @param file path of the database
+  * @return s16 status of the operation
+  */
+  s16 open(const char* file);
+  /** @brief Closes the database
+  *
+  * Writes the rows queued before closing
+  *
+  * @return void
+  */
+  void close();
+  /** @brief returns if the database is open
+  *
+  * @return bool true after open succeeded
+  */
+  bool isOpen() const;
+  /** @brief Looks for the stored path of a route
+  *
+  * The route is the cell of the origin and the cell of the destination. The
+  * possible results of this operation are:
+  * kErrorCode_PathNotCreated -> The store is closed or the path couldn't be created
+  * kErrorCode_PathNotFound -> The route is not stored
+  * kErrorCode_Ok -> path has the stored points, in the scale of the map
+  *
+  * @param map map of the route
+  * @param origin origin of the route in world units
+  * @param dst destination of the route in world units
+  * @param path Path in which the result will be stored
+  * @return s16 status of the operation
+  */
+  s16 findPath(const Map& map, const Float2& origin, const Float2& dst, Path* path);
+  /** @brief Counts a path found by a search
+  *
+  * The path is queued to be stored the kPathStoreHotRoute time its route
+  * is found.
+  *
+  * @param map map of the route
+  * @param origin origin of the route in world units
+  * @param dst destination of the route in world units
+  * @param path path found, it must be ready
+  * @return void
+  */
+  void recordPath(const Map& map, const Float2& origin, const Float2& dst, const Path& path);
+  /** @brief Looks for the data of a layer of a map
+  *
+  * The possible results of this operation are:
+  * kErrorCode_InvalidPointer -> name or data were nullptr
+  * kErrorCode_PathNotCreated -> The store is closed
+  * kErrorCode_PathNotFound -> The layer is not stored
+  * kErrorCode_Ok -> data has the layer
+  *
+  * @param map_hash content hash of the map
+  * @param name name of the layer
+  * @param data bytes of the layer
+  * @return s16 status of the operation
+  */
+  s16 findLayer(const u64 map_hash, const char* name, std::vector<u8>* data);
+  /** @brief Queues the data of a layer of a map
+  *
+  * Replaces the layer with the same name
+  *
+  * @param map_hash content hash of the map
+  * @param name name of the layer
+  * @param data bytes of the layer
+  * @param size number of bytes
+  * @return void
+  */
+  void storeLayer(const u64 map_hash, const char* name, const u8* data, const u64 size);
+  /** @brief Queues a result of a benchmark
+  *
+  * The results are added with the time they were stored, they are never replaced
+  *
+  * @param map_hash content hash of the map measured
+  * @param name name of the measure
+  * @param value value measured
+  * @return void
+  */
+  void storeResult(const u64 map_hash, const char* name, const double value);
+  /** @brief Waits until the writer thread has written every row queued
+  *
+  * The rows queued are written without waiting for their batch to fill.
+  *
+  * @return void
+  */
+  void flush();
+  /** @brief returns what the store did since it was opened
+  *
+  * @return PathStoreCounters counters of the store
+  */
+  PathStoreCounters counters() const;
+
+private:
+  /** @brief PathStore copy constructor
+  *
+  * The store cannot be copied
+  *
+  * @return *PathStore
+  */
+  PathStore(const PathStore& other) = delete;
+  /** @brief PathStore copy operation
+  *
+  * The store cannot be copied
+  *
+  * @return PathStore
+  */
+  PathStore operator=(const PathStore& other) = delete;
+  /** @brief Queues a row for the writer thread
+  *
+  * @param write row to write
+  * @return void
+  */
+  void queue(PathStoreWrite write);
+  /** @brief Loop of the writer thread
+  *
+  * Waits for a batch of rows and writes it in a transaction
+  *
+  * @return void
+  */
+  void writerLoop();
+  /** @brief Writes a row with the writer connection
+  *
+  * @param write row to write
+  * @return bool false if the statement failed
+  */
+  bool write(const PathStoreWrite& write);
+  //Connection of the callers, only reads
+  sqlite3* reader_;
+
+  //Connection of the writer thread
+  sqlite3* writer_;
+
+  sqlite3_stmt* select_path_;
+
+  sqlite3_stmt* select_layer_;
+
+  sqlite3_stmt* insert_path_;
+
+  sqlite3_stmt* insert_layer_;
+
+  sqlite3_stmt* insert_result_;
+
+  std::thread writer_thread_;
+
+  std::deque<PathStoreWrite> queue_;
+
+  //Rows taken by the writer thread and not written yet
+  u32 writing_;
+
+  //Calls to flush waiting, the writer doesn't wait for full batches meanwhile
+  u32 flushes_;
+
+  //When the oldest row of the queue was queued
+  std::chrono::steady_clock::time_point oldest_queued_;
+
+  bool quit_;
+
+  mutable std::mutex mutex_;
+
+  std::condition_variable queued_;
+
+  std::condition_variable written_;
+
+  //Times each route was found in this session, by origin << 32 | destination
+  std::unordered_map<u64, u16> route_counts_;
+
+  //Map of the routes counted, the counts start again when it changes
+  u64 counts_map_hash_;
+
+  PathStoreCounters counters_;
+};
+
+#endif
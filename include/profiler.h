@@ -0,0 +1,210 @@
+// profiler.h
+// Jose Maria Martinez
+// Header of the profiler that measures the zones of a frame
+
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include "platform_types.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//The zones are measured in Debug, a Release build defines ENABLE_PROFILER to measure them
+#if defined(DEBUG) || defined(ENABLE_PROFILER)
+#define PROFILER_ENABLED
+#endif
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#ifdef PROFILER_ENABLED
+//Measures from this line to the end of the scope, the name must be a string literal
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#endif
+
+//Zones kept by every thread for the trace, the oldest ones are overwritten
+const u32 kProfileBufferCapacity = 1 << 15;
+
+//Different zones counted by every thread for the summary
+const u32 kProfileMaxZones = 32;
+
+//Buckets of the durations of a zone, four per power of two from 1 us
+const u32 kProfileHistogramBuckets = 96;
+
+/** @brief ProfileEvent struct
+*
+* A zone measured by a thread, the times are in ms
+*
+*/
+struct ProfileEvent
+{
+  const char* name;
+  double start;
+  double duration;
+};
+
+/** @brief Profiler class
+*
+* Keeps the zones measured by every thread. Each thread writes in its own
+* buffer without locks, only the first zone of a thread takes the lock to
+* register its buffer. The buffer has a ring with the last zones, exported
+* as the trace, and a histogram of the durations of every zone, which isn't
+* overwritten so the summary counts every zone however many are measured.
+* The zones a thread overwrites while the ring is read are discarded.
+*
+*/
+class Profiler
+{
+public:
+  /** @brief Gets the instance of the Profiler
+  *
+  * @return Profiler& instance
+  */
+  static Profiler& instance();
+  /** @brief Adds a zone measured by the calling thread
+  *
+  * @param name name of the zone, must outlive the profiler
+  * @param start time in ms when the zone started
+  * @param duration time in ms spent in the zone
+  * @return void
+  */
+  void record(const char* name, const double start, const double duration);
+  /** @brief Writes the zones kept by every thread as a Chrome trace
+  *
+  * The file can be opened with chrome://tracing or Perfetto, every thread
+  * is a row.
+  *
+  * @param file path of the json file
+  * @return s16 kErrorCode_Ok or kErrorCode_File if it couldn't be written
+  */
+  s16 exportChromeTrace(const char* file);
+  /** @brief Prints the percentiles of every zone
+  *
+  * Only the zones measured since the previous summary are used, so calling
+  * it periodically gives the evolution of the frame. The percentiles are
+  * the upper limit of their histogram bucket, at most 25% above the real
+  * duration.
+  *
+  * @return void
+  */
+  void printSummary();
+
+private:
+  /** @brief Profiler constructor
+  *
+  * The buffers are created by the first zone of every thread
+  *
+  * @return *Profiler
+  */
+  Profiler();
+  /** @brief Profiler copy constructor
+  *
+  * The profiler cannot be copied
+  *
+  * @return *Profiler
+  */
+  Profiler(const Profiler& other) = delete;
+  /** @brief Profiler copy operation
+  *
+  * The profiler cannot be copied
+  *
+  * @return Profiler&
+  */
+  Profiler& operator=(const Profiler& other) = delete;
+
+  /** @brief ZoneHistogram struct
+  *
+  * Durations of a zone in a thread, name is set once by its thread
+  *
+  */
+  struct ZoneHistogram
+  {
+    std::atomic<const char*> name;
+    std::atomic<u32> counts[kProfileHistogramBuckets];
+    std::atomic<u64> total_ns;
+  };
+
+  /** @brief ThreadBuffer struct
+  *
+  * Zones of a thread, only its thread writes in zones and events. The
+  * counts already summarized are only used by the summary.
+  *
+  */
+  struct ThreadBuffer
+  {
+    ProfileEvent events[kProfileBufferCapacity];
+    std::atomic<u64> written;
+    ZoneHistogram zones[kProfileMaxZones];
+    u32 summarized_counts[kProfileMaxZones][kProfileHistogramBuckets];
+    u64 summarized_ns[kProfileMaxZones];
+    u32 thread_index;
+  };
+
+  /** @brief gets the buffer of the calling thread, creating it the first time
+  *
+  * @return ThreadBuffer* buffer of the thread
+  */
+  ThreadBuffer* threadBuffer();
+  /** @brief Copies the zones kept in the ring of a buffer
+  *
+  * @param buffer buffer to read
+  * @param events zones copied, added at the end
+  * @return void
+  */
+  static void collect(const ThreadBuffer& buffer, std::vector<ProfileEvent>* events);
+  /** @brief returns the histogram bucket of a duration
+  *
+  * @param duration duration in ms
+  * @return u32 bucket, the last one for the longest durations
+  */
+  static u32 bucket(const double duration);
+  /** @brief returns the longest duration of a histogram bucket
+  *
+  * @param bucket bucket of the histogram
+  * @return double duration in ms
+  */
+  static double bucketLimit(const u32 bucket);
+
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+
+  //Time when the profiler was created, the origin of the trace
+  double start_time_;
+
+  std::mutex mutex_;
+};
+
+/** @brief ProfileZone class
+*
+* Measures the time from its creation to its destruction, used through PROFILE_ZONE
+*
+*/
+class ProfileZone
+{
+public:
+  /** @brief ProfileZone constructor
+  *
+  * @param name name of the zone, must be a string literal
+  * @return *ProfileZone
+  */
+  explicit ProfileZone(const char* name);
+  /** @brief ProfileZone destructor
+  *
+  * Records the zone in the buffer of the thread
+  *
+  * @return void
+  */
+  ~ProfileZone();
+
+private:
+  ProfileZone(const ProfileZone& other) = delete;
+  ProfileZone& operator=(const ProfileZone& other) = delete;
+
+  const char* name_;
+  double start_;
+};
+
+#endif
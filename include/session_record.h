@@ -0,0 +1,89 @@
+// session_record.h
+// Jose Maria Martinez
+// Header of the format of the recorded sessions
+#ifndef __SESSION_RECORD_H__
+#define __SESSION_RECORD_H__
+
+#include "platform_types.h"
+#include "Math/float2.h"
+
+//Version of the file format, files with another version are rejected
+const u32 kSessionVersion = 3;
+
+enum class SessionEventType
+{
+  k_PathRequest = 0,
+  k_PathCompute = 1,
+  k_StartPath = 2,
+  k_CancelPath = 3,
+  k_PathHandle = 4,
+  k_PADDING = 255
+};
+
+/** @brief Header of a recorded session file
+*
+* It's followed by map_length characters of the source of the map, by
+* num_agents spawns and by the ticks until the end of the file. Every
+* tick is a SessionTickHeader followed by its events. The viewport is the
+* one of the AI level of detail, it changes how often the agents think.
+* map_size is the size of the original map, the collisions are scaled to it.
+*
+*/
+struct SessionHeader
+{
+  char magic[4];
+  u32 version;
+  u32 seed;
+  u32 time_step;
+  u32 num_agents;
+  u32 map_length;
+  Float2 viewport_min;
+  Float2 viewport_max;
+  Float2 map_size;
+};
+
+/** @brief Agent alive when the recording started
+*
+* The agents are created again in the same order so they get the same ids.
+*
+*/
+struct SessionSpawn
+{
+  u32 id;
+  u8 type;
+  u8 has_path_finder;
+  u8 clearance;
+  u8 padding;
+  float x;
+  float y;
+};
+
+/** @brief Header of a recorded tick
+*
+* update_ms is the time updateAgents took when it was recorded.
+*
+*/
+struct SessionTickHeader
+{
+  u16 dt;
+  u16 num_events;
+  float update_ms;
+};
+
+/** @brief Command given to an agent before the update of a tick
+*
+* agent is the id of the agent, origin and dst are not used by k_StartPath
+* and k_CancelPath. deadline is the relative deadline of k_PathRequest and
+* k_PathHandle.
+*
+*/
+struct SessionEvent
+{
+  SessionEventType type;
+  u32 agent;
+  Float2 origin;
+  Float2 dst;
+  u32 deadline;
+};
+
+#endif
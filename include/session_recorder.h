@@ -0,0 +1,110 @@
+// session_recorder.h
+// Jose Maria Martinez
+// Header of the recorder of the inputs of a session
+#ifndef __SESSION_RECORDER_H__
+#define __SESSION_RECORDER_H__
+
+#include "session_record.h"
+#include <cstdio>
+#include <vector>
+
+class World;
+
+/** @brief SessionRecorder class
+*
+* Writes to a file everything the simulation needs to run a session again
+* without window: the seed, the map, the agents alive when the recording
+* starts and, for every tick, its dt, the commands given to the agents
+* before the update and how long the update took. The Headless project
+* replays the file and compares the time of every tick, so a session that
+* went slow can be kept as a benchmark.
+*
+*/
+class SessionRecorder
+{
+public:
+  /** @brief SessionRecorder constructor
+  *
+  * Default SessionRecorder constructor, it doesn't record until begin
+  *
+  * @return *SessionRecorder
+  */
+  SessionRecorder();
+  /** @brief SessionRecorder destructor
+  *
+  * Closes the file if it's still recording
+  *
+  * @return void
+  */
+  ~SessionRecorder();
+  /** @brief Starts to record
+  *
+  * Writes the header and the agents of the world, call it once the map
+  * and the agents are created.
+  *
+  * @param file path of the file written
+  * @param world world recorded, the one that owns the recorder
+  * @param time_step time step the world is updated with
+  * @return s16 error code
+  * kErrorCode_Ok -> Everything went well
+  * kErrorCode_InvalidPointer -> file was nullptr
+  * kErrorCode_File -> The file couldn't be written
+  */
+  s16 begin(const char* file, const World& world, const u32 time_step);
+  /** @brief Records a command given to an agent
+  *
+  * It's written with the tick that ends at the next endTick. The commands
+  * are given from the main thread, never while the agents are updated.
+  *
+  * @param type command given
+  * @param agent id of the agent
+  * @param origin origin of the path, unused by k_StartPath
+  * @param dst destination of the path, unused by k_StartPath
+  * @param deadline ms the path is wanted for, only used by k_PathRequest and k_PathHandle
+  * @return void
+  */
+  void record(const SessionEventType type, const u32 agent, const Float2& origin, const Float2& dst,
+              const u32 deadline = 0);
+  /** @brief Writes a tick with the commands recorded since the last one
+  *
+  * @param dt time that has passed in the game world
+  * @param update_ms time the update took
+  * @return void
+  */
+  void endTick(const u32 dt, const float update_ms);
+  /** @brief Stops recording and closes the file
+  *
+  * @return s16 kErrorCode_File if any write failed
+  */
+  s16 end();
+  /** @brief Checks if a session is being recorded
+  *
+  * @return bool true between begin and end
+  */
+  bool isRecording() const;
+
+private:
+  FILE* file_;
+
+  //Commands of the tick being recorded
+  std::vector<SessionEvent> events_;
+
+  bool failed_;
+
+  /** @brief SessionRecorder copy constructor
+  *
+  * The recorder cannot be copied
+  *
+  * @return *SessionRecorder
+  */
+  SessionRecorder(const SessionRecorder& other) = delete;
+  /** @brief SessionRecorder copy operation
+  *
+  * The recorder cannot be copied
+  *
+  * @return SessionRecorder&
+  */
+  SessionRecorder& operator=(const SessionRecorder& other) = delete;
+};
+
+#endif
@@ -0,0 +1,121 @@
+// session_replayer.h
+// Jose Maria Martinez
+// Header of the reader of the recorded sessions
+#ifndef __SESSION_REPLAYER_H__
+#define __SESSION_REPLAYER_H__
+
+#include "session_record.h"
+#include <string>
+#include <vector>
+
+/** @brief SessionTick struct
+*
+* Tick of a loaded session, its events are num_events consecutive events
+* starting at first_event.
+*
+*/
+struct SessionTick
+{
+  u32 dt;
+  float update_ms;
+  u32 first_event;
+  u32 num_events;
+};
+
+/** @brief SessionReplayer class
+*
+* Loads a session written by SessionRecorder. The Headless project creates
+* its agents, gives them the commands of every tick and updates them with
+* the same dt to run the session again as fast as possible.
+*
+*/
+class SessionReplayer
+{
+public:
+  /** @brief SessionReplayer constructor
+  *
+  * Default SessionReplayer constructor, no session is loaded
+  *
+  * @return *SessionReplayer
+  */
+  SessionReplayer();
+  /** @brief SessionReplayer destructor
+  *
+  * Default SessionReplayer destructor
+  *
+  * @return void
+  */
+  ~SessionReplayer();
+  /** @brief Loads a session
+  *
+  * Reads the whole file, a tick cut at the end of the file is dropped.
+  *
+  * @param file path of the session
+  * @return s16 error code
+  * kErrorCode_Ok -> Everything went well
+  * kErrorCode_InvalidPointer -> file was nullptr
+  * kErrorCode_File -> The file couldn't be read or isn't a session of this version
+  */
+  s16 load(const char* file);
+  /** @brief Seed of the random sequences when the session was recorded
+  *
+  * @return u32 seed
+  */
+  u32 seed() const;
+  /** @brief Time step of the game when the session was recorded
+  *
+  * @return u32 time step in ms
+  */
+  u32 timeStep() const;
+  /** @brief Top left corner of the viewport when the session was recorded
+  *
+  * @return Float2 top left corner
+  */
+  Float2 viewportMin() const;
+  /** @brief Bottom right corner of the viewport when the session was recorded
+  *
+  * @return Float2 bottom right corner
+  */
+  Float2 viewportMax() const;
+  /** @brief Size of the original map of the session
+  *
+  * @return Float2 width and height the collisions are scaled to
+  */
+  Float2 mapSize() const;
+  /** @brief Source of the collision map of the session
+  *
+  * @return const char* source, empty if there was no map
+  */
+  const char* mapSource() const;
+  /** @brief Agents alive when the recording started
+  *
+  * @return const std::vector<SessionSpawn>& agents in order of creation
+  */
+  const std::vector<SessionSpawn>& spawns() const;
+  /** @brief Number of ticks recorded
+  *
+  * @return u32 number of ticks
+  */
+  u32 numTicks() const;
+  /** @brief Gets a tick
+  *
+  * @param index index of the tick, lower than numTicks
+  * @return const SessionTick& tick
+  */
+  const SessionTick& tick(const u32 index) const;
+  /** @brief Gets an event
+  *
+  * @param index index of the event, taken from a tick
+  * @return const SessionEvent& event
+  */
+  const SessionEvent& event(const u32 index) const;
+
+private:
+  SessionHeader header_;
+  std::string map_source_;
+  std::vector<SessionSpawn> spawns_;
+  std::vector<SessionTick> ticks_;
+  std::vector<SessionEvent> events_;
+};
+
+#endif
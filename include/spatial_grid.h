@@ -0,0 +1,121 @@
+// spatial_grid.h
+// Jose Maria Martinez
+// Header of the uniform grid used to find nearby agents
+#ifndef __SPATIAL_GRID_H__
+#define __SPATIAL_GRID_H__
+
+#include "platform_types.h"
+#include "Math/float2.h"
+#include <vector>
+
+class Agent;
+enum class AgentType;
+
+//Agent types go from k_Huge (1) to k_Hero (4)
+const u8 kNumAgentTypes = 4;
+
+/** @brief SpatialGridEntry struct
+*
+* Agent stored in a cell of the grid with its position at the last rebuild
+*
+*/
+struct SpatialGridEntry
+{
+  Float2 position;
+  Agent* agent;
+};
+
+/** @brief SpatialGrid class
+*
+* Uniform grid over the positions of the agents, there is one grid per agent
+* type so a query only visits the agents of the type it's interested in. The
+* grid is rebuilt once per tick with the positions of the agents at that moment,
+* the cells are stored contiguously so a rebuild doesn't allocate once the
+* vectors have grown.
+*
+*/
+class SpatialGrid
+{
+public:
+  /** @brief SpatialGrid constructor
+  *
+  * Default SpatialGrid constructor, the grid is empty until rebuilt
+  *
+  * @return *SpatialGrid
+  */
+  SpatialGrid();
+  /** @brief SpatialGrid destructor
+  *
+  * Default SpatialGrid destructor
+  *
+  * @return void
+  */
+  ~SpatialGrid();
+  /** @brief Sets the size of the cells
+  *
+  * Queries visit every cell their radius touches, so cells around the size
+  * of the usual radius keep the visited cells low. Takes effect at the next
+  * rebuild.
+  *
+  * @param cell_size size of a cell in world units, 300 by default
+  * @return void
+  */
+  void set_cell_size(const float cell_size);
+  /** @brief Rebuilds the grid
+  *
+  * Stores every agent in the cell of its current position. The grid covers
+  * the bounding box of the agents so there are no world limits.
+  *
+  * @param agents agents of the game
+  * @return void
+  */
+  void rebuild(const std::vector<Agent*>& agents);
+  /** @brief Finds the agents of a type around a position
+  *
+  * Adds to result every agent of the type whose position at the last rebuild
+  * is at a distance less or equal than radius of center. The distances are
+  * compared squared.
+  *
+  * @param type type of the agents wanted
+  * @param center center of the query
+  * @param radius radius of the query
+  * @param result vector where the agents found are added
+  * @return void
+  */
+  void queryRadius(const AgentType type, const Float2& center, const float radius,
+                   std::vector<Agent*>* result) const;
+  /** @brief returns the number of agents stored
+  *
+  * @return u32 agents stored at the last rebuild
+  */
+  u32 size() const;
+
+private:
+
+  float cell_size_;
+
+  //Position of the corner of the first cell
+  Float2 origin_;
+
+  s32 columns_;
+
+  s32 rows_;
+
+  //Index of the first entry of each cell, per agent type
+  std::vector<u32> cell_start_[kNumAgentTypes];
+
+  std::vector<SpatialGridEntry> entries_[kNumAgentTypes];
+
+  //Cell of each agent during the rebuild
+  std::vector<s32> agent_cells_;
+  /** @brief returns the column or row of a coordinate
+  *
+  * @param value coordinate
+  * @param origin coordinate of the first cell
+  * @param count number of columns or rows
+  * @return s32 column or row clamped to the grid
+  */
+  s32 cellCoordinate(const float value, const float origin, const s32 count) const;
+};
+
+#endif
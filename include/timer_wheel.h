@@ -0,0 +1,142 @@
+// timer_wheel.h
+// Jose Maria Martinez
+// Header of the hierarchical timing wheel that wakes up the agents
+#ifndef __TIMER_WHEEL_H__
+#define __TIMER_WHEEL_H__
+
+#include "platform_types.h"
+#include <vector>
+
+//Levels of the wheel and slots per level, each level covers 64 times the
+//time of the previous one so 4 levels cover more than 4 hours in ms
+const u32 kWheelLevels = 4;
+const u32 kWheelSlotBits = 6;
+const u32 kWheelSlots = 1 << kWheelSlotBits;
+
+//Due time of an id without timer
+const u32 kNoTimer = 0xFFFFFFFF;
+
+/** @brief TimerEntry struct
+*
+* Timer stored in a slot of the wheel, stamp must match the one of its id
+* or the timer was cancelled or rescheduled.
+*
+*/
+struct TimerEntry
+{
+  u32 due;
+  u32 id;
+  u32 stamp;
+};
+
+/** @brief TimerWheel class
+*
+* Hierarchical timing wheel with a resolution of 1 ms. Every id has at most
+* one timer, scheduling it again replaces the previous one. Timers are kept
+* in the slot of the level their distance falls in and moved to the lower
+* levels when the wheel gets close, so advancing costs the ms advanced plus
+* the timers that fire, no matter how many timers are waiting.
+*
+*/
+class TimerWheel
+{
+public:
+  /** @brief TimerWheel constructor
+  *
+  * Default TimerWheel constructor, the wheel starts at time 0
+  *
+  * @return *TimerWheel
+  */
+  TimerWheel();
+  /** @brief TimerWheel destructor
+  *
+  * Default TimerWheel destructor
+  *
+  * @return void
+  */
+  ~TimerWheel();
+  /** @brief Schedules the timer of an id
+  *
+  * Replaces the timer the id had. A due time that has already passed fires
+  * at the next advance.
+  *
+  * @param id identifier the timer will return
+  * @param due time at which the timer fires
+  * @return void
+  */
+  void schedule(const u32 id, const u32 due);
+  /** @brief Cancels the timer of an id
+  *
+  * @param id identifier of the timer
+  * @return void
+  */
+  void cancel(const u32 id);
+  /** @brief returns when the timer of an id fires
+  *
+  * @param id identifier of the timer
+  * @return u32 due time or kNoTimer if the id has no timer
+  */
+  u32 due(const u32 id) const;
+  /** @brief Advances the wheel
+  *
+  * Moves the time of the wheel to now and adds to fired the ids whose timer
+  * is due, once each. The timers that fire are removed.
+  *
+  * @param now new time of the wheel, it can't go backwards
+  * @param fired where the ids whose timer fired are added
+  * @return void
+  */
+  void advance(const u32 now, std::vector<u32>* fired);
+  /** @brief returns the time of the wheel
+  *
+  * @return u32 time of the last advance
+  */
+  u32 now() const;
+  /** @brief Removes every timer
+  *
+  * @return void
+  */
+  void clear();
+
+private:
+  u32 now_;
+
+  std::vector<TimerEntry> slots_[kWheelLevels][kWheelSlots];
+
+  //Timers scheduled at or before now_, fired at the next advance
+  std::vector<TimerEntry> expired_;
+
+  //Current stamp and due time of every id
+  std::vector<u32> stamps_;
+  std::vector<u32> dues_;
+
+  /** @brief Puts a timer in the slot of its distance to now_
+  *
+  * @param entry timer to store
+  * @return void
+  */
+  void insert(const TimerEntry& entry);
+  /** @brief Fires a timer if it is still the one of its id
+  *
+  * @param entry timer that is due
+  * @param fired where the id is added
+  * @return void
+  */
+  void fire(const TimerEntry& entry, std::vector<u32>* fired);
+  /** @brief TimerWheel copy constructor
+  *
+  * The wheel cannot be copied
+  *
+  * @return *TimerWheel
+  */
+  TimerWheel(const TimerWheel& other) = delete;
+  /** @brief TimerWheel copy operation
+  *
+  * The wheel cannot be copied
+  *
+  * @return TimerWheel&
+  */
+  TimerWheel& operator=(const TimerWheel& other) = delete;
+};
+
+#endif
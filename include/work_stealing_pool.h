@@ -0,0 +1,130 @@
+// work_stealing_pool.h
+// Jose Maria Martinez
+// Header of the work stealing thread pool
+#ifndef __WORK_STEALING_POOL_H__
+#define __WORK_STEALING_POOL_H__
+
+#include "platform_types.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/** @brief WorkStealingPool class
+*
+* Pool of threads that run ranges of a parallel loop. Every thread has its own
+* queue of ranges, it takes them from the front of its queue and, when it's
+* empty, steals them from the back of the queue of another thread. The thread
+* that calls parallelFor works as one more thread of the pool.
+*
+*/
+class WorkStealingPool
+{
+public:
+  /** @brief WorkStealingPool constructor
+  *
+  * Default constructor, the pool has no threads until start is called
+  *
+  * @return *WorkStealingPool
+  */
+  WorkStealingPool();
+  /** @brief WorkStealingPool destructor
+  *
+  * Stops the threads of the pool
+  *
+  * @return void
+  */
+  ~WorkStealingPool();
+  /** @brief Starts the threads of the pool
+  *
+  * Stops the previous threads if there were any.
+  *
+  * @param num_threads threads that run the loops counting the caller, 0 uses one per core
+  * @return s16 kErrorCode_Ok or kErrorCode_Memory if the threads couldn't be created
+  */
+  s16 start(u32 num_threads);
+  /** @brief Stops the threads of the pool
+  *
+  * @return void
+  */
+  void stop();
+  /** @brief returns the threads that run the loops
+  *
+  * @return u32 threads of the pool counting the caller, 1 if it's not started
+  */
+  u32 numThreads() const;
+  /** @brief Runs a loop in parallel
+  *
+  * Splits [0, count) in ranges of grain elements and runs job for each of them.
+  * Returns once every range is finished. The ranges must not depend on each other.
+  *
+  * @param count number of elements of the loop
+  * @param grain elements of each range
+  * @param job function called with the first element and the element after the last one
+  * @return void
+  */
+  void parallelFor(const u32 count, const u32 grain, const std::function<void(u32, u32)>& job);
+
+private:
+
+  struct WorkQueue
+  {
+    std::mutex mutex;
+    std::deque<std::pair<u32, u32>> ranges;
+  };
+
+  std::vector<std::thread> threads_;
+
+  //Queue 0 belongs to the caller of parallelFor
+  std::vector<std::unique_ptr<WorkQueue>> queues_;
+
+  const std::function<void(u32, u32)>* job_;
+
+  //Ranges not finished of the current loop
+  std::atomic<u32> pending_;
+
+  std::mutex wake_mutex_;
+
+  std::condition_variable wake_;
+
+  u64 generation_;
+
+  bool quit_;
+  /** @brief Runs one range
+  *
+  * Takes a range from the queue of the thread or steals it from another one
+  *
+  * @param worker index of the thread
+  * @return bool false if there was no range to run
+  */
+  bool runRange(const u32 worker);
+  /** @brief Loop of the threads of the pool
+  *
+  * Waits for a new loop and runs its ranges until there are none left
+  *
+  * @param worker index of the thread
+  * @return void
+  */
+  void workerLoop(const u32 worker);
+  /** @brief WorkStealingPool copy constructor
+  *
+  * The pool cannot be copied
+  *
+  * @return *WorkStealingPool
+  */
+  WorkStealingPool(const WorkStealingPool& other) = delete;
+  /** @brief WorkStealingPool copy operation
+  *
+  * The pool cannot be copied
+  *
+  * @return *WorkStealingPool
+  */
+  WorkStealingPool operator=(const WorkStealingPool& other) = delete;
+};
+
+#endif
@@ -0,0 +1,218 @@
+// world.h
+// Jose Maria Martinez
+// Header of the world where the agents are simulated
+
+#ifndef __WORLD_H__
+#define __WORLD_H__
+
+#include <agent.h>
+#include <cstdint>
+#include <vector>
+#include "map.h"
+#include "spatial_grid.h"
+#include "agent_store.h"
+#include "work_stealing_pool.h"
+#include "message_dispatcher.h"
+#include "timer_wheel.h"
+#include "session_recorder.h"
+#include "moving_target_search.h"
+#include "occupancy_grid.h"
+
+class PathFinder;
+
+/** @brief UpdateTimings struct
+*
+* Time spent in each phase of updateAgents since the timings were reset
+*
+*/
+struct UpdateTimings
+{
+  uint32_t ticks = 0;
+  double grid_ms = 0.0;
+  double lod_ms = 0.0;
+  double wake_ms = 0.0;
+  double integrate_ms = 0.0;
+  double occupancy_ms = 0.0;
+  double deliver_ms = 0.0;
+};
+
+/** @brief World class
+*
+* Everything one simulation needs: the map, the agents, the path finder
+* and the ids given to the agents. The agents and the path finder are
+* created in a world and only see that world, so a process can update as
+* many worlds as it wants, each one from a different thread. The GameState
+* of the projects with window is a world too.
+* A decoded map can be shared between worlds with shareMap, the worlds only
+* read it. The path databases are memory mapped, so the path finders of the
+* worlds that use the same map already share their pages.
+*
+*/
+class World {
+
+public:
+  /** @brief World constructor
+  *
+  * Creates an empty world without map, the first agent gets the id 1
+  *
+  * @return *World
+  */
+  World();
+  /** @brief World destructor
+  *
+  * The agents and the path finder must be destroyed before their world
+  *
+  * @return void
+  */
+  ~World();
+  /** @brief Updates the agents
+  *
+  * Rebuilds the agent grid, wakes up the agents whose timer is due and
+  * integrates the movement of every agent. The agents that are not woken up
+  * have nothing to do this tick, they are scheduled again by the delay
+  * returned from Agent::wake. Once per rebalance period the AI level of
+  * detail reassigns how often each agent thinks.
+  * During the update the agents only read the positions of the previous tick,
+  * which don't change until all of them are integrated, and write their own
+  * state, so with update_threads_ different than 1 the agents are split between
+  * the threads of a work stealing pool. The result is the same with any number
+  * of threads. The messages sent during the tick are delivered at the end and
+  * wake up the agents that receive them.
+  *
+  * @param dt time that has passed in the game world
+  * @return void
+  */
+  void updateAgents(const uint32_t dt);
+  /** @brief Gives an id to a new agent
+  *
+  * The ids start at 1 in every world, 0 is the id of the path finder.
+  *
+  * @return uint32_t id of the agent
+  */
+  uint32_t allocateAgentId();
+  /** @brief Adds an agent to the ones woken up by updateAgents
+  *
+  * Called by the agent when it's created, it's woken up at the next update.
+  *
+  * @param agent agent to add
+  * @return void
+  */
+  void registerAgent(Agent* agent);
+  /** @brief Removes an agent from the ones woken up by updateAgents
+  *
+  * Called by the agent when it's destroyed.
+  *
+  * @param agent agent to remove
+  * @return void
+  */
+  void unregisterAgent(Agent* agent);
+  /** @brief Wakes up an agent at the next update
+  *
+  * Used when something outside the agent changes what it has to do.
+  *
+  * @param id id of the agent
+  * @return void
+  */
+  void wakeAgent(const uint32_t id);
+  /** @brief gets an agent of the world
+  *
+  * @param id id of the agent
+  * @return Agent* the agent, nullptr if there is no agent with that id
+  */
+  Agent* agent(const uint32_t id) const;
+  /** @brief Uses a map owned by someone else
+  *
+  * The map must be loaded and outlive the world, nullptr goes back to map_.
+  * Its content hash is calculated here so the worlds that share it only
+  * read it.
+  *
+  * @param map map shared with other worlds
+  * @return void
+  */
+  void shareMap(const Map* map);
+  /** @brief gets the map the agents move in
+  *
+  * @return const Map& the shared map if there is one, map_ otherwise
+  */
+  const Map& map() const;
+
+  std::vector<Agent*> agents_;
+
+  PathFinder* pf_agent_;
+
+  //Map of the world, not used while a shared map is set
+  Map map_;
+
+  //Positions of the agents, rebuilt at the start of every update
+  SpatialGrid agent_grid_;
+
+  //Movement data of the agents, integrated after every agent is updated
+  AgentStore agent_store_;
+
+  //Agents in each cell of the map, updated after the integration
+  OccupancyGrid occupancy_;
+
+  //Seed of the random sequences of the agents created from now on
+  uint32_t seed_;
+
+  //Threads used by updateAgents, 0 uses one per core
+  uint32_t update_threads_;
+
+  WorkStealingPool update_pool_;
+
+  MessageDispatcher dispatcher_;
+
+  //Time of the game world in ms, advanced by updateAgents
+  uint32_t game_time_;
+
+  //Wake ups of the agents by id
+  TimerWheel agent_timers_;
+
+  //Think rate of the agents, the mains set its viewport
+  AILod ai_lod_;
+
+  //Without window the agents don't load their sprites
+  bool headless_;
+
+  //Accumulated by updateAgents, reset it to measure a period
+  UpdateTimings update_timings_;
+
+  //Records the ticks of updateAgents between begin and end
+  SessionRecorder recorder_;
+
+  //Searches of the agents chasing through the map, check MovingTargetSearch
+  ChaseStats chase_stats_;
+
+private:
+  /** @brief World copy constructor
+  *
+  * The world cannot be copied
+  *
+  * @return *World
+  */
+  World(const World& other) = delete;
+  /** @brief World copy operation
+  *
+  * The world cannot be copied
+  *
+  * @return World&
+  */
+  World& operator=(const World& other) = delete;
+
+  //Id of the next agent created in the world
+  uint32_t next_agent_id_;
+
+  const Map* shared_map_;
+
+  //Agents registered by id, the ids of the timer wheel
+  std::vector<Agent*> agents_by_id_;
+
+  //Buffers of updateAgents reused between ticks
+  std::vector<u32> awake_ids_;
+  std::vector<Agent*> awake_agents_;
+  std::vector<u32> wake_delays_;
+  std::vector<double> wake_costs_;
+  std::vector<Agent*> lod_changed_;
+};
+
+#endif
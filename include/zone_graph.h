@@ -0,0 +1,173 @@
+// zone_graph.h
+// Jose Maria Martinez
+// Header of the graph of zones and portals used to plan the routes of the paths
+#ifndef __ZONE_GRAPH_H__
+#define __ZONE_GRAPH_H__
+
+#include "platform_types.h"
+#include <vector>
+
+class Map;
+
+//Side in cells of the sectors that split the zones, so no zone is bigger than a sector
+const s32 kZoneSectorSize = 16;
+
+/** @brief ZonePortal struct
+*
+* Cell of a zone next to another zone. The portals come in pairs, one at
+* each side of the border, and twin is the index of the other one.
+*
+*/
+struct ZonePortal
+{
+  s32 cell;
+  s32 zone;
+  s32 twin;
+};
+
+/** @brief ZoneEdge struct
+*
+* Connection of a portal with another one, cost in the units of the A*
+* (10 a straight step, 15 a diagonal one)
+*
+*/
+struct ZoneEdge
+{
+  s32 portal;
+  u32 cost;
+};
+
+/** @brief ZoneGraph class
+*
+* Splits the free cells of a map in zones, connected groups of cells of the
+* same zone id that don't leave their sector, and joins the zones with
+* portals. Each border between two zones has a portal pair per stretch of
+* cells that touch, and the portals of a zone are joined with the cost of
+* the shortest path between them inside the zone, calculated when the
+* graph is built.
+*
+* findCorridor solves a route on the portals and returns the zones it goes
+* through, so a search restricted to them only visits the cells of the
+* corridor. The route is the shortest one between portals, the path in
+* the corridor can be a bit longer than the shortest one of the map.
+* The zones are built for agents of one cell and the moves of the A*,
+* 8 neighbours without checking the corners.
+*
+*/
+class ZoneGraph
+{
+public:
+  /** @brief ZoneGraph constructor
+  *
+  * Creates a graph without zones
+  *
+  * @return *ZoneGraph
+  */
+  ZoneGraph();
+  /** @brief ZoneGraph destructor
+  *
+  * Default ZoneGraph destructor
+  *
+  * @return void
+  */
+  ~ZoneGraph();
+  /** @brief Builds the zones, portals and distances of a map
+  *
+  * The possible results of this operation are:
+  * kErrorCode_PathNotCreated -> There is no map loaded
+  * kErrorCode_IncorrectPointsNumber -> zone_ids doesn't have a value per cell or sector_size is not positive
+  * kErrorCode_Memory -> The program was unable of allocating memory
+  * kErrorCode_Ok -> Everything went fine
+  *
+  * @param map collision map, the zones are only valid until its cells change
+  * @param zone_ids id of the zone of every cell, nullptr to only split by sectors
+  * @param sector_size side in cells of the sectors
+  * @return s16 status of the operation
+  */
+  s16 build(const Map& map, const std::vector<u32>* zone_ids, const s32 sector_size);
+  /** @brief Removes the zones
+  *
+  * @return void
+  */
+  void clear();
+  /** @brief checks if the graph has zones
+  *
+  * @return bool true once build succeeded
+  */
+  bool isBuilt() const;
+  /** @brief returns the number of zones
+  *
+  * @return s32 zones of the map
+  */
+  s32 numZones() const;
+  /** @brief returns the number of portals
+  *
+  * @return s32 portals of the graph, two per crossing between zones
+  */
+  s32 numPortals() const;
+  /** @brief returns the zone of a cell
+  *
+  * @param x column of the cell
+  * @param y row of the cell
+  * @return s32 zone of the cell, -1 if it's blocked or outside the map
+  */
+  s32 zone(const s32 x, const s32 y) const;
+  /** @brief Calculates the zones a path goes through
+  *
+  * The possible results of this operation are:
+  * kErrorCode_InvalidPointer -> corridor was nullptr
+  * kErrorCode_InvalidOrigin -> The origin is outside the zones
+  * kErrorCode_InvalidDestination -> The destination is outside the zones
+  * kErrorCode_PathNotFound -> There is no route between the zones
+  * kErrorCode_Ok -> The corridor was calculated
+  *
+  * @param origin cell of the origin, x + y * width
+  * @param dst cell of the destination, x + y * width
+  * @param corridor 1 for each zone of the route and 0 for the rest
+  * @return s16 status of the operation
+  */
+  s16 findCorridor(const s32 origin, const s32 dst, std::vector<u8>* corridor) const;
+
+private:
+  /** @brief Calculates the cost from a cell to the cells of its zone
+  *
+  * Dijkstra that doesn't leave the zone of the cell. The costs are indexed
+  * by the position of the cell inside its sector.
+  *
+  * @param cell cell the costs are measured from
+  * @param costs cost of every cell of the sector, kZoneUnreached outside the zone
+  * @return void
+  */
+  void zoneCosts(const s32 cell, std::vector<u32>* costs) const;
+  /** @brief returns the index of a cell inside its sector
+  *
+  * @param cell cell of the map
+  * @return s32 x + y * sector_size relative to the corner of the sector
+  */
+  s32 sectorIndex(const s32 cell) const;
+
+  s32 width_;
+
+  s32 height_;
+
+  s32 sector_size_;
+
+  //Zone of each cell, -1 for the blocked ones
+  std::vector<s32> zone_;
+
+  s32 num_zones_;
+
+  std::vector<ZonePortal> portals_;
+
+  //Edges of portal i are edges_[edge_start_[i]] to edges_[edge_start_[i + 1]]
+  std::vector<u32> edge_start_;
+
+  std::vector<ZoneEdge> edges_;
+
+  //Portals of zone i are zone_portals_[zone_portal_start_[i]] to zone_portals_[zone_portal_start_[i + 1]]
+  std::vector<u32> zone_portal_start_;
+
+  std::vector<s32> zone_portals_;
+};
+
+#endif
@@ -5,6 +5,11 @@
 -- Genie Project Configuration.
 -- ---------------------------------
 
+newoption {
+  trigger = "profiler",
+  description = "Measure the profiler zones in Release builds"
+}
+
 solution ("3IA_Solution" .. _ACTION)
   configurations { "Debug", "Release" }
   platforms { "x32", "x64" }
@@ -15,7 +20,7 @@ solution ("3IA_Solution" .. _ACTION)
 	language "C++"
 	kind "ConsoleApp"
 
-	projects = { "PR0_Base", "PR1_AStar", "PR2_Extras" }
+	projects = { "PR0_Base", "PR1_AStar", "PR2_Extras", "CPD_Builder", "Benchmark", "Headless" }
 
 	for i, prj in ipairs(projects) do 
 		project (prj)
@@ -57,19 +62,34 @@ solution ("3IA_Solution" .. _ACTION)
 		  
 		configuration "windows"
 			links { "opengl32", "user32", "gdi32", "shell32"}
+
+		--Without ESAT.lib the projects use the headless ESAT, run them from build/<project>/<action>
+		configuration "linux"
+			files { "./deps/ESAT_headless/*.cc" }
+			buildoptions { "-std=c++14" }
+			--SQLite of the system, in Windows it comes in ESAT_extra
+			links { "pthread", "sqlite3" }
 		
 		configuration "Debug"
 		   defines {"DEBUG"}
-		   links {"ESAT_d", "ESAT_extra_d"}
 		   targetdir "./bin/debug"
 		   flags { "Symbols" }
 		   implibsuffix "-d"
 
+		configuration { "Debug", "windows" }
+		   links {"ESAT_d", "ESAT_extra_d"}
+
 		configuration "Release"
-		  links {"ESAT", "ESAT_extra"}
 		  targetdir "./bin/release"
 		  flags { "OptimizeSpeed", "No64BitChecks" }
 
+		--premake4 --profiler <action> measures the profiler zones in Release too
+		configuration { "Release", "profiler" }
+		  defines {"ENABLE_PROFILER"}
+
+		configuration { "Release", "windows" }
+		  links {"ESAT", "ESAT_extra"}
+
 	end
 
 	project "PR0_Base"
@@ -77,15 +97,59 @@ solution ("3IA_Solution" .. _ACTION)
 		"./include/agent.h",
 		"./include/path.h",
 		"./include/gamestate.h",
+		"./include/world.h",
 		"./include/astar.h",
+		"./include/path_stats.h",
+		"./include/path_handle.h",
+		"./include/moving_target_search.h",
+		"./include/occupancy_grid.h",
+		"./include/profiler.h",
 		"./include/map.h",
+		"./include/zone_graph.h",
+		"./include/asset_cache.h",
 		"./include/path_finder.h",
+		"./include/mapped_file.h",
+		"./include/compressed_path_database.h",
+		"./include/nav_mesh.h",
+		"./include/path_store.h",
+		"./include/spatial_grid.h",
+		"./include/agent_store.h",
+		"./include/work_stealing_pool.h",
+		"./include/message.h",
+		"./include/inbox.h",
+		"./include/message_dispatcher.h",
+		"./include/timer_wheel.h",
+		"./include/ai_lod.h",
+		"./include/session_record.h",
+		"./include/session_recorder.h",
+		"./include/session_replayer.h",
 		"./src/agent.cc",
 		"./src/path.cc",
 		"./src/path_finder.cc",
 		"./src/astar.cpp",
+		"./src/path_stats.cc",
+		"./src/path_handle.cc",
+		"./src/moving_target_search.cc",
+		"./src/occupancy_grid.cc",
+		"./src/profiler.cc",
 		"./src/gamestate.cc",
+		"./src/world.cc",
 		"./src/map.cc",
+		"./src/zone_graph.cc",
+		"./src/asset_cache.cc",
+		"./src/mapped_file.cc",
+		"./src/compressed_path_database.cc",
+		"./src/nav_mesh.cc",
+		"./src/path_store.cc",
+		"./src/spatial_grid.cc",
+		"./src/agent_store.cc",
+		"./src/work_stealing_pool.cc",
+		"./src/inbox.cc",
+		"./src/message_dispatcher.cc",
+		"./src/timer_wheel.cc",
+		"./src/ai_lod.cc",
+		"./src/session_recorder.cc",
+		"./src/session_replayer.cc",
 		"./tests/main_base.cc",
 		
 		}
@@ -96,15 +160,59 @@ solution ("3IA_Solution" .. _ACTION)
 		"./include/agent.h",
 		"./include/path.h",
 		"./include/gamestate.h",
+		"./include/world.h",
 		"./include/astar.h",
+		"./include/path_stats.h",
+		"./include/path_handle.h",
+		"./include/moving_target_search.h",
+		"./include/occupancy_grid.h",
+		"./include/profiler.h",
 		"./include/map.h",
+		"./include/zone_graph.h",
+		"./include/asset_cache.h",
 		"./include/path_finder.h",
+		"./include/mapped_file.h",
+		"./include/compressed_path_database.h",
+		"./include/nav_mesh.h",
+		"./include/path_store.h",
+		"./include/spatial_grid.h",
+		"./include/agent_store.h",
+		"./include/work_stealing_pool.h",
+		"./include/message.h",
+		"./include/inbox.h",
+		"./include/message_dispatcher.h",
+		"./include/timer_wheel.h",
+		"./include/ai_lod.h",
+		"./include/session_record.h",
+		"./include/session_recorder.h",
+		"./include/session_replayer.h",
 		"./src/agent.cc",
 		"./src/path.cc",
 		"./src/path_finder.cc",
 		"./src/astar.cpp",
+		"./src/path_stats.cc",
+		"./src/path_handle.cc",
+		"./src/moving_target_search.cc",
+		"./src/occupancy_grid.cc",
+		"./src/profiler.cc",
 		"./src/gamestate.cc",
+		"./src/world.cc",
 		"./src/map.cc",
+		"./src/zone_graph.cc",
+		"./src/asset_cache.cc",
+		"./src/mapped_file.cc",
+		"./src/compressed_path_database.cc",
+		"./src/nav_mesh.cc",
+		"./src/path_store.cc",
+		"./src/spatial_grid.cc",
+		"./src/agent_store.cc",
+		"./src/work_stealing_pool.cc",
+		"./src/inbox.cc",
+		"./src/message_dispatcher.cc",
+		"./src/timer_wheel.cc",
+		"./src/ai_lod.cc",
+		"./src/session_recorder.cc",
+		"./src/session_replayer.cc",
 		"./tests/main_astar.cpp",
 	}
 	
@@ -113,14 +221,172 @@ solution ("3IA_Solution" .. _ACTION)
 		"./include/agent.h",
 		"./include/path.h",
 		"./include/gamestate.h",
+		"./include/world.h",
 		"./include/astar.h",
+		"./include/path_stats.h",
+		"./include/path_handle.h",
+		"./include/moving_target_search.h",
+		"./include/occupancy_grid.h",
+		"./include/profiler.h",
 		"./include/map.h",
+		"./include/zone_graph.h",
+		"./include/asset_cache.h",
 		"./include/path_finder.h",
+		"./include/mapped_file.h",
+		"./include/compressed_path_database.h",
+		"./include/nav_mesh.h",
+		"./include/path_store.h",
+		"./include/spatial_grid.h",
+		"./include/agent_store.h",
+		"./include/work_stealing_pool.h",
+		"./include/message.h",
+		"./include/inbox.h",
+		"./include/message_dispatcher.h",
+		"./include/timer_wheel.h",
+		"./include/ai_lod.h",
+		"./include/session_record.h",
+		"./include/session_recorder.h",
+		"./include/session_replayer.h",
 		"./src/agent.cc",
 		"./src/path.cc",
 		"./src/path_finder.cc",
 		"./src/astar.cpp",
+		"./src/path_stats.cc",
+		"./src/path_handle.cc",
+		"./src/moving_target_search.cc",
+		"./src/occupancy_grid.cc",
+		"./src/profiler.cc",
 		"./src/gamestate.cc",
+		"./src/world.cc",
 		"./src/map.cc",
+		"./src/zone_graph.cc",
+		"./src/asset_cache.cc",
+		"./src/mapped_file.cc",
+		"./src/compressed_path_database.cc",
+		"./src/nav_mesh.cc",
+		"./src/path_store.cc",
+		"./src/spatial_grid.cc",
+		"./src/agent_store.cc",
+		"./src/work_stealing_pool.cc",
+		"./src/inbox.cc",
+		"./src/message_dispatcher.cc",
+		"./src/timer_wheel.cc",
+		"./src/ai_lod.cc",
+		"./src/session_recorder.cc",
+		"./src/session_replayer.cc",
 		"./tests/main_extras.cpp",
-	}
\ No newline at end of file
+	}
+
+	project "CPD_Builder"
+		files {
+		"./include/path.h",
+		"./include/map.h",
+		"./include/zone_graph.h",
+		"./include/asset_cache.h",
+		"./include/mapped_file.h",
+		"./include/compressed_path_database.h",
+		"./include/nav_mesh.h",
+		"./src/path.cc",
+		"./src/map.cc",
+		"./src/zone_graph.cc",
+		"./src/asset_cache.cc",
+		"./src/mapped_file.cc",
+		"./src/compressed_path_database.cc",
+		"./src/nav_mesh.cc",
+		"./tests/main_cpd_builder.cc",
+	}
+
+	project "Benchmark"
+		files {
+		"./include/astar.h",
+		"./include/path_stats.h",
+		"./include/path_handle.h",
+		"./include/moving_target_search.h",
+		"./include/occupancy_grid.h",
+		"./include/profiler.h",
+		"./include/path.h",
+		"./include/map.h",
+		"./include/zone_graph.h",
+		"./include/mapped_file.h",
+		"./include/nav_mesh.h",
+		"./include/path_store.h",
+		"./include/asset_cache.h",
+		"./include/agent_store.h",
+		"./src/astar.cpp",
+		"./src/path_stats.cc",
+		"./src/path_handle.cc",
+		"./src/moving_target_search.cc",
+		"./src/occupancy_grid.cc",
+		"./src/profiler.cc",
+		"./src/path.cc",
+		"./src/map.cc",
+		"./src/zone_graph.cc",
+		"./src/mapped_file.cc",
+		"./src/nav_mesh.cc",
+		"./src/path_store.cc",
+		"./src/asset_cache.cc",
+		"./src/agent_store.cc",
+		"./tests/main_benchmark.cpp",
+	}
+
+	project "Headless"
+		files {
+		"./include/agent.h",
+		"./include/path.h",
+		"./include/gamestate.h",
+		"./include/world.h",
+		"./include/astar.h",
+		"./include/path_stats.h",
+		"./include/path_handle.h",
+		"./include/moving_target_search.h",
+		"./include/occupancy_grid.h",
+		"./include/profiler.h",
+		"./include/map.h",
+		"./include/zone_graph.h",
+		"./include/asset_cache.h",
+		"./include/path_finder.h",
+		"./include/mapped_file.h",
+		"./include/compressed_path_database.h",
+		"./include/nav_mesh.h",
+		"./include/path_store.h",
+		"./include/spatial_grid.h",
+		"./include/agent_store.h",
+		"./include/work_stealing_pool.h",
+		"./include/message.h",
+		"./include/inbox.h",
+		"./include/message_dispatcher.h",
+		"./include/timer_wheel.h",
+		"./include/ai_lod.h",
+		"./include/session_record.h",
+		"./include/session_recorder.h",
+		"./include/session_replayer.h",
+		"./src/agent.cc",
+		"./src/path.cc",
+		"./src/path_finder.cc",
+		"./src/astar.cpp",
+		"./src/path_stats.cc",
+		"./src/path_handle.cc",
+		"./src/moving_target_search.cc",
+		"./src/occupancy_grid.cc",
+		"./src/profiler.cc",
+		"./src/gamestate.cc",
+		"./src/world.cc",
+		"./src/map.cc",
+		"./src/zone_graph.cc",
+		"./src/asset_cache.cc",
+		"./src/mapped_file.cc",
+		"./src/compressed_path_database.cc",
+		"./src/nav_mesh.cc",
+		"./src/path_store.cc",
+		"./src/spatial_grid.cc",
+		"./src/agent_store.cc",
+		"./src/work_stealing_pool.cc",
+		"./src/inbox.cc",
+		"./src/message_dispatcher.cc",
+		"./src/timer_wheel.cc",
+		"./src/ai_lod.cc",
+		"./src/session_recorder.cc",
+		"./src/session_replayer.cc",
+		"./tests/main_headless.cc",
+		
+		}
@@ -5,51 +5,106 @@
 //Comments for the functions can be found at the header
 
 #include <cmath>
+#include <algorithm>
 #include "agent.h"
 #include "gamestate.h"
 #include "path_finder.h"
-
-static u32 total_agents = 1;
+#include "agent_store.h"
+#include "asset_cache.h"
+#include "profiler.h"
+#include "moving_target_search.h"
 
 Agent::Agent() : type_agent_(AgentType::k_Small)
 {
+  world_ = &GameState::instance();
   init(0, 0);
 }
 
 Agent::Agent(const AgentType agent_type, const float x, const float y, PathFinder* pf) : type_agent_(agent_type)
 {
+  world_ = &GameState::instance();
   init(x, y);
   path_finder_agent_ = pf;
 }
 
 Agent::Agent(const AgentType agent_type, const float x, const float y) : type_agent_(agent_type)
 {
+  world_ = &GameState::instance();
   init(x, y);
 }
 
+Agent::Agent(World* world, const AgentType agent_type, const float x, const float y, PathFinder* pf) : type_agent_(agent_type)
+{
+  world_ = world;
+  init(x, y);
+  path_finder_agent_ = pf;
+}
+
 Agent::~Agent()
 {
+  //The path finder may be calculating into path_
+  if(path_finder_agent_)
+  {
+    path_finder_agent_->cancelRequests(id_);
+  }
   if(path_)
   {
     delete path_;
     path_ = nullptr;
   }
+  if(chase_search_)
+  {
+    delete chase_search_;
+    chase_search_ = nullptr;
+  }
   if(representation_)
   {
-    ESAT::SpriteRelease(representation_);
+    AssetCache::instance().release(representation_);
   }
+  store_->remove(slot_);
+  world_->dispatcher_.cancel(&inbox_);
+  world_->unregisterAgent(this);
 }
 
 void Agent::init(const float x, const float y)
 {
-  position_ = Float2(x, y);
-  velocity_ = Float2(0, 0);
-  target_position_ = position_;
-  id_ = total_agents;
-  total_agents++;
+  store_ = &world_->agent_store_;
+  slot_ = store_->add(Float2(x, y));
+  id_ = world_->allocateAgentId();
   initialized_ = false;
-  representation_ = nullptr;
+  actual_state_ = FSMStates::k_Working;
   path_ = new Path();
+  //Each agent has its own random sequence so the result doesn't depend on the update order
+  random_state_ = (world_->seed_ * 0x9E3779B9u) ^ (id_ * 0x85EBCA6Bu);
+  if (random_state_ == 0) random_state_ = 1;
+  //The sprites are acquired at the thread that creates the agent, updates can run in other threads
+  representation_ = nullptr;
+  if (!world_->headless_)
+  {
+    representation_ = AssetCache::instance().acquire(spritePath(type_agent_));
+  }
+  world_->registerAgent(this);
+}
+
+const char* Agent::spritePath(const AgentType type)
+{
+  switch (type)
+  {
+  case AgentType::k_Hero: return "../../../data/gfx/agents/allied_soldier.bmp";
+  case AgentType::k_Huge: return "../../../data/gfx/agents/big_agent.png";
+  case AgentType::k_Normal: return "../../../data/gfx/agents/normal_agent.png";
+  case AgentType::k_Small: return "../../../data/gfx/agents/small_agent.png";
+  default: return nullptr;
+  }
+}
+
+float Agent::random()
+{
+  //xorshift32
+  random_state_ ^= random_state_ << 13;
+  random_state_ ^= random_state_ >> 17;
+  random_state_ ^= random_state_ << 5;
+  return (random_state_ >> 8) * (1.0f / 16777216.0f);
 }
 
 ESAT::SpriteHandle Agent::representation() const
@@ -63,19 +118,99 @@ void Agent::update(const u32 dt)
   updateBody(dt);
 }
 
+u32 Agent::wake(const u32 now, const u32 dt)
+{
+  const u32 elapsed = woken_ ? now - last_wake_ : dt;
+  last_wake_ = now;
+  woken_ = true;
+  update(elapsed);
+  return wakeDelay(dt);
+}
+
+u32 Agent::wakeDelay(const u32 dt) const
+{
+  //Messages that arrive make the mind think at the next tick
+  if (inbox_.size() > 0) return 0;
+  u32 delay = mind_time_ - mind_acum_;
+  switch (move_type_)
+  {
+  case MovementType::k_MovDeterminist:
+    delay = std::min(delay, arrivalDelay(dt));
+    break;
+  case MovementType::k_MovRandom:
+    delay = std::min(delay, accum_time_random_ < next_random_time_ ? next_random_time_ - accum_time_random_ : 1);
+    delay = std::min(delay, arrivalDelay(dt));
+    break;
+  case MovementType::k_MovTracking:
+    delay = std::min(delay, accum_time_tracking_ < tracking_retarget_time_ ? tracking_retarget_time_ - accum_time_tracking_ : 1);
+    delay = std::min(delay, arrivalDelay(dt));
+    break;
+  case MovementType::k_MovPattern:
+  {
+    //The target is kept a step ahead in a straight line, so the movement is
+    //the same until the pattern changes as long as the step isn't reached
+    const u32 seconds = pattern_targets_[pattern_idx_].seconds;
+    delay = std::min(delay, accum_time_pattern_ < seconds ? seconds - accum_time_pattern_ + 1 : 1);
+    delay = std::min(delay, arrivalDelay(dt));
+    break;
+  }
+  case MovementType::k_MovAStar:
+    if (target_reached_) delay = std::min(delay, path_->isLast() ? 1 : arrivalDelay(dt));
+    break;
+  case MovementType::k_MovStop:
+  {
+    //Once the target is its position a stopped agent only needs its mind
+    const Float2 target = store_->target(slot_);
+    if (target.x != x() || target.y != y()) delay = 1;
+    break;
+  }
+  default:
+    break;
+  }
+  return delay;
+}
+
+u32 Agent::arrivalDelay(const u32 dt) const
+{
+  if (positionReached()) return 1;
+  const float time = store_->timeToTarget(slot_);
+  if (time < 0.0f) return kNoTimer;
+  //The position is the one of the last tick and this tick is integrated after
+  //the update, the other tick of margin absorbs the rounding of the integration
+  const float delay = time - 2.0f * dt;
+  if (delay < 1.0f) return 1;
+  return static_cast<u32>(fminf(delay, 1.0e9f));
+}
+
 float Agent::x() const
 {
-  return position_.x;
+  return store_->x(slot_);
 }
 
 float Agent::y() const
 {
-  return position_.y;
+  return store_->y(slot_);
+}
+
+AgentType Agent::type() const
+{
+  return type_agent_;
+}
+
+u32 Agent::id() const
+{
+  return id_;
+}
+
+Float2 Agent::position() const
+{
+  return store_->position(slot_);
 }
 
 
 void Agent::updateBody(const u32 dt)
 {
+  PROFILE_ZONE("Agent::updateBody");
   switch (move_type_)
   {
   case MovementType::k_MovDeterminist:
@@ -98,37 +233,32 @@ void Agent::updateBody(const u32 dt)
   default:
     break;
   }
-  calculateVelocity();
-  move(dt);
 }
 
 void Agent::updateMind(const u32 dt)
 {
+  PROFILE_ZONE("Agent::updateMind");
   mind_acum_ += dt;
-  if (mind_acum_ < mind_time_) return;
+  //The first update and the messages received make the agent think right away
+  if (initialized_ && mind_acum_ < mind_time_ && inbox_.size() == 0) return;
 
+  //The states count the time since the agent thought the last time
+  const u32 mind_dt = mind_acum_;
   mind_acum_ = 0;  
   if (!initialized_)
   {
-    mail_box_ = static_cast<AgentMessage*>(malloc(total_agents * sizeof(AgentMessage)));
-    for (u32 i = 0; i < total_agents; i++)
-    {
-      (mail_box_ + i)->type = AgentMessageType::k_Nothing;
-      (mail_box_ + i)->position = Float2(0.0f, 0.0f);
-    }
     objective_ = nullptr;
     actual_state_ = FSMStates::k_Working;
     const float generic_speed = 5.0f;
     //const float generic_speed = 50.0f;
-    speed_ = generic_speed;
+    float speed = generic_speed;
     switch (type_agent_)
     {
     case AgentType::k_Hero:
       move_type_ = MovementType::k_MovStop;
-      speed_ *= 20.0f;
-      epsilon_ = kEpsilonFactor * speed_;
+      speed *= 20.0f;
+      store_->set_speed(slot_, speed, kEpsilonFactor * speed);
       //mind_time_ = 1000;
-      representation_ = ESAT::SpriteFromFile("../../../data/gfx/agents/allied_soldier.bmp");
       break;
     case AgentType::k_Huge:
       ////
@@ -143,9 +273,8 @@ void Agent::updateMind(const u32 dt)
 
       tracking_retarget_time_ = 3000; //3s
 
-      speed_ *= 4.75f;
-      epsilon_ = kEpsilonFactor * speed_;
-      representation_ = ESAT::SpriteFromFile("../../../data/gfx/agents/big_agent.png");
+      speed *= 4.75f;
+      store_->set_speed(slot_, speed, kEpsilonFactor * speed);
       break;
     case AgentType::k_Normal:
       move_type_ = MovementType::k_MovRandom;
@@ -154,9 +283,8 @@ void Agent::updateMind(const u32 dt)
 
       tracking_retarget_time_ = 1500; //1.5s
 
-      speed_ *= 5.0f;
-      epsilon_ = kEpsilonFactor * speed_;
-      representation_ = ESAT::SpriteFromFile("../../../data/gfx/agents/normal_agent.png");
+      speed *= 5.0f;
+      store_->set_speed(slot_, speed, kEpsilonFactor * speed);
       break;
     case AgentType::k_Small:
       move_type_ = MovementType::k_MovPattern;
@@ -170,9 +298,8 @@ void Agent::updateMind(const u32 dt)
 
       accum_time_pattern_ = 0;
       pattern_step_ = 50;
-      speed_ *= 5.25f;
-      epsilon_ = kEpsilonFactor * speed_;
-      representation_ = ESAT::SpriteFromFile("../../../data/gfx/agents/small_agent.png");
+      speed *= 5.25f;
+      store_->set_speed(slot_, speed, kEpsilonFactor * speed);
       break;
     default:
       break;
@@ -181,30 +308,28 @@ void Agent::updateMind(const u32 dt)
     initialized_ = true;
   }
 
-  for (u32 i = 0; i < total_agents; i++)
+  AgentMessage msg;
+  while (inbox_.pop(&msg))
   {
-    if ((mail_box_ + i)->type == AgentMessageType::k_PathIsReady)
+    if (msg.type == AgentMessageType::k_PathIsReady && msg.request == path_request_)
     {
       move_type_ = MovementType::k_MovAStar;
       target_reached_ = true;
-      (mail_box_ + i)->type = AgentMessageType::k_Nothing;
-      break;
     }
-    (mail_box_ + i)->position = Float2(0.0f, 0.0f);
   }
 
   switch (actual_state_) {
   case FSMStates::k_Working:
-    FSM_Working(dt);
+    FSM_Working(mind_dt);
     break;
   case FSMStates::k_Chasing:
-    FSM_Chasing(dt);
+    FSM_Chasing(mind_dt);
     break;
   case FSMStates::k_Fleeing:
-    FSM_Fleeing(dt);
+    FSM_Fleeing(mind_dt);
     break;
   case FSMStates::k_Resting:
-    FSM_Resting(dt);
+    FSM_Resting(mind_dt);
     break;
   default:
     break;
@@ -212,95 +337,66 @@ void Agent::updateMind(const u32 dt)
 
 }
 
-void Agent::move(const u32 dt)
-{
-  //displacement
-  const float time_in_seconds = dt * 0.001f;
-  Float2 e = velocity_ * time_in_seconds;
-  position_ += e;
-}
-
 bool Agent::positionReached() const
 {
-  Float2 aux_vector = target_position_ - position_;
-  return aux_vector.Length() < epsilon_;
+  return store_->positionReached(slot_);
 }
 
 void Agent::setNextPosition(float new_target_x, float new_target_y)
 {
-  target_position_ = Float2(new_target_x, new_target_y);
-}
-
-void Agent::setOrientation(const Float2& destination)
-{
-  velocity_ = destination - position_;
-  // 0/0 exception
-  if (velocity_.Length() == 0.0f) return;
-  velocity_ /= velocity_.Length();
-}
-
-void Agent::calculateVelocity()
-{
-  setOrientation(target_position_);
-  velocity_ *= speed_;
+  store_->set_target(slot_, Float2(new_target_x, new_target_y));
 }
 
 void Agent::FSM_Working(u32 dt) {
 #ifdef DEBUG
   accum_time_ += dt;
 #endif
-  
-
-  for (Agent* agent : GameState::instance().agents_)
-  {
-    Float2 distance = agent->position_ - this->position_;
-    const float d = distance.Length();
 #ifdef DEBUG
-    if (accum_time_ >= time_for_print_)
-    {
-      //printf("I'm at a distance of: %f \n", d);
-      accum_time_ = 0;
-    }
+  if (accum_time_ >= time_for_print_)
+  {
+    accum_time_ = 0;
+  }
 #endif
-    //We check if the agent is in chase range and we are bigger
-    if(agent != this && isBigger(agent) && d <= chase_distance_)
-    {
+
+  //We check if there's an agent in chase range we are bigger than or one in flee
+  //range we are smaller than, the one created first wins
+  Agent* prey = firstInRange(true, chase_distance_);
+  Agent* threat = firstInRange(false, flee_distance_);
+  if(prey && (!threat || prey->id_ < threat->id_))
+  {
 #ifdef DEBUG
-      printf("Changing to chase \n");
+    printf("Changing to chase \n");
 #endif
-      actual_state_ = FSMStates::k_Chasing;
-      objective_ = agent;
-      move_type_ = MovementType::k_MovTracking;
-      return;
-    }
-    //We check if the agent is in flee range and is smaller
-    if(agent != this && isSmaller(agent) && d <= flee_distance_)
-    {
+    actual_state_ = FSMStates::k_Chasing;
+    objective_ = prey;
+    move_type_ = MovementType::k_MovTracking;
+    return;
+  }
+  if(threat)
+  {
 #ifdef DEBUG
-      printf("Changing to flee \n");
+    printf("Changing to flee \n");
 #endif
-      actual_state_ = FSMStates::k_Fleeing;
-      objective_ = agent;
-      move_type_ = MovementType::k_MovTracking;
-      return;
-    }
+    actual_state_ = FSMStates::k_Fleeing;
+    objective_ = threat;
+    move_type_ = MovementType::k_MovTracking;
   }
 }
 
 void Agent::FSM_Chasing(u32 dt) {
-  Float2 distance = objective_->position_ - this->position_;
-  const float d = distance.Length();
+  Float2 distance = objective_->position() - position();
+  const float squared_d = distance.DotProduct(distance);
 
 #ifdef DEBUG
   accum_time_ += dt;
   if (accum_time_ >= time_for_print_)
   {
-    printf("I'm at a distance of: %f \n", d);
+    printf("I'm at a distance of: %f \n", sqrtf(squared_d));
     accum_time_ = 0;
   }
 #endif
 
-  if(d >= lost_focus_distance_)
+  if(squared_d >= lost_focus_distance_ * lost_focus_distance_)
   {
 #ifdef DEBUG
     printf("I'm going to take a rest \n");
@@ -308,31 +404,56 @@ void Agent::FSM_Chasing(u32 dt) {
     actual_state_ = FSMStates::k_Resting;
     move_type_ = MovementType::k_MovStop;
     objective_ = nullptr;
+    //The search is kept for the next chase without what it learned
+    if (chase_search_) chase_search_->reset();
     return;
   }
   if(target_reached_)
   {
 #ifdef DEBUG
-    printf("I'm chasing to: {%f,%f} \n", objective_->position_.x, objective_->position_.y);
+    printf("I'm chasing to: {%f,%f} \n", objective_->x(), objective_->y());
 #endif
-    target_position_ = objective_->position_;
+    //Without map or path the agent goes straight to the objective
+    const Float2* next = chasePath() ? chase_search_->path()->nextPoint() : nullptr;
+    if (next)
+    {
+      setNextPosition(next->x, next->y);
+    }
+    else
+    {
+      setNextPosition(objective_->x(), objective_->y());
+    }
     target_reached_ = false;
   }
 }
 
+bool Agent::chasePath()
+{
+  const Map& map = world_->map();
+  if (map.width() == 0) return false;
+  if (!chase_search_) chase_search_ = new MovingTargetSearch();
+  const s16 result = chase_search_->search(position(), objective_->position(), map, clearance(),
+                                           world_->chase_stats_.measure_savings);
+  world_->chase_stats_.add(chase_search_->lastReplan());
+  if (result != kErrorCode_Ok) return false;
+  //The first point is the cell of the agent
+  chase_search_->path()->nextPoint();
+  return true;
+}
+
 void Agent::FSM_Fleeing(u32 dt) {
-  Float2 distance = this->position_ - objective_->position_;
-  //Float2 distance = objective_->position_ - this->position_;
-  const float d = distance.Length();
+  Float2 distance = position() - objective_->position();
+  //Float2 distance = objective_->position() - position();
+  const float squared_d = distance.DotProduct(distance);
 #ifdef DEBUG
   accum_time_ += dt;
   if (accum_time_ >= time_for_print_)
   {
-    printf("I'm at a distance of: %f \n", d);
+    printf("I'm at a distance of: %f \n", sqrtf(squared_d));
     accum_time_ = 0;
   }
 #endif
-  if (d >= lost_focus_distance_)
+  if (squared_d >= lost_focus_distance_ * lost_focus_distance_)
   {
 #ifdef DEBUG
     printf("I'm going to take a rest \n");
@@ -344,9 +465,9 @@ void Agent::FSM_Fleeing(u32 dt) {
   }
   if (target_reached_)
   {
-    Float2 direction = distance / d;
+    Float2 direction = distance / sqrtf(squared_d);
     direction *= 100.0f;
-    Float2 final_position = position_ + direction;
+    Float2 final_position = position() + direction;
     //We normalize to our screen boundaries they are not exact because the
     //sprites of the agents are not exactly a pixel, so they get out.
     final_position.x = fmax(final_position.x, 20.0f);
@@ -354,7 +475,7 @@ void Agent::FSM_Fleeing(u32 dt) {
     final_position.x = fmin(final_position.x, 1260.0f);
     final_position.y = fmin(final_position.y, 680.0f);
 
-    target_position_ = final_position;
+    setNextPosition(final_position.x, final_position.y);
     target_reached_ = false;
 #ifdef DEBUG
     printf("I'm going to flee to: {%f,%f} \n", final_position.x, final_position.y);
@@ -388,47 +509,63 @@ void Agent::FSM_Resting(const u32 dt) {
     }
   }
 
-  for (Agent* agent : GameState::instance().agents_)
+  //We check if there's an agent in flee range we are smaller than
+  Agent* threat = firstInRange(false, flee_distance_);
+  if (threat)
   {
-    Float2 distance = agent->position_ - this->position_;
-    const float d = distance.Length();
-    //We check if the agent is in flee range and is smaller
-    if (agent != this && isSmaller(agent) && d <= flee_distance_)
-    {
-      actual_state_ = FSMStates::k_Fleeing;
-      objective_ = agent;
-      move_type_ = MovementType::k_MovTracking;
-      return;
-    }
+    actual_state_ = FSMStates::k_Fleeing;
+    objective_ = threat;
+    move_type_ = MovementType::k_MovTracking;
   }
 }
 
-bool Agent::isBigger(Agent* a)
+bool Agent::isBigger(const AgentType type) const
 {
   //If we are huge and the other agent is not huge, we are bigger
   bool bigger_if_huge = ((type_agent_ == AgentType::k_Huge) &&
-                        (a->type_agent_ != AgentType::k_Huge));
+                        (type != AgentType::k_Huge));
 
   //If we are medium and the other agent is small, we are bigger
   bool bigger_if_medium = ((type_agent_ == AgentType::k_Normal) &&
-                          (a->type_agent_ == AgentType::k_Small));
+                          (type == AgentType::k_Small));
 
   //If one of the previous conditions is true we are bigger
   return bigger_if_huge || bigger_if_medium;
 }
 
-bool Agent::isSmaller(Agent* a)
+bool Agent::isSmaller(const AgentType type) const
 {
   //If we are small and the other agent is not small, we are smaller
   bool smaller_if_small = (type_agent_ == AgentType::k_Small) &&
-                          (a->type_agent_ != AgentType::k_Small);
+                          (type != AgentType::k_Small);
 
   //If we are normal and the other agent is huge, we are smaller
   bool smaller_if_normal = (type_agent_ == AgentType::k_Normal) &&
-    (a->type_agent_ == AgentType::k_Huge);
+    (type == AgentType::k_Huge);
 
   //If one of the previous conditions is true we are bigger
   return smaller_if_small || smaller_if_normal;
+}
+
+Agent* Agent::firstInRange(const bool bigger, const float radius)
+{
+  const SpatialGrid& grid = world_->agent_grid_;
+  nearby_agents_.clear();
+  for (u8 t = 1; t <= kNumAgentTypes; t++)
+  {
+    const AgentType type = static_cast<AgentType>(t);
+    if (bigger ? isBigger(type) : isSmaller(type))
+    {
+      grid.queryRadius(type, position(), radius, &nearby_agents_);
+    }
+  }
+
+  Agent* first = nullptr;
+  for (Agent* agent : nearby_agents_)
+  {
+    if (agent != this && (!first || agent->id_ < first->id_)) first = agent;
+  }
+  return first;
 }
 
 
@@ -455,8 +592,8 @@ void Agent::MOV_Random(const u32 dt)
 
   //float rand_px = rand() % 1280;
   //float rand_py = rand() % 720;
-  float rand_px = rand() / float(RAND_MAX);
-  float rand_py = rand() / float(RAND_MAX);
+  float rand_px = random();
+  float rand_py = random();
   rand_px = rand_px * boundary_x_right + boundary_x_left;
   rand_py = rand_py * boundary_y_right + boundary_y_left;
 
@@ -469,8 +606,16 @@ void Agent::MOV_Tracking(const u32 dt)
 {
   accum_time_tracking_ += dt;
   if (accum_time_tracking_ < tracking_retarget_time_ && !positionReached()) return;
+  //A chase through the map follows its path until it's time to search again
+  if (accum_time_tracking_ < tracking_retarget_time_ && chase_search_ &&
+      chase_search_->lastReplan().result == kErrorCode_Ok && !chase_search_->path()->isLast())
+  {
+    const Float2* p = chase_search_->path()->nextPoint();
+    setNextPosition(p->x, p->y);
+    return;
+  }
   target_reached_ = true;
-  setNextPosition(target_position_.x, target_position_.y);
+  setNextPosition(store_->target(slot_).x, store_->target(slot_).y);
   accum_time_tracking_ = 0;
 }
 
@@ -485,16 +630,16 @@ void Agent::MOV_Pattern(const u32 dt)
   switch (pattern_targets_[pattern_idx_].token)
   {
   case PatternToken::k_East:
-    target_position_ = Float2(position_.x + pattern_step_, position_.y);
+    setNextPosition(x() + pattern_step_, y());
     break;
   case PatternToken::k_West:
-    target_position_ = Float2(position_.x - pattern_step_, position_.y);
+    setNextPosition(x() - pattern_step_, y());
     break;
   case PatternToken::k_North:
-    target_position_ = Float2(position_.x, position_.y - pattern_step_);
+    setNextPosition(x(), y() - pattern_step_);
     break;
   case PatternToken::k_South:
-    target_position_ = Float2(position_.x, position_.y + pattern_step_);
+    setNextPosition(x(), y() + pattern_step_);
     break;
   default:
     break;
@@ -503,7 +648,7 @@ void Agent::MOV_Pattern(const u32 dt)
 
 void Agent::MOV_Stop()
 {
-  target_position_ = position_;
+  setNextPosition(x(), y());
 }
 
 void Agent::MOV_AStar(const u32 dt) {
@@ -522,7 +667,7 @@ void Agent::MOV_AStar(const u32 dt) {
   }
 }
 
-void Agent::prepareAStarMessage(const Float2& origin, const Float2& dst)
+void Agent::prepareAStarMessage(const Float2& origin, const Float2& dst, const u32 deadline)
 {
   if(path_finder_agent_ && !path_->isReady())
   {
@@ -531,24 +676,105 @@ void Agent::prepareAStarMessage(const Float2& origin, const Float2& dst)
     msg.position = origin;
     msg.dst = dst;
     msg.path = path_;
+    msg.clearance = clearance();
+    msg.priority = pathPriority();
+    msg.deadline = deadline ? world_->game_time_ + deadline : 0;
+    msg.request = ++path_request_;
     path_finder_agent_->sendMessage(msg, id_);
+    world_->recorder_.record(SessionEventType::k_PathRequest, id_, origin, dst, deadline);
     //path_finder_agent_->generatePath(&path_, origin, dst);
   }
 }
 
+void Agent::cancelPathRequest()
+{
+  if (!path_finder_agent_) return;
+  AgentMessage msg;
+  msg.type = AgentMessageType::k_CancelPath;
+  path_finder_agent_->sendMessage(msg, id_);
+  //An answer sent before the cancellation arrives doesn't match anymore
+  path_request_++;
+  world_->recorder_.record(SessionEventType::k_CancelPath, id_, Float2(), Float2());
+}
+
+PathHandle Agent::requestPath(const Float2& origin, const Float2& dst, const u32 deadline)
+{
+  if (!path_finder_agent_) return PathHandle();
+  PathRequestOptions options;
+  options.priority = pathPriority();
+  options.deadline = deadline;
+  options.clearance = clearance();
+  options.requester = id_;
+  options.path = path_;
+  //The answer of a request sent as a message is not wanted anymore
+  path_request_++;
+  world_->recorder_.record(SessionEventType::k_PathHandle, id_, origin, dst, deadline);
+  return path_finder_agent_->requestPath(origin, dst, options);
+}
+
+PathPriority Agent::pathPriority() const
+{
+  return type_agent_ == AgentType::k_Hero ? PathPriority::k_Hero : PathPriority::k_Ambient;
+}
+
 void Agent::prepareAStar(const Float2& origin, const Float2& dst)
 {
   //if (path_->isReady()) return;
-  path_finder_agent_->generatePath(path_, origin, dst);
+  world_->recorder_.record(SessionEventType::k_PathCompute, id_, origin, dst);
+  path_finder_agent_->generatePath(path_, origin, dst, clearance());
+}
+
+u8 Agent::clearance() const
+{
+  if (clearance_) return clearance_;
+  const Float2 ratio = world_->map().ratio();
+  if (!representation_ || ratio.x <= 0.0f || ratio.y <= 0.0f) return 1;
+  const float cells_x = ceilf(ESAT::SpriteWidth(representation_) / ratio.x);
+  const float cells_y = ceilf(ESAT::SpriteHeight(representation_) / ratio.y);
+  const float cells = fmax(fmax(cells_x, cells_y), 1.0f);
+  return static_cast<u8>(fmin(cells, static_cast<float>(kMaxClearance)));
+}
+
+void Agent::set_clearance(const u8 clearance)
+{
+  clearance_ = clearance;
+}
+
+bool Agent::hasPathFinder() const
+{
+  return path_finder_agent_ != nullptr;
+}
+
+bool Agent::inCombat() const
+{
+  return actual_state_ == FSMStates::k_Chasing || actual_state_ == FSMStates::k_Fleeing;
+}
+
+AILodTier Agent::lodTier() const
+{
+  return lod_tier_;
+}
+
+bool Agent::set_lod_tier(const AILodTier tier, const u32 mind_time)
+{
+  if (tier == lod_tier_ && mind_time == mind_time_) return false;
+  lod_tier_ = tier;
+  mind_time_ = mind_time;
+  mind_acum_ = (id_ * 2654435761u) % mind_time_;
+  return true;
 }
 
 void Agent::startAStar()
 {
   target_reached_ = true;
   move_type_ = MovementType::k_MovAStar;
+  world_->recorder_.record(SessionEventType::k_StartPath, id_, Float2(), Float2());
+  world_->wakeAgent(id_);
 }
 
 void Agent::sendMessage(const AgentMessage& msg, const u32 id)
 {
-  *(mail_box_ + id) = msg;
+  AgentMessage sent = msg;
+  sent.sender = id;
+  world_->dispatcher_.post(sent, &inbox_, id_);
 }
\ No newline at end of file
@@ -0,0 +1,229 @@
+// agent_store.cc
+// Jose Maria Martinez
+// Implementation of the structure of arrays with the movement data of the agents
+//Comments for the functions can be found at the header
+
+#include "agent_store.h"
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define AGENT_STORE_SSE
+#include <emmintrin.h>
+#endif
+
+AgentStore::AgentStore()
+{
+
+}
+
+AgentStore::~AgentStore()
+{
+
+}
+
+u32 AgentStore::add(const Float2& position)
+{
+  u32 slot;
+  if (!free_slots_.empty())
+  {
+    slot = free_slots_.back();
+    free_slots_.pop_back();
+  }
+  else
+  {
+    slot = size();
+    position_x_.push_back(0.0f);
+    position_y_.push_back(0.0f);
+    next_position_x_.push_back(0.0f);
+    next_position_y_.push_back(0.0f);
+    velocity_x_.push_back(0.0f);
+    velocity_y_.push_back(0.0f);
+    target_x_.push_back(0.0f);
+    target_y_.push_back(0.0f);
+    speed_.push_back(0.0f);
+    epsilon_.push_back(0.0f);
+    reached_.push_back(0);
+    active_.push_back(0);
+  }
+  active_[slot] = 1;
+  position_x_[slot] = position.x;
+  position_y_[slot] = position.y;
+  next_position_x_[slot] = position.x;
+  next_position_y_[slot] = position.y;
+  velocity_x_[slot] = 0.0f;
+  velocity_y_[slot] = 0.0f;
+  target_x_[slot] = position.x;
+  target_y_[slot] = position.y;
+  speed_[slot] = 0.0f;
+  epsilon_[slot] = 0.0f;
+  updateReached(slot);
+  return slot;
+}
+
+void AgentStore::remove(const u32 slot)
+{
+  if (slot >= size()) return;
+  //A free slot has no speed so the integration leaves it where it is
+  speed_[slot] = 0.0f;
+  active_[slot] = 0;
+  free_slots_.push_back(slot);
+}
+
+u32 AgentStore::size() const
+{
+  return static_cast<u32>(position_x_.size());
+}
+
+Float2 AgentStore::position(const u32 slot) const
+{
+  return Float2(position_x_[slot], position_y_[slot]);
+}
+
+float AgentStore::x(const u32 slot) const
+{
+  return position_x_[slot];
+}
+
+float AgentStore::y(const u32 slot) const
+{
+  return position_y_[slot];
+}
+
+const float* AgentStore::xs() const
+{
+  return position_x_.data();
+}
+
+const float* AgentStore::ys() const
+{
+  return position_y_.data();
+}
+
+Float2 AgentStore::target(const u32 slot) const
+{
+  return Float2(target_x_[slot], target_y_[slot]);
+}
+
+Float2 AgentStore::velocity(const u32 slot) const
+{
+  return Float2(velocity_x_[slot], velocity_y_[slot]);
+}
+
+void AgentStore::set_target(const u32 slot, const Float2& target)
+{
+  target_x_[slot] = target.x;
+  target_y_[slot] = target.y;
+  updateReached(slot);
+}
+
+void AgentStore::set_speed(const u32 slot, const float speed, const float epsilon)
+{
+  speed_[slot] = speed;
+  epsilon_[slot] = epsilon;
+  updateReached(slot);
+}
+
+bool AgentStore::positionReached(const u32 slot) const
+{
+  return reached_[slot] != 0;
+}
+
+bool AgentStore::isActive(const u32 slot) const
+{
+  return active_[slot] != 0;
+}
+
+float AgentStore::timeToTarget(const u32 slot) const
+{
+  if (speed_[slot] <= 0.0f) return -1.0f;
+  const Float2 remaining = Float2(target_x_[slot] - position_x_[slot], target_y_[slot] - position_y_[slot]);
+  return fmaxf(remaining.Length() - epsilon_[slot], 0.0f) * 1000.0f / speed_[slot];
+}
+
+void AgentStore::integrate(const u32 dt)
+{
+  integrateRange(0, size(), dt);
+  swapBuffers();
+}
+
+void AgentStore::integrateRange(const u32 first, const u32 last, const u32 dt)
+{
+  const float time_in_seconds = dt * 0.001f;
+  u32 first_scalar = first;
+
+#ifdef AGENT_STORE_SSE
+  first_scalar = first + ((last - first) & ~3u);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 time = _mm_set1_ps(time_in_seconds);
+  for (u32 i = first; i < first_scalar; i += 4)
+  {
+    __m128 position_x = _mm_loadu_ps(&position_x_[i]);
+    __m128 position_y = _mm_loadu_ps(&position_y_[i]);
+    const __m128 target_x = _mm_loadu_ps(&target_x_[i]);
+    const __m128 target_y = _mm_loadu_ps(&target_y_[i]);
+    const __m128 speed = _mm_loadu_ps(&speed_[i]);
+
+    //Velocity towards the target, a zero length direction is not normalized
+    __m128 direction_x = _mm_sub_ps(target_x, position_x);
+    __m128 direction_y = _mm_sub_ps(target_y, position_y);
+    const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(direction_x, direction_x),
+                                                 _mm_mul_ps(direction_y, direction_y)));
+    const __m128 zero_length = _mm_cmpeq_ps(length, zero);
+    direction_x = _mm_or_ps(_mm_and_ps(zero_length, direction_x),
+                            _mm_andnot_ps(zero_length, _mm_div_ps(direction_x, length)));
+    direction_y = _mm_or_ps(_mm_and_ps(zero_length, direction_y),
+                            _mm_andnot_ps(zero_length, _mm_div_ps(direction_y, length)));
+    const __m128 velocity_x = _mm_mul_ps(direction_x, speed);
+    const __m128 velocity_y = _mm_mul_ps(direction_y, speed);
+    _mm_storeu_ps(&velocity_x_[i], velocity_x);
+    _mm_storeu_ps(&velocity_y_[i], velocity_y);
+
+    position_x = _mm_add_ps(position_x, _mm_mul_ps(velocity_x, time));
+    position_y = _mm_add_ps(position_y, _mm_mul_ps(velocity_y, time));
+    _mm_storeu_ps(&next_position_x_[i], position_x);
+    _mm_storeu_ps(&next_position_y_[i], position_y);
+
+    const __m128 remaining_x = _mm_sub_ps(target_x, position_x);
+    const __m128 remaining_y = _mm_sub_ps(target_y, position_y);
+    const __m128 remaining = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(remaining_x, remaining_x),
+                                                    _mm_mul_ps(remaining_y, remaining_y)));
+    const s32 reached = _mm_movemask_ps(_mm_cmplt_ps(remaining, _mm_loadu_ps(&epsilon_[i])));
+    reached_[i] = reached & 1;
+    reached_[i + 1] = (reached >> 1) & 1;
+    reached_[i + 2] = (reached >> 2) & 1;
+    reached_[i + 3] = (reached >> 3) & 1;
+  }
+#endif
+  integrateScalar(first_scalar, last, time_in_seconds);
+}
+
+void AgentStore::swapBuffers()
+{
+  position_x_.swap(next_position_x_);
+  position_y_.swap(next_position_y_);
+}
+
+void AgentStore::integrateScalar(const u32 first, const u32 last, const float time_in_seconds)
+{
+  for (u32 i = first; i < last; i++)
+  {
+    Float2 velocity = Float2(target_x_[i], target_y_[i]) - Float2(position_x_[i], position_y_[i]);
+    const float length = velocity.Length();
+    // 0/0 exception
+    if (length != 0.0f) velocity /= length;
+    velocity *= speed_[i];
+    velocity_x_[i] = velocity.x;
+    velocity_y_[i] = velocity.y;
+
+    next_position_x_[i] = position_x_[i] + velocity.x * time_in_seconds;
+    next_position_y_[i] = position_y_[i] + velocity.y * time_in_seconds;
+    const Float2 remaining = Float2(target_x_[i] - next_position_x_[i], target_y_[i] - next_position_y_[i]);
+    reached_[i] = remaining.Length() < epsilon_[i] ? 1 : 0;
+  }
+}
+
+void AgentStore::updateReached(const u32 slot)
+{
+  const Float2 remaining = Float2(target_x_[slot] - position_x_[slot], target_y_[slot] - position_y_[slot]);
+  reached_[slot] = remaining.Length() < epsilon_[slot] ? 1 : 0;
+}
@@ -0,0 +1,149 @@
+// ai_lod.cc
+// Jose Maria Martinez
+// Implementation of the level of detail that decides how often the agents think
+//Comments for the functions can be found at the header
+
+#include "ai_lod.h"
+#include "agent.h"
+#include "common_def.h"
+#include <cstdio>
+#include <cstring>
+
+AILod::AILod()
+{
+  viewport_min_ = Float2(0.0f, 0.0f);
+  viewport_max_ = Float2(0.0f, 0.0f);
+  high_radius_ = 300.0f;
+  medium_radius_ = 800.0f;
+  mind_time_[static_cast<u8>(AILodTier::k_High)] = 100;
+  mind_time_[static_cast<u8>(AILodTier::k_Medium)] = 300;
+  mind_time_[static_cast<u8>(AILodTier::k_Low)] = 1000;
+  rebalance_period_ = 1000;
+  last_rebalance_ = 0;
+  memset(&current_, 0, sizeof(current_));
+  memset(&last_, 0, sizeof(last_));
+}
+
+AILod::~AILod()
+{
+
+}
+
+void AILod::set_viewport(const Float2& min, const Float2& max)
+{
+  viewport_min_ = min;
+  viewport_max_ = max;
+}
+
+Float2 AILod::viewportMin() const
+{
+  return viewport_min_;
+}
+
+Float2 AILod::viewportMax() const
+{
+  return viewport_max_;
+}
+
+void AILod::set_radius(const float high_radius, const float medium_radius)
+{
+  high_radius_ = high_radius;
+  medium_radius_ = medium_radius;
+}
+
+s16 AILod::set_mind_time(const AILodTier tier, const u32 mind_time)
+{
+  if (static_cast<u8>(tier) >= kNumLodTiers) return kErrorCode_InvalidOrigin;
+  mind_time_[static_cast<u8>(tier)] = mind_time > 0 ? mind_time : 1;
+  return kErrorCode_Ok;
+}
+
+u32 AILod::mindTime(const AILodTier tier) const
+{
+  return mind_time_[static_cast<u8>(tier)];
+}
+
+void AILod::set_rebalance_period(const u32 period)
+{
+  rebalance_period_ = period > 0 ? period : 1;
+}
+
+bool AILod::isRebalanceDue(const u32 now) const
+{
+  return now - last_rebalance_ >= rebalance_period_;
+}
+
+void AILod::rebalance(const std::vector<Agent*>& agents, const u32 now, std::vector<Agent*>* changed)
+{
+  last_ = current_;
+  memset(&current_, 0, sizeof(current_));
+  last_rebalance_ = now;
+
+  interest_agents_.clear();
+  for (Agent* agent : agents)
+  {
+    if (agent->type() == AgentType::k_Hero || agent->inCombat()) interest_agents_.push_back(agent);
+  }
+  interest_grid_.set_cell_size(high_radius_);
+  interest_grid_.rebuild(interest_agents_);
+
+  for (Agent* agent : agents)
+  {
+    const AILodTier tier = classify(agent);
+    current_.agents[static_cast<u8>(tier)]++;
+    if (agent->set_lod_tier(tier, mind_time_[static_cast<u8>(tier)])) changed->push_back(agent);
+  }
+}
+
+AILodTier AILod::classify(Agent* agent)
+{
+  if (agent->type() == AgentType::k_Hero) return AILodTier::k_High;
+  const Float2 position = Float2(agent->x(), agent->y());
+  if (isNear(position, AgentType::k_Hero, high_radius_)) return AILodTier::k_High;
+
+  //Fights matter more when the player can see them
+  bool fighting = agent->inCombat();
+  for (u8 t = 1; t < kNumAgentTypes && !fighting; t++)
+  {
+    fighting = isNear(position, static_cast<AgentType>(t), high_radius_);
+  }
+  const bool visible = isVisible(agent);
+  if (fighting && visible) return AILodTier::k_High;
+  if (fighting || visible) return AILodTier::k_Medium;
+  if (isNear(position, AgentType::k_Hero, medium_radius_)) return AILodTier::k_Medium;
+  return AILodTier::k_Low;
+}
+
+bool AILod::isNear(const Float2& position, const AgentType type, const float radius)
+{
+  nearby_agents_.clear();
+  interest_grid_.queryRadius(type, position, radius, &nearby_agents_);
+  return !nearby_agents_.empty();
+}
+
+bool AILod::isVisible(const Agent* agent) const
+{
+  if (viewport_max_.x <= viewport_min_.x || viewport_max_.y <= viewport_min_.y) return false;
+  return agent->x() >= viewport_min_.x && agent->x() <= viewport_max_.x &&
+         agent->y() >= viewport_min_.y && agent->y() <= viewport_max_.y;
+}
+
+void AILod::record(const AILodTier tier, const double ms)
+{
+  current_.wakes[static_cast<u8>(tier)]++;
+  current_.ms[static_cast<u8>(tier)] += ms;
+}
+
+const AILodStats& AILod::stats() const
+{
+  return last_;
+}
+
+void AILod::printStats() const
+{
+  static const char* const names[kNumLodTiers] = { "high", "medium", "low" };
+  for (u8 t = 0; t < kNumLodTiers; t++)
+  {
+    printf("AI LOD %-6s %6u agents %8u wakes %8.3f ms\n", names[t], last_.agents[t], last_.wakes[t], last_.ms[t]);
+  }
+}
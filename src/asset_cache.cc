@@ -0,0 +1,199 @@
+// asset_cache.cc
+// Jose Maria Martinez
+// Implementation of the cache of the sprites loaded from files
+//Comments for the functions can be found at the header
+
+#include "asset_cache.h"
+#include "STB/stb_image.h"
+#include "common_def.h"
+#include <ESAT/time.h>
+#include <algorithm>
+#include <cstdio>
+
+AssetCache& AssetCache::instance()
+{
+  static AssetCache cache;
+  return cache;
+}
+
+AssetCache::AssetCache()
+{
+  backend_.create = ESAT::SpriteFromMemory;
+  backend_.release = ESAT::SpriteRelease;
+  quit_ = false;
+}
+
+AssetCache::~AssetCache()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  queued_.notify_all();
+  if (loader_.joinable()) loader_.join();
+  for (auto& entry : entries_)
+  {
+    if (entry.second.pixels) stbi_image_free(entry.second.pixels);
+  }
+}
+
+void AssetCache::set_backend(const SpriteBackend& backend)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  backend_ = backend;
+}
+
+void AssetCache::preload(const char* path)
+{
+  if (!path) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (entries_.find(path) != entries_.end()) return;
+  entries_[path].decoding = true;
+  queue_.push_back(path);
+  if (!loader_.joinable()) loader_ = std::thread(&AssetCache::loaderLoop, this);
+  queued_.notify_one();
+}
+
+ESAT::SpriteHandle AssetCache::acquire(const char* path)
+{
+  if (!path) return nullptr;
+  const std::string key = path;
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  auto entry = entries_.find(key);
+  if (entry == entries_.end())
+  {
+    entries_[key].decoding = true;
+    lock.unlock();
+    decode(key);
+    lock.lock();
+  }
+  else if (entry->second.decoding)
+  {
+    //Still waiting for the loader thread, it's decoded here instead
+    auto queued = std::find(queue_.begin(), queue_.end(), key);
+    if (queued != queue_.end())
+    {
+      queue_.erase(queued);
+      lock.unlock();
+      decode(key);
+      lock.lock();
+    }
+  }
+  decoded_.wait(lock, [this, &key]() {
+    auto waited = entries_.find(key);
+    return waited == entries_.end() || !waited->second.decoding;
+  });
+
+  entry = entries_.find(key);
+  if (entry == entries_.end()) return nullptr;
+  AssetEntry& asset = entry->second;
+  const u64 bytes = static_cast<u64>(asset.width) * asset.height * 4;
+  if (asset.sprite)
+  {
+    asset.references++;
+    stats_.hits++;
+    stats_.bytes_saved += bytes;
+    return asset.sprite;
+  }
+
+  if (asset.pixels)
+  {
+    asset.sprite = backend_.create(asset.width, asset.height, asset.pixels);
+    stbi_image_free(asset.pixels);
+    asset.pixels = nullptr;
+  }
+  if (!asset.sprite)
+  {
+    entries_.erase(entry);
+    return nullptr;
+  }
+  asset.references = 1;
+  paths_[asset.sprite] = key;
+  stats_.resident_bytes += bytes;
+  stats_.resident_assets++;
+  return asset.sprite;
+}
+
+void AssetCache::release(ESAT::SpriteHandle sprite)
+{
+  if (!sprite) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto path = paths_.find(sprite);
+  if (path == paths_.end()) return;
+  auto entry = entries_.find(path->second);
+  AssetEntry& asset = entry->second;
+  if (--asset.references > 0) return;
+
+  backend_.release(sprite);
+  stats_.resident_bytes -= static_cast<u64>(asset.width) * asset.height * 4;
+  stats_.resident_assets--;
+  entries_.erase(entry);
+  paths_.erase(path);
+}
+
+bool AssetCache::size(ESAT::SpriteHandle sprite, s32* width, s32* height) const
+{
+  if (!sprite || !width || !height) return false;
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto path = paths_.find(sprite);
+  if (path == paths_.end()) return false;
+  const AssetEntry& asset = entries_.at(path->second);
+  *width = asset.width;
+  *height = asset.height;
+  return true;
+}
+
+AssetCacheStats AssetCache::stats() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void AssetCache::printStats() const
+{
+  const AssetCacheStats current = stats();
+  printf("Assets %u decoded in %.1f ms, %u shared saving %.1f KB, %u resident using %.1f KB\n",
+         current.decodes, current.decode_ms, current.hits, current.bytes_saved / 1024.0,
+         current.resident_assets, current.resident_bytes / 1024.0);
+}
+
+void AssetCache::decode(const std::string& path)
+{
+  s32 width = 0;
+  s32 height = 0;
+  s32 bpp;
+  unsigned char* pixels;
+  double elapsed;
+  {
+    std::lock_guard<std::mutex> decode_lock(decode_mutex_);
+    const double start = ESAT::Time();
+    pixels = stbi_load(path.c_str(), &width, &height, &bpp, 4);
+    elapsed = ESAT::Time() - start;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  AssetEntry& entry = entries_[path];
+  entry.pixels = pixels;
+  entry.width = width;
+  entry.height = height;
+  entry.decoding = false;
+  stats_.decodes++;
+  stats_.decode_ms += elapsed;
+  decoded_.notify_all();
+}
+
+void AssetCache::loaderLoop()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true)
+  {
+    queued_.wait(lock, [this]() { return quit_ || !queue_.empty(); });
+    if (quit_) return;
+    const std::string path = queue_.front();
+    queue_.pop_front();
+    lock.unlock();
+    decode(path);
+    lock.lock();
+  }
+}
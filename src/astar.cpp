@@ -6,14 +6,30 @@
 #include "astar.h"
 #include "path.h"
 #include "map.h"
+#include "profiler.h"
+#include "occupancy_grid.h"
 #include <stack>
 #include <algorithm>
+#include <thread>
+#include <functional>
+#include <new>
 #include <ESAT/time.h>
 
 static const AgentDirection g_directions[8] = { AgentDirection::k_Northwest, AgentDirection::k_North, AgentDirection::k_Northeast,
                                               AgentDirection::k_West, AgentDirection::k_East,
                                               AgentDirection::k_Southwest, AgentDirection::k_South, AgentDirection::k_Southeast };
 
+//Offsets and extra step cost of each direction, in the same order as g_directions
+static const s32 g_offset_x[8] = { -1, 0, 1, -1, 1, -1, 0, 1 };
+static const s32 g_offset_y[8] = { -1, -1, -1, 0, 0, 1, 1, 1 };
+static const u32 g_extra_step_cost[8] = { 5, 0, 5, 0, 0, 5, 0, 5 };
+
+static const u32 kInfiniteCost = UINT32_MAX;
+//Messages of each ring of the hash distributed search
+static const u32 kMessageQueueSize = 1 << 13;
+//The hash distributed search hashes blocks of 8x8 cells
+static const s32 kHashBlockShift = 3;
+
 AStarNode::AStarNode(Float2 pos, AStarNode* p, s32 step)
 {
   position = pos;
@@ -43,20 +59,160 @@ bool AStarNode::hasSameState(const AStarNode& node)
     position.y == node.position.y);
 }
 
+bool AStarOpenEntry::operator<(const AStarOpenEntry& other) const
+{
+  if (f != other.f) return f > other.f;
+  return g < other.g;
+}
+
+AStarFrontier::AStarFrontier()
+{
+  min_key = 0;
+}
+
+AStarFrontier::~AStarFrontier()
+{
+  release();
+}
+
+bool AStarFrontier::reset(const s32 cells)
+{
+  if (cells > capacity)
+  {
+    release();
+    g = new (std::nothrow) std::atomic<u32>[cells];
+    parent = new (std::nothrow) s32[cells];
+    closed = new (std::nothrow) u8[cells];
+    if (!g || !parent || !closed)
+    {
+      release();
+      return false;
+    }
+    capacity = cells;
+  }
+  for (s32 i = 0; i < cells; i++)
+  {
+    g[i].store(kInfiniteCost, std::memory_order_relaxed);
+  }
+  std::fill(parent, parent + cells, -1);
+  std::fill(closed, closed + cells, static_cast<u8>(0));
+  open = std::priority_queue<AStarOpenEntry>();
+  min_key = 0;
+  return true;
+}
+
+void AStarFrontier::release()
+{
+  delete[] g;
+  delete[] parent;
+  delete[] closed;
+  g = nullptr;
+  parent = nullptr;
+  closed = nullptr;
+  capacity = 0;
+  open = std::priority_queue<AStarOpenEntry>();
+}
+
+AStarMessageQueue::AStarMessageQueue()
+{
+  head = 0;
+  tail = 0;
+}
+
+AStarMessageQueue::~AStarMessageQueue()
+{
+  delete[] buffer;
+}
+
+bool AStarMessageQueue::reset(const u32 size)
+{
+  if (capacity != size)
+  {
+    delete[] buffer;
+    buffer = new (std::nothrow) AStarMessage[size];
+    capacity = buffer ? size : 0;
+  }
+  head = 0;
+  tail = 0;
+  return buffer != nullptr;
+}
+
+bool AStarMessageQueue::push(const AStarMessage& message)
+{
+  const u32 current_tail = tail.load(std::memory_order_relaxed);
+  if (current_tail - head.load(std::memory_order_acquire) == capacity) return false;
+  buffer[current_tail & (capacity - 1)] = message;
+  tail.store(current_tail + 1, std::memory_order_release);
+  return true;
+}
+
+bool AStarMessageQueue::pop(AStarMessage* message)
+{
+  const u32 current_head = head.load(std::memory_order_relaxed);
+  if (current_head == tail.load(std::memory_order_acquire)) return false;
+  *message = buffer[current_head & (capacity - 1)];
+  head.store(current_head + 1, std::memory_order_release);
+  return true;
+}
+
 AStar::AStar()
 {
   base_step_cost_ = 10;
+  clearance_ = 1;
+  logging_ = false;
+  query_start_ = 0.0;
   actual_state_ = AStarStatus::k_Finished;
+  occupancy_ = nullptr;
+  dynamic_obstacles_ = DynamicObstacles::k_Ignore;
+  dynamic_extra_cost_ = 20;
+  zone_corridor_ = nullptr;
+  mode_ = AStarMode::k_Classic;
+  threaded_ = false;
+  best_cost_ = kInfiniteCost;
+  meeting_cell_ = -1;
+  frontiers_done_ = true;
+  search_level_ = 0;
+  corridor_radius_ = 1;
+  corridor_active_ = false;
+  origin_cell_ = -1;
+  dst_cell_ = -1;
+  num_threads_ = 0;
+  hda_threads_ = 0;
+  queues_ = nullptr;
+  num_queues_ = 0;
+  busy_ = 0;
+  hda_done_ = true;
+  hda_timeout_ = false;
 }
 
 AStar::~AStar()
 {
   clean();
+  delete[] queues_;
+}
+
+s16 AStar::generatePath(Float2 origin, Float2 dst, Path* path, const Map& collisionData)
+{
+  PROFILE_ZONE("AStar::generatePath");
+  beginQuery();
+  const s16 result = searchPath(origin, dst, path, collisionData);
+  endQuery(result);
+  return result;
+}
+
+s16 AStar::generatePath(Float2 origin, Float2 dst, Path* path, const Map& collisionData, double timeout)
+{
+  PROFILE_ZONE("AStar::generatePath");
+  //A path that timed out continues the same query
+  if (actual_state_ == AStarStatus::k_Finished) beginQuery();
+  const s16 result = searchPath(origin, dst, path, collisionData, timeout);
+  if (result != kErrorCode_Timeout) endQuery(result);
+  return result;
 }
 
-s16 AStar::generatePath(Float2 origin, Float2 dst,Path* path, const Map& collisionData)
+s16 AStar::searchPath(Float2 origin, Float2 dst,Path* path, const Map& collisionData)
 {
-  printf("Calculating path... wait please \n");
+  if (logging_) printf("Calculating path... wait please \n");
   Float2 origin_ratio = origin / collisionData.ratio();
   Float2 dst_ratio = dst / collisionData.ratio();
 
@@ -69,18 +225,37 @@ s16 AStar::generatePath(Float2 origin, Float2 dst,Path* path, const Map& collisi
 
   if (!path) return kErrorCode_InvalidPointer;
   //Check that the origin and destination are valid in our map coordinates
-  if (collisionData.isOccupied(origin_ratio.x, origin_ratio.y))
+  if (collisionData.isBlocked(static_cast<s32>(origin_ratio.x), static_cast<s32>(origin_ratio.y), clearance_))
   {
-    printf("Trying to reach an invalid position \n");
+    if (logging_) printf("Trying to reach an invalid position \n");
     return kErrorCode_PathNotFound;
   }
-  if (collisionData.isOccupied(dst_ratio.x, dst_ratio.y))
+  if (collisionData.isBlocked(static_cast<s32>(dst_ratio.x), static_cast<s32>(dst_ratio.y), clearance_))
   {
-    printf("Trying to reach an invalid position \n");
+    if (logging_) printf("Trying to reach an invalid position \n");
     return kErrorCode_PathNotFound;
   }
   //path->clear();
 
+  if (mode_ == AStarMode::k_CoarseToFine)
+  {
+    const s16 status = startCoarseToFine(origin_ratio, dst_ratio, collisionData);
+    if (status != kErrorCode_Ok) return status;
+    return stepCoarseToFine(path, collisionData, -1.0);
+  }
+  if (mode_ == AStarMode::k_HashDistributed)
+  {
+    const s16 status = startHashDistributed(origin_ratio, dst_ratio, collisionData);
+    if (status != kErrorCode_Ok) return status;
+    return stepHashDistributed(path, collisionData, -1.0);
+  }
+  if (mode_ != AStarMode::k_Classic)
+  {
+    const s16 status = startBidirectional(origin_ratio, dst_ratio, collisionData);
+    if (status != kErrorCode_Ok) return status;
+    return stepBidirectional(path, collisionData, -1.0);
+  }
+
   //Create a node containing the goal state: node_goal
   AStarNode* node_goal = new AStarNode(dst_ratio, nullptr, base_step_cost_);
 
@@ -113,6 +288,7 @@ s16 AStar::generatePath(Float2 origin, Float2 dst,Path* path, const Map& collisi
 
     //If node_current is the same state as node_goal: break from the while loop
     if (node_current->hasSameState(*node_goal)) break;
+    forward_.counters.expanded++;
 
     //Generate each state node_successor that can come after node_current
     for (AgentDirection d : g_directions)
@@ -151,7 +327,7 @@ s16 AStar::generatePath(Float2 origin, Float2 dst,Path* path, const Map& collisi
         step_cost += 5;
         break;
       default:
-        printf("Problem at A*!!!!!! \n");
+        if (logging_) printf("Problem at A*!!!!!! \n");
         delete node_goal;
         //We don't need to delete node_start as right now it is already on the lists
         //that will be cleaned at clean()
@@ -161,7 +337,9 @@ s16 AStar::generatePath(Float2 origin, Float2 dst,Path* path, const Map& collisi
         return kErrorCode_PathNotCreated;
       }
       //If the position obtained is not occupied (in case is invalid counts as if it's occupied)
-      if(!collisionData.isOccupied(new_position.x, new_position.y))
+      if(!collisionData.isBlocked(static_cast<s32>(new_position.x), static_cast<s32>(new_position.y), clearance_) &&
+         isInZoneCorridor(collisionData, new_position) &&
+         applyDynamicObstacles(new_position, node_goal->position, &step_cost))
       {
         //TODO check if it's worth to only creating it after checking if it's in the open list or the closed list
         AStarNode* node_successor = new AStarNode(Float2(new_position.x, new_position.y), node_current, step_cost);
@@ -174,6 +352,7 @@ s16 AStar::generatePath(Float2 origin, Float2 dst,Path* path, const Map& collisi
           if(open_list_[idx_ol]->g <= node_successor->g)
           {
             finished_loop = true;
+            forward_.counters.duplicates++;
             delete node_successor;
             //continue;
           }
@@ -185,6 +364,7 @@ s16 AStar::generatePath(Float2 origin, Float2 dst,Path* path, const Map& collisi
           if (closed_list_[idx_cl]->g <= node_successor->g)
           {
             finished_loop = true;
+            forward_.counters.duplicates++;
             delete node_successor;
             //continue;
           }
@@ -203,6 +383,7 @@ s16 AStar::generatePath(Float2 origin, Float2 dst,Path* path, const Map& collisi
             AStarNode* aux = closed_list_[idx_cl];
             closed_list_.erase(closed_list_.begin() + idx_cl);
             delete aux;
+            forward_.counters.reopened++;
           }
           //Set the parent of node_successor to node_current
           node_successor->parent = node_current;
@@ -211,6 +392,8 @@ s16 AStar::generatePath(Float2 origin, Float2 dst,Path* path, const Map& collisi
           node_successor->f = node_successor->g + node_successor->h;
           //Add node_successor to the OPEN list
           open_list_.push_back(node_successor);
+          forward_.counters.generated++;
+          forward_.counters.peak_open = std::max<u64>(forward_.counters.peak_open, open_list_.size());
         }
       }
     }
@@ -224,7 +407,8 @@ s16 AStar::generatePath(Float2 origin, Float2 dst,Path* path, const Map& collisi
     //that will be cleaned at clean()
     //delete node_start;
     delete node_goal;
-    clean(); printf("Path not found.\n");
+    clean();
+    if (logging_) printf("Path not found.\n");
     return kErrorCode_PathNotFound;
   }
 
@@ -256,17 +440,17 @@ s16 AStar::generatePath(Float2 origin, Float2 dst,Path* path, const Map& collisi
   //delete node_start;
   delete node_goal;
   clean(); 
-  printf(" Path found, please press F2 to start.\n");
+  if (logging_) printf(" Path found, please press F2 to start.\n");
   return kErrorCode_Ok;
 }
 
-s16 AStar::generatePath(Float2 origin, Float2 dst, Path* path, const Map& collisionData, double timeout)
+s16 AStar::searchPath(Float2 origin, Float2 dst, Path* path, const Map& collisionData, double timeout)
 {
   const double start_time = ESAT::Time();
   double elapsed_time = 0;
   if(actual_state_ == AStarStatus::k_Finished)
   {
-    printf("Calculating path... wait please \n");
+    if (logging_) printf("Calculating path... wait please \n");
     Float2 origin_ratio = origin / collisionData.ratio();
     Float2 dst_ratio = dst / collisionData.ratio();
 
@@ -278,39 +462,68 @@ s16 AStar::generatePath(Float2 origin, Float2 dst, Path* path, const Map& collis
 
     if (!path) return kErrorCode_InvalidPointer;
     //Check that the origin and destination are valid in our map coordinates
-    if (collisionData.isOccupied(origin_ratio.x, origin_ratio.y))
+    if (collisionData.isBlocked(static_cast<s32>(origin_ratio.x), static_cast<s32>(origin_ratio.y), clearance_))
     {
-      printf("Trying to reach an invalid position \n");
+      if (logging_) printf("Trying to reach an invalid position \n");
       return kErrorCode_PathNotFound;
     }
-    if (collisionData.isOccupied(dst_ratio.x, dst_ratio.y))
+    if (collisionData.isBlocked(static_cast<s32>(dst_ratio.x), static_cast<s32>(dst_ratio.y), clearance_))
     {
-      printf("Trying to reach an invalid position \n");
+      if (logging_) printf("Trying to reach an invalid position \n");
       return kErrorCode_PathNotFound;
     }
     //path->clear();
 
-    //Create a node containing the goal state: node_goal
-    node_goal = new AStarNode(dst_ratio, nullptr, base_step_cost_);
+    if (mode_ == AStarMode::k_CoarseToFine)
+    {
+      const s16 status = startCoarseToFine(origin_ratio, dst_ratio, collisionData);
+      if (status != kErrorCode_Ok) return status;
+    }
+    else if (mode_ == AStarMode::k_HashDistributed)
+    {
+      const s16 status = startHashDistributed(origin_ratio, dst_ratio, collisionData);
+      if (status != kErrorCode_Ok) return status;
+    }
+    else if (mode_ != AStarMode::k_Classic)
+    {
+      const s16 status = startBidirectional(origin_ratio, dst_ratio, collisionData);
+      if (status != kErrorCode_Ok) return status;
+    }
+    else
+    {
+      //Create a node containing the goal state: node_goal
+      node_goal = new AStarNode(dst_ratio, nullptr, base_step_cost_);
 
-    if (node_goal == nullptr) return kErrorCode_Memory;
+      if (node_goal == nullptr) return kErrorCode_Memory;
 
-    //Create a node containing the start state: node_start
-    node_start = new AStarNode(origin_ratio, nullptr, base_step_cost_);
+      //Create a node containing the start state: node_start
+      node_start = new AStarNode(origin_ratio, nullptr, base_step_cost_);
 
-    if (node_start == nullptr)
-    {
-      delete node_goal;
-      return kErrorCode_Memory;
-    }
+      if (node_start == nullptr)
+      {
+        delete node_goal;
+        node_goal = nullptr;
+        return kErrorCode_Memory;
+      }
 
-    open_list_.clear();
+      open_list_.clear();
 
-    //Put node_start on the OPEN list
-    open_list_.push_back(node_start);
+      //Put node_start on the OPEN list
+      open_list_.push_back(node_start);
+      node_current = nullptr;
+    }
 
     actual_state_ = AStarStatus::k_Calculating;
-    node_current = nullptr;
+  }
+
+  if (mode_ != AStarMode::k_Classic)
+  {
+    s16 status;
+    if (mode_ == AStarMode::k_CoarseToFine) status = stepCoarseToFine(path, collisionData, timeout);
+    else if (mode_ == AStarMode::k_HashDistributed) status = stepHashDistributed(path, collisionData, timeout);
+    else status = stepBidirectional(path, collisionData, timeout);
+    if (status != kErrorCode_Timeout) actual_state_ = AStarStatus::k_Finished;
+    return status;
   }
 
   //while the OPEN list is not empty
@@ -324,6 +537,7 @@ s16 AStar::generatePath(Float2 origin, Float2 dst, Path* path, const Map& collis
 
     //If node_current is the same state as node_goal: break from the while loop
     if (node_current->hasSameState(*node_goal)) break;
+    forward_.counters.expanded++;
 
     //Generate each state node_successor that can come after node_current
     for (AgentDirection d : g_directions)
@@ -362,8 +576,9 @@ s16 AStar::generatePath(Float2 origin, Float2 dst, Path* path, const Map& collis
         step_cost += 5;
         break;
       default:
-        printf("Problem at A*!!!!!! \n");
+        if (logging_) printf("Problem at A*!!!!!! \n");
         delete node_goal;
+        node_goal = nullptr;
         //We don't need to delete node_start as right now it is already on the lists
         //that will be cleaned at clean()
         //delete node_start;
@@ -372,7 +587,9 @@ s16 AStar::generatePath(Float2 origin, Float2 dst, Path* path, const Map& collis
         return kErrorCode_PathNotCreated;
       }
       //If the position obtained is not occupied (in case is invalid counts as if it's occupied)
-      if (!collisionData.isOccupied(new_position.x, new_position.y))
+      if (!collisionData.isBlocked(static_cast<s32>(new_position.x), static_cast<s32>(new_position.y), clearance_) &&
+          isInZoneCorridor(collisionData, new_position) &&
+          applyDynamicObstacles(new_position, node_goal->position, &step_cost))
       {
         //TODO check if it's worth to only creating it after checking if it's in the open list or the closed list
         AStarNode* node_successor = new AStarNode(Float2(new_position.x, new_position.y), node_current, step_cost);
@@ -385,6 +602,7 @@ s16 AStar::generatePath(Float2 origin, Float2 dst, Path* path, const Map& collis
           if (open_list_[idx_ol]->g <= node_successor->g)
           {
             finished_loop = true;
+            forward_.counters.duplicates++;
             delete node_successor;
             //continue;
           }
@@ -396,6 +614,7 @@ s16 AStar::generatePath(Float2 origin, Float2 dst, Path* path, const Map& collis
           if (closed_list_[idx_cl]->g <= node_successor->g)
           {
             finished_loop = true;
+            forward_.counters.duplicates++;
             delete node_successor;
             //continue;
           }
@@ -414,6 +633,7 @@ s16 AStar::generatePath(Float2 origin, Float2 dst, Path* path, const Map& collis
             AStarNode* aux = closed_list_[idx_cl];
             closed_list_.erase(closed_list_.begin() + idx_cl);
             delete aux;
+            forward_.counters.reopened++;
           }
           //Set the parent of node_successor to node_current
           node_successor->parent = node_current;
@@ -422,6 +642,8 @@ s16 AStar::generatePath(Float2 origin, Float2 dst, Path* path, const Map& collis
           node_successor->f = node_successor->g + node_successor->h;
           //Add node_successor to the OPEN list
           open_list_.push_back(node_successor);
+          forward_.counters.generated++;
+          forward_.counters.peak_open = std::max<u64>(forward_.counters.peak_open, open_list_.size());
         }
       }
     }
@@ -440,8 +662,9 @@ s16 AStar::generatePath(Float2 origin, Float2 dst, Path* path, const Map& collis
     //that will be cleaned at clean()
     //delete node_start;
     delete node_goal;
+    node_goal = nullptr;
     clean(); 
-    printf("Path not found.\n");
+    if (logging_) printf("Path not found.\n");
     actual_state_ = AStarStatus::k_Finished;
     return kErrorCode_PathNotFound;
   }
@@ -468,16 +691,809 @@ s16 AStar::generatePath(Float2 origin, Float2 dst, Path* path, const Map& collis
   }
   path->set_direction(Direction::kDirForward);
   path->setToReady();
-  printf(" Path found, proceeding to execute it.\n");
+  if (logging_) printf(" Path found, proceeding to execute it.\n");
   //We don't need to delete node_start as right now it is already on the lists
   //that will be cleaned at clean()
   //delete node_start;
   delete node_goal;
+  node_goal = nullptr;
+  clean();
+  actual_state_ = AStarStatus::k_Finished;
+  return kErrorCode_Ok;
+}
+
+s16 AStar::set_mode(AStarMode mode)
+{
+  if (actual_state_ == AStarStatus::k_Calculating) return kErrorCode_Timeout;
+  mode_ = mode;
+  return kErrorCode_Ok;
+}
+
+AStarMode AStar::mode() const
+{
+  return mode_;
+}
+
+void AStar::set_threaded(bool threaded)
+{
+  threaded_ = threaded;
+}
+
+s16 AStar::startBidirectional(const Float2& origin, const Float2& dst, const Map& collisionData)
+{
+  const s32 width = collisionData.width();
+  const s32 cells = width * collisionData.height();
+  if (!forward_.reset(cells) || !backward_.reset(cells)) return kErrorCode_Memory;
+
+  const s32 origin_cell = static_cast<s32>(origin.x) + static_cast<s32>(origin.y) * width;
+  const s32 dst_cell = static_cast<s32>(dst.x) + static_cast<s32>(dst.y) * width;
+  const bool dijkstra = mode_ == AStarMode::k_BidirectionalDijkstra;
+
+  forward_.root = origin_cell;
+  forward_.target = dst_cell;
+  forward_.g[origin_cell] = 0;
+  forward_.open.push(AStarOpenEntry{ dijkstra ? 0 : octileHeuristic(origin_cell, dst_cell, width), 0, origin_cell });
+
+  backward_.root = dst_cell;
+  backward_.target = origin_cell;
+  backward_.g[dst_cell] = 0;
+  backward_.open.push(AStarOpenEntry{ dijkstra ? 0 : octileHeuristic(dst_cell, origin_cell, width), 0, dst_cell });
+
+  best_cost_ = (origin_cell == dst_cell) ? 0 : kInfiniteCost;
+  meeting_cell_ = origin_cell;
+  frontiers_done_ = false;
+  return kErrorCode_Ok;
+}
+
+s16 AStar::stepBidirectional(Path* path, const Map& collisionData, double timeout)
+{
+  const double start_time = ESAT::Time();
+  if (threaded_)
+  {
+    std::thread backward_thread(&AStar::runFrontier, this, std::ref(backward_), std::cref(forward_),
+                                std::cref(collisionData), start_time, timeout);
+    runFrontier(forward_, backward_, collisionData, start_time, timeout);
+    backward_thread.join();
+  }
+  else
+  {
+    u32 expansions = 0;
+    while (!frontiers_done_)
+    {
+      //We expand the frontier with less open nodes, that keeps both of them balanced
+      const bool forward_turn = forward_.open.size() <= backward_.open.size();
+      AStarFrontier& frontier = forward_turn ? forward_ : backward_;
+      const AStarFrontier& other = forward_turn ? backward_ : forward_;
+      if (!expandFrontier(frontier, other, collisionData))
+      {
+        frontiers_done_ = true;
+      }
+      else if (timeout >= 0.0 && (++expansions & 63) == 0 && ESAT::Time() - start_time > timeout)
+      {
+        return kErrorCode_Timeout;
+      }
+    }
+  }
+  if (!frontiers_done_) return kErrorCode_Timeout;
+
+  if (best_cost_ == kInfiniteCost)
+  {
+    if (logging_) printf("Path not found.\n");
+    return kErrorCode_PathNotFound;
+  }
+  return buildBidirectionalPath(path, collisionData);
+}
+
+void AStar::runFrontier(AStarFrontier& frontier, const AStarFrontier& other,
+                        const Map& collisionData, double start_time, double timeout)
+{
+  u32 expansions = 0;
+  while (!frontiers_done_)
+  {
+    if (!expandFrontier(frontier, other, collisionData))
+    {
+      //Once a frontier can't improve the meeting point neither can the other one
+      frontiers_done_ = true;
+      return;
+    }
+    if (timeout >= 0.0 && (++expansions & 63) == 0 && ESAT::Time() - start_time > timeout) return;
+  }
+}
+
+bool AStar::expandFrontier(AStarFrontier& frontier, const AStarFrontier& other, const Map& collisionData)
+{
+  const s32 width = collisionData.width();
+  const bool dijkstra = mode_ == AStarMode::k_BidirectionalDijkstra;
+
+  //Entries of cells that were improved after being pushed are discarded
+  while (!frontier.open.empty())
+  {
+    const AStarOpenEntry& top = frontier.open.top();
+    if (!frontier.closed[top.cell] &&
+        top.g == frontier.g[top.cell].load(std::memory_order_relaxed)) break;
+    frontier.open.pop();
+  }
+  //If a frontier runs out of nodes every path has already met the other frontier
+  if (frontier.open.empty()) return false;
+
+  const AStarOpenEntry current = frontier.open.top();
+  const u32 key = dijkstra ? current.g : current.f;
+  frontier.min_key = key;
+
+  /*The key of the best open node is a lower bound of any path that goes through this
+  frontier. Once it reaches the best meeting point found no better path can exist.
+  Without heuristic the keys of both frontiers can be added as a tighter bound*/
+  const u32 best_cost = best_cost_;
+  if (key >= best_cost) return false;
+  if (dijkstra && static_cast<u64>(key) + other.min_key >= best_cost) return false;
+
+  frontier.open.pop();
+  frontier.closed[current.cell] = 1;
+  frontier.counters.expanded++;
+
+  //The steps of the backward frontier go from the successor into the current cell
+  const bool backward = &frontier == &backward_;
+  u32 entry_cost = 0;
+  if (backward && !applyDynamicObstacles(current.cell, forward_.target, width, &entry_cost)) return true;
+
+  for (s32 i = 0; i < 8; i++)
+  {
+    s32 new_x, new_y;
+    u32 step_cost = neighbour(current.cell, i, width, &new_x, &new_y);
+    if (collisionData.isBlocked(new_x, new_y, clearance_) || !isInZoneCorridor(collisionData, new_x, new_y)) continue;
+
+    const s32 successor = new_x + new_y * width;
+    if (backward) step_cost += entry_cost;
+    else if (!applyDynamicObstacles(successor, forward_.target, width, &step_cost)) continue;
+    //The cells already reached with an equal or better cost are duplicates
+    const u32 g = current.g + step_cost;
+    if (frontier.closed[successor] || g >= frontier.g[successor].load(std::memory_order_relaxed))
+    {
+      frontier.counters.duplicates++;
+      continue;
+    }
+
+    frontier.g[successor] = g;
+    frontier.parent[successor] = current.cell;
+    const u32 h = dijkstra ? 0 : octileHeuristic(successor, frontier.target, width);
+    frontier.open.push(AStarOpenEntry{ g + h, g, successor });
+    frontier.counters.generated++;
+    frontier.counters.peak_open = std::max<u64>(frontier.counters.peak_open, frontier.open.size());
+
+    //If the other frontier already reached this cell we have a path between origin and dst
+    const u32 other_g = other.g[successor];
+    if (other_g != kInfiniteCost && g + other_g < best_cost_)
+    {
+      std::lock_guard<std::mutex> lock(meeting_mutex_);
+      if (g + other_g < best_cost_)
+      {
+        best_cost_ = g + other_g;
+        meeting_cell_ = successor;
+      }
+    }
+  }
+  return true;
+}
+
+s16 AStar::buildBidirectionalPath(Path* path, const Map& collisionData)
+{
+  const s32 width = collisionData.width();
+  const Float2 ratio = collisionData.ratio();
+
+  //The forward branch goes from the meeting cell to the origin so it has to be reversed
+  std::stack<s32> forward_branch;
+  for (s32 cell = meeting_cell_; cell != -1; cell = forward_.parent[cell])
+  {
+    forward_branch.push(cell);
+  }
+  u32 count = static_cast<u32>(forward_branch.size());
+  for (s32 cell = backward_.parent[meeting_cell_]; cell != -1; cell = backward_.parent[cell])
+  {
+    count++;
+  }
+  if (count > kMaxPoints || path->create(static_cast<u16>(count)) != kErrorCode_Ok)
+  {
+    return kErrorCode_PathNotCreated;
+  }
+
+  while (!forward_branch.empty())
+  {
+    const s32 cell = forward_branch.top();
+    forward_branch.pop();
+    path->addPoint((cell % width) * ratio.x, (cell / width) * ratio.y);
+  }
+  for (s32 cell = backward_.parent[meeting_cell_]; cell != -1; cell = backward_.parent[cell])
+  {
+    path->addPoint((cell % width) * ratio.x, (cell / width) * ratio.y);
+  }
+  path->set_direction(Direction::kDirForward);
+  path->setToReady();
+  if (logging_) printf(" Path found, proceeding to execute it.\n");
+  return kErrorCode_Ok;
+}
+
+s16 AStar::set_clearance(u8 clearance)
+{
+  if (actual_state_ == AStarStatus::k_Calculating) return kErrorCode_Timeout;
+  clearance_ = (clearance == 0) ? 1 : clearance;
+  return kErrorCode_Ok;
+}
+
+s16 AStar::set_dynamic_obstacles(const OccupancyGrid* occupancy, DynamicObstacles mode, u16 extra_cost)
+{
+  if (actual_state_ == AStarStatus::k_Calculating) return kErrorCode_Timeout;
+  if (!occupancy && mode != DynamicObstacles::k_Ignore) return kErrorCode_InvalidPointer;
+  occupancy_ = occupancy;
+  dynamic_obstacles_ = mode;
+  dynamic_extra_cost_ = std::min(extra_cost, kMaxDynamicExtraCost);
+  return kErrorCode_Ok;
+}
+
+bool AStar::applyDynamicObstacles(const Float2& cell, const Float2& goal, u16* step_cost) const
+{
+  if (dynamic_obstacles_ == DynamicObstacles::k_Ignore || (cell.x == goal.x && cell.y == goal.y)) return true;
+  if (!occupancy_->isOccupied(static_cast<s32>(cell.x), static_cast<s32>(cell.y))) return true;
+  if (dynamic_obstacles_ == DynamicObstacles::k_Blocked) return false;
+  *step_cost += dynamic_extra_cost_;
+  return true;
+}
+
+bool AStar::applyDynamicObstacles(const s32 cell, const s32 goal, const s32 width, u32* step_cost) const
+{
+  if (dynamic_obstacles_ == DynamicObstacles::k_Ignore || cell == goal) return true;
+  if (!occupancy_->isOccupied(cell % width, cell / width)) return true;
+  if (dynamic_obstacles_ == DynamicObstacles::k_Blocked) return false;
+  *step_cost += dynamic_extra_cost_;
+  return true;
+}
+
+s16 AStar::set_zone_corridor(const std::vector<u8>* corridor)
+{
+  if (actual_state_ == AStarStatus::k_Calculating) return kErrorCode_Timeout;
+  zone_corridor_ = corridor;
+  return kErrorCode_Ok;
+}
+
+const std::vector<u8>* AStar::zoneCorridor() const
+{
+  return zone_corridor_;
+}
+
+bool AStar::isInZoneCorridor(const Map& collisionData, const Float2& cell) const
+{
+  return isInZoneCorridor(collisionData, static_cast<s32>(cell.x), static_cast<s32>(cell.y));
+}
+
+bool AStar::isInZoneCorridor(const Map& collisionData, const s32 x, const s32 y) const
+{
+  if (!zone_corridor_) return true;
+  const s32 zone = collisionData.zones().zone(x, y);
+  return zone >= 0 && zone < static_cast<s32>(zone_corridor_->size()) && (*zone_corridor_)[zone];
+}
+
+void AStar::set_corridor_radius(u8 radius)
+{
+  corridor_radius_ = radius;
+}
+
+s16 AStar::set_num_threads(u32 num_threads)
+{
+  if (actual_state_ == AStarStatus::k_Calculating) return kErrorCode_Timeout;
+  num_threads_ = num_threads;
+  return kErrorCode_Ok;
+}
+
+AStarParallelStats AStar::parallelStats() const
+{
+  AStarParallelStats stats = { hda_threads_, best_cost_.load(), 0, 0, 0 };
+  for (const AStarWorker& worker : workers_)
+  {
+    stats.expansions += worker.counters.expanded;
+    stats.max_thread_expansions = std::max(stats.max_thread_expansions, worker.counters.expanded);
+    stats.messages += worker.messages;
+  }
+  return stats;
+}
+
+const PathStats& AStar::stats() const
+{
+  return stats_;
+}
+
+PathQueryStats AStar::lastQuery() const
+{
+  return last_query_;
+}
+
+void AStar::resetStats()
+{
+  stats_.reset();
+}
+
+void AStar::set_logging(bool logging)
+{
+  logging_ = logging;
+}
+
+void AStar::cancel()
+{
+  if (actual_state_ != AStarStatus::k_Calculating) return;
+  //node_start is in the lists, node_goal is not and only exists while a classic search runs
+  if (mode_ == AStarMode::k_Classic)
+  {
+    delete node_goal;
+    node_goal = nullptr;
+  }
   clean();
+  std::vector<AStarNode*>().swap(open_list_);
+  std::vector<AStarNode*>().swap(closed_list_);
+  node_start = nullptr;
+  node_current = nullptr;
+  //Swapping with an empty queue frees its memory, pop would keep it
+  std::priority_queue<AStarOpenEntry>().swap(forward_.open);
+  std::priority_queue<AStarOpenEntry>().swap(backward_.open);
+  for (AStarWorker& worker : workers_)
+  {
+    std::priority_queue<AStarOpenEntry>().swap(worker.open);
+    for (std::vector<AStarMessage>& outbox : worker.outbox)
+    {
+      std::vector<AStarMessage>().swap(outbox);
+    }
+  }
   actual_state_ = AStarStatus::k_Finished;
+  if (logging_) printf("Path cancelled.\n");
+}
+
+bool AStar::isCalculating() const
+{
+  return actual_state_ == AStarStatus::k_Calculating;
+}
+
+void AStar::beginQuery()
+{
+  query_start_ = ESAT::Time();
+  forward_.counters = AStarCounters();
+  backward_.counters = AStarCounters();
+  for (AStarWorker& worker : workers_)
+  {
+    worker.counters = AStarCounters();
+  }
+}
+
+void AStar::endQuery(const s16 result)
+{
+  //Only the frontiers and workers of the mode have counted something since beginQuery
+  AStarCounters total;
+  const AStarCounters* parts[2] = { &forward_.counters, &backward_.counters };
+  for (const AStarCounters* part : parts)
+  {
+    total.expanded += part->expanded;
+    total.generated += part->generated;
+    total.duplicates += part->duplicates;
+    total.reopened += part->reopened;
+    total.peak_open += part->peak_open;
+  }
+  for (const AStarWorker& worker : workers_)
+  {
+    total.expanded += worker.counters.expanded;
+    total.generated += worker.counters.generated;
+    total.duplicates += worker.counters.duplicates;
+    total.reopened += worker.counters.reopened;
+    total.peak_open += worker.counters.peak_open;
+  }
+  last_query_.expanded = total.expanded;
+  last_query_.generated = total.generated;
+  last_query_.duplicates = total.duplicates;
+  last_query_.reopened = total.reopened;
+  last_query_.peak_open = total.peak_open;
+  last_query_.latency_ms = ESAT::Time() - query_start_;
+  last_query_.result = result;
+  stats_.add(last_query_);
+}
+
+s16 AStar::startCoarseToFine(const Float2& origin, const Float2& dst, const Map& collisionData)
+{
+  const s32 width = collisionData.width();
+  origin_cell_ = static_cast<s32>(origin.x) + static_cast<s32>(origin.y) * width;
+  dst_cell_ = static_cast<s32>(dst.x) + static_cast<s32>(dst.y) * width;
+  search_level_ = collisionData.numLevels() - 1;
+  corridor_active_ = false;
+  if (!startLevel(collisionData)) return kErrorCode_Memory;
+  return kErrorCode_Ok;
+}
+
+s16 AStar::stepCoarseToFine(Path* path, const Map& collisionData, double timeout)
+{
+  const double start_time = ESAT::Time();
+  u32 expansions = 0;
+  while (true)
+  {
+    const s16 status = expandLevel(collisionData);
+    if (status == kErrorCode_PathNotFound)
+    {
+      //A cell of a level is free if any cell it covers is free, so a level without
+      //a path proves there is no path. Only the corridor can hide one.
+      if (!corridor_active_)
+      {
+        if (logging_) printf("Path not found.\n");
+        return kErrorCode_PathNotFound;
+      }
+      corridor_active_ = false;
+      if (!startLevel(collisionData)) return kErrorCode_Memory;
+    }
+    else if (status == kErrorCode_Ok)
+    {
+      if (search_level_ == 0) return buildForwardPath(path, forward_.parent, forward_.target, collisionData);
+      buildCorridor(collisionData);
+      search_level_--;
+      corridor_active_ = true;
+      if (!startLevel(collisionData)) return kErrorCode_Memory;
+    }
+    if (timeout >= 0.0 && (++expansions & 63) == 0 && ESAT::Time() - start_time > timeout)
+    {
+      return kErrorCode_Timeout;
+    }
+  }
+}
+
+bool AStar::startLevel(const Map& collisionData)
+{
+  const MapLevel level = collisionData.level(search_level_);
+  const s32 width = collisionData.width();
+  if (!forward_.reset(level.width * level.height)) return false;
+
+  const s32 origin_cell = (origin_cell_ % width) / level.scale_x + ((origin_cell_ / width) / level.scale_y) * level.width;
+  const s32 dst_cell = (dst_cell_ % width) / level.scale_x + ((dst_cell_ / width) / level.scale_y) * level.width;
+  forward_.root = origin_cell;
+  forward_.target = dst_cell;
+  forward_.g[origin_cell].store(0, std::memory_order_relaxed);
+  forward_.open.push(AStarOpenEntry{ octileHeuristic(origin_cell, dst_cell, level.width), 0, origin_cell });
+  return true;
+}
+
+s16 AStar::expandLevel(const Map& collisionData)
+{
+  const MapLevel level = collisionData.level(search_level_);
+
+  //Entries of cells that were improved after being pushed are discarded
+  while (!forward_.open.empty())
+  {
+    const AStarOpenEntry& top = forward_.open.top();
+    if (!forward_.closed[top.cell] &&
+        top.g == forward_.g[top.cell].load(std::memory_order_relaxed)) break;
+    forward_.open.pop();
+  }
+  if (forward_.open.empty()) return kErrorCode_PathNotFound;
+
+  const AStarOpenEntry current = forward_.open.top();
+  forward_.open.pop();
+  if (current.cell == forward_.target) return kErrorCode_Ok;
+  forward_.closed[current.cell] = 1;
+  forward_.counters.expanded++;
+
+  for (s32 i = 0; i < 8; i++)
+  {
+    s32 new_x, new_y;
+    u32 step_cost = neighbour(current.cell, i, level.width, &new_x, &new_y);
+    //Coarser levels ignore the clearance, they only guide the search of level 0
+    const bool blocked = (search_level_ == 0) ? collisionData.isBlocked(new_x, new_y, clearance_) :
+                                                collisionData.isOccupied(new_x, new_y, search_level_);
+    if (blocked) continue;
+
+    const s32 successor = new_x + new_y * level.width;
+    if (corridor_active_ && !corridor_[successor]) continue;
+    //The agents and the zones are only in the cells of the map, the coarser levels ignore them
+    if (search_level_ == 0 && (!isInZoneCorridor(collisionData, new_x, new_y) ||
+                               !applyDynamicObstacles(successor, forward_.target, level.width, &step_cost))) continue;
+    const u32 g = current.g + step_cost;
+    if (forward_.closed[successor] || g >= forward_.g[successor].load(std::memory_order_relaxed))
+    {
+      forward_.counters.duplicates++;
+      continue;
+    }
+
+    forward_.g[successor].store(g, std::memory_order_relaxed);
+    forward_.parent[successor] = current.cell;
+    forward_.open.push(AStarOpenEntry{ g + octileHeuristic(successor, forward_.target, level.width), g, successor });
+    forward_.counters.generated++;
+    forward_.counters.peak_open = std::max<u64>(forward_.counters.peak_open, forward_.open.size());
+  }
+  return kErrorCode_Timeout;
+}
+
+void AStar::buildCorridor(const Map& collisionData)
+{
+  const MapLevel coarse = collisionData.level(search_level_);
+  const MapLevel fine = collisionData.level(search_level_ - 1);
+  const s32 factor_x = coarse.scale_x / fine.scale_x;
+  const s32 factor_y = coarse.scale_y / fine.scale_y;
+  const s32 radius = corridor_radius_;
+
+  corridor_.assign(fine.width * fine.height, 0);
+  for (s32 cell = forward_.target; cell != -1; cell = forward_.parent[cell])
+  {
+    const s32 x = cell % coarse.width;
+    const s32 y = cell / coarse.width;
+    for (s32 coarse_y = std::max(0, y - radius); coarse_y <= std::min(coarse.height - 1, y + radius); coarse_y++)
+    {
+      for (s32 coarse_x = std::max(0, x - radius); coarse_x <= std::min(coarse.width - 1, x + radius); coarse_x++)
+      {
+        //Every cell of the finer level covered by the coarse cell is inside the corridor
+        for (s32 fine_y = coarse_y * factor_y; fine_y < std::min(fine.height, (coarse_y + 1) * factor_y); fine_y++)
+        {
+          for (s32 fine_x = coarse_x * factor_x; fine_x < std::min(fine.width, (coarse_x + 1) * factor_x); fine_x++)
+          {
+            corridor_[fine_x + fine_y * fine.width] = 1;
+          }
+        }
+      }
+    }
+  }
+}
+
+s16 AStar::buildForwardPath(Path* path, const s32* parent, const s32 target, const Map& collisionData)
+{
+  const s32 width = collisionData.width();
+  const Float2 ratio = collisionData.ratio();
+
+  std::stack<s32> final_path;
+  for (s32 cell = target; cell != -1; cell = parent[cell])
+  {
+    final_path.push(cell);
+  }
+  if (final_path.size() > kMaxPoints || path->create(static_cast<u16>(final_path.size())) != kErrorCode_Ok)
+  {
+    return kErrorCode_PathNotCreated;
+  }
+  while (!final_path.empty())
+  {
+    const s32 cell = final_path.top();
+    final_path.pop();
+    path->addPoint((cell % width) * ratio.x, (cell / width) * ratio.y);
+  }
+  path->set_direction(Direction::kDirForward);
+  path->setToReady();
+  if (logging_) printf(" Path found, proceeding to execute it.\n");
   return kErrorCode_Ok;
 }
 
+s16 AStar::startHashDistributed(const Float2& origin, const Float2& dst, const Map& collisionData)
+{
+  const s32 width = collisionData.width();
+  const s32 height = collisionData.height();
+  const s32 cells = width * height;
+
+  hda_threads_ = num_threads_ ? num_threads_ : std::max(1u, std::thread::hardware_concurrency());
+  const u32 num_queues = hda_threads_ * hda_threads_;
+  if (num_queues != num_queues_)
+  {
+    delete[] queues_;
+    queues_ = new (std::nothrow) AStarMessageQueue[num_queues];
+    num_queues_ = queues_ ? num_queues : 0;
+    if (!queues_) return kErrorCode_Memory;
+  }
+  for (u32 i = 0; i < num_queues_; i++)
+  {
+    if (!queues_[i].reset(kMessageQueueSize)) return kErrorCode_Memory;
+  }
+
+  const size_t blocks_x = static_cast<size_t>((width >> kHashBlockShift) + 1);
+  const size_t blocks_y = static_cast<size_t>((height >> kHashBlockShift) + 1);
+  try
+  {
+    hda_g_.assign(cells, kInfiniteCost);
+    hda_parent_.assign(cells, -1);
+    workers_.assign(hda_threads_, AStarWorker());
+    for (AStarWorker& worker : workers_)
+    {
+      worker.outbox.resize(hda_threads_);
+    }
+    if (zobrist_x_.size() != blocks_x || zobrist_y_.size() != blocks_y)
+    {
+      //Fixed seed so every search partitions the map in the same way
+      u32 seed = 0x9e3779b9;
+      auto next_key = [&seed]() { seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5; return seed; };
+      zobrist_x_.resize(blocks_x);
+      zobrist_y_.resize(blocks_y);
+      for (u32& key : zobrist_x_) key = next_key();
+      for (u32& key : zobrist_y_) key = next_key();
+    }
+  }
+  catch (const std::bad_alloc&)
+  {
+    return kErrorCode_Memory;
+  }
+
+  origin_cell_ = static_cast<s32>(origin.x) + static_cast<s32>(origin.y) * width;
+  dst_cell_ = static_cast<s32>(dst.x) + static_cast<s32>(dst.y) * width;
+  best_cost_ = kInfiniteCost;
+
+  //Only the owner of the origin starts active, the rest wait for messages
+  const u32 owner = cellOwner(origin_cell_, width);
+  workers_[owner].active = true;
+  busy_ = 1;
+  relaxOwnedCell(owner, AStarMessage{ origin_cell_, -1, 0 }, width);
+  hda_done_ = false;
+  hda_timeout_ = false;
+  return kErrorCode_Ok;
+}
+
+s16 AStar::stepHashDistributed(Path* path, const Map& collisionData, double timeout)
+{
+  const double start_time = ESAT::Time();
+  hda_timeout_ = false;
+
+  std::vector<std::thread> threads;
+  for (u32 i = 1; i < hda_threads_; i++)
+  {
+    threads.push_back(std::thread(&AStar::runHashDistributedWorker, this, i,
+                                  std::cref(collisionData), start_time, timeout));
+  }
+  runHashDistributedWorker(0, collisionData, start_time, timeout);
+  for (std::thread& thread : threads)
+  {
+    thread.join();
+  }
+  if (!hda_done_) return kErrorCode_Timeout;
+
+  if (best_cost_ == kInfiniteCost)
+  {
+    if (logging_) printf("Path not found.\n");
+    return kErrorCode_PathNotFound;
+  }
+  return buildForwardPath(path, hda_parent_.data(), dst_cell_, collisionData);
+}
+
+void AStar::runHashDistributedWorker(const u32 id, const Map& collisionData, double start_time, double timeout)
+{
+  const s32 width = collisionData.width();
+  AStarWorker& worker = workers_[id];
+  u32 iterations = 0;
+
+  while (!hda_done_ && !hda_timeout_)
+  {
+    //An idle worker is counted as busy before the message it receives stops being counted
+    for (u32 sender = 0; sender < hda_threads_; sender++)
+    {
+      AStarMessage message;
+      AStarMessageQueue& queue = queues_[sender * hda_threads_ + id];
+      while (queue.pop(&message))
+      {
+        if (!worker.active)
+        {
+          busy_++;
+          worker.active = true;
+        }
+        relaxOwnedCell(id, message, width);
+        busy_--;
+      }
+    }
+
+    //Messages that didn't fit before are sent in order
+    bool pending_messages = false;
+    for (u32 owner = 0; owner < hda_threads_; owner++)
+    {
+      std::vector<AStarMessage>& outbox = worker.outbox[owner];
+      if (outbox.empty()) continue;
+      size_t sent = 0;
+      while (sent < outbox.size() && queues_[id * hda_threads_ + owner].push(outbox[sent])) sent++;
+      outbox.erase(outbox.begin(), outbox.begin() + sent);
+      pending_messages = pending_messages || !outbox.empty();
+    }
+
+    if (worker.active)
+    {
+      //Entries of cells that were improved after being pushed are discarded
+      while (!worker.open.empty() && worker.open.top().g != hda_g_[worker.open.top().cell])
+      {
+        worker.open.pop();
+      }
+      //Nodes whose f reaches the best path found can't improve it
+      if (!worker.open.empty() && worker.open.top().f < best_cost_.load(std::memory_order_relaxed))
+      {
+        const AStarOpenEntry current = worker.open.top();
+        worker.open.pop();
+        worker.counters.expanded++;
+
+        for (s32 i = 0; i < 8; i++)
+        {
+          s32 new_x, new_y;
+          u32 step_cost = neighbour(current.cell, i, width, &new_x, &new_y);
+          if (collisionData.isBlocked(new_x, new_y, clearance_) || !isInZoneCorridor(collisionData, new_x, new_y)) continue;
+
+          const s32 successor = new_x + new_y * width;
+          if (!applyDynamicObstacles(successor, dst_cell_, width, &step_cost)) continue;
+          const u32 g = current.g + step_cost;
+          if (g + octileHeuristic(successor, dst_cell_, width) >= best_cost_.load(std::memory_order_relaxed)) continue;
+
+          const AStarMessage message = { successor, current.cell, g };
+          const u32 owner = cellOwner(successor, width);
+          if (owner == id) relaxOwnedCell(id, message, width);
+          else sendToOwner(id, owner, message);
+        }
+      }
+      else if (!pending_messages)
+      {
+        worker.active = false;
+        busy_--;
+      }
+    }
+    else
+    {
+      //No active worker and no message in flight, nothing can change anymore
+      if (busy_ == 0)
+      {
+        hda_done_ = true;
+        return;
+      }
+      std::this_thread::yield();
+    }
+
+    if (timeout >= 0.0 && (++iterations & 63) == 0 && ESAT::Time() - start_time > timeout)
+    {
+      hda_timeout_ = true;
+    }
+  }
+}
+
+void AStar::relaxOwnedCell(const u32 id, const AStarMessage& message, const s32 width)
+{
+  AStarCounters& counters = workers_[id].counters;
+  if (message.g >= hda_g_[message.cell])
+  {
+    counters.duplicates++;
+    return;
+  }
+
+  hda_g_[message.cell] = message.g;
+  hda_parent_[message.cell] = message.parent;
+  if (message.cell == dst_cell_)
+  {
+    u32 best_cost = best_cost_.load();
+    while (message.g < best_cost && !best_cost_.compare_exchange_weak(best_cost, message.g)) {}
+    return;
+  }
+  workers_[id].open.push(AStarOpenEntry{ message.g + octileHeuristic(message.cell, dst_cell_, width),
+                                         message.g, message.cell });
+  counters.generated++;
+  counters.peak_open = std::max<u64>(counters.peak_open, workers_[id].open.size());
+}
+
+void AStar::sendToOwner(const u32 id, const u32 owner, const AStarMessage& message)
+{
+  //The message is counted before it can be received
+  busy_++;
+  workers_[id].messages++;
+  std::vector<AStarMessage>& outbox = workers_[id].outbox[owner];
+  if (!outbox.empty() || !queues_[id * hda_threads_ + owner].push(message))
+  {
+    outbox.push_back(message);
+  }
+}
+
+u32 AStar::cellOwner(const s32 cell, const s32 width) const
+{
+  const s32 block_x = (cell % width) >> kHashBlockShift;
+  const s32 block_y = (cell / width) >> kHashBlockShift;
+  return (zobrist_x_[block_x] ^ zobrist_y_[block_y]) % hda_threads_;
+}
+
+u32 AStar::octileHeuristic(const s32 cell, const s32 target, const s32 width) const
+{
+  const s32 dx = abs(cell % width - target % width);
+  const s32 dy = abs(cell / width - target / width);
+  const u32 diagonal = static_cast<u32>(std::min(dx, dy));
+  const u32 straight = static_cast<u32>(std::max(dx, dy)) - diagonal;
+  return diagonal * (base_step_cost_ + 5) + straight * base_step_cost_;
+}
+
+u32 AStar::neighbour(const s32 cell, const s32 direction, const s32 width, s32* neighbour_x, s32* neighbour_y) const
+{
+  *neighbour_x = cell % width + g_offset_x[direction];
+  *neighbour_y = cell / width + g_offset_y[direction];
+  return base_step_cost_ + g_extra_step_cost[direction];
+}
+
 void AStar::clean()
 {
   while(!open_list_.empty()){
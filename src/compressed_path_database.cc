@@ -0,0 +1,292 @@
+// compressed_path_database.cc
+// Jose Maria Martinez
+// Implementation of the compressed path database
+//Comments for the functions can be found at the header
+
+#include "compressed_path_database.h"
+#include "map.h"
+#include "path.h"
+#include "common_def.h"
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <new>
+#include <queue>
+#include <thread>
+#include <vector>
+
+//Offsets and extra step cost of each move, in the same order as the directions of the A*
+static const s32 g_move_x[8] = { -1, 0, 1, -1, 1, -1, 0, 1 };
+static const s32 g_move_y[8] = { -1, -1, -1, 0, 0, 1, 1, 1 };
+static const u32 g_move_extra_cost[8] = { 5, 0, 5, 0, 0, 5, 0, 5 };
+static const u32 kBaseStepCost = 10;
+
+static const char kCPDMagic[4] = { 'C', 'P', 'D', '1' };
+
+CompressedPathDatabase::CompressedPathDatabase()
+{
+  header_ = nullptr;
+  row_offsets_ = nullptr;
+  runs_ = nullptr;
+  logging_ = false;
+}
+
+CompressedPathDatabase::~CompressedPathDatabase()
+{
+  unload();
+}
+
+s16 CompressedPathDatabase::build(const Map& map, const char* file, u32 num_threads)
+{
+  if (!file) return kErrorCode_InvalidPointer;
+  const s32 width = map.width();
+  const s32 cells = width * map.height();
+  if (cells == 0) return kErrorCode_PathNotCreated;
+  //Runs store the target in 28 bits
+  if (cells > (1 << 28)) return kErrorCode_Memory;
+
+  if (num_threads == 0) num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+  std::vector<std::vector<u32>> source_runs;
+  try
+  {
+    source_runs.resize(cells);
+  }
+  catch (const std::bad_alloc&)
+  {
+    return kErrorCode_Memory;
+  }
+  std::atomic<s32> next_source(0);
+  std::atomic<bool> out_of_memory(false);
+
+  auto worker = [&]()
+  {
+    typedef std::pair<u32, s32> OpenEntry;
+    try
+    {
+      std::vector<u32> g(cells);
+      std::vector<u8> first_move(cells);
+      std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry>> open;
+
+      for (s32 source = next_source++; source < cells && !out_of_memory; source = next_source++)
+      {
+        if (map.isBlocked(source % width, source / width, 1)) continue;
+
+        std::fill(g.begin(), g.end(), UINT32_MAX);
+        std::fill(first_move.begin(), first_move.end(), kCPDNoMove);
+        g[source] = 0;
+        open.push(OpenEntry(0, source));
+        while (!open.empty())
+        {
+          const OpenEntry current = open.top();
+          open.pop();
+          if (current.first > g[current.second]) continue;
+
+          const s32 x = current.second % width;
+          const s32 y = current.second / width;
+          for (s32 i = 0; i < 8; i++)
+          {
+            const s32 new_x = x + g_move_x[i];
+            const s32 new_y = y + g_move_y[i];
+            if (map.isBlocked(new_x, new_y, 1)) continue;
+
+            const s32 successor = new_x + new_y * width;
+            const u32 cost = current.first + kBaseStepCost + g_move_extra_cost[i];
+            if (cost >= g[successor]) continue;
+
+            g[successor] = cost;
+            //The neighbours of the source start the branches, the rest inherit the first move
+            first_move[successor] = (current.second == source) ? static_cast<u8>(i) : first_move[current.second];
+            open.push(OpenEntry(cost, successor));
+          }
+        }
+
+        //Occupied targets and the source itself are never asked so they extend the current run
+        std::vector<u32>& runs = source_runs[source];
+        u8 current_move = 0xff;
+        for (s32 target = 0; target < cells; target++)
+        {
+          if (target == source || map.isBlocked(target % width, target / width, 1)) continue;
+          if (first_move[target] == current_move) continue;
+          current_move = first_move[target];
+          //The first run always starts at the first target so lookups never fall before it
+          const u32 start = runs.empty() ? 0 : static_cast<u32>(target);
+          runs.push_back((start << 4) | current_move);
+        }
+        runs.shrink_to_fit();
+      }
+    }
+    catch (const std::bad_alloc&)
+    {
+      out_of_memory = true;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (u32 i = 1; i < num_threads; i++)
+  {
+    threads.push_back(std::thread(worker));
+  }
+  worker();
+  for (std::thread& thread : threads)
+  {
+    thread.join();
+  }
+  if (out_of_memory) return kErrorCode_Memory;
+
+  CPDHeader header;
+  memcpy(header.magic, kCPDMagic, sizeof(kCPDMagic));
+  header.version = kCPDVersion;
+  header.width = width;
+  header.height = map.height();
+  header.map_hash = map.contentHash();
+  header.padding = 0;
+
+  std::vector<u32> row_offsets(cells + 1);
+  u64 num_runs = 0;
+  for (s32 i = 0; i < cells; i++)
+  {
+    row_offsets[i] = static_cast<u32>(num_runs);
+    num_runs += source_runs[i].size();
+    if (num_runs > UINT32_MAX) return kErrorCode_Memory;
+  }
+  row_offsets[cells] = static_cast<u32>(num_runs);
+  header.num_runs = static_cast<u32>(num_runs);
+
+  FILE* output = fopen(file, "wb");
+  if (!output) return kErrorCode_File;
+
+  bool written = fwrite(&header, sizeof(header), 1, output) == 1 &&
+                 fwrite(row_offsets.data(), sizeof(u32), row_offsets.size(), output) == row_offsets.size();
+  for (s32 i = 0; i < cells && written; i++)
+  {
+    const std::vector<u32>& runs = source_runs[i];
+    written = runs.empty() || fwrite(runs.data(), sizeof(u32), runs.size(), output) == runs.size();
+  }
+  written = (fclose(output) == 0) && written;
+
+  return written ? kErrorCode_Ok : kErrorCode_File;
+}
+
+s16 CompressedPathDatabase::load(const char* file, const Map& map)
+{
+  if (!file) return kErrorCode_InvalidPointer;
+  unload();
+
+  const s16 status = file_.open(file);
+  if (status != kErrorCode_Ok) return status;
+
+  const CPDHeader* header = reinterpret_cast<const CPDHeader*>(file_.data());
+  const u64 cells = static_cast<u64>(map.width()) * map.height();
+  if (file_.size() < sizeof(CPDHeader) ||
+      memcmp(header->magic, kCPDMagic, sizeof(kCPDMagic)) != 0 ||
+      header->version != kCPDVersion ||
+      header->width != map.width() || header->height != map.height() ||
+      header->map_hash != map.contentHash() ||
+      file_.size() != sizeof(CPDHeader) + (cells + 1 + header->num_runs) * sizeof(u32))
+  {
+    file_.close();
+    return kErrorCode_File;
+  }
+
+  row_offsets_ = reinterpret_cast<const u32*>(file_.data() + sizeof(CPDHeader));
+  if (row_offsets_[cells] != header->num_runs)
+  {
+    row_offsets_ = nullptr;
+    file_.close();
+    return kErrorCode_File;
+  }
+  runs_ = row_offsets_ + cells + 1;
+  header_ = header;
+  return kErrorCode_Ok;
+}
+
+void CompressedPathDatabase::unload()
+{
+  file_.close();
+  header_ = nullptr;
+  row_offsets_ = nullptr;
+  runs_ = nullptr;
+}
+
+bool CompressedPathDatabase::isLoaded() const
+{
+  return header_ != nullptr;
+}
+
+u8 CompressedPathDatabase::firstMove(const s32 source, const s32 target) const
+{
+  if (!header_) return kCPDNoMove;
+  const s32 cells = header_->width * header_->height;
+  if (source < 0 || source >= cells || target < 0 || target >= cells) return kCPDNoMove;
+
+  const u32* first = runs_ + row_offsets_[source];
+  const u32* last = runs_ + row_offsets_[source + 1];
+  if (first == last) return kCPDNoMove;
+
+  //The run that covers the target is the last one that starts before it
+  const u32* run = std::upper_bound(first, last, (static_cast<u32>(target) << 4) | 0xf) - 1;
+  return static_cast<u8>(*run & 0xf);
+}
+
+s16 CompressedPathDatabase::generatePath(Float2 origin, Float2 dst, Path* path, const Map& map) const
+{
+  if (!header_ || !path) return kErrorCode_PathNotCreated;
+
+  const Float2 ratio = map.ratio();
+  const s32 origin_x = static_cast<s32>(floorf(origin.x / ratio.x));
+  const s32 origin_y = static_cast<s32>(floorf(origin.y / ratio.y));
+  const s32 dst_x = static_cast<s32>(floorf(dst.x / ratio.x));
+  const s32 dst_y = static_cast<s32>(floorf(dst.y / ratio.y));
+
+  if (map.isBlocked(origin_x, origin_y, 1))
+  {
+    if (logging_) printf("Origin not valid.\n");
+    return kErrorCode_InvalidOrigin;
+  }
+  if (map.isBlocked(dst_x, dst_y, 1))
+  {
+    if (logging_) printf("Destination not valid.\n");
+    return kErrorCode_InvalidDestination;
+  }
+
+  const s32 width = header_->width;
+  const s32 dst_cell = dst_x + dst_y * width;
+
+  //The points are counted first as the path has to be created with its size
+  u32 count = 1;
+  for (s32 cell = origin_x + origin_y * width; cell != dst_cell; count++)
+  {
+    const u8 move = firstMove(cell, dst_cell);
+    if (move == kCPDNoMove)
+    {
+      if (logging_) printf("Path not found.\n");
+      return kErrorCode_PathNotFound;
+    }
+    if (count >= kMaxPoints) return kErrorCode_PathNotCreated;
+    cell += g_move_x[move] + g_move_y[move] * width;
+  }
+  if (path->create(static_cast<u16>(count)) != kErrorCode_Ok) return kErrorCode_PathNotCreated;
+
+  s32 x = origin_x;
+  s32 y = origin_y;
+  path->addPoint(x * ratio.x, y * ratio.y);
+  while (x + y * width != dst_cell)
+  {
+    const u8 move = firstMove(x + y * width, dst_cell);
+    x += g_move_x[move];
+    y += g_move_y[move];
+    path->addPoint(x * ratio.x, y * ratio.y);
+  }
+  path->set_direction(Direction::kDirForward);
+  path->setToReady();
+  return kErrorCode_Ok;
+}
+
+void CompressedPathDatabase::set_logging(bool logging)
+{
+  logging_ = logging;
+}
@@ -12,4 +12,4 @@ GameState::GameState() {
 GameState& GameState::instance() {
   static GameState* game_instance = new GameState();
   return *game_instance;
-}
\ No newline at end of file
+}
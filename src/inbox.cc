@@ -0,0 +1,49 @@
+// inbox.cc
+// Jose Maria Martinez
+// Implementation of the inbox where an agent receives its messages
+//Comments for the functions can be found at the header
+
+#include "inbox.h"
+#include "common_def.h"
+
+Inbox::Inbox()
+{
+  head_ = 0;
+  tail_ = 0;
+}
+
+Inbox::~Inbox()
+{
+
+}
+
+s16 Inbox::push(const AgentMessage& msg)
+{
+  if (isFull()) return kErrorCode_Memory;
+  messages_[tail_ & (kInboxCapacity - 1)] = msg;
+  tail_++;
+  return kErrorCode_Ok;
+}
+
+bool Inbox::pop(AgentMessage* msg)
+{
+  if (head_ == tail_) return false;
+  *msg = messages_[head_ & (kInboxCapacity - 1)];
+  head_++;
+  return true;
+}
+
+void Inbox::clear()
+{
+  head_ = tail_;
+}
+
+u32 Inbox::size() const
+{
+  return tail_ - head_;
+}
+
+bool Inbox::isFull() const
+{
+  return tail_ - head_ == kInboxCapacity;
+}
@@ -6,7 +6,13 @@
 #include "map.h"
 #include "STB/stb_image.h"
 #include "common_def.h"
+#include "asset_cache.h"
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <algorithm>
+#include <thread>
 
 
 Map::Map()
@@ -14,6 +20,13 @@ Map::Map()
   height_ = 0;
   width_ = 0;
   collision_data_ = nullptr;
+  free_run_ = nullptr;
+  clearance_ = nullptr;
+  background_ = nullptr;
+  original_width_ = 0;
+  original_height_ = 0;
+  content_hash_ = 0;
+  content_hash_dirty_ = true;
 }
 
 Map::~Map()
@@ -21,9 +34,29 @@ Map::~Map()
   freeResources();
 }
 
+s16 Map::set_original_size(const s32 width, const s32 height)
+{
+  if (!collision_data_) return kErrorCode_PathNotCreated;
+  if (width <= 0 || height <= 0) return kErrorCode_InvalidOrigin;
+  original_width_ = width;
+  original_height_ = height;
+  ratio_ = Float2(static_cast<float>(original_width_) / width_, static_cast<float>(original_height_) / height_);
+  return kErrorCode_Ok;
+}
+
 Float2 Map::ratio() const
 {
   return ratio_;
+}
+
+s32 Map::width() const
+{
+  return width_;
+}
+
+s32 Map::height() const
+{
+  return height_;
 }
 
 ESAT::SpriteHandle Map::background() const
@@ -39,37 +72,323 @@ bool Map::isOccupied(const float x, const float y) const
   return !collision_data_[position];
 }
 
+bool Map::isOccupied(const s32 x, const s32 y, const u8 level) const
+{
+  if (level == 0) return isOccupied(static_cast<float>(x), static_cast<float>(y));
+  if (level > levels_.size()) return true;
+  const MapLevel& map_level = levels_[level - 1];
+  if (x < 0 || x >= map_level.width || y < 0 || y >= map_level.height) return true;
+  return !map_level.collision_data[x + y * map_level.width];
+}
+
+u8 Map::numLevels() const
+{
+  return static_cast<u8>(levels_.size() + 1);
+}
+
+MapLevel Map::level(const u8 level) const
+{
+  if (level == 0 || level > levels_.size()) return MapLevel{ width_, height_, 1, 1, nullptr };
+  MapLevel result = levels_[level - 1];
+  result.collision_data = nullptr;
+  return result;
+}
+
+s16 Map::buildLevels(const u8 num_levels)
+{
+  if (!collision_data_) return kErrorCode_PathNotCreated;
+  freeLevels();
+  for (u8 i = 1; i < num_levels; i++)
+  {
+    const s16 status = addLevel(2, 2);
+    if (status != kErrorCode_Ok) return status;
+  }
+  return kErrorCode_Ok;
+}
+
+s16 Map::loadZones(const char* src, const s32 sector_size)
+{
+  if (!src) return kErrorCode_InvalidPointer;
+  if (!collision_data_) return kErrorCode_PathNotCreated;
+
+  s32 bpp;
+  s32 image_width;
+  s32 image_height;
+  unsigned char* image_data = stbi_load(src, &image_width, &image_height, &bpp, 4);
+  if (!image_data) return kErrorCode_Memory;
+
+  std::vector<u32> zone_ids;
+  try
+  {
+    zone_ids.resize(static_cast<size_t>(width_) * height_);
+  }
+  catch (const std::bad_alloc&)
+  {
+    stbi_image_free(image_data);
+    return kErrorCode_Memory;
+  }
+  for (s32 y = 0; y < height_; y++)
+  {
+    const s32 image_y = static_cast<s32>((2 * static_cast<s64>(y) + 1) * image_height / (2 * height_));
+    for (s32 x = 0; x < width_; x++)
+    {
+      const s32 image_x = static_cast<s32>((2 * static_cast<s64>(x) + 1) * image_width / (2 * width_));
+      const unsigned char* pixel = image_data + (image_x + image_y * image_width) * 4;
+      zone_ids[x + y * width_] = pixel[0] | (pixel[1] << 8) | (pixel[2] << 16) | (static_cast<u32>(pixel[3]) << 24);
+    }
+  }
+  stbi_image_free(image_data);
+  return zones_.build(*this, &zone_ids, sector_size);
+}
+
+s16 Map::buildZones(const s32 sector_size)
+{
+  if (!collision_data_) return kErrorCode_PathNotCreated;
+  return zones_.build(*this, nullptr, sector_size);
+}
+
+const ZoneGraph& Map::zones() const
+{
+  return zones_;
+}
+
+s16 Map::addLevel(const s32 factor_x, const s32 factor_y)
+{
+  const u8 finer_level = numLevels() - 1;
+  const MapLevel finer = level(finer_level);
+
+  MapLevel new_level;
+  new_level.width = (finer.width + factor_x - 1) / factor_x;
+  new_level.height = (finer.height + factor_y - 1) / factor_y;
+  new_level.scale_x = finer.scale_x * factor_x;
+  new_level.scale_y = finer.scale_y * factor_y;
+  new_level.collision_data = static_cast<bool*>(malloc(sizeof(bool) * new_level.width * new_level.height));
+
+  if (!new_level.collision_data) return kErrorCode_Memory;
+
+  for (s32 y = 0; y < new_level.height; y++)
+  {
+    for (s32 x = 0; x < new_level.width; x++)
+    {
+      bool free_cell = false;
+      //The cell is free if any of the cells it covers is free
+      for (s32 j = 0; j < factor_y && !free_cell; j++)
+      {
+        for (s32 i = 0; i < factor_x && !free_cell; i++)
+        {
+          const s32 finer_x = x * factor_x + i;
+          const s32 finer_y = y * factor_y + j;
+          if (finer_x < finer.width && finer_y < finer.height)
+          {
+            free_cell = !isOccupied(finer_x, finer_y, finer_level);
+          }
+        }
+      }
+      new_level.collision_data[x + y * new_level.width] = free_cell;
+    }
+  }
+  levels_.push_back(new_level);
+  return kErrorCode_Ok;
+}
+
+void Map::freeLevels()
+{
+  for (MapLevel& map_level : levels_)
+  {
+    free(map_level.collision_data);
+  }
+  levels_.clear();
+}
+
+u8 Map::clearance(const s32 x, const s32 y) const
+{
+  if (x < 0 || x >= width_ || y < 0 || y >= height_) return 0;
+  return clearance_[x + y * width_];
+}
+
+bool Map::isBlocked(const s32 x, const s32 y, const u8 clearance) const
+{
+  if (x < 0 || x >= width_ || y < 0 || y >= height_) return true;
+  const u8 cell_clearance = clearance_[x + y * width_];
+  return cell_clearance == 0 || cell_clearance < clearance;
+}
+
+s16 Map::setOccupied(const s32 x, const s32 y, const bool occupied)
+{
+  if (!collision_data_) return kErrorCode_PathNotCreated;
+  if (x < 0 || x >= width_ || y < 0 || y >= height_) return kErrorCode_InvalidOrigin;
+
+  collision_data_[x + y * width_] = !occupied;
+  content_hash_dirty_ = true;
+  //Only the squares that could contain the cell change, the rest are limited by kMaxClearance
+  computeClearance(std::max(0, x - kMaxClearance), std::max(0, y - kMaxClearance), x, y);
+  updateLevels(x, y);
+  return kErrorCode_Ok;
+}
+
+void Map::computeClearance(const s32 min_x, const s32 min_y, const s32 max_x, const s32 max_y)
+{
+  auto compute_runs = [this, min_x, max_x](s32 first_row, s32 last_row)
+  {
+    for (s32 y = first_row; y <= last_row; y++)
+    {
+      //The run of the cell after max_x is still valid
+      u8 run = (max_x + 1 < width_) ? free_run_[max_x + 1 + y * width_] : 0;
+      for (s32 x = max_x; x >= min_x; x--)
+      {
+        const s32 cell = x + y * width_;
+        run = collision_data_[cell] ? static_cast<u8>(std::min(run + 1, static_cast<s32>(kMaxClearance))) : 0;
+        free_run_[cell] = run;
+      }
+    }
+  };
+  auto compute_clearance = [this, min_x, max_x](s32 first_row, s32 last_row)
+  {
+    for (s32 y = first_row; y <= last_row; y++)
+    {
+      for (s32 x = min_x; x <= max_x; x++)
+      {
+        //A square of size n fits if the n rows below have a free run of at least n
+        u8 min_run = kMaxClearance;
+        u8 result = 0;
+        for (s32 row = y; row < height_ && result < kMaxClearance; row++)
+        {
+          min_run = std::min(min_run, free_run_[x + row * width_]);
+          if (min_run <= result) break;
+          result++;
+        }
+        clearance_[x + y * width_] = result;
+      }
+    }
+  };
+
+  //The clearance of a row needs the runs of the rows below, so every run is finished first
+  const s32 rows = max_y - min_y + 1;
+  const s32 cells = (max_x - min_x + 1) * rows;
+  const s32 num_threads = (cells > kParallelClearanceCells) ?
+                          std::max(1, static_cast<s32>(std::thread::hardware_concurrency())) : 1;
+  if (num_threads == 1)
+  {
+    compute_runs(min_y, max_y);
+    compute_clearance(min_y, max_y);
+    return;
+  }
+
+  std::vector<std::thread> workers;
+  for (s32 i = 0; i < num_threads; i++)
+  {
+    const s32 first_row = min_y + (rows * i) / num_threads;
+    const s32 last_row = min_y + (rows * (i + 1)) / num_threads - 1;
+    workers.emplace_back(compute_runs, first_row, last_row);
+  }
+  for (std::thread& worker : workers) worker.join();
+  workers.clear();
+  for (s32 i = 0; i < num_threads; i++)
+  {
+    const s32 first_row = min_y + (rows * i) / num_threads;
+    const s32 last_row = min_y + (rows * (i + 1)) / num_threads - 1;
+    workers.emplace_back(compute_clearance, first_row, last_row);
+  }
+  for (std::thread& worker : workers) worker.join();
+}
+
+void Map::updateLevels(const s32 x, const s32 y)
+{
+  for (u8 i = 1; i < numLevels(); i++)
+  {
+    MapLevel& coarse = levels_[i - 1];
+    const MapLevel fine = level(i - 1);
+    const s32 factor_x = coarse.scale_x / fine.scale_x;
+    const s32 factor_y = coarse.scale_y / fine.scale_y;
+    const s32 coarse_x = x / coarse.scale_x;
+    const s32 coarse_y = y / coarse.scale_y;
+
+    bool free_cell = false;
+    for (s32 j = 0; j < factor_y && !free_cell; j++)
+    {
+      for (s32 k = 0; k < factor_x && !free_cell; k++)
+      {
+        const s32 fine_x = coarse_x * factor_x + k;
+        const s32 fine_y = coarse_y * factor_y + j;
+        if (fine_x < fine.width && fine_y < fine.height)
+        {
+          free_cell = !isOccupied(fine_x, fine_y, i - 1);
+        }
+      }
+    }
+    coarse.collision_data[coarse_x + coarse_y * coarse.width] = free_cell;
+  }
+}
+
 void Map::freeResources()
 {
+  freeLevels();
+  zones_.clear();
   if (collision_data_) free(collision_data_);
-  ESAT::SpriteRelease(background_);
+  if (free_run_) free(free_run_);
+  if (clearance_) free(clearance_);
+  collision_data_ = nullptr;
+  free_run_ = nullptr;
+  clearance_ = nullptr;
+  width_ = 0;
+  height_ = 0;
+  source_.clear();
+  content_hash_dirty_ = true;
+  if (background_) AssetCache::instance().release(background_);
+  background_ = nullptr;
 }
 
 s16 Map::loadMap(const char* src, const char* background)
 {
   if (!src || !background) return kErrorCode_InvalidPointer;
-  //If there's already data loaded we free it
-  if (collision_data_) freeResources();
 
-  s32 bpp;
+  //The background is acquired before loading the collision data, that frees the previous one
+  AssetCache& cache = AssetCache::instance();
+  ESAT::SpriteHandle background_sprite = cache.acquire(background);
+  s32 background_width;
+  s32 background_height;
 
-  unsigned char* background_image = stbi_load(background, &original_width_, &original_height_, &bpp, 1);
+  if (!cache.size(background_sprite, &background_width, &background_height)) return kErrorCode_Memory;
 
-  if (!background_image) return kErrorCode_Memory;
+  const s16 status = loadCollision(src);
 
-  unsigned char* image_data = stbi_load(src, &width_, &height_, &bpp, 1);
-
-  if (!image_data) {
-    stbi_image_free(background_image);
-    return kErrorCode_Memory;
+  if (status != kErrorCode_Ok) {
+    cache.release(background_sprite);
+    return status;
   }
 
+  original_width_ = background_width;
+  original_height_ = background_height;
+  ratio_ = Float2(static_cast<float>(original_width_) / width_, static_cast<float>(original_height_) / height_);
+
+  background_ = background_sprite;
+
+  return kErrorCode_Ok;
+}
+
+s16 Map::loadCollision(const char* src)
+{
+  if (!src) return kErrorCode_InvalidPointer;
+  //If there's already data loaded we free it
+  if (collision_data_) freeResources();
+
+  const size_t src_length = strlen(src);
+  const bool text_source = src_length > 4 && strcmp(src + src_length - 4, ".txt") == 0;
+
+  s32 bpp;
+  unsigned char* image_data = text_source ? loadTextCollision(src, &width_, &height_) :
+                                            stbi_load(src, &width_, &height_, &bpp, 1);
+
+  if (!image_data) return text_source ? kErrorCode_File : kErrorCode_Memory;
+
   const int number_of_elements = height_*width_;
   collision_data_ = static_cast<bool*>(malloc(sizeof(bool)*number_of_elements));
+  free_run_ = static_cast<u8*>(malloc(sizeof(u8)*number_of_elements));
+  clearance_ = static_cast<u8*>(malloc(sizeof(u8)*number_of_elements));
 
-  if (!collision_data_) {
-    stbi_image_free(background_image);
-    stbi_image_free(image_data);
+  if (!collision_data_ || !free_run_ || !clearance_) {
+    text_source ? free(image_data) : stbi_image_free(image_data);
+    freeResources();
     return kErrorCode_Memory;
   }
 
@@ -78,19 +397,88 @@ s16 Map::loadMap(const char* src, const char* background)
     const bool result = image_data[i] == 0xff;
     collision_data_[i] = result;
   }
-  ratio_ = Float2(static_cast<float>(original_width_) / width_, static_cast<float>(original_height_) / height_);
-
-  background_ = ESAT::SpriteFromFile(background);
+  computeClearance(0, 0, width_ - 1, height_ - 1);
+  original_width_ = width_;
+  original_height_ = height_;
+  ratio_ = Float2(1.0f, 1.0f);
+  source_ = src;
+  content_hash_dirty_ = true;
 
-  stbi_image_free(background_image);
-  stbi_image_free(image_data);
+  text_source ? free(image_data) : stbi_image_free(image_data);
 
   return kErrorCode_Ok;
+}
+
+unsigned char* Map::loadTextCollision(const char* src, s32* width, s32* height)
+{
+  FILE* file = fopen(src, "rb");
+  if (!file) return nullptr;
+
+  std::vector<std::string> rows;
+  std::string row;
+  s32 c;
+  while ((c = fgetc(file)) != EOF)
+  {
+    if (c == '\n')
+    {
+      rows.push_back(row);
+      row.clear();
+    }
+    else if (c != '\r')
+    {
+      row.push_back(static_cast<char>(c));
+    }
+  }
+  if (!row.empty()) rows.push_back(row);
+  fclose(file);
+
+  if (rows.empty() || rows[0].empty()) return nullptr;
+
+  *width = static_cast<s32>(rows[0].size());
+  *height = static_cast<s32>(rows.size());
+  unsigned char* data = static_cast<unsigned char*>(malloc(*width * *height));
+  if (!data) return nullptr;
+
+  for (s32 y = 0; y < *height; y++)
+  {
+    for (s32 x = 0; x < *width; x++)
+    {
+      const bool free_cell = x < static_cast<s32>(rows[y].size()) && rows[y][x] != '*';
+      data[x + y * *width] = free_cell ? 0xff : 0;
+    }
+  }
+  return data;
+}
+
+const char* Map::source() const
+{
+  return source_.c_str();
+}
+
+u64 Map::contentHash() const
+{
+  if (!content_hash_dirty_) return content_hash_;
+
+  const u64 kFnvPrime = 1099511628211ULL;
+  u64 hash = 14695981039346656037ULL;
+  const s32 header[2] = { width_, height_ };
+  const unsigned char* header_bytes = reinterpret_cast<const unsigned char*>(header);
+  for (size_t i = 0; i < sizeof(header); i++)
+  {
+    hash = (hash ^ header_bytes[i]) * kFnvPrime;
+  }
+  for (s32 i = 0; i < width_ * height_; i++)
+  {
+    hash = (hash ^ (collision_data_[i] ? 1u : 0u)) * kFnvPrime;
+  }
+  content_hash_ = hash;
+  content_hash_dirty_ = false;
+  return content_hash_;
 }
 
 bool Map::isValidPosition(const float x, const float y) const
 {
-  if (x > width_ || x < 0) return false;
-  if (y > height_ || y < 0) return false;
+  if (x >= width_ || x < 0) return false;
+  if (y >= height_ || y < 0) return false;
   return true;
 }
@@ -0,0 +1,111 @@
+// mapped_file.cc
+// Jose Maria Martinez
+// Implementation of the read only memory mapped file class
+//Comments for the functions can be found at the header
+
+#include "mapped_file.h"
+#include "common_def.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+  data_ = nullptr;
+  size_ = 0;
+#ifdef _WIN32
+  file_ = INVALID_HANDLE_VALUE;
+  mapping_ = nullptr;
+#else
+  file_ = -1;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+s16 MappedFile::open(const char* path)
+{
+  if (!path) return kErrorCode_InvalidPointer;
+  close();
+
+#ifdef _WIN32
+  file_ = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                      FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_ == INVALID_HANDLE_VALUE) return kErrorCode_File;
+
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file_, &file_size) || file_size.QuadPart == 0)
+  {
+    close();
+    return kErrorCode_File;
+  }
+  mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping_)
+  {
+    close();
+    return kErrorCode_File;
+  }
+  data_ = static_cast<const u8*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+  if (!data_)
+  {
+    close();
+    return kErrorCode_File;
+  }
+  size_ = static_cast<u64>(file_size.QuadPart);
+#else
+  file_ = ::open(path, O_RDONLY);
+  if (file_ < 0) return kErrorCode_File;
+
+  struct stat file_stat;
+  if (fstat(file_, &file_stat) != 0 || file_stat.st_size == 0)
+  {
+    close();
+    return kErrorCode_File;
+  }
+  void* mapping = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_SHARED, file_, 0);
+  if (mapping == MAP_FAILED)
+  {
+    close();
+    return kErrorCode_File;
+  }
+  data_ = static_cast<const u8*>(mapping);
+  size_ = static_cast<u64>(file_stat.st_size);
+#endif
+  return kErrorCode_Ok;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+  if (data_) UnmapViewOfFile(data_);
+  if (mapping_) CloseHandle(mapping_);
+  if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+  mapping_ = nullptr;
+  file_ = INVALID_HANDLE_VALUE;
+#else
+  if (data_) munmap(const_cast<u8*>(data_), static_cast<size_t>(size_));
+  if (file_ >= 0) ::close(file_);
+  file_ = -1;
+#endif
+  data_ = nullptr;
+  size_ = 0;
+}
+
+const u8* MappedFile::data() const
+{
+  return data_;
+}
+
+u64 MappedFile::size() const
+{
+  return size_;
+}
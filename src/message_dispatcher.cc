@@ -0,0 +1,58 @@
+// message_dispatcher.cc
+// Jose Maria Martinez
+// Implementation of the dispatcher that delivers the messages between agents
+//Comments for the functions can be found at the header
+
+#include "message_dispatcher.h"
+#include "inbox.h"
+#include "common_def.h"
+#include <algorithm>
+
+MessageDispatcher::MessageDispatcher()
+{
+
+}
+
+MessageDispatcher::~MessageDispatcher()
+{
+
+}
+
+s16 MessageDispatcher::post(const AgentMessage& msg, Inbox* recipient, const u32 recipient_id)
+{
+  if (!recipient) return kErrorCode_InvalidPointer;
+  std::lock_guard<std::mutex> lock(mutex_);
+  pending_.push_back(PendingMessage{ recipient, recipient_id, msg });
+  return kErrorCode_Ok;
+}
+
+void MessageDispatcher::deliver(std::vector<u32>* woken)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (pending_.empty()) return;
+
+  //A sender is always updated by one thread, so its messages are already in order
+  std::stable_sort(pending_.begin(), pending_.end(),
+    [](const PendingMessage& a, const PendingMessage& b) { return a.msg.sender < b.msg.sender; });
+
+  retained_.clear();
+  for (const PendingMessage& p : pending_)
+  {
+    if (p.recipient->push(p.msg) != kErrorCode_Ok) retained_.push_back(p);
+    else if (p.recipient_id != 0) woken->push_back(p.recipient_id);
+  }
+  pending_.swap(retained_);
+}
+
+void MessageDispatcher::cancel(const Inbox* recipient)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  pending_.erase(std::remove_if(pending_.begin(), pending_.end(),
+    [recipient](const PendingMessage& p) { return p.recipient == recipient; }), pending_.end());
+}
+
+u32 MessageDispatcher::pending() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<u32>(pending_.size());
+}
@@ -0,0 +1,303 @@
+// moving_target_search.cc
+// Jose Maria Martinez
+// Implementation of the search that follows a moving target reusing what it learned
+//Comments for the functions can be found at the header
+
+#include "moving_target_search.h"
+#include "map.h"
+#include "common_def.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+//Cost of the cells not reached
+static const u32 kUnreached = 0xFFFFFFFF;
+//Heuristics learned by a chase before the lost ones are looked for
+static const size_t kMinPruneSize = 1024;
+
+/** @brief MovingTargetScratch struct
+*
+* Costs of the searches of a thread, shared by all its chasing agents. The
+* cells are stamped with the number of the search instead of being cleared.
+*
+*/
+struct MovingTargetScratch
+{
+  std::vector<u32> g;
+  std::vector<u32> h;
+  std::vector<s32> parent;
+  std::vector<u32> stamp;
+  u32 counter = 0;
+  //Open list of the search as a heap, the best entry first
+  std::vector<AStarOpenEntry> open;
+  //Cells expanded by the current search, the ones that learn from it
+  std::vector<s32> expanded;
+  //Neighbours and heuristic of the searches and the A* of the measures
+  AStar grid;
+  Path baseline_path;
+};
+
+static MovingTargetScratch& ThreadScratch()
+{
+  thread_local MovingTargetScratch scratch;
+  return scratch;
+}
+
+//Prepares the costs of the thread for a new search of a map
+static bool BeginSearch(MovingTargetScratch& scratch, const size_t cells)
+{
+  if (scratch.stamp.size() < cells)
+  {
+    try
+    {
+      scratch.g.resize(cells);
+      scratch.h.resize(cells);
+      scratch.parent.resize(cells);
+      scratch.stamp.resize(cells, 0);
+    }
+    catch (const std::bad_alloc&)
+    {
+      return false;
+    }
+  }
+  if (++scratch.counter == 0)
+  {
+    std::fill(scratch.stamp.begin(), scratch.stamp.end(), 0);
+    scratch.counter = 1;
+  }
+  scratch.open.clear();
+  scratch.expanded.clear();
+  return true;
+}
+
+ChaseStats::ChaseStats()
+{
+  measure_savings = false;
+  reset();
+}
+
+void ChaseStats::add(const MovingTargetReplan& replan)
+{
+  replans += 1;
+  expanded += replan.expanded;
+  if (!replan.measured) return;
+  measured += 1;
+  measured_expanded += replan.expanded;
+  baseline_expanded += replan.baseline_expanded;
+}
+
+void ChaseStats::reset()
+{
+  replans = 0;
+  expanded = 0;
+  measured = 0;
+  measured_expanded = 0;
+  baseline_expanded = 0;
+}
+
+void ChaseStats::print() const
+{
+  const u64 searches = replans;
+  printf("Chase: %llu searches, %.1f expanded per search\n", static_cast<unsigned long long>(searches),
+         searches ? static_cast<double>(expanded) / searches : 0.0);
+  const u64 measured_searches = measured;
+  if (measured_searches == 0) return;
+  const double mean = static_cast<double>(measured_expanded) / measured_searches;
+  const double baseline = static_cast<double>(baseline_expanded) / measured_searches;
+  printf("Chase: %.1f expanded per search against %.1f of the A*, %.1f saved per search (%.1f%%)\n", mean,
+         baseline, baseline - mean, baseline > 0.0 ? (baseline - mean) * 100.0 / baseline : 0.0);
+}
+
+MovingTargetSearch::MovingTargetSearch()
+{
+  map_ = nullptr;
+  width_ = 0;
+  height_ = 0;
+  delta_h_ = 0;
+  prune_size_ = kMinPruneSize;
+  goal_ = -1;
+}
+
+MovingTargetSearch::~MovingTargetSearch()
+{
+
+}
+
+u32 MovingTargetSearch::heuristic(const s32 cell, const AStar& grid) const
+{
+  const u32 octile = grid.octileHeuristic(cell, goal_, width_);
+  const std::unordered_map<s32, u64>::const_iterator learned = learned_.find(cell);
+  if (learned == learned_.end()) return octile;
+  //The target moved since the cell learned, the heuristic loses what the new targets had
+  if (learned->second <= delta_h_) return octile;
+  return std::max(static_cast<u32>(learned->second - delta_h_), octile);
+}
+
+void MovingTargetSearch::learn(const std::vector<u32>& g, const std::vector<s32>& expanded, const u32 cost,
+                               const AStar& grid)
+{
+  //Only the cells expanded are below the cost of the path, the rest keep what they had
+  for (const s32 cell : expanded)
+  {
+    const u32 h = cost - g[cell];
+    if (h > grid.octileHeuristic(cell, goal_, width_)) learned_[cell] = h + delta_h_;
+    else learned_.erase(cell);
+  }
+  if (learned_.size() < prune_size_) return;
+
+  //The heuristics lost never come back, as delta_h_ only grows
+  for (std::unordered_map<s32, u64>::iterator it = learned_.begin(); it != learned_.end();)
+  {
+    if (it->second <= delta_h_) it = learned_.erase(it);
+    else ++it;
+  }
+  prune_size_ = std::max(learned_.size() * 2, kMinPruneSize);
+}
+
+s16 MovingTargetSearch::search(const Float2& origin, const Float2& target, const Map& map, const u8 clearance,
+                               const bool measure_savings)
+{
+  if (&map != map_ || map.width() != width_ || map.height() != height_)
+  {
+    reset();
+    map_ = &map;
+    width_ = map.width();
+    height_ = map.height();
+  }
+  last_replan_ = MovingTargetReplan();
+
+  const Float2 ratio = map.ratio();
+  const s32 start_x = static_cast<s32>(floorf(origin.x / ratio.x));
+  const s32 start_y = static_cast<s32>(floorf(origin.y / ratio.y));
+  const s32 goal_x = static_cast<s32>(floorf(target.x / ratio.x));
+  const s32 goal_y = static_cast<s32>(floorf(target.y / ratio.y));
+  if (map.isBlocked(start_x, start_y, clearance) || map.isBlocked(goal_x, goal_y, clearance))
+  {
+    last_replan_.result = kErrorCode_PathNotFound;
+    return kErrorCode_PathNotFound;
+  }
+  const s32 start = start_x + start_y * width_;
+  const s32 goal = goal_x + goal_y * width_;
+
+  MovingTargetScratch& scratch = ThreadScratch();
+  if (!BeginSearch(scratch, static_cast<size_t>(width_) * height_))
+  {
+    last_replan_.result = kErrorCode_Memory;
+    return kErrorCode_Memory;
+  }
+  const AStar& grid = scratch.grid;
+
+  //When the target moves the next searches lose the heuristic of its new cell
+  if (goal_ != -1 && goal != goal_) delta_h_ += heuristic(goal, grid);
+  goal_ = goal;
+
+  std::vector<AStarOpenEntry>& open = scratch.open;
+  scratch.stamp[start] = scratch.counter;
+  scratch.g[start] = 0;
+  scratch.h[start] = heuristic(start, grid);
+  scratch.parent[start] = -1;
+  open.push_back(AStarOpenEntry{ scratch.h[start], 0, start });
+
+  bool found = false;
+  while (!open.empty())
+  {
+    std::pop_heap(open.begin(), open.end());
+    const AStarOpenEntry current = open.back();
+    open.pop_back();
+    //Entries of cells that were improved after being pushed are discarded
+    if (current.g != scratch.g[current.cell]) continue;
+    if (current.cell == goal)
+    {
+      found = true;
+      break;
+    }
+    scratch.expanded.push_back(current.cell);
+
+    for (s32 i = 0; i < 8; i++)
+    {
+      s32 new_x, new_y;
+      const u32 step_cost = grid.neighbour(current.cell, i, width_, &new_x, &new_y);
+      if (map.isBlocked(new_x, new_y, clearance)) continue;
+
+      const s32 successor = new_x + new_y * width_;
+      const u32 g = current.g + step_cost;
+      if (scratch.stamp[successor] != scratch.counter)
+      {
+        scratch.stamp[successor] = scratch.counter;
+        scratch.g[successor] = kUnreached;
+        scratch.h[successor] = heuristic(successor, grid);
+      }
+      if (g >= scratch.g[successor]) continue;
+      scratch.g[successor] = g;
+      scratch.parent[successor] = current.cell;
+      open.push_back(AStarOpenEntry{ g + scratch.h[successor], g, successor });
+      std::push_heap(open.begin(), open.end());
+    }
+  }
+  last_replan_.expanded = static_cast<u32>(scratch.expanded.size());
+
+  if (measure_savings)
+  {
+    //The hash distributed search with one thread is the A* with the octile heuristic
+    scratch.grid.set_mode(AStarMode::k_HashDistributed);
+    scratch.grid.set_num_threads(1);
+    scratch.grid.set_clearance(clearance);
+    scratch.grid.generatePath(origin, target, &scratch.baseline_path, map);
+    last_replan_.measured = true;
+    last_replan_.baseline_expanded = static_cast<u32>(scratch.grid.lastQuery().expanded);
+  }
+  if (!found)
+  {
+    last_replan_.result = kErrorCode_PathNotFound;
+    return kErrorCode_PathNotFound;
+  }
+
+  const u32 cost = scratch.g[goal];
+  learn(scratch.g, scratch.expanded, cost, grid);
+  last_replan_.cost = cost;
+  last_replan_.result = buildPath(scratch.parent, map);
+  return last_replan_.result;
+}
+
+s16 MovingTargetSearch::buildPath(const std::vector<s32>& parent, const Map& map)
+{
+  std::vector<s32> cells;
+  for (s32 cell = goal_; cell != -1; cell = parent[cell])
+  {
+    cells.push_back(cell);
+  }
+  //The agent replans before reaching the end of a long path, only its start is kept
+  const u16 count = static_cast<u16>(std::min<size_t>(cells.size(), kMaxPoints));
+  const s16 status = path_.create(count);
+  if (status != kErrorCode_Ok) return status;
+  const Float2 ratio = map.ratio();
+  for (u16 i = 0; i < count; ++i)
+  {
+    const s32 cell = cells[cells.size() - 1 - i];
+    path_.addPoint((cell % width_) * ratio.x, (cell / width_) * ratio.y);
+  }
+  path_.set_direction(Direction::kDirForward);
+  return path_.setToReady();
+}
+
+Path* MovingTargetSearch::path()
+{
+  return &path_;
+}
+
+MovingTargetReplan MovingTargetSearch::lastReplan() const
+{
+  return last_replan_;
+}
+
+void MovingTargetSearch::reset()
+{
+  learned_.clear();
+  delta_h_ = 0;
+  prune_size_ = kMinPruneSize;
+  goal_ = -1;
+  map_ = nullptr;
+  //Until the next search there's no path to follow
+  last_replan_ = MovingTargetReplan();
+  last_replan_.result = kErrorCode_PathNotFound;
+}
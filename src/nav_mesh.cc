@@ -0,0 +1,589 @@
+// nav_mesh.cc
+// Jose Maria Martinez
+// Implementation of the navigation mesh built from the collision data of a map
+//Comments for the functions can be found at the header
+
+#include "nav_mesh.h"
+#include "map.h"
+#include "path.h"
+#include "common_def.h"
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <new>
+#include <queue>
+
+static const char kNavMeshMagic[4] = { 'N', 'A', 'V', '1' };
+
+/** @brief NavMeshOpenEntry struct
+*
+* Polygon in the open list of the search, g is the cost it had when it was
+* pushed so the entries of polygons improved later can be discarded
+*
+*/
+struct NavMeshOpenEntry
+{
+  float f;
+  float g;
+  u32 polygon;
+
+  bool operator>(const NavMeshOpenEntry& other) const
+  {
+    return f > other.f;
+  }
+};
+
+/** @brief returns twice the signed area of a triangle
+*
+* Negative when c is at the left of the line from a to b, as seen by the funnel
+*
+* @param a first vertex
+* @param b second vertex
+* @param c third vertex
+* @return float twice the area
+*/
+static float TriArea2(const Float2& a, const Float2& b, const Float2& c)
+{
+  const Float2 ab = b - a;
+  const Float2 ac = c - a;
+  return ac.x * ab.y - ab.x * ac.y;
+}
+
+/** @brief checks if two points are the same
+*
+* @param a first point
+* @param b second point
+* @return bool true if they are closer than a thousandth of a cell
+*/
+static bool SamePoint(const Float2& a, const Float2& b)
+{
+  const Float2 offset = b - a;
+  return offset.x * offset.x + offset.y * offset.y < 0.000001f;
+}
+
+NavMesh::NavMesh()
+{
+  header_ = nullptr;
+  polygons_ = nullptr;
+  links_ = nullptr;
+  row_offsets_ = nullptr;
+  row_polygons_ = nullptr;
+  counter_ = 0;
+  last_expanded_ = 0;
+  logging_ = false;
+}
+
+NavMesh::~NavMesh()
+{
+  unload();
+}
+
+s16 NavMesh::build(const Map& map)
+{
+  unload();
+  const s32 width = map.width();
+  const s32 height = map.height();
+  if (width == 0 || height == 0) return kErrorCode_PathNotCreated;
+  const s32 cells = width * height;
+
+  try
+  {
+    //Polygon of each cell, the cells are covered in row order
+    std::vector<s32> owner(cells, -1);
+    std::vector<NavMeshPolygon> polygons;
+    for (s32 y = 0; y < height; y++)
+    {
+      for (s32 x = 0; x < width; x++)
+      {
+        if (owner[x + y * width] != -1 || map.isBlocked(x, y, 1)) continue;
+
+        s32 polygon_width = 1;
+        while (x + polygon_width < width && owner[x + polygon_width + y * width] == -1 &&
+               !map.isBlocked(x + polygon_width, y, 1))
+        {
+          polygon_width++;
+        }
+        s32 polygon_height = 1;
+        for (bool free_row = true; free_row && y + polygon_height < height;)
+        {
+          const s32 row = y + polygon_height;
+          for (s32 i = 0; i < polygon_width && free_row; i++)
+          {
+            free_row = owner[x + i + row * width] == -1 && !map.isBlocked(x + i, row, 1);
+          }
+          if (free_row) polygon_height++;
+        }
+
+        const s32 polygon = static_cast<s32>(polygons.size());
+        for (s32 row = y; row < y + polygon_height; row++)
+        {
+          std::fill(owner.begin() + x + row * width, owner.begin() + x + polygon_width + row * width, polygon);
+        }
+        polygons.push_back(NavMeshPolygon{ x, y, polygon_width, polygon_height, 0, 0 });
+      }
+    }
+
+    //The links of a side are the stretches of cells of the same neighbour
+    std::vector<NavMeshLink> links;
+    auto add_side = [&](const s32 first_x, const s32 first_y, const s32 step_x, const s32 step_y,
+                        const s32 length, const s32 edge_x, const s32 edge_y)
+    {
+      s32 neighbour = -1;
+      s32 start = 0;
+      for (s32 i = 0; i <= length; i++)
+      {
+        const s32 x = first_x + i * step_x;
+        const s32 y = first_y + i * step_y;
+        const bool inside = i < length && x >= 0 && y >= 0 && x < width && y < height;
+        const s32 current = inside ? owner[x + y * width] : -1;
+        if (current == neighbour) continue;
+        if (neighbour != -1)
+        {
+          links.push_back(NavMeshLink{ static_cast<u32>(neighbour), edge_x + start * step_x, edge_y + start * step_y,
+                                       edge_x + i * step_x, edge_y + i * step_y });
+        }
+        neighbour = current;
+        start = i;
+      }
+    };
+    for (u32 i = 0; i < polygons.size(); i++)
+    {
+      NavMeshPolygon& polygon = polygons[i];
+      polygon.first_link = static_cast<u32>(links.size());
+      add_side(polygon.x, polygon.y - 1, 1, 0, polygon.width, polygon.x, polygon.y);
+      add_side(polygon.x, polygon.y + polygon.height, 1, 0, polygon.width, polygon.x, polygon.y + polygon.height);
+      add_side(polygon.x - 1, polygon.y, 0, 1, polygon.height, polygon.x, polygon.y);
+      add_side(polygon.x + polygon.width, polygon.y, 0, 1, polygon.height, polygon.x + polygon.width, polygon.y);
+      polygon.num_links = static_cast<u32>(links.size()) - polygon.first_link;
+    }
+
+    std::vector<u32> row_offsets(height + 1);
+    std::vector<u32> row_polygons;
+    for (s32 y = 0; y < height; y++)
+    {
+      row_offsets[y] = static_cast<u32>(row_polygons.size());
+      for (s32 x = 0; x < width; x++)
+      {
+        const s32 polygon = owner[x + y * width];
+        if (polygon != -1 && polygons[polygon].x == x) row_polygons.push_back(static_cast<u32>(polygon));
+      }
+    }
+    row_offsets[height] = static_cast<u32>(row_polygons.size());
+
+    NavMeshHeader header;
+    memcpy(header.magic, kNavMeshMagic, sizeof(kNavMeshMagic));
+    header.version = kNavMeshVersion;
+    header.width = width;
+    header.height = height;
+    header.map_hash = map.contentHash();
+    header.num_polygons = static_cast<u32>(polygons.size());
+    header.num_links = static_cast<u32>(links.size());
+    header.num_row_entries = static_cast<u32>(row_polygons.size());
+    header.padding = 0;
+
+    const size_t polygons_size = polygons.size() * sizeof(NavMeshPolygon);
+    const size_t links_size = links.size() * sizeof(NavMeshLink);
+    const size_t offsets_size = row_offsets.size() * sizeof(u32);
+    const size_t entries_size = row_polygons.size() * sizeof(u32);
+    data_.resize(sizeof(header) + polygons_size + links_size + offsets_size + entries_size);
+    u8* data = data_.data();
+    memcpy(data, &header, sizeof(header));
+    data += sizeof(header);
+    if (polygons_size) memcpy(data, polygons.data(), polygons_size);
+    data += polygons_size;
+    if (links_size) memcpy(data, links.data(), links_size);
+    data += links_size;
+    memcpy(data, row_offsets.data(), offsets_size);
+    data += offsets_size;
+    if (entries_size) memcpy(data, row_polygons.data(), entries_size);
+  }
+  catch (const std::bad_alloc&)
+  {
+    unload();
+    return kErrorCode_Memory;
+  }
+
+  attach(data_.data(), data_.size());
+  return kErrorCode_Ok;
+}
+
+s16 NavMesh::save(const char* file) const
+{
+  if (!file) return kErrorCode_InvalidPointer;
+  if (!header_) return kErrorCode_PathNotCreated;
+
+  FILE* output = fopen(file, "wb");
+  if (!output) return kErrorCode_File;
+  bool written = fwrite(data(), 1, static_cast<size_t>(dataSize()), output) == dataSize();
+  written = (fclose(output) == 0) && written;
+  return written ? kErrorCode_Ok : kErrorCode_File;
+}
+
+s16 NavMesh::load(const char* file, const Map& map)
+{
+  if (!file) return kErrorCode_InvalidPointer;
+  unload();
+
+  const s16 status = file_.open(file);
+  if (status != kErrorCode_Ok) return status;
+
+  if (!attach(file_.data(), file_.size()) ||
+      header_->width != map.width() || header_->height != map.height() ||
+      header_->map_hash != map.contentHash())
+  {
+    unload();
+    return kErrorCode_File;
+  }
+  return kErrorCode_Ok;
+}
+
+s16 NavMesh::load(const std::vector<u8>& data, const Map& map)
+{
+  unload();
+  try
+  {
+    data_ = data;
+  }
+  catch (const std::bad_alloc&)
+  {
+    return kErrorCode_Memory;
+  }
+
+  if (!attach(data_.data(), data_.size()) ||
+      header_->width != map.width() || header_->height != map.height() ||
+      header_->map_hash != map.contentHash())
+  {
+    unload();
+    return kErrorCode_File;
+  }
+  return kErrorCode_Ok;
+}
+
+bool NavMesh::attach(const u8* data, const u64 size)
+{
+  if (size < sizeof(NavMeshHeader)) return false;
+  const NavMeshHeader* header = reinterpret_cast<const NavMeshHeader*>(data);
+  if (memcmp(header->magic, kNavMeshMagic, sizeof(kNavMeshMagic)) != 0 ||
+      header->version != kNavMeshVersion || header->width <= 0 || header->height <= 0)
+  {
+    return false;
+  }
+  const u64 expected = sizeof(NavMeshHeader) + static_cast<u64>(header->num_polygons) * sizeof(NavMeshPolygon) +
+                       static_cast<u64>(header->num_links) * sizeof(NavMeshLink) +
+                       (static_cast<u64>(header->height) + 1 + header->num_row_entries) * sizeof(u32);
+  if (size != expected) return false;
+
+  const u8* polygons = data + sizeof(NavMeshHeader);
+  const u8* links = polygons + header->num_polygons * sizeof(NavMeshPolygon);
+  const u32* row_offsets = reinterpret_cast<const u32*>(links + header->num_links * sizeof(NavMeshLink));
+  if (row_offsets[header->height] != header->num_row_entries) return false;
+
+  header_ = header;
+  polygons_ = reinterpret_cast<const NavMeshPolygon*>(polygons);
+  links_ = reinterpret_cast<const NavMeshLink*>(links);
+  row_offsets_ = row_offsets;
+  row_polygons_ = row_offsets + header->height + 1;
+  return true;
+}
+
+void NavMesh::unload()
+{
+  file_.close();
+  data_ = std::vector<u8>();
+  header_ = nullptr;
+  polygons_ = nullptr;
+  links_ = nullptr;
+  row_offsets_ = nullptr;
+  row_polygons_ = nullptr;
+  //The search buffers are sized again for the next mesh
+  search_.clear();
+}
+
+bool NavMesh::isLoaded() const
+{
+  return header_ != nullptr;
+}
+
+u32 NavMesh::numPolygons() const
+{
+  return header_ ? header_->num_polygons : 0;
+}
+
+const u8* NavMesh::data() const
+{
+  if (!header_) return nullptr;
+  return data_.empty() ? file_.data() : data_.data();
+}
+
+u64 NavMesh::dataSize() const
+{
+  if (!header_) return 0;
+  return data_.empty() ? file_.size() : data_.size();
+}
+
+u32 NavMesh::numLinks() const
+{
+  return header_ ? header_->num_links : 0;
+}
+
+s32 NavMesh::polygonAt(const s32 x, const s32 y) const
+{
+  if (!header_ || x < 0 || y < 0 || x >= header_->width || y >= header_->height) return -1;
+
+  //The polygon that covers the cell is the last one of the row that starts before it
+  const u32* first = row_polygons_ + row_offsets_[y];
+  const u32* last = row_polygons_ + row_offsets_[y + 1];
+  const u32* entry = std::upper_bound(first, last, x,
+                                      [this](const s32 column, const u32 polygon) { return column < polygons_[polygon].x; });
+  if (entry == first) return -1;
+  const NavMeshPolygon& polygon = polygons_[*(entry - 1)];
+  return x < polygon.x + polygon.width ? static_cast<s32>(*(entry - 1)) : -1;
+}
+
+void NavMesh::portal(const u32 from, const u32 link, const float offset, Float2* left, Float2* right) const
+{
+  const NavMeshLink& edge = links_[link];
+  const NavMeshPolygon& polygon = polygons_[from];
+  Float2 first;
+  Float2 second;
+  Float2 behind;
+  if (edge.x0 == edge.x1)
+  {
+    const float direction = (polygon.x < edge.x0) ? 1.0f : -1.0f;
+    const float x = edge.x0 + offset * direction;
+    first = Float2(x, edge.y0 + 0.5f);
+    second = Float2(x, edge.y1 - 0.5f);
+    behind = Float2(edge.x0 - direction, edge.y0 + 0.5f);
+  }
+  else
+  {
+    const float direction = (polygon.y < edge.y0) ? 1.0f : -1.0f;
+    const float y = edge.y0 + offset * direction;
+    first = Float2(edge.x0 + 0.5f, y);
+    second = Float2(edge.x1 - 0.5f, y);
+    behind = Float2(edge.x0 + 0.5f, edge.y0 - direction);
+  }
+  //The sides are seen from a cell behind the edge, the center of a thin polygon can be on the portal
+  if (TriArea2(behind, first, second) < 0.0f)
+  {
+    *right = first;
+    *left = second;
+  }
+  else
+  {
+    *right = second;
+    *left = first;
+  }
+}
+
+void NavMesh::pullString(const std::vector<Float2>& portals, std::vector<Float2>* corners) const
+{
+  const s32 num_portals = static_cast<s32>(portals.size() / 2);
+  Float2 apex = portals[0];
+  Float2 funnel_left = portals[0];
+  Float2 funnel_right = portals[1];
+  s32 apex_index = 0;
+  s32 left_index = 0;
+  s32 right_index = 0;
+  corners->push_back(apex);
+
+  for (s32 i = 1; i < num_portals; i++)
+  {
+    const Float2& left = portals[i * 2];
+    const Float2& right = portals[i * 2 + 1];
+
+    //The right side of the funnel closes unless it crosses the left one
+    if (TriArea2(apex, funnel_right, right) <= 0.0f)
+    {
+      if (SamePoint(apex, funnel_right) || TriArea2(apex, funnel_left, right) > 0.0f)
+      {
+        funnel_right = right;
+        right_index = i;
+      }
+      else
+      {
+        //The left side is a corner of the path, the funnel starts again from it
+        apex = funnel_left;
+        apex_index = left_index;
+        corners->push_back(apex);
+        funnel_left = apex;
+        funnel_right = apex;
+        left_index = apex_index;
+        right_index = apex_index;
+        i = apex_index;
+        continue;
+      }
+    }
+
+    if (TriArea2(apex, funnel_left, left) >= 0.0f)
+    {
+      if (SamePoint(apex, funnel_left) || TriArea2(apex, funnel_right, left) < 0.0f)
+      {
+        funnel_left = left;
+        left_index = i;
+      }
+      else
+      {
+        apex = funnel_right;
+        apex_index = right_index;
+        corners->push_back(apex);
+        funnel_left = apex;
+        funnel_right = apex;
+        left_index = apex_index;
+        right_index = apex_index;
+        i = apex_index;
+        continue;
+      }
+    }
+  }
+
+  const Float2& end = portals[portals.size() - 1];
+  if (!SamePoint(corners->back(), end)) corners->push_back(end);
+}
+
+s16 NavMesh::generatePath(Float2 origin, Float2 dst, Path* path, const Map& map)
+{
+  last_expanded_ = 0;
+  if (!header_ || !path) return kErrorCode_PathNotCreated;
+
+  const Float2 ratio = map.ratio();
+  const s32 origin_x = static_cast<s32>(floorf(origin.x / ratio.x));
+  const s32 origin_y = static_cast<s32>(floorf(origin.y / ratio.y));
+  const s32 dst_x = static_cast<s32>(floorf(dst.x / ratio.x));
+  const s32 dst_y = static_cast<s32>(floorf(dst.y / ratio.y));
+
+  const s32 start = polygonAt(origin_x, origin_y);
+  if (start == -1)
+  {
+    if (logging_) printf("Origin not valid.\n");
+    return kErrorCode_InvalidOrigin;
+  }
+  const s32 goal = polygonAt(dst_x, dst_y);
+  if (goal == -1)
+  {
+    if (logging_) printf("Destination not valid.\n");
+    return kErrorCode_InvalidDestination;
+  }
+
+  const u32 num_polygons = header_->num_polygons;
+  //The polygons are stamped with the number of the search instead of being cleared
+  if (search_.size() != num_polygons || counter_ == UINT32_MAX)
+  {
+    try
+    {
+      g_.assign(num_polygons, 0.0f);
+      parent_.assign(num_polygons, 0);
+      parent_link_.assign(num_polygons, 0);
+      search_.assign(num_polygons, 0);
+      entry_.assign(num_polygons, Float2(0.0f, 0.0f));
+    }
+    catch (const std::bad_alloc&)
+    {
+      search_.clear();
+      return kErrorCode_PathNotCreated;
+    }
+    counter_ = 0;
+  }
+  counter_++;
+
+  //The points of the search are the centers of the cells, the path uses their corners as the A*
+  const Float2 start_point(origin_x + 0.5f, origin_y + 0.5f);
+  const Float2 end_point(dst_x + 0.5f, dst_y + 0.5f);
+  std::priority_queue<NavMeshOpenEntry, std::vector<NavMeshOpenEntry>, std::greater<NavMeshOpenEntry>> open;
+  g_[start] = 0.0f;
+  entry_[start] = start_point;
+  search_[start] = counter_;
+  open.push(NavMeshOpenEntry{ (end_point - start_point).Length(), 0.0f, static_cast<u32>(start) });
+
+  bool found = false;
+  while (!open.empty())
+  {
+    const NavMeshOpenEntry current = open.top();
+    open.pop();
+    if (current.g != g_[current.polygon]) continue;
+    if (current.polygon == static_cast<u32>(goal))
+    {
+      found = true;
+      break;
+    }
+    last_expanded_++;
+
+    const NavMeshPolygon& polygon = polygons_[current.polygon];
+    for (u32 link = polygon.first_link; link < polygon.first_link + polygon.num_links; link++)
+    {
+      Float2 left;
+      Float2 right;
+      portal(current.polygon, link, 0.0f, &left, &right);
+      //The polygon is entered by the point of the portal closest to where its parent was entered
+      const Float2& from = entry_[current.polygon];
+      const Float2 entry(std::min(std::max(from.x, std::min(left.x, right.x)), std::max(left.x, right.x)),
+                         std::min(std::max(from.y, std::min(left.y, right.y)), std::max(left.y, right.y)));
+      const float g = current.g + (entry - from).Length();
+
+      const u32 neighbour = links_[link].polygon;
+      if (search_[neighbour] == counter_ && g >= g_[neighbour]) continue;
+      search_[neighbour] = counter_;
+      g_[neighbour] = g;
+      entry_[neighbour] = entry;
+      parent_[neighbour] = current.polygon;
+      parent_link_[neighbour] = link;
+      open.push(NavMeshOpenEntry{ g + (end_point - entry).Length(), g, neighbour });
+    }
+  }
+
+  if (!found)
+  {
+    if (logging_) printf("Path not found.\n");
+    return kErrorCode_PathNotFound;
+  }
+
+  std::vector<u32> chain;
+  for (u32 polygon = static_cast<u32>(goal); polygon != static_cast<u32>(start); polygon = parent_[polygon])
+  {
+    chain.push_back(polygon);
+  }
+  std::vector<Float2> portals;
+  portals.push_back(start_point);
+  portals.push_back(start_point);
+  for (size_t i = chain.size(); i > 0; i--)
+  {
+    const u32 polygon = chain[i - 1];
+    //The link is crossed leaving the centers of the parent and entering the ones of the polygon
+    Float2 left;
+    Float2 right;
+    portal(parent_[polygon], parent_link_[polygon], -0.5f, &left, &right);
+    portals.push_back(left);
+    portals.push_back(right);
+    portal(parent_[polygon], parent_link_[polygon], 0.5f, &left, &right);
+    portals.push_back(left);
+    portals.push_back(right);
+  }
+  portals.push_back(end_point);
+  portals.push_back(end_point);
+
+  std::vector<Float2> corners;
+  pullString(portals, &corners);
+  if (corners.size() > kMaxPoints || path->create(static_cast<u16>(corners.size())) != kErrorCode_Ok)
+  {
+    return kErrorCode_PathNotCreated;
+  }
+  for (const Float2& corner : corners)
+  {
+    path->addPoint((corner.x - 0.5f) * ratio.x, (corner.y - 0.5f) * ratio.y);
+  }
+  path->set_direction(Direction::kDirForward);
+  path->setToReady();
+  return kErrorCode_Ok;
+}
+
+u32 NavMesh::lastExpanded() const
+{
+  return last_expanded_;
+}
+
+void NavMesh::set_logging(bool logging)
+{
+  logging_ = logging;
+}
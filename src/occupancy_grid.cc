@@ -0,0 +1,154 @@
+// occupancy_grid.cc
+// Jose Maria Martinez
+// Implementation of the cells of the collision map occupied by the agents
+//Comments for the functions can be found at the header
+
+#include "occupancy_grid.h"
+#include "agent_store.h"
+#include "map.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+OccupancyGrid::OccupancyGrid()
+{
+  width_ = 0;
+  height_ = 0;
+  ratio_ = Float2(0.0f, 0.0f);
+  last_changes_ = 0;
+}
+
+OccupancyGrid::~OccupancyGrid()
+{
+
+}
+
+void OccupancyGrid::update(const AgentStore& store, const Map& map)
+{
+  last_changes_ = 0;
+  const Float2 ratio = map.ratio();
+  if (map.width() != width_ || map.height() != height_ || ratio.x != ratio_.x || ratio.y != ratio_.y)
+  {
+    width_ = map.width();
+    height_ = map.height();
+    ratio_ = ratio;
+    const size_t cells = static_cast<size_t>(width_) * height_;
+    count_.assign(cells, 0);
+    occupied_.assign((cells + 63) / 64, 0);
+    slot_cell_.assign(slot_cell_.size(), -1);
+  }
+  if (width_ == 0 || height_ == 0 || ratio_.x <= 0.0f || ratio_.y <= 0.0f) return;
+
+  const u32 slots = store.size();
+  if (slot_cell_.size() < slots) slot_cell_.resize(slots, -1);
+  const float inverse_x = 1.0f / ratio_.x;
+  const float inverse_y = 1.0f / ratio_.y;
+  const float* xs = store.xs();
+  const float* ys = store.ys();
+  const float width = static_cast<float>(width_);
+  const float height = static_cast<float>(height_);
+  for (u32 slot = 0; slot < slots; ++slot)
+  {
+    s32 cell = -1;
+    const float x = xs[slot] * inverse_x;
+    const float y = ys[slot] * inverse_y;
+    //The truncation is the floor inside the map, the negative positions are outside
+    if (x >= 0.0f && y >= 0.0f && x < width && y < height && store.isActive(slot))
+    {
+      cell = static_cast<s32>(x) + static_cast<s32>(y) * width_;
+    }
+    //Most of the agents stay in their cell, those don't write anything
+    if (cell == slot_cell_[slot]) continue;
+    if (slot_cell_[slot] != -1) remove(slot_cell_[slot]);
+    if (cell != -1) add(cell);
+    slot_cell_[slot] = cell;
+    last_changes_++;
+  }
+}
+
+void OccupancyGrid::clear()
+{
+  std::fill(count_.begin(), count_.end(), 0);
+  std::fill(occupied_.begin(), occupied_.end(), 0);
+  std::fill(slot_cell_.begin(), slot_cell_.end(), -1);
+  last_changes_ = 0;
+}
+
+bool OccupancyGrid::isOccupied(const s32 x, const s32 y) const
+{
+  if (x < 0 || y < 0 || x >= width_ || y >= height_) return false;
+  const u32 cell = static_cast<u32>(x + y * width_);
+  return (occupied_[cell >> 6] >> (cell & 63)) & 1;
+}
+
+u16 OccupancyGrid::count(const s32 x, const s32 y) const
+{
+  if (x < 0 || y < 0 || x >= width_ || y >= height_) return 0;
+  return count_[x + y * width_];
+}
+
+bool OccupancyGrid::findFreePosition(const Map& map, const Float2& position, const u8 clearance, const s32 radius,
+                                     Float2* free_position) const
+{
+  if (!free_position || width_ == 0 || height_ == 0 || ratio_.x <= 0.0f || ratio_.y <= 0.0f) return false;
+  const s32 center_x = static_cast<s32>(floorf(position.x / ratio_.x));
+  const s32 center_y = static_cast<s32>(floorf(position.y / ratio_.y));
+
+  for (s32 ring = 0; ring <= radius; ++ring)
+  {
+    //The closest cell of the ring to the position wins, the ring is small so it's walked whole
+    bool found = false;
+    float best_distance = 0.0f;
+    s32 best_x = 0;
+    s32 best_y = 0;
+    for (s32 y = center_y - ring; y <= center_y + ring; ++y)
+    {
+      //Only the border of the ring, the inner cells were looked at by the previous rings
+      const bool border_row = (y == center_y - ring || y == center_y + ring);
+      const s32 step = border_row ? 1 : std::max(2 * ring, 1);
+      for (s32 x = center_x - ring; x <= center_x + ring; x += step)
+      {
+        if (!isFree(map, x, y, clearance)) continue;
+        const Float2 center((x + 0.5f) * ratio_.x, (y + 0.5f) * ratio_.y);
+        const Float2 offset = center - position;
+        const float distance = offset.DotProduct(offset);
+        if (!found || distance < best_distance)
+        {
+          found = true;
+          best_distance = distance;
+          best_x = x;
+          best_y = y;
+        }
+      }
+    }
+    if (found)
+    {
+      *free_position = Float2((best_x + 0.5f) * ratio_.x, (best_y + 0.5f) * ratio_.y);
+      return true;
+    }
+  }
+  return false;
+}
+
+u32 OccupancyGrid::lastChanges() const
+{
+  return last_changes_;
+}
+
+void OccupancyGrid::add(const s32 cell)
+{
+  //A counter that saturates keeps its cell occupied for good
+  if (count_[cell] == UINT16_MAX) return;
+  if (count_[cell]++ == 0) occupied_[cell >> 6] |= static_cast<u64>(1) << (cell & 63);
+}
+
+void OccupancyGrid::remove(const s32 cell)
+{
+  if (count_[cell] == 0 || count_[cell] == UINT16_MAX) return;
+  if (--count_[cell] == 0) occupied_[cell >> 6] &= ~(static_cast<u64>(1) << (cell & 63));
+}
+
+bool OccupancyGrid::isFree(const Map& map, const s32 x, const s32 y, const u8 clearance) const
+{
+  return !map.isBlocked(x, y, clearance) && !isOccupied(x, y);
+}
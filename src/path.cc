@@ -172,4 +172,10 @@ Float2 const* Path::lastPoint()
 {
   if (!isReady())return nullptr;
   return points_ + lp_index_;
+}
+
+Float2 const* Path::pointAt(u16 index) const
+{
+  if (!ready_ || static_cast<s16>(index) > lp_index_) return nullptr;
+  return points_ + index;
 }
\ No newline at end of file
@@ -7,33 +7,480 @@
 #include "path.h"
 #include "common_def.h"
 #include "gamestate.h"
+#include "profiler.h"
+#include <ESAT/time.h>
+#include <algorithm>
+#include <cmath>
+#include <string>
 
-PathFinder::PathFinder()
+//Name of the navigation meshes in the store
+static const char* kNavMeshLayer = "navmesh";
+
+PathFinder::PathFinder() : PathFinder(&GameState::instance())
+{
+
+}
+
+PathFinder::PathFinder(World* world)
 {
+  world_ = world;
   a_star_ = new AStar();
+  backend_ = PathBackend::k_AStar;
+  dynamic_obstacles_ = DynamicObstacles::k_Ignore;
+  use_zones_ = false;
+  logging_ = false;
+  cpd_ = new CompressedPathDatabase();
+  cpd_map_hash_ = 0;
+  cpd_checked_ = false;
+  nav_mesh_ = new NavMesh();
+  nav_mesh_map_hash_ = 0;
+  nav_mesh_checked_ = false;
+  store_ = nullptr;
   id_ = 0;
   actual_state_ = PFAgentState::k_Waiting;
   initialized_ = false;
-  requestor_ = -1;
+  next_order_ = 0;
 }
 
 PathFinder::~PathFinder()
 {
+  //The handles still waiting are cancelled, their paths are never calculated
+  std::vector<PathRequest> requests;
+  {
+    std::lock_guard<std::mutex> lock(requested_mutex_);
+    requests.swap(requested_);
+  }
+  requests.insert(requests.end(), pending_.begin(), pending_.end());
+  if (actual_state_ == PFAgentState::k_Calculating) requests.push_back(active_);
+  for (const PathRequest& request : requests)
+  {
+    if (request.handle) answer(request, AgentMessageType::k_CancelPath);
+  }
+  for (const std::shared_ptr<PathHandleState>& handle : finished_handles_) handle->resume();
+  world_->dispatcher_.cancel(&inbox_);
   delete(a_star_);
+  delete(cpd_);
+  delete(nav_mesh_);
 }
 
 
-s16 PathFinder::generatePath(/*origin, dest, */ Path* path, Float2 origin, Float2 dst, u32 timeout)
+s16 PathFinder::generatePath(/*origin, dest, */ Path* path, Float2 origin, Float2 dst, u32 timeout, u8 clearance)
+{
+  //The A* and ESAT::Time work in ms too
+  return calculatePath(path, origin, dst, clearance, static_cast<double>(timeout));
+}
+
+s16 PathFinder::generatePath(/*origin, dest, */ Path* path, Float2 origin, Float2 dst, u8 clearance)
+{
+  return calculatePath(path, origin, dst, clearance, -1.0);
+}
+
+s16 PathFinder::set_mode(AStarMode mode)
+{
+  return a_star_->set_mode(mode);
+}
+
+s16 PathFinder::set_backend(PathBackend backend)
+{
+  if (actual_state_ == PFAgentState::k_Calculating) return kErrorCode_Timeout;
+  backend_ = backend;
+  return kErrorCode_Ok;
+}
+
+s16 PathFinder::set_dynamic_obstacles(DynamicObstacles mode, u16 extra_cost)
+{
+  if (actual_state_ == PFAgentState::k_Calculating) return kErrorCode_Timeout;
+  const s16 result = a_star_->set_dynamic_obstacles(&world_->occupancy_, mode, extra_cost);
+  if (result == kErrorCode_Ok) dynamic_obstacles_ = mode;
+  return result;
+}
+
+s16 PathFinder::set_use_zones(bool use_zones)
+{
+  if (actual_state_ == PFAgentState::k_Calculating) return kErrorCode_Timeout;
+  use_zones_ = use_zones;
+  return kErrorCode_Ok;
+}
+
+s16 PathFinder::set_store(PathStore* store)
+{
+  if (actual_state_ == PFAgentState::k_Calculating) return kErrorCode_Timeout;
+  store_ = store;
+  return kErrorCode_Ok;
+}
+
+const PathStats& PathFinder::stats() const
+{
+  return stats_;
+}
+
+void PathFinder::resetStats()
+{
+  stats_.reset();
+}
+
+void PathFinder::set_logging(bool logging)
+{
+  logging_ = logging;
+  a_star_->set_logging(logging);
+  cpd_->set_logging(logging);
+  nav_mesh_->set_logging(logging);
+}
+
+PathHandle PathFinder::requestPath(const Float2& origin, const Float2& dst, const PathRequestOptions& options)
+{
+  std::shared_ptr<PathHandleState> handle = std::make_shared<PathHandleState>();
+  handle->path = options.path ? options.path : &handle->own_path;
+
+  PathRequest request;
+  request.requester = options.requester;
+  request.priority = options.priority;
+  request.deadline = options.deadline ? world_->game_time_ + options.deadline : 0;
+  request.origin = origin;
+  request.dst = dst;
+  request.path = handle->path;
+  request.clearance = options.clearance;
+  request.handle = handle;
+  {
+    std::lock_guard<std::mutex> lock(requested_mutex_);
+    requested_.push_back(request);
+  }
+  return PathHandle(handle);
+}
+
+u32 PathFinder::cancelRequests(const u32 requester)
+{
+  u32 removed = 0;
+  if (actual_state_ == PFAgentState::k_Calculating && active_.requester == requester)
+  {
+    const PathRequest cancelled = active_;
+    abandonActive();
+    answer(cancelled, AgentMessageType::k_CancelPath);
+    removed++;
+  }
+  for (size_t i = 0; i < pending_.size();)
+  {
+    if (pending_[i].requester == requester)
+    {
+      answer(pending_[i], AgentMessageType::k_CancelPath);
+      pending_[i] = pending_.back();
+      pending_.pop_back();
+      removed++;
+    }
+    else
+    {
+      ++i;
+    }
+  }
+  //Requests of requestPath that haven't reached pending_, 0 is not an agent
+  if (requester != 0)
+  {
+    std::lock_guard<std::mutex> lock(requested_mutex_);
+    for (size_t i = 0; i < requested_.size();)
+    {
+      if (requested_[i].requester == requester)
+      {
+        answer(requested_[i], AgentMessageType::k_CancelPath);
+        requested_.erase(requested_.begin() + i);
+        removed++;
+      }
+      else
+      {
+        ++i;
+      }
+    }
+  }
+  request_counters_.cancelled += removed;
+  return removed;
+}
+
+u32 PathFinder::pendingRequests() const
+{
+  return static_cast<u32>(pending_.size());
+}
+
+const PathRequestCounters& PathFinder::requestCounters() const
+{
+  return request_counters_;
+}
+
+void PathFinder::schedule(PathRequest request)
+{
+  //The agent may have been destroyed while the request was on its way
+  if (request.requester != 0 && !world_->agent(request.requester))
+  {
+    answer(request, AgentMessageType::k_CancelPath);
+    request_counters_.dropped++;
+    return;
+  }
+  request_counters_.received++;
+
+  if (request.requester != 0)
+  {
+    if (actual_state_ == PFAgentState::k_Calculating && active_.requester == request.requester)
+    {
+      const PathRequest superseded = active_;
+      abandonActive();
+      answer(superseded, AgentMessageType::k_CancelPath);
+      request_counters_.superseded++;
+    }
+    for (PathRequest& old : pending_)
+    {
+      if (old.requester != request.requester) continue;
+      //The new request takes the place of the old one
+      answer(old, AgentMessageType::k_CancelPath);
+      old = pending_.back();
+      pending_.pop_back();
+      request_counters_.superseded++;
+      break;
+    }
+  }
+
+  request.order = next_order_++;
+  pending_.push_back(request);
+}
+
+void PathFinder::dropAbandonedHandles()
+{
+  //Nobody can read a path kept by the handle once every handle is destroyed
+  auto abandoned = [](const PathRequest& request)
+  {
+    return request.handle && (request.handle->cancelled.load() ||
+                              (request.handle.use_count() == 1 && request.path == &request.handle->own_path));
+  };
+  if (actual_state_ == PFAgentState::k_Calculating && abandoned(active_))
+  {
+    const PathRequest cancelled = active_;
+    abandonActive();
+    answer(cancelled, AgentMessageType::k_CancelPath);
+    request_counters_.cancelled++;
+  }
+  for (size_t i = 0; i < pending_.size();)
+  {
+    if (abandoned(pending_[i]))
+    {
+      answer(pending_[i], AgentMessageType::k_CancelPath);
+      pending_[i] = pending_.back();
+      pending_.pop_back();
+      request_counters_.cancelled++;
+    }
+    else
+    {
+      ++i;
+    }
+  }
+}
+
+void PathFinder::expireRequests(const u32 now)
+{
+  if (actual_state_ == PFAgentState::k_Calculating && active_.deadline && now >= active_.deadline)
+  {
+    const PathRequest expired = active_;
+    abandonActive();
+    answer(expired, AgentMessageType::k_PathExpired);
+    request_counters_.expired++;
+  }
+  for (size_t i = 0; i < pending_.size();)
+  {
+    if (pending_[i].deadline && now >= pending_[i].deadline)
+    {
+      answer(pending_[i], AgentMessageType::k_PathExpired);
+      request_counters_.expired++;
+      pending_[i] = pending_.back();
+      pending_.pop_back();
+    }
+    else
+    {
+      ++i;
+    }
+  }
+}
+
+bool PathFinder::startNextRequest()
+{
+  if (pending_.empty()) return false;
+  //The requests without deadline go after the ones with any deadline
+  auto more_urgent = [](const PathRequest& a, const PathRequest& b)
+  {
+    if (a.priority != b.priority) return a.priority > b.priority;
+    const u32 deadline_a = a.deadline ? a.deadline : UINT32_MAX;
+    const u32 deadline_b = b.deadline ? b.deadline : UINT32_MAX;
+    if (deadline_a != deadline_b) return deadline_a < deadline_b;
+    return a.order < b.order;
+  };
+  const auto next = std::min_element(pending_.begin(), pending_.end(), more_urgent);
+  active_ = *next;
+  *next = pending_.back();
+  pending_.pop_back();
+  actual_state_ = PFAgentState::k_Calculating;
+  if (active_.handle) active_.handle->status.store(PathHandleStatus::k_Calculating);
+  return true;
+}
+
+void PathFinder::abandonActive()
 {
-  double t = static_cast<double>(timeout) / 1000;  
-  return a_star_->generatePath(origin, dst, path, GameState::instance().map_, t);
+  a_star_->cancel();
+  active_ = PathRequest();
+  actual_state_ = PFAgentState::k_Waiting;
+}
 
+void PathFinder::answer(const PathRequest& request, const AgentMessageType type)
+{
+  if (request.handle)
+  {
+    PathHandleStatus status = PathHandleStatus::k_Cancelled;
+    if (type == AgentMessageType::k_PathIsReady) status = PathHandleStatus::k_Ready;
+    else if (type == AgentMessageType::k_PathNotFound) status = PathHandleStatus::k_NotFound;
+    else if (type == AgentMessageType::k_PathExpired) status = PathHandleStatus::k_Expired;
+    request.handle->finish(status);
+    finished_handles_.push_back(request.handle);
+    return;
+  }
+  if (type == AgentMessageType::k_CancelPath) return;
+  Agent* requester = world_->agent(request.requester);
+  if (!requester)
+  {
+    request_counters_.dropped++;
+    return;
+  }
+  AgentMessage msg;
+  msg.type = type;
+  msg.position = Float2(0.0f, 0.0f);
+  msg.path = nullptr;
+  msg.request = request.request;
+  requester->sendMessage(msg, id_);
+}
+
+void PathFinder::prepareZoneCorridor(const Float2& origin, const Float2& dst, u8 clearance)
+{
+  if (a_star_->isCalculating()) return;
+  const Map& map = world_->map();
+  const ZoneGraph& zones = map.zones();
+  //The zones are built for agents of one cell
+  if (!use_zones_ || clearance > 1 || !zones.isBuilt())
+  {
+    a_star_->set_zone_corridor(nullptr);
+    return;
+  }
+  const Float2 ratio = map.ratio();
+  const s32 origin_x = static_cast<s32>(floorf(origin.x / ratio.x));
+  const s32 origin_y = static_cast<s32>(floorf(origin.y / ratio.y));
+  const s32 dst_x = static_cast<s32>(floorf(dst.x / ratio.x));
+  const s32 dst_y = static_cast<s32>(floorf(dst.y / ratio.y));
+  //The A* reports the invalid origins and destinations itself
+  if (origin_x < 0 || origin_y < 0 || origin_x >= map.width() || origin_y >= map.height() ||
+      dst_x < 0 || dst_y < 0 || dst_x >= map.width() || dst_y >= map.height() ||
+      zones.findCorridor(origin_x + origin_y * map.width(), dst_x + dst_y * map.width(), &zone_corridor_) != kErrorCode_Ok)
+  {
+    a_star_->set_zone_corridor(nullptr);
+    return;
+  }
+  a_star_->set_zone_corridor(&zone_corridor_);
 }
 
-s16 PathFinder::generatePath(/*origin, dest, */ Path* path, Float2 origin, Float2 dst)
+bool PathFinder::useNavMesh(const Map& map, u8 clearance)
 {
-  return a_star_->generatePath(origin, dst, path, GameState::instance().map_);
+  //The mesh is made for agents of one cell and doesn't know about the agents
+  if (backend_ != PathBackend::k_NavMesh || clearance > 1) return false;
+  if (dynamic_obstacles_ != DynamicObstacles::k_Ignore) return false;
 
+  const u64 map_hash = map.contentHash();
+  if (!nav_mesh_checked_ || map_hash != nav_mesh_map_hash_)
+  {
+    const std::string file = std::string(map.source()) + ".nav";
+    std::vector<u8> layer;
+    bool loaded = nav_mesh_->load(file.c_str(), map) == kErrorCode_Ok;
+    if (!loaded && store_ && store_->findLayer(map_hash, kNavMeshLayer, &layer) == kErrorCode_Ok)
+    {
+      loaded = nav_mesh_->load(layer, map) == kErrorCode_Ok;
+    }
+    if (!loaded && nav_mesh_->build(map) == kErrorCode_Ok)
+    {
+      //The next runs take the mesh from the store instead of building it
+      if (store_) store_->storeLayer(map_hash, kNavMeshLayer, nav_mesh_->data(), nav_mesh_->dataSize());
+    }
+    else if (!loaded && logging_)
+    {
+      printf("Unable to build the navigation mesh of the map, using the A*.\n");
+    }
+    nav_mesh_map_hash_ = map_hash;
+    nav_mesh_checked_ = true;
+  }
+  return nav_mesh_->isLoaded();
+}
+
+s16 PathFinder::calculatePath(Path* path, const Float2& origin, const Float2& dst, u8 clearance, double timeout)
+{
+  if (useDatabase(world_->map(), clearance))
+  {
+    const double start_time = ESAT::Time();
+    PathQueryStats query;
+    query.result = cpd_->generatePath(origin, dst, path, world_->map());
+    query.latency_ms = ESAT::Time() - start_time;
+    stats_.add(query);
+    return query.result;
+  }
+  //A search that timed out continues, its route was already looked for
+  if (!a_star_->isCalculating() && findStoredPath(path, origin, dst, clearance)) return kErrorCode_Ok;
+  if (useNavMesh(world_->map(), clearance))
+  {
+    const double start_time = ESAT::Time();
+    PathQueryStats query;
+    query.result = nav_mesh_->generatePath(origin, dst, path, world_->map());
+    query.latency_ms = ESAT::Time() - start_time;
+    query.expanded = nav_mesh_->lastExpanded();
+    stats_.add(query);
+    return query.result;
+  }
+  a_star_->set_clearance(clearance);
+  prepareZoneCorridor(origin, dst, clearance);
+  const s16 result = timeout < 0.0 ? a_star_->generatePath(origin, dst, path, world_->map()) :
+                                     a_star_->generatePath(origin, dst, path, world_->map(), timeout);
+  if (result != kErrorCode_Timeout) stats_.add(a_star_->lastQuery());
+  if (result == kErrorCode_Ok) recordStoredPath(*path, origin, dst, clearance);
+  return result;
+}
+
+bool PathFinder::findStoredPath(Path* path, const Float2& origin, const Float2& dst, u8 clearance)
+{
+  //Only the paths every search of the map would give are stored
+  if (!store_ || clearance > 1 || dynamic_obstacles_ != DynamicObstacles::k_Ignore) return false;
+
+  const double start_time = ESAT::Time();
+  if (store_->findPath(world_->map(), origin, dst, path) != kErrorCode_Ok) return false;
+  PathQueryStats query;
+  query.result = kErrorCode_Ok;
+  query.latency_ms = ESAT::Time() - start_time;
+  stats_.add(query);
+  return true;
+}
+
+void PathFinder::recordStoredPath(const Path& path, const Float2& origin, const Float2& dst, u8 clearance)
+{
+  if (!store_ || clearance > 1 || dynamic_obstacles_ != DynamicObstacles::k_Ignore) return;
+  //The store serves the paths to every later search, so it only takes the shortest ones
+  if (a_star_->mode() == AStarMode::k_CoarseToFine || a_star_->zoneCorridor()) return;
+  store_->recordPath(world_->map(), origin, dst, path);
+}
+
+bool PathFinder::useDatabase(const Map& map, u8 clearance)
+{
+  //The database only stores paths for agents of one cell
+  if (backend_ != PathBackend::k_CompressedPathDatabase || clearance > 1) return false;
+  if (dynamic_obstacles_ != DynamicObstacles::k_Ignore) return false;
+
+  const u64 map_hash = map.contentHash();
+  if (!cpd_checked_ || map_hash != cpd_map_hash_)
+  {
+    const std::string file = std::string(map.source()) + ".cpd";
+    if (cpd_->load(file.c_str(), map) != kErrorCode_Ok && logging_)
+    {
+      printf("No path database for the map, using the A*.\n");
+    }
+    cpd_map_hash_ = map_hash;
+    cpd_checked_ = true;
+  }
+  return cpd_->isLoaded();
 }
 
 void PathFinder::update(const u32 dt)
@@ -49,60 +496,77 @@ void PathFinder::updateBody(const u32 dt)
 
 void PathFinder::updateMind(const u32 dt)
 {
+  PROFILE_ZONE("PathFinder::updateMind");
   if(!initialized_)
   {
-    num_agents_ = GameState::instance().num_agents_;
-    mail_box_ = static_cast<AgentMessage*>(malloc(num_agents_ * sizeof(AgentMessage)));
-    for (uint32_t i = 0; i < num_agents_; i++)
-    {
-      (mail_box_ + i)->type = AgentMessageType::k_Nothing;
-      (mail_box_ + i)->position = Float2(0.0f, 0.0f);
-    }
     initialized_ = true;
   }
 
-  if(actual_state_ == PFAgentState::k_Waiting)
+  //Every message is read so the cancellations are seen while a path is calculated
+  AgentMessage msg;
+  while(inbox_.pop(&msg))
   {
-    for (uint32_t i = 0; i < num_agents_; i++)
+    if(msg.type == AgentMessageType::k_AskForPath)
     {
-      if((mail_box_ + i)->type == AgentMessageType::k_AskForPath)
-      {
-        requestor_ = i;
-        actual_state_ = PFAgentState::k_Calculating;
-        origin_ = (mail_box_ + i)->position;
-        dst_ = (mail_box_ + i)->dst;
-        path_ = (mail_box_ + i)->path;
-        (mail_box_ + i)->type = AgentMessageType::k_Nothing;
-        (mail_box_ + i)->position = Float2(0.0f, 0.0f);
-        break;
-      }
+      PathRequest request;
+      request.requester = msg.sender;
+      request.request = msg.request;
+      request.priority = msg.priority;
+      request.deadline = msg.deadline;
+      request.origin = msg.position;
+      request.dst = msg.dst;
+      request.path = msg.path;
+      request.clearance = msg.clearance;
+      schedule(request);
+    }
+    else if(msg.type == AgentMessageType::k_CancelPath)
+    {
+      cancelRequests(msg.sender);
     }
   }
+  std::vector<PathRequest> requested;
+  {
+    std::lock_guard<std::mutex> lock(requested_mutex_);
+    requested.swap(requested_);
+  }
+  for (const PathRequest& request : requested)
+  {
+    schedule(request);
+  }
+  dropAbandonedHandles();
+  expireRequests(world_->game_time_);
+
+  //Requests are calculated one at a time, the rest wait in pending_
+  if(actual_state_ == PFAgentState::k_Waiting)
+  {
+    startNextRequest();
+  }
   if(actual_state_ == PFAgentState::k_Calculating)
   {
-    const s32 status = generatePath(path_, origin_, dst_, dt);
-    if(status == kErrorCode_Ok)
+    const s32 status = generatePath(active_.path, active_.origin, active_.dst, dt, active_.clearance);
+    if(status != kErrorCode_Timeout)
     {
-      AgentMessage msg;
-      msg.type = AgentMessageType::k_PathIsReady;
-      msg.position = Float2(0.0f, 0.0f);
-      msg.path = nullptr;
-      GameState::instance().agents_[requestor_ - 1]->sendMessage(msg, id_);
-      actual_state_ = PFAgentState::k_Waiting;
-    }else if(status != kErrorCode_Timeout)
-    {
-      AgentMessage msg;
-      msg.type = AgentMessageType::k_PathNotFound;
-      msg.position = Float2(0.0f, 0.0f);
-      msg.path = nullptr;
-      GameState::instance().agents_[requestor_ - 1]->sendMessage(msg, id_);
+      answer(active_, status == kErrorCode_Ok ? AgentMessageType::k_PathIsReady : AgentMessageType::k_PathNotFound);
+      request_counters_.answered++;
+      active_ = PathRequest();
       actual_state_ = PFAgentState::k_Waiting;
     }
   }
+
+  //The coroutines may ask for other paths, they are resumed once the requests aren't used
+  std::vector<std::shared_ptr<PathHandleState>> finished;
+  finished.swap(finished_handles_);
+  for (const std::shared_ptr<PathHandleState>& handle : finished)
+  {
+    handle->resume();
+  }
 }
 
 void PathFinder::sendMessage(const AgentMessage msg, const u32 id)
 {
-  *(mail_box_ + id) = msg;
+  AgentMessage sent = msg;
+  sent.sender = id;
+  //The pathfinder is updated every tick, it doesn't need to be woken up
+  world_->dispatcher_.post(sent, &inbox_, 0);
 }
 
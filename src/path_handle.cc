@@ -0,0 +1,103 @@
+// path_handle.cc
+// Jose Maria Martinez
+// Implementation of the handle of a path requested to the path finder
+//Comments for the functions can be found at the header
+
+#include "path_handle.h"
+
+static bool IsFinished(const PathHandleStatus status)
+{
+  return status != PathHandleStatus::k_Pending && status != PathHandleStatus::k_Calculating;
+}
+
+PathHandleState::PathHandleState()
+{
+  status.store(PathHandleStatus::k_Pending);
+  cancelled.store(false);
+}
+
+void PathHandleState::finish(const PathHandleStatus result)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  status.store(result);
+}
+
+void PathHandleState::resume()
+{
+#ifdef PATH_HANDLE_COROUTINES
+  std::coroutine_handle<> coroutine;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!IsFinished(status.load())) return;
+    coroutine = waiting;
+    waiting = nullptr;
+  }
+  if (coroutine) coroutine.resume();
+#endif
+}
+
+PathHandle::PathHandle()
+{
+
+}
+
+PathHandle::PathHandle(const std::shared_ptr<PathHandleState>& state)
+{
+  state_ = state;
+}
+
+bool PathHandle::valid() const
+{
+  return state_ != nullptr;
+}
+
+PathHandleStatus PathHandle::poll() const
+{
+  if (!state_) return PathHandleStatus::k_Cancelled;
+  const PathHandleStatus status = state_->status.load();
+  if (!IsFinished(status) && state_->cancelled.load()) return PathHandleStatus::k_Cancelled;
+  return status;
+}
+
+bool PathHandle::ready() const
+{
+  return IsFinished(poll());
+}
+
+void PathHandle::cancel()
+{
+  if (state_) state_->cancelled.store(true);
+}
+
+Path* PathHandle::path() const
+{
+  return poll() == PathHandleStatus::k_Ready ? state_->path : nullptr;
+}
+
+#ifdef PATH_HANDLE_COROUTINES
+bool PathHandle::PathAwaiter::await_ready() const
+{
+  return !state || IsFinished(state->status.load());
+}
+
+bool PathHandle::PathAwaiter::await_suspend(std::coroutine_handle<> coroutine)
+{
+  std::lock_guard<std::mutex> lock(state->mutex);
+  //It may have finished since await_ready
+  if (IsFinished(state->status.load())) return false;
+  state->waiting = coroutine;
+  return true;
+}
+
+PathHandleStatus PathHandle::PathAwaiter::await_resume() const
+{
+  return state ? state->status.load() : PathHandleStatus::k_Cancelled;
+}
+
+PathHandle::PathAwaiter PathHandle::operator co_await() const
+{
+  PathAwaiter awaiter;
+  awaiter.state = state_;
+  return awaiter;
+}
+#endif
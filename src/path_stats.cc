@@ -0,0 +1,228 @@
+// path_stats.cc
+// Jose Maria Martinez
+// Implementation of the statistics of the paths calculated
+//Comments for the functions can be found at the header
+
+#include "path_stats.h"
+#include "common_def.h"
+#include <algorithm>
+#include <cstdio>
+
+static const u32 kPercentiles[3] = { 50, 90, 99 };
+
+void PathStatsHistogram::add(const u64 value)
+{
+  u32 bucket = 0;
+  while (bucket < kPathStatsBuckets - 1 && (value >> bucket) != 0) bucket++;
+  buckets[bucket]++;
+  count++;
+  total += value;
+  max = std::max(max, value);
+}
+
+void PathStatsHistogram::merge(const PathStatsHistogram& other)
+{
+  for (u32 i = 0; i < kPathStatsBuckets; ++i) buckets[i] += other.buckets[i];
+  count += other.count;
+  total += other.total;
+  max = std::max(max, other.max);
+}
+
+u64 PathStatsHistogram::percentile(const u32 percentile) const
+{
+  if (count == 0) return 0;
+  //Nearest rank, the smallest value with at least percentile % of the values up to it
+  u64 rank = (count * percentile + 99) / 100;
+  if (rank > 0) rank--;
+  u64 accumulated = 0;
+  for (u32 i = 0; i < kPathStatsBuckets; ++i)
+  {
+    accumulated += buckets[i];
+    if (rank < accumulated)
+    {
+      //The last bucket has no upper limit
+      if (i == kPathStatsBuckets - 1) return max;
+      return std::min(max, (static_cast<u64>(1) << i) - 1);
+    }
+  }
+  return max;
+}
+
+double PathStatsHistogram::mean() const
+{
+  return count ? static_cast<double>(total) / count : 0.0;
+}
+
+PathStats::PathStats()
+{
+  reset();
+}
+
+void PathStats::add(const PathQueryStats& query)
+{
+  queries_++;
+  const s32 index = -query.result;
+  if (index >= 0 && index < static_cast<s32>(kPathStatsResults)) results_[index]++;
+
+  histograms_[static_cast<u32>(PathStatsMetric::k_Expanded)].add(query.expanded);
+  histograms_[static_cast<u32>(PathStatsMetric::k_Generated)].add(query.generated);
+  histograms_[static_cast<u32>(PathStatsMetric::k_Duplicates)].add(query.duplicates);
+  histograms_[static_cast<u32>(PathStatsMetric::k_Reopened)].add(query.reopened);
+  histograms_[static_cast<u32>(PathStatsMetric::k_PeakOpen)].add(query.peak_open);
+  histograms_[static_cast<u32>(PathStatsMetric::k_LatencyUs)].add(static_cast<u64>(query.latency_ms * 1000.0));
+}
+
+void PathStats::merge(const PathStats& other)
+{
+  queries_ += other.queries_;
+  for (u32 i = 0; i < kPathStatsResults; ++i) results_[i] += other.results_[i];
+  for (u32 i = 0; i < static_cast<u32>(PathStatsMetric::k_Count); ++i) histograms_[i].merge(other.histograms_[i]);
+}
+
+void PathStats::reset()
+{
+  queries_ = 0;
+  std::fill(results_, results_ + kPathStatsResults, 0);
+  for (PathStatsHistogram& histogram : histograms_) histogram = PathStatsHistogram();
+}
+
+u64 PathStats::queries() const
+{
+  return queries_;
+}
+
+u64 PathStats::results(const s16 result) const
+{
+  const s32 index = -result;
+  if (index < 0 || index >= static_cast<s32>(kPathStatsResults)) return 0;
+  return results_[index];
+}
+
+const PathStatsHistogram& PathStats::histogram(const PathStatsMetric metric) const
+{
+  return histograms_[static_cast<u32>(metric)];
+}
+
+void PathStats::print() const
+{
+  printf("Paths: %llu queries", static_cast<unsigned long long>(queries_));
+  for (u32 i = 0; i < kPathStatsResults; ++i)
+  {
+    if (results_[i]) printf(", %llu %s", static_cast<unsigned long long>(results_[i]), resultName(-static_cast<s16>(i)));
+  }
+  printf("\n");
+  if (queries_ == 0) return;
+  printf("metric             mean        p50        p90        p99        max\n");
+  for (u32 i = 0; i < static_cast<u32>(PathStatsMetric::k_Count); ++i)
+  {
+    const PathStatsHistogram& histogram = histograms_[i];
+    printf("%-12s %10.1f %10llu %10llu %10llu %10llu\n", metricName(static_cast<PathStatsMetric>(i)), histogram.mean(),
+           static_cast<unsigned long long>(histogram.percentile(kPercentiles[0])),
+           static_cast<unsigned long long>(histogram.percentile(kPercentiles[1])),
+           static_cast<unsigned long long>(histogram.percentile(kPercentiles[2])),
+           static_cast<unsigned long long>(histogram.max));
+  }
+}
+
+s16 PathStats::writeCsv(const char* file) const
+{
+  if (!file) return kErrorCode_InvalidPointer;
+  FILE* out = fopen(file, "w");
+  if (!out) return kErrorCode_File;
+
+  fprintf(out, "metric,count,total,mean,p50,p90,p99,max\n");
+  for (u32 i = 0; i < static_cast<u32>(PathStatsMetric::k_Count); ++i)
+  {
+    const PathStatsHistogram& histogram = histograms_[i];
+    fprintf(out, "%s,%llu,%llu,%.3f,%llu,%llu,%llu,%llu\n", metricName(static_cast<PathStatsMetric>(i)),
+            static_cast<unsigned long long>(histogram.count), static_cast<unsigned long long>(histogram.total),
+            histogram.mean(),
+            static_cast<unsigned long long>(histogram.percentile(kPercentiles[0])),
+            static_cast<unsigned long long>(histogram.percentile(kPercentiles[1])),
+            static_cast<unsigned long long>(histogram.percentile(kPercentiles[2])),
+            static_cast<unsigned long long>(histogram.max));
+  }
+  //The results only have the count column
+  for (u32 i = 0; i < kPathStatsResults; ++i)
+  {
+    if (results_[i]) fprintf(out, "result_%s,%llu,,,,,,\n", resultName(-static_cast<s16>(i)),
+                             static_cast<unsigned long long>(results_[i]));
+  }
+  const bool written = ferror(out) == 0;
+  fclose(out);
+  return written ? kErrorCode_Ok : kErrorCode_File;
+}
+
+s16 PathStats::writeJson(const char* file) const
+{
+  if (!file) return kErrorCode_InvalidPointer;
+  FILE* out = fopen(file, "w");
+  if (!out) return kErrorCode_File;
+
+  fprintf(out, "{\n  \"queries\": %llu,\n  \"results\": {", static_cast<unsigned long long>(queries_));
+  bool first = true;
+  for (u32 i = 0; i < kPathStatsResults; ++i)
+  {
+    if (!results_[i]) continue;
+    fprintf(out, "%s\"%s\": %llu", first ? "" : ", ", resultName(-static_cast<s16>(i)),
+            static_cast<unsigned long long>(results_[i]));
+    first = false;
+  }
+  fprintf(out, "},\n  \"metrics\": {\n");
+  for (u32 i = 0; i < static_cast<u32>(PathStatsMetric::k_Count); ++i)
+  {
+    const PathStatsHistogram& histogram = histograms_[i];
+    fprintf(out, "    \"%s\": {\"count\": %llu, \"total\": %llu, \"mean\": %.3f, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"max\": %llu, \"buckets\": [",
+            metricName(static_cast<PathStatsMetric>(i)),
+            static_cast<unsigned long long>(histogram.count), static_cast<unsigned long long>(histogram.total),
+            histogram.mean(),
+            static_cast<unsigned long long>(histogram.percentile(kPercentiles[0])),
+            static_cast<unsigned long long>(histogram.percentile(kPercentiles[1])),
+            static_cast<unsigned long long>(histogram.percentile(kPercentiles[2])),
+            static_cast<unsigned long long>(histogram.max));
+    for (u32 b = 0; b < kPathStatsBuckets; ++b)
+    {
+      fprintf(out, "%s%llu", b ? ", " : "", static_cast<unsigned long long>(histogram.buckets[b]));
+    }
+    fprintf(out, "]}%s\n", i + 1 < static_cast<u32>(PathStatsMetric::k_Count) ? "," : "");
+  }
+  fprintf(out, "  }\n}\n");
+  const bool written = ferror(out) == 0;
+  fclose(out);
+  return written ? kErrorCode_Ok : kErrorCode_File;
+}
+
+const char* PathStats::metricName(const PathStatsMetric metric)
+{
+  switch (metric)
+  {
+  case PathStatsMetric::k_Expanded: return "expanded";
+  case PathStatsMetric::k_Generated: return "generated";
+  case PathStatsMetric::k_Duplicates: return "duplicates";
+  case PathStatsMetric::k_Reopened: return "reopened";
+  case PathStatsMetric::k_PeakOpen: return "peak_open";
+  case PathStatsMetric::k_LatencyUs: return "latency_us";
+  default: return "unknown";
+  }
+}
+
+const char* PathStats::resultName(const s16 result)
+{
+  switch (result)
+  {
+  case kErrorCode_Ok: return "Ok";
+  case kErrorCode_InvalidPointer: return "InvalidPointer";
+  case kErrorCode_StorageFull: return "StorageFull";
+  case kErrorCode_IncorrectPointsNumber: return "IncorrectPointsNumber";
+  case kErrorCode_EmptyPath: return "EmptyPath";
+  case kErrorCode_BadLoopsSetting: return "BadLoopsSetting";
+  case kErrorCode_PathNotCreated: return "PathNotCreated";
+  case kErrorCode_InvalidOrigin: return "InvalidOrigin";
+  case kErrorCode_InvalidDestination: return "InvalidDestination";
+  case kErrorCode_PathNotFound: return "PathNotFound";
+  case kErrorCode_Timeout: return "Timeout";
+  case kErrorCode_Memory: return "Memory";
+  case kErrorCode_File: return "File";
+  default: return "Unknown";
+  }
+}
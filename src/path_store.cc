@@ -0,0 +1,361 @@
+// path_store.cc
+// Jose Maria Martinez
+// Implementation of the persistent store of paths and data precalculated from the maps
+//Comments for the functions can be found at the header
+
+#include "path_store.h"
+#include "map.h"
+#include "path.h"
+#include "common_def.h"
+#include "ESAT_extra/sqlite3.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+//Milliseconds a connection waits for the other one to release the database
+static const s32 kPathStoreBusyTimeout = 1000;
+
+static const char* kPathStoreSchema =
+  "PRAGMA journal_mode=WAL;"
+  "PRAGMA synchronous=NORMAL;"
+  "CREATE TABLE IF NOT EXISTS paths(map_hash INTEGER NOT NULL, origin INTEGER NOT NULL, dst INTEGER NOT NULL, "
+  "points BLOB NOT NULL, PRIMARY KEY(map_hash, origin, dst)) WITHOUT ROWID;"
+  "CREATE TABLE IF NOT EXISTS layers(map_hash INTEGER NOT NULL, name TEXT NOT NULL, data BLOB NOT NULL, "
+  "PRIMARY KEY(map_hash, name)) WITHOUT ROWID;"
+  "CREATE TABLE IF NOT EXISTS results(map_hash INTEGER NOT NULL, name TEXT NOT NULL, value REAL NOT NULL, "
+  "recorded INTEGER NOT NULL);";
+
+/** @brief returns the index of the cell of a position
+*
+* @param map map of the position
+* @param position position in world units
+* @return s32 index of the cell, y * width + x
+*/
+static s32 CellIndex(const Map& map, const Float2& position)
+{
+  const Float2 ratio = map.ratio();
+  const s32 x = static_cast<s32>(floorf(position.x / ratio.x));
+  const s32 y = static_cast<s32>(floorf(position.y / ratio.y));
+  return y * map.width() + x;
+}
+
+PathStore::PathStore()
+{
+  reader_ = nullptr;
+  writer_ = nullptr;
+  select_path_ = nullptr;
+  select_layer_ = nullptr;
+  insert_path_ = nullptr;
+  insert_layer_ = nullptr;
+  insert_result_ = nullptr;
+  writing_ = 0;
+  flushes_ = 0;
+  quit_ = false;
+  counts_map_hash_ = 0;
+}
+
+PathStore::~PathStore()
+{
+  close();
+}
+
+s16 PathStore::open(const char* file)
+{
+  if (!file) return kErrorCode_InvalidPointer;
+  close();
+
+  const s32 flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX;
+  //The writer creates the tables before the reader opens the file
+  bool opened = sqlite3_open_v2(file, &writer_, flags, nullptr) == SQLITE_OK &&
+                sqlite3_exec(writer_, kPathStoreSchema, nullptr, nullptr, nullptr) == SQLITE_OK &&
+                sqlite3_open_v2(file, &reader_, flags, nullptr) == SQLITE_OK;
+  if (opened)
+  {
+    sqlite3_busy_timeout(writer_, kPathStoreBusyTimeout);
+    sqlite3_busy_timeout(reader_, kPathStoreBusyTimeout);
+    opened = sqlite3_prepare_v2(reader_, "SELECT points FROM paths WHERE map_hash = ?1 AND origin = ?2 AND dst = ?3;",
+                                -1, &select_path_, nullptr) == SQLITE_OK &&
+             sqlite3_prepare_v2(reader_, "SELECT data FROM layers WHERE map_hash = ?1 AND name = ?2;",
+                                -1, &select_layer_, nullptr) == SQLITE_OK &&
+             sqlite3_prepare_v2(writer_, "INSERT OR REPLACE INTO paths VALUES(?1, ?2, ?3, ?4);",
+                                -1, &insert_path_, nullptr) == SQLITE_OK &&
+             sqlite3_prepare_v2(writer_, "INSERT OR REPLACE INTO layers VALUES(?1, ?2, ?3);",
+                                -1, &insert_layer_, nullptr) == SQLITE_OK &&
+             sqlite3_prepare_v2(writer_, "INSERT INTO results VALUES(?1, ?2, ?3, strftime('%s', 'now'));",
+                                -1, &insert_result_, nullptr) == SQLITE_OK;
+  }
+  if (!opened)
+  {
+    printf("Path store %s could not be opened.\n", file);
+    close();
+    return kErrorCode_File;
+  }
+
+  counters_ = PathStoreCounters();
+  writer_thread_ = std::thread(&PathStore::writerLoop, this);
+  return kErrorCode_Ok;
+}
+
+void PathStore::close()
+{
+  if (writer_thread_.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      quit_ = true;
+    }
+    queued_.notify_all();
+    //The writer thread empties the queue before quitting
+    writer_thread_.join();
+    quit_ = false;
+  }
+
+  sqlite3_stmt** statements[] = { &select_path_, &select_layer_, &insert_path_, &insert_layer_, &insert_result_ };
+  for (sqlite3_stmt** statement : statements)
+  {
+    sqlite3_finalize(*statement);
+    *statement = nullptr;
+  }
+  sqlite3_close(reader_);
+  sqlite3_close(writer_);
+  reader_ = nullptr;
+  writer_ = nullptr;
+  route_counts_.clear();
+  counts_map_hash_ = 0;
+}
+
+bool PathStore::isOpen() const
+{
+  return reader_ != nullptr;
+}
+
+s16 PathStore::findPath(const Map& map, const Float2& origin, const Float2& dst, Path* path)
+{
+  if (!isOpen() || !path) return kErrorCode_PathNotCreated;
+
+  sqlite3_bind_int64(select_path_, 1, static_cast<sqlite3_int64>(map.contentHash()));
+  sqlite3_bind_int(select_path_, 2, CellIndex(map, origin));
+  sqlite3_bind_int(select_path_, 3, CellIndex(map, dst));
+  s16 result = kErrorCode_PathNotFound;
+  if (sqlite3_step(select_path_) == SQLITE_ROW)
+  {
+    //The points are pairs of floats in cells
+    const s32 bytes = sqlite3_column_bytes(select_path_, 0);
+    const s32 num_points = bytes / static_cast<s32>(sizeof(float) * 2);
+    const float* points = static_cast<const float*>(sqlite3_column_blob(select_path_, 0));
+    if (num_points > 0 && num_points <= kMaxPoints && path->create(static_cast<u16>(num_points)) == kErrorCode_Ok)
+    {
+      const Float2 ratio = map.ratio();
+      for (s32 i = 0; i < num_points; ++i)
+      {
+        path->addPoint(points[i * 2] * ratio.x, points[i * 2 + 1] * ratio.y);
+      }
+      path->set_direction(Direction::kDirForward);
+      path->setToReady();
+      result = kErrorCode_Ok;
+    }
+  }
+  sqlite3_reset(select_path_);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (result == kErrorCode_Ok)
+  {
+    counters_.hits++;
+  }
+  else
+  {
+    counters_.misses++;
+  }
+  return result;
+}
+
+void PathStore::recordPath(const Map& map, const Float2& origin, const Float2& dst, const Path& path)
+{
+  if (!isOpen() || !path.pointAt(0)) return;
+
+  const u64 map_hash = map.contentHash();
+  if (map_hash != counts_map_hash_)
+  {
+    route_counts_.clear();
+    counts_map_hash_ = map_hash;
+  }
+  const s32 origin_cell = CellIndex(map, origin);
+  const s32 dst_cell = CellIndex(map, dst);
+  const u64 route = (static_cast<u64>(static_cast<u32>(origin_cell)) << 32) | static_cast<u32>(dst_cell);
+  //Only the time the route becomes hot is written, the next ones find it stored
+  if (++route_counts_[route] != kPathStoreHotRoute) return;
+
+  PathStoreWrite write;
+  write.type = PathStoreWriteType::k_Path;
+  write.map_hash = map_hash;
+  write.origin = origin_cell;
+  write.dst = dst_cell;
+  write.value = 0.0;
+  const Float2 ratio = map.ratio();
+  std::vector<float> points;
+  for (u16 i = 0; path.pointAt(i); ++i)
+  {
+    const Float2* point = path.pointAt(i);
+    points.push_back(point->x / ratio.x);
+    points.push_back(point->y / ratio.y);
+  }
+  write.data.resize(points.size() * sizeof(float));
+  memcpy(write.data.data(), points.data(), write.data.size());
+  queue(std::move(write));
+}
+
+s16 PathStore::findLayer(const u64 map_hash, const char* name, std::vector<u8>* data)
+{
+  if (!name || !data) return kErrorCode_InvalidPointer;
+  if (!isOpen()) return kErrorCode_PathNotCreated;
+
+  sqlite3_bind_int64(select_layer_, 1, static_cast<sqlite3_int64>(map_hash));
+  sqlite3_bind_text(select_layer_, 2, name, -1, SQLITE_STATIC);
+  s16 result = kErrorCode_PathNotFound;
+  if (sqlite3_step(select_layer_) == SQLITE_ROW)
+  {
+    const u8* bytes = static_cast<const u8*>(sqlite3_column_blob(select_layer_, 0));
+    data->assign(bytes, bytes + sqlite3_column_bytes(select_layer_, 0));
+    result = kErrorCode_Ok;
+  }
+  sqlite3_reset(select_layer_);
+  sqlite3_clear_bindings(select_layer_);
+  return result;
+}
+
+void PathStore::storeLayer(const u64 map_hash, const char* name, const u8* data, const u64 size)
+{
+  if (!isOpen() || !name || !data) return;
+
+  PathStoreWrite write;
+  write.type = PathStoreWriteType::k_Layer;
+  write.map_hash = map_hash;
+  write.origin = 0;
+  write.dst = 0;
+  write.name = name;
+  write.data.assign(data, data + size);
+  write.value = 0.0;
+  queue(std::move(write));
+}
+
+void PathStore::storeResult(const u64 map_hash, const char* name, const double value)
+{
+  if (!isOpen() || !name) return;
+
+  PathStoreWrite write;
+  write.type = PathStoreWriteType::k_Result;
+  write.map_hash = map_hash;
+  write.origin = 0;
+  write.dst = 0;
+  write.name = name;
+  write.value = value;
+  queue(std::move(write));
+}
+
+void PathStore::flush()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!writer_thread_.joinable()) return;
+  flushes_++;
+  queued_.notify_all();
+  written_.wait(lock, [this] { return queue_.empty() && writing_ == 0; });
+  flushes_--;
+}
+
+PathStoreCounters PathStore::counters() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return counters_;
+}
+
+void PathStore::queue(PathStoreWrite write)
+{
+  size_t queued;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (queue_.empty()) oldest_queued_ = std::chrono::steady_clock::now();
+    queue_.push_back(std::move(write));
+    queued = queue_.size();
+  }
+  //The writer only wakes to start waiting for the batch and once it's full
+  if (queued == 1 || queued == kPathStoreBatch) queued_.notify_one();
+}
+
+void PathStore::writerLoop()
+{
+  std::vector<PathStoreWrite> batch;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true)
+  {
+    queued_.wait(lock, [this] { return quit_ || !queue_.empty(); });
+    if (queue_.empty()) return;
+    queued_.wait_until(lock, oldest_queued_ + std::chrono::milliseconds(kPathStoreFlushInterval), [this] {
+      return quit_ || flushes_ > 0 || queue_.size() >= kPathStoreBatch;
+    });
+
+    batch.clear();
+    while (!queue_.empty() && batch.size() < kPathStoreBatch)
+    {
+      batch.push_back(std::move(queue_.front()));
+      queue_.pop_front();
+    }
+    //The rows left start the next batch
+    if (!queue_.empty()) oldest_queued_ = std::chrono::steady_clock::now();
+    writing_ = static_cast<u32>(batch.size());
+    lock.unlock();
+
+    //One transaction per batch, a commit per row would sync the log every time
+    u64 failed = 0;
+    const bool began = sqlite3_exec(writer_, "BEGIN;", nullptr, nullptr, nullptr) == SQLITE_OK;
+    for (const PathStoreWrite& row : batch)
+    {
+      if (!write(row)) failed++;
+    }
+    const bool committed = began && sqlite3_exec(writer_, "COMMIT;", nullptr, nullptr, nullptr) == SQLITE_OK;
+    if (!committed)
+    {
+      if (began) sqlite3_exec(writer_, "ROLLBACK;", nullptr, nullptr, nullptr);
+      failed = batch.size();
+    }
+
+    lock.lock();
+    counters_.writes += batch.size() - failed;
+    counters_.failed_writes += failed;
+    if (committed) counters_.transactions++;
+    writing_ = 0;
+    written_.notify_all();
+  }
+}
+
+bool PathStore::write(const PathStoreWrite& write)
+{
+  sqlite3_stmt* statement = nullptr;
+  switch (write.type)
+  {
+  case PathStoreWriteType::k_Path:
+    statement = insert_path_;
+    sqlite3_bind_int64(statement, 1, static_cast<sqlite3_int64>(write.map_hash));
+    sqlite3_bind_int(statement, 2, write.origin);
+    sqlite3_bind_int(statement, 3, write.dst);
+    sqlite3_bind_blob(statement, 4, write.data.data(), static_cast<s32>(write.data.size()), SQLITE_STATIC);
+    break;
+  case PathStoreWriteType::k_Layer:
+    statement = insert_layer_;
+    sqlite3_bind_int64(statement, 1, static_cast<sqlite3_int64>(write.map_hash));
+    sqlite3_bind_text(statement, 2, write.name.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_blob(statement, 3, write.data.data(), static_cast<s32>(write.data.size()), SQLITE_STATIC);
+    break;
+  case PathStoreWriteType::k_Result:
+    statement = insert_result_;
+    sqlite3_bind_int64(statement, 1, static_cast<sqlite3_int64>(write.map_hash));
+    sqlite3_bind_text(statement, 2, write.name.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_double(statement, 3, write.value);
+    break;
+  default:
+    return false;
+  }
+  const bool done = sqlite3_step(statement) == SQLITE_DONE;
+  sqlite3_reset(statement);
+  sqlite3_clear_bindings(statement);
+  return done;
+}
@@ -0,0 +1,220 @@
+// profiler.cc
+// Jose Maria Martinez
+// Implementation of the profiler that measures the zones of a frame
+//Comments for the functions can be found at the header
+
+#include "profiler.h"
+#include "common_def.h"
+#include <ESAT/time.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <string>
+
+Profiler& Profiler::instance()
+{
+  static Profiler profiler;
+  return profiler;
+}
+
+Profiler::Profiler()
+{
+  start_time_ = ESAT::Time();
+}
+
+Profiler::ThreadBuffer* Profiler::threadBuffer()
+{
+  thread_local ThreadBuffer* buffer = nullptr;
+  if (!buffer)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    //Value initialized, every zone and count starts at 0
+    buffers_.emplace_back(new ThreadBuffer());
+    buffer = buffers_.back().get();
+    buffer->thread_index = static_cast<u32>(buffers_.size() - 1);
+  }
+  return buffer;
+}
+
+u32 Profiler::bucket(const double duration)
+{
+  const double us = duration * 1000.0;
+  if (us < 1.0) return 0;
+  //us = mantissa * 2^exponent with the mantissa in [0.5, 1)
+  int exponent = 0;
+  const double mantissa = frexp(us, &exponent);
+  const u32 quarter = static_cast<u32>((mantissa * 2.0 - 1.0) * 4.0);
+  const u32 result = 1 + static_cast<u32>(exponent - 1) * 4 + quarter;
+  return result < kProfileHistogramBuckets ? result : kProfileHistogramBuckets - 1;
+}
+
+double Profiler::bucketLimit(const u32 bucket)
+{
+  if (bucket == 0) return 0.001;
+  const u32 octave = (bucket - 1) / 4;
+  const u32 quarter = (bucket - 1) % 4;
+  return ldexp(1.0 + (quarter + 1) * 0.25, static_cast<int>(octave)) * 0.001;
+}
+
+void Profiler::record(const char* name, const double start, const double duration)
+{
+  ThreadBuffer* buffer = threadBuffer();
+  const u64 position = buffer->written.load(std::memory_order_relaxed);
+  ProfileEvent& event = buffer->events[position & (kProfileBufferCapacity - 1)];
+  event.name = name;
+  event.start = start;
+  event.duration = duration;
+  buffer->written.store(position + 1, std::memory_order_release);
+
+  //Only this thread writes the histograms, the summary reads them from other thread
+  for (u32 i = 0; i < kProfileMaxZones; ++i)
+  {
+    ZoneHistogram& zone = buffer->zones[i];
+    const char* zone_name = zone.name.load(std::memory_order_relaxed);
+    if (!zone_name)
+    {
+      zone.name.store(name, std::memory_order_release);
+    }
+    else if (zone_name != name)
+    {
+      continue;
+    }
+    std::atomic<u32>& count = zone.counts[bucket(duration)];
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    zone.total_ns.store(zone.total_ns.load(std::memory_order_relaxed) + static_cast<u64>(duration * 1000000.0),
+                        std::memory_order_relaxed);
+    return;
+  }
+}
+
+void Profiler::collect(const ThreadBuffer& buffer, std::vector<ProfileEvent>* events)
+{
+  const u64 end = buffer.written.load(std::memory_order_acquire);
+  const u64 begin = end > kProfileBufferCapacity ? end - kProfileBufferCapacity : 0;
+  const size_t first = events->size();
+  for (u64 i = begin; i < end; ++i)
+  {
+    events->push_back(buffer.events[i & (kProfileBufferCapacity - 1)]);
+  }
+  //The thread may have kept writing, the slot it writes now and the ones before are not valid
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const u64 now = buffer.written.load(std::memory_order_relaxed);
+  if (now + 1 > begin + kProfileBufferCapacity)
+  {
+    const u64 overwritten = std::min(now + 1 - kProfileBufferCapacity - begin, end - begin);
+    events->erase(events->begin() + first, events->begin() + first + static_cast<size_t>(overwritten));
+  }
+}
+
+s16 Profiler::exportChromeTrace(const char* file)
+{
+  if (!file) return kErrorCode_InvalidPointer;
+  FILE* out = fopen(file, "w");
+  if (!out) return kErrorCode_File;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<ProfileEvent> events;
+  u32 total = 0;
+  fprintf(out, "{\"traceEvents\":[\n");
+  for (const std::unique_ptr<ThreadBuffer>& buffer : buffers_)
+  {
+    events.clear();
+    collect(*buffer, &events);
+    for (const ProfileEvent& event : events)
+    {
+      //Complete events, the trace is in microseconds
+      fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+              total == 0 ? "" : ",\n", event.name, buffer->thread_index,
+              (event.start - start_time_) * 1000.0, event.duration * 1000.0);
+      total++;
+    }
+  }
+  fprintf(out, "\n]}\n");
+  const bool written = ferror(out) == 0;
+  fclose(out);
+  if (!written) return kErrorCode_File;
+
+  printf("Profiler: %u zones of %u threads written to %s\n", total, static_cast<u32>(buffers_.size()), file);
+  return kErrorCode_Ok;
+}
+
+void Profiler::printSummary()
+{
+  struct ZoneSummary
+  {
+    u64 counts[kProfileHistogramBuckets] = {};
+    u64 count = 0;
+    u64 total_ns = 0;
+  };
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  //The same name can be in several translation units with different pointers
+  std::map<std::string, ZoneSummary> zones;
+  for (const std::unique_ptr<ThreadBuffer>& buffer : buffers_)
+  {
+    for (u32 i = 0; i < kProfileMaxZones; ++i)
+    {
+      const ZoneHistogram& zone = buffer->zones[i];
+      const char* name = zone.name.load(std::memory_order_acquire);
+      if (!name) break;
+      ZoneSummary& summary = zones[name];
+      for (u32 b = 0; b < kProfileHistogramBuckets; ++b)
+      {
+        const u32 count = zone.counts[b].load(std::memory_order_relaxed);
+        summary.counts[b] += count - buffer->summarized_counts[i][b];
+        summary.count += count - buffer->summarized_counts[i][b];
+        buffer->summarized_counts[i][b] = count;
+      }
+      const u64 total_ns = zone.total_ns.load(std::memory_order_relaxed);
+      summary.total_ns += total_ns - buffer->summarized_ns[i];
+      buffer->summarized_ns[i] = total_ns;
+    }
+  }
+
+  bool measured = false;
+  for (const auto& zone : zones)
+  {
+    if (zone.second.count > 0) measured = true;
+  }
+  if (!measured)
+  {
+#ifdef PROFILER_ENABLED
+    printf("Profiler: no zones measured since the last summary\n");
+#else
+    printf("Profiler: zones not compiled, build with DEBUG or ENABLE_PROFILER\n");
+#endif
+    return;
+  }
+
+  printf("Profiler: %-28s %9s %9s %9s %9s %9s %10s\n", "zone", "count", "p50 ms", "p95 ms", "p99 ms", "max ms", "total ms");
+  for (const auto& zone : zones)
+  {
+    const ZoneSummary& summary = zone.second;
+    if (summary.count == 0) continue;
+    const u64 ranks[4] = { (summary.count - 1) * 50 / 100, (summary.count - 1) * 95 / 100,
+                           (summary.count - 1) * 99 / 100, summary.count - 1 };
+    double limits[4] = {};
+    u32 next = 0;
+    u64 accumulated = 0;
+    for (u32 b = 0; b < kProfileHistogramBuckets && next < 4; ++b)
+    {
+      accumulated += summary.counts[b];
+      while (next < 4 && ranks[next] < accumulated) limits[next++] = bucketLimit(b);
+    }
+    printf("          %-28s %9llu %9.3f %9.3f %9.3f %9.3f %10.1f\n", zone.first.c_str(),
+           static_cast<unsigned long long>(summary.count), limits[0], limits[1], limits[2], limits[3],
+           summary.total_ns / 1000000.0);
+  }
+}
+
+ProfileZone::ProfileZone(const char* name)
+{
+  name_ = name;
+  start_ = ESAT::Time();
+}
+
+ProfileZone::~ProfileZone()
+{
+  Profiler::instance().record(name_, start_, ESAT::Time() - start_);
+}
@@ -0,0 +1,108 @@
+// session_recorder.cc
+// Jose Maria Martinez
+// Implementation of the recorder of the inputs of a session
+//Comments for the functions can be found at the header
+
+#include "session_recorder.h"
+#include "world.h"
+#include "common_def.h"
+#include <cstring>
+
+SessionRecorder::SessionRecorder()
+{
+  file_ = nullptr;
+  failed_ = false;
+}
+
+SessionRecorder::~SessionRecorder()
+{
+  end();
+}
+
+s16 SessionRecorder::begin(const char* file, const World& world, const u32 time_step)
+{
+  if (!file) return kErrorCode_InvalidPointer;
+  end();
+
+  file_ = fopen(file, "wb");
+  if (!file_) return kErrorCode_File;
+  failed_ = false;
+  events_.clear();
+
+  const char* map_source = world.map().source();
+  SessionHeader header;
+  memcpy(header.magic, "SREC", 4);
+  header.version = kSessionVersion;
+  header.seed = world.seed_;
+  header.time_step = time_step;
+  header.num_agents = static_cast<u32>(world.agents_.size());
+  header.map_length = static_cast<u32>(strlen(map_source));
+  header.viewport_min = world.ai_lod_.viewportMin();
+  header.viewport_max = world.ai_lod_.viewportMax();
+  header.map_size = Float2(world.map().width() * world.map().ratio().x, world.map().height() * world.map().ratio().y);
+
+  bool written = fwrite(&header, sizeof(header), 1, file_) == 1 &&
+                 (header.map_length == 0 || fwrite(map_source, 1, header.map_length, file_) == header.map_length);
+  for (const Agent* agent : world.agents_)
+  {
+    if (!written) break;
+    SessionSpawn spawn;
+    spawn.id = agent->id();
+    spawn.type = static_cast<u8>(agent->type());
+    spawn.has_path_finder = agent->hasPathFinder() ? 1 : 0;
+    spawn.clearance = agent->clearance();
+    spawn.padding = 0;
+    spawn.x = agent->x();
+    spawn.y = agent->y();
+    written = fwrite(&spawn, sizeof(spawn), 1, file_) == 1;
+  }
+  if (!written)
+  {
+    fclose(file_);
+    file_ = nullptr;
+    return kErrorCode_File;
+  }
+  return kErrorCode_Ok;
+}
+
+void SessionRecorder::record(const SessionEventType type, const u32 agent, const Float2& origin, const Float2& dst,
+                             const u32 deadline)
+{
+  if (!file_) return;
+  SessionEvent event;
+  event.type = type;
+  event.agent = agent;
+  event.origin = origin;
+  event.dst = dst;
+  event.deadline = deadline;
+  events_.push_back(event);
+}
+
+void SessionRecorder::endTick(const u32 dt, const float update_ms)
+{
+  if (!file_) return;
+  SessionTickHeader tick;
+  tick.dt = static_cast<u16>(dt);
+  tick.num_events = static_cast<u16>(events_.size());
+  tick.update_ms = update_ms;
+  if (fwrite(&tick, sizeof(tick), 1, file_) != 1 ||
+      (!events_.empty() && fwrite(events_.data(), sizeof(SessionEvent), events_.size(), file_) != events_.size()))
+  {
+    failed_ = true;
+  }
+  events_.clear();
+}
+
+s16 SessionRecorder::end()
+{
+  if (!file_) return kErrorCode_Ok;
+  const bool written = (fclose(file_) == 0) && !failed_;
+  file_ = nullptr;
+  events_.clear();
+  return written ? kErrorCode_Ok : kErrorCode_File;
+}
+
+bool SessionRecorder::isRecording() const
+{
+  return file_ != nullptr;
+}
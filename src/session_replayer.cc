@@ -0,0 +1,127 @@
+// session_replayer.cc
+// Jose Maria Martinez
+// Implementation of the reader of the recorded sessions
+//Comments for the functions can be found at the header
+
+#include "session_replayer.h"
+#include "common_def.h"
+#include <cstdio>
+#include <cstring>
+
+SessionReplayer::SessionReplayer()
+{
+  memset(header_.magic, 0, sizeof(header_.magic));
+  header_.version = 0;
+  header_.seed = 0;
+  header_.time_step = 0;
+  header_.num_agents = 0;
+  header_.map_length = 0;
+}
+
+SessionReplayer::~SessionReplayer()
+{
+
+}
+
+s16 SessionReplayer::load(const char* file)
+{
+  if (!file) return kErrorCode_InvalidPointer;
+  map_source_.clear();
+  spawns_.clear();
+  ticks_.clear();
+  events_.clear();
+
+  FILE* input = fopen(file, "rb");
+  if (!input) return kErrorCode_File;
+
+  bool read = fread(&header_, sizeof(header_), 1, input) == 1 &&
+              memcmp(header_.magic, "SREC", 4) == 0 && header_.version == kSessionVersion;
+  if (read && header_.map_length)
+  {
+    map_source_.resize(header_.map_length);
+    read = fread(&map_source_[0], 1, header_.map_length, input) == header_.map_length;
+  }
+  if (read)
+  {
+    spawns_.resize(header_.num_agents);
+    read = header_.num_agents == 0 ||
+           fread(spawns_.data(), sizeof(SessionSpawn), spawns_.size(), input) == spawns_.size();
+  }
+
+  SessionTickHeader tick_header;
+  while (read && fread(&tick_header, sizeof(tick_header), 1, input) == 1)
+  {
+    SessionTick tick;
+    tick.dt = tick_header.dt;
+    tick.update_ms = tick_header.update_ms;
+    tick.first_event = static_cast<u32>(events_.size());
+    tick.num_events = tick_header.num_events;
+    events_.resize(tick.first_event + tick.num_events);
+    if (tick.num_events &&
+        fread(&events_[tick.first_event], sizeof(SessionEvent), tick.num_events, input) != tick.num_events)
+    {
+      events_.resize(tick.first_event);
+      break;
+    }
+    ticks_.push_back(tick);
+  }
+  fclose(input);
+
+  if (!read)
+  {
+    map_source_.clear();
+    spawns_.clear();
+    return kErrorCode_File;
+  }
+  return kErrorCode_Ok;
+}
+
+u32 SessionReplayer::seed() const
+{
+  return header_.seed;
+}
+
+u32 SessionReplayer::timeStep() const
+{
+  return header_.time_step;
+}
+
+Float2 SessionReplayer::viewportMin() const
+{
+  return header_.viewport_min;
+}
+
+Float2 SessionReplayer::viewportMax() const
+{
+  return header_.viewport_max;
+}
+
+Float2 SessionReplayer::mapSize() const
+{
+  return header_.map_size;
+}
+
+const char* SessionReplayer::mapSource() const
+{
+  return map_source_.c_str();
+}
+
+const std::vector<SessionSpawn>& SessionReplayer::spawns() const
+{
+  return spawns_;
+}
+
+u32 SessionReplayer::numTicks() const
+{
+  return static_cast<u32>(ticks_.size());
+}
+
+const SessionTick& SessionReplayer::tick(const u32 index) const
+{
+  return ticks_[index];
+}
+
+const SessionEvent& SessionReplayer::event(const u32 index) const
+{
+  return events_[index];
+}
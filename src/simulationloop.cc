@@ -44,6 +44,7 @@ void Init() {
   g_game_state.time_step_ = static_cast<uint32_t>((1.0/g_game_state.frequency_)*1000);
 
   ESAT::WindowInit(1280, 720);
+  g_game_state.ai_lod_.set_viewport(Float2(0.0f, 0.0f), Float2(1280.0f, 720.0f));
 
   g_game_state.agent_spr_ = ESAT::SpriteFromFile("../data/agent.png");
 
@@ -101,10 +102,7 @@ void Update(uint32_t dt)
 {
   if (!ESAT::WindowIsOpened()) g_game_state.quit_game_ = true;
   if (g_game_state.should_game_end_) g_game_state.quit_game_ = true;
-  for (Agent* agent : g_game_state.agents_)
-  {
-    agent->update(dt);
-  }
+  g_game_state.updateAgents(dt);
 }
 
 /** @brief Deinit
@@ -0,0 +1,141 @@
+// spatial_grid.cc
+// Jose Maria Martinez
+// Implementation of the uniform grid used to find nearby agents
+//Comments for the functions can be found at the header
+
+#include "spatial_grid.h"
+#include "agent.h"
+#include <algorithm>
+#include <cmath>
+
+SpatialGrid::SpatialGrid()
+{
+  cell_size_ = 300.0f;
+  origin_ = Float2(0.0f, 0.0f);
+  columns_ = 0;
+  rows_ = 0;
+}
+
+SpatialGrid::~SpatialGrid()
+{
+
+}
+
+void SpatialGrid::set_cell_size(const float cell_size)
+{
+  if (cell_size > 0.0f) cell_size_ = cell_size;
+}
+
+void SpatialGrid::rebuild(const std::vector<Agent*>& agents)
+{
+  if (agents.empty())
+  {
+    columns_ = 0;
+    rows_ = 0;
+    for (u8 t = 0; t < kNumAgentTypes; t++)
+    {
+      cell_start_[t].clear();
+      entries_[t].clear();
+    }
+    return;
+  }
+
+  float min_x = agents[0]->x();
+  float min_y = agents[0]->y();
+  float max_x = min_x;
+  float max_y = min_y;
+  for (const Agent* agent : agents)
+  {
+    min_x = std::min(min_x, agent->x());
+    min_y = std::min(min_y, agent->y());
+    max_x = std::max(max_x, agent->x());
+    max_y = std::max(max_y, agent->y());
+  }
+  origin_ = Float2(min_x, min_y);
+  columns_ = static_cast<s32>((max_x - min_x) / cell_size_) + 1;
+  rows_ = static_cast<s32>((max_y - min_y) / cell_size_) + 1;
+  const s32 cells = columns_ * rows_;
+
+  //Counting sort of the agents by type and cell
+  for (u8 t = 0; t < kNumAgentTypes; t++)
+  {
+    cell_start_[t].assign(cells + 1, 0);
+  }
+  agent_cells_.resize(agents.size());
+  for (size_t i = 0; i < agents.size(); i++)
+  {
+    const Agent* agent = agents[i];
+    const u8 t = static_cast<u8>(agent->type()) - 1;
+    if (t >= kNumAgentTypes) continue;
+    agent_cells_[i] = cellCoordinate(agent->x(), origin_.x, columns_) +
+                      cellCoordinate(agent->y(), origin_.y, rows_) * columns_;
+    cell_start_[t][agent_cells_[i] + 1]++;
+  }
+  for (u8 t = 0; t < kNumAgentTypes; t++)
+  {
+    for (s32 c = 0; c < cells; c++)
+    {
+      cell_start_[t][c + 1] += cell_start_[t][c];
+    }
+    entries_[t].resize(cell_start_[t][cells]);
+  }
+  //The starts are advanced while filling and restored afterwards
+  for (size_t i = 0; i < agents.size(); i++)
+  {
+    Agent* agent = agents[i];
+    const u8 t = static_cast<u8>(agent->type()) - 1;
+    if (t >= kNumAgentTypes) continue;
+    entries_[t][cell_start_[t][agent_cells_[i]]++] = SpatialGridEntry{ Float2(agent->x(), agent->y()), agent };
+  }
+  for (u8 t = 0; t < kNumAgentTypes; t++)
+  {
+    for (s32 c = cells; c > 0; c--)
+    {
+      cell_start_[t][c] = cell_start_[t][c - 1];
+    }
+    cell_start_[t][0] = 0;
+  }
+}
+
+void SpatialGrid::queryRadius(const AgentType type, const Float2& center, const float radius,
+                              std::vector<Agent*>* result) const
+{
+  const u8 t = static_cast<u8>(type) - 1;
+  if (t >= kNumAgentTypes || entries_[t].empty() || !result) return;
+
+  const s32 first_column = cellCoordinate(center.x - radius, origin_.x, columns_);
+  const s32 last_column = cellCoordinate(center.x + radius, origin_.x, columns_);
+  const s32 first_row = cellCoordinate(center.y - radius, origin_.y, rows_);
+  const s32 last_row = cellCoordinate(center.y + radius, origin_.y, rows_);
+  const float squared_radius = radius * radius;
+
+  for (s32 row = first_row; row <= last_row; row++)
+  {
+    for (s32 column = first_column; column <= last_column; column++)
+    {
+      const s32 cell = column + row * columns_;
+      for (u32 i = cell_start_[t][cell]; i < cell_start_[t][cell + 1]; i++)
+      {
+        const SpatialGridEntry& entry = entries_[t][i];
+        const Float2 distance = entry.position - center;
+        if (distance.DotProduct(distance) <= squared_radius) result->push_back(entry.agent);
+      }
+    }
+  }
+}
+
+u32 SpatialGrid::size() const
+{
+  u32 total = 0;
+  for (u8 t = 0; t < kNumAgentTypes; t++)
+  {
+    total += static_cast<u32>(entries_[t].size());
+  }
+  return total;
+}
+
+s32 SpatialGrid::cellCoordinate(const float value, const float origin, const s32 count) const
+{
+  const s32 coordinate = static_cast<s32>(floorf((value - origin) / cell_size_));
+  return std::max(0, std::min(count - 1, coordinate));
+}
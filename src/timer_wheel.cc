@@ -0,0 +1,133 @@
+// timer_wheel.cc
+// Jose Maria Martinez
+// Implementation of the hierarchical timing wheel that wakes up the agents
+//Comments for the functions can be found at the header
+
+#include "timer_wheel.h"
+
+TimerWheel::TimerWheel()
+{
+  now_ = 0;
+}
+
+TimerWheel::~TimerWheel()
+{
+
+}
+
+void TimerWheel::schedule(const u32 id, const u32 due)
+{
+  if (id >= stamps_.size())
+  {
+    stamps_.resize(id + 1, 0);
+    dues_.resize(id + 1, kNoTimer);
+  }
+  //The stamp invalidates the timer the id had
+  stamps_[id]++;
+  dues_[id] = due;
+  const TimerEntry entry = { due, id, stamps_[id] };
+  if (due <= now_)
+  {
+    expired_.push_back(entry);
+    return;
+  }
+  insert(entry);
+}
+
+void TimerWheel::cancel(const u32 id)
+{
+  if (id >= stamps_.size()) return;
+  stamps_[id]++;
+  dues_[id] = kNoTimer;
+}
+
+u32 TimerWheel::due(const u32 id) const
+{
+  if (id >= dues_.size()) return kNoTimer;
+  return dues_[id];
+}
+
+void TimerWheel::insert(const TimerEntry& entry)
+{
+  const u32 delta = entry.due - now_;
+  for (u32 level = 0; level < kWheelLevels; level++)
+  {
+    if (delta < (1u << (kWheelSlotBits * (level + 1))))
+    {
+      const u32 slot = (entry.due >> (kWheelSlotBits * level)) & (kWheelSlots - 1);
+      slots_[level][slot].push_back(entry);
+      return;
+    }
+  }
+  //Farther than the last level, it's stored as far as possible and moved down
+  //again when that slot is reached
+  const u32 level = kWheelLevels - 1;
+  const u32 farthest = now_ + (1u << (kWheelSlotBits * kWheelLevels)) - 1;
+  slots_[level][(farthest >> (kWheelSlotBits * level)) & (kWheelSlots - 1)].push_back(entry);
+}
+
+void TimerWheel::fire(const TimerEntry& entry, std::vector<u32>* fired)
+{
+  if (entry.stamp != stamps_[entry.id]) return;
+  dues_[entry.id] = kNoTimer;
+  stamps_[entry.id]++;
+  fired->push_back(entry.id);
+}
+
+void TimerWheel::advance(const u32 now, std::vector<u32>* fired)
+{
+  for (const TimerEntry& entry : expired_)
+  {
+    fire(entry, fired);
+  }
+  expired_.clear();
+
+  std::vector<TimerEntry> moved;
+  while (now_ != now)
+  {
+    now_++;
+    //Entering a new block of a level moves its timers to the lower levels
+    for (u32 level = 1; level < kWheelLevels; level++)
+    {
+      if (now_ & ((1u << (kWheelSlotBits * level)) - 1)) break;
+      const u32 slot = (now_ >> (kWheelSlotBits * level)) & (kWheelSlots - 1);
+      moved.swap(slots_[level][slot]);
+      for (const TimerEntry& entry : moved)
+      {
+        if (entry.stamp != stamps_[entry.id]) continue;
+        if (entry.due <= now_) fire(entry, fired);
+        else insert(entry);
+      }
+      moved.clear();
+    }
+
+    std::vector<TimerEntry>& due_slot = slots_[0][now_ & (kWheelSlots - 1)];
+    for (const TimerEntry& entry : due_slot)
+    {
+      fire(entry, fired);
+    }
+    due_slot.clear();
+  }
+}
+
+u32 TimerWheel::now() const
+{
+  return now_;
+}
+
+void TimerWheel::clear()
+{
+  for (u32 level = 0; level < kWheelLevels; level++)
+  {
+    for (u32 slot = 0; slot < kWheelSlots; slot++)
+    {
+      slots_[level][slot].clear();
+    }
+  }
+  expired_.clear();
+  for (u32 id = 0; id < stamps_.size(); id++)
+  {
+    stamps_[id]++;
+    dues_[id] = kNoTimer;
+  }
+}
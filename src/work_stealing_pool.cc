@@ -0,0 +1,152 @@
+// work_stealing_pool.cc
+// Jose Maria Martinez
+// Implementation of the work stealing thread pool
+//Comments for the functions can be found at the header
+
+#include "work_stealing_pool.h"
+#include "common_def.h"
+#include <algorithm>
+#include <system_error>
+
+WorkStealingPool::WorkStealingPool()
+{
+  job_ = nullptr;
+  pending_ = 0;
+  generation_ = 0;
+  quit_ = false;
+  queues_.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+  stop();
+}
+
+s16 WorkStealingPool::start(u32 num_threads)
+{
+  stop();
+  if (num_threads == 0) num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+  while (queues_.size() < num_threads)
+  {
+    queues_.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+  }
+  quit_ = false;
+  try
+  {
+    for (u32 i = 1; i < num_threads; i++)
+    {
+      threads_.push_back(std::thread(&WorkStealingPool::workerLoop, this, i));
+    }
+  }
+  catch (const std::system_error&)
+  {
+    stop();
+    return kErrorCode_Memory;
+  }
+  return kErrorCode_Ok;
+}
+
+void WorkStealingPool::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    quit_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread& thread : threads_)
+  {
+    thread.join();
+  }
+  threads_.clear();
+}
+
+u32 WorkStealingPool::numThreads() const
+{
+  return static_cast<u32>(threads_.size()) + 1;
+}
+
+void WorkStealingPool::parallelFor(const u32 count, const u32 grain, const std::function<void(u32, u32)>& job)
+{
+  if (count == 0) return;
+  const u32 range_size = std::max(1u, grain);
+  const u32 num_ranges = (count + range_size - 1) / range_size;
+  const u32 num_threads = numThreads();
+  if (num_threads == 1 || num_ranges == 1)
+  {
+    job(0, count);
+    return;
+  }
+
+  //Each thread starts with a contiguous block of ranges
+  pending_ = num_ranges;
+  //Written before any range is queued so a thread that takes a range sees it
+  job_ = &job;
+  for (u32 worker = 0; worker < num_threads; worker++)
+  {
+    const u32 first_range = num_ranges * worker / num_threads;
+    const u32 last_range = num_ranges * (worker + 1) / num_threads;
+    WorkQueue& queue = *queues_[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    for (u32 r = first_range; r < last_range; r++)
+    {
+      queue.ranges.push_back(std::make_pair(r * range_size, std::min(count, (r + 1) * range_size)));
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    generation_++;
+  }
+  wake_.notify_all();
+
+  while (pending_ > 0)
+  {
+    if (!runRange(0)) std::this_thread::yield();
+  }
+}
+
+bool WorkStealingPool::runRange(const u32 worker)
+{
+  const u32 num_threads = numThreads();
+  std::pair<u32, u32> range;
+  const std::function<void(u32, u32)>* job = nullptr;
+  for (u32 i = 0; i < num_threads && !job; i++)
+  {
+    //The own queue is used from the front and the others are stolen from the back
+    const u32 victim = (worker + i) % num_threads;
+    WorkQueue& queue = *queues_[victim];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.ranges.empty()) continue;
+    if (i == 0)
+    {
+      range = queue.ranges.front();
+      queue.ranges.pop_front();
+    }
+    else
+    {
+      range = queue.ranges.back();
+      queue.ranges.pop_back();
+    }
+    job = job_;
+  }
+  if (!job) return false;
+
+  (*job)(range.first, range.second);
+  pending_--;
+  return true;
+}
+
+void WorkStealingPool::workerLoop(const u32 worker)
+{
+  u64 generation = 0;
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(wake_mutex_);
+      wake_.wait(lock, [this, generation]() { return quit_ || generation_ != generation; });
+      if (quit_) return;
+      generation = generation_;
+    }
+    while (runRange(worker)) {}
+  }
+}
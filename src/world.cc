@@ -0,0 +1,138 @@
+// world.cc
+// Jose Maria Martinez
+// Implementation of the world where the agents are simulated
+// Comments for the functions can be found at the header
+
+#include <world.h>
+#include <algorithm>
+#include <ESAT/time.h>
+
+World::World() {
+  pf_agent_ = nullptr;
+  seed_ = 1;
+  update_threads_ = 1;
+  game_time_ = 0;
+  headless_ = false;
+  next_agent_id_ = 1;
+  shared_map_ = nullptr;
+}
+
+World::~World() {
+
+}
+
+void World::updateAgents(const uint32_t dt) {
+  //Ranges of agents and slots big enough to not be dominated by the stealing
+  const u32 kAgentsPerRange = 64;
+  const u32 kSlotsPerRange = 1024;
+
+  const u32 threads = update_threads_ ? update_threads_ : std::max(1u, std::thread::hardware_concurrency());
+  if (threads != update_pool_.numThreads()) {
+    if (threads == 1) update_pool_.stop();
+    else update_pool_.start(threads);
+  }
+
+  game_time_ += dt;
+  const double tick_start = ESAT::Time();
+  double phase_start = tick_start;
+  agent_grid_.rebuild(agents_);
+  double phase_end = ESAT::Time();
+  update_timings_.grid_ms += phase_end - phase_start;
+
+  phase_start = phase_end;
+  if (ai_lod_.isRebalanceDue(game_time_)) {
+    lod_changed_.clear();
+    ai_lod_.rebalance(agents_, game_time_, &lod_changed_);
+    //Their next thought moved, they are scheduled again at this update
+    for (Agent* agent : lod_changed_) {
+      wakeAgent(agent->id());
+    }
+  }
+
+  phase_end = ESAT::Time();
+  update_timings_.lod_ms += phase_end - phase_start;
+
+  phase_start = phase_end;
+  awake_ids_.clear();
+  agent_timers_.advance(game_time_, &awake_ids_);
+  awake_agents_.clear();
+  for (u32 id : awake_ids_) {
+    awake_agents_.push_back(agents_by_id_[id]);
+  }
+  wake_delays_.resize(awake_agents_.size());
+  wake_costs_.resize(awake_agents_.size());
+  update_pool_.parallelFor(static_cast<u32>(awake_agents_.size()), kAgentsPerRange, [this, dt](u32 first, u32 last) {
+    for (u32 i = first; i < last; i++) {
+      const double start = ESAT::Time();
+      wake_delays_[i] = awake_agents_[i]->wake(game_time_, dt);
+      wake_costs_[i] = ESAT::Time() - start;
+    }
+  });
+  for (u32 i = 0; i < awake_agents_.size(); i++) {
+    if (wake_delays_[i] != kNoTimer) agent_timers_.schedule(awake_agents_[i]->id(), game_time_ + wake_delays_[i]);
+    ai_lod_.record(awake_agents_[i]->lodTier(), wake_costs_[i]);
+  }
+  phase_end = ESAT::Time();
+  update_timings_.wake_ms += phase_end - phase_start;
+
+  phase_start = phase_end;
+  update_pool_.parallelFor(agent_store_.size(), kSlotsPerRange, [this, dt](u32 first, u32 last) {
+    agent_store_.integrateRange(first, last, dt);
+  });
+  agent_store_.swapBuffers();
+  phase_end = ESAT::Time();
+  update_timings_.integrate_ms += phase_end - phase_start;
+
+  phase_start = phase_end;
+  occupancy_.update(agent_store_, map());
+  phase_end = ESAT::Time();
+  update_timings_.occupancy_ms += phase_end - phase_start;
+
+  phase_start = phase_end;
+  awake_ids_.clear();
+  dispatcher_.deliver(&awake_ids_);
+  for (u32 id : awake_ids_) {
+    wakeAgent(id);
+  }
+  phase_end = ESAT::Time();
+  update_timings_.deliver_ms += phase_end - phase_start;
+  update_timings_.ticks++;
+  recorder_.endTick(dt, static_cast<float>(phase_end - tick_start));
+}
+
+uint32_t World::allocateAgentId() {
+  return next_agent_id_++;
+}
+
+void World::registerAgent(Agent* agent) {
+  const u32 id = agent->id();
+  if (id >= agents_by_id_.size()) agents_by_id_.resize(id + 1, nullptr);
+  agents_by_id_[id] = agent;
+  agent_timers_.schedule(id, game_time_);
+}
+
+void World::unregisterAgent(Agent* agent) {
+  const u32 id = agent->id();
+  if (id >= agents_by_id_.size() || agents_by_id_[id] != agent) return;
+  agents_by_id_[id] = nullptr;
+  agent_timers_.cancel(id);
+}
+
+void World::wakeAgent(const uint32_t id) {
+  if (id >= agents_by_id_.size() || !agents_by_id_[id]) return;
+  if (agent_timers_.due(id) > game_time_) agent_timers_.schedule(id, game_time_);
+}
+
+Agent* World::agent(const uint32_t id) const {
+  if (id >= agents_by_id_.size()) return nullptr;
+  return agents_by_id_[id];
+}
+
+void World::shareMap(const Map* map) {
+  if (map) map->contentHash();
+  shared_map_ = map;
+}
+
+const Map& World::map() const {
+  return shared_map_ ? *shared_map_ : map_;
+}
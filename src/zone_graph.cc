@@ -0,0 +1,356 @@
+// zone_graph.cc
+// Jose Maria Martinez
+// Implementation of the graph of zones and portals used to plan the routes of the paths
+//Comments for the functions can be found at the header
+
+#include "zone_graph.h"
+#include "map.h"
+#include "common_def.h"
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <queue>
+#include <utility>
+
+//Neighbours of a cell, the straight ones first so the portals cross straight when they can
+static const s32 g_offset_x[8] = { 1, -1, 0, 0, 1, -1, 1, -1 };
+static const s32 g_offset_y[8] = { 0, 0, 1, -1, 1, 1, -1, -1 };
+static const u32 g_step_cost[8] = { 10, 10, 10, 10, 15, 15, 15, 15 };
+
+static const u32 kZoneUnreached = 0xFFFFFFFF;
+
+typedef std::pair<u32, s32> ZoneOpenEntry;
+typedef std::priority_queue<ZoneOpenEntry, std::vector<ZoneOpenEntry>, std::greater<ZoneOpenEntry>> ZoneOpenList;
+
+/** @brief returns the octile distance between two cells
+*
+* @param cell first cell
+* @param other second cell
+* @param width width of the map
+* @return u32 cost of the straight and diagonal steps between them
+*/
+static u32 Octile(const s32 cell, const s32 other, const s32 width)
+{
+  const s32 dx = abs(cell % width - other % width);
+  const s32 dy = abs(cell / width - other / width);
+  const u32 diagonal = static_cast<u32>(std::min(dx, dy));
+  const u32 straight = static_cast<u32>(std::max(dx, dy)) - diagonal;
+  return diagonal * 15 + straight * 10;
+}
+
+ZoneGraph::ZoneGraph()
+{
+  width_ = 0;
+  height_ = 0;
+  sector_size_ = kZoneSectorSize;
+  num_zones_ = 0;
+}
+
+ZoneGraph::~ZoneGraph()
+{
+
+}
+
+s16 ZoneGraph::build(const Map& map, const std::vector<u32>* zone_ids, const s32 sector_size)
+{
+  clear();
+  if (map.width() == 0 || map.height() == 0) return kErrorCode_PathNotCreated;
+  const s32 cells = map.width() * map.height();
+  if (sector_size <= 0 || (zone_ids && static_cast<s32>(zone_ids->size()) != cells))
+  {
+    return kErrorCode_IncorrectPointsNumber;
+  }
+
+  try
+  {
+    width_ = map.width();
+    height_ = map.height();
+    sector_size_ = sector_size;
+    zone_.assign(cells, -1);
+
+    //Flood fill of the free cells with the same id and sector, the cells of each zone end up together
+    std::vector<s32> zone_cells;
+    std::vector<u32> zone_cell_start;
+    std::vector<s32> pending;
+    for (s32 cell = 0; cell < cells; ++cell)
+    {
+      if (zone_[cell] != -1 || map.isBlocked(cell % width_, cell / width_, 1)) continue;
+      const s32 zone = num_zones_++;
+      const u32 id = zone_ids ? (*zone_ids)[cell] : 0;
+      const s32 sector_x = (cell % width_) / sector_size_;
+      const s32 sector_y = (cell / width_) / sector_size_;
+      zone_cell_start.push_back(static_cast<u32>(zone_cells.size()));
+      zone_[cell] = zone;
+      pending.push_back(cell);
+      while (!pending.empty())
+      {
+        const s32 current = pending.back();
+        pending.pop_back();
+        zone_cells.push_back(current);
+        for (s32 i = 0; i < 8; ++i)
+        {
+          const s32 x = current % width_ + g_offset_x[i];
+          const s32 y = current / width_ + g_offset_y[i];
+          if (x < 0 || y < 0 || x >= width_ || y >= height_) continue;
+          if (x / sector_size_ != sector_x || y / sector_size_ != sector_y) continue;
+          const s32 neighbour = x + y * width_;
+          if (zone_[neighbour] != -1 || map.isBlocked(x, y, 1)) continue;
+          if (zone_ids && (*zone_ids)[neighbour] != id) continue;
+          zone_[neighbour] = zone;
+          pending.push_back(neighbour);
+        }
+      }
+    }
+    zone_cell_start.push_back(static_cast<u32>(zone_cells.size()));
+
+    //A portal pair per stretch of cells of a zone that touch a zone with a higher index
+    std::vector<std::vector<ZoneEdge>> links;
+    std::vector<std::pair<s32, s32>> touching;
+    std::vector<s32> border;
+    std::vector<s32> stretch;
+    for (s32 zone = 0; zone < num_zones_; ++zone)
+    {
+      touching.clear();
+      for (u32 i = zone_cell_start[zone]; i < zone_cell_start[zone + 1]; ++i)
+      {
+        const s32 cell = zone_cells[i];
+        for (s32 d = 0; d < 8; ++d)
+        {
+          const s32 x = cell % width_ + g_offset_x[d];
+          const s32 y = cell / width_ + g_offset_y[d];
+          if (x < 0 || y < 0 || x >= width_ || y >= height_) continue;
+          const s32 other = zone_[x + y * width_];
+          if (other > zone) touching.push_back(std::make_pair(other, cell));
+        }
+      }
+      std::sort(touching.begin(), touching.end());
+      touching.erase(std::unique(touching.begin(), touching.end()), touching.end());
+
+      for (size_t first = 0; first < touching.size();)
+      {
+        const s32 other = touching[first].first;
+        size_t last = first;
+        border.clear();
+        while (last < touching.size() && touching[last].first == other) border.push_back(touching[last++].second);
+        first = last;
+
+        //The border cells are split in stretches of cells next to each other
+        while (!border.empty())
+        {
+          stretch.clear();
+          stretch.push_back(border.back());
+          border.pop_back();
+          for (size_t i = 0; i < stretch.size(); ++i)
+          {
+            for (size_t j = 0; j < border.size();)
+            {
+              if (abs(border[j] % width_ - stretch[i] % width_) <= 1 && abs(border[j] / width_ - stretch[i] / width_) <= 1)
+              {
+                stretch.push_back(border[j]);
+                border[j] = border.back();
+                border.pop_back();
+              }
+              else
+              {
+                ++j;
+              }
+            }
+          }
+          std::sort(stretch.begin(), stretch.end());
+          const s32 cell = stretch[stretch.size() / 2];
+          for (s32 d = 0; d < 8; ++d)
+          {
+            const s32 x = cell % width_ + g_offset_x[d];
+            const s32 y = cell / width_ + g_offset_y[d];
+            if (x < 0 || y < 0 || x >= width_ || y >= height_ || zone_[x + y * width_] != other) continue;
+            const s32 portal = static_cast<s32>(portals_.size());
+            portals_.push_back(ZonePortal{ cell, zone, portal + 1 });
+            portals_.push_back(ZonePortal{ x + y * width_, other, portal });
+            links.resize(portals_.size());
+            links[portal].push_back(ZoneEdge{ portal + 1, g_step_cost[d] });
+            links[portal + 1].push_back(ZoneEdge{ portal, g_step_cost[d] });
+            break;
+          }
+        }
+      }
+    }
+
+    zone_portal_start_.assign(num_zones_ + 1, 0);
+    for (const ZonePortal& portal : portals_) zone_portal_start_[portal.zone + 1]++;
+    for (s32 zone = 0; zone < num_zones_; ++zone) zone_portal_start_[zone + 1] += zone_portal_start_[zone];
+    zone_portals_.resize(portals_.size());
+    std::vector<u32> next(zone_portal_start_.begin(), zone_portal_start_.end() - 1);
+    for (s32 portal = 0; portal < static_cast<s32>(portals_.size()); ++portal)
+    {
+      zone_portals_[next[portals_[portal].zone]++] = portal;
+    }
+
+    //The portals of a zone are joined by the shortest path inside the zone
+    std::vector<u32> costs;
+    for (s32 portal = 0; portal < static_cast<s32>(portals_.size()); ++portal)
+    {
+      const s32 zone = portals_[portal].zone;
+      zoneCosts(portals_[portal].cell, &costs);
+      for (u32 i = zone_portal_start_[zone]; i < zone_portal_start_[zone + 1]; ++i)
+      {
+        const s32 other = zone_portals_[i];
+        const u32 cost = costs[sectorIndex(portals_[other].cell)];
+        if (other != portal && cost != kZoneUnreached) links[portal].push_back(ZoneEdge{ other, cost });
+      }
+    }
+
+    edge_start_.assign(portals_.size() + 1, 0);
+    for (size_t portal = 0; portal < portals_.size(); ++portal)
+    {
+      edge_start_[portal + 1] = edge_start_[portal] + static_cast<u32>(links[portal].size());
+      edges_.insert(edges_.end(), links[portal].begin(), links[portal].end());
+    }
+  }
+  catch (const std::bad_alloc&)
+  {
+    clear();
+    return kErrorCode_Memory;
+  }
+  return kErrorCode_Ok;
+}
+
+void ZoneGraph::clear()
+{
+  width_ = 0;
+  height_ = 0;
+  num_zones_ = 0;
+  zone_.clear();
+  portals_.clear();
+  edge_start_.clear();
+  edges_.clear();
+  zone_portal_start_.clear();
+  zone_portals_.clear();
+}
+
+bool ZoneGraph::isBuilt() const
+{
+  return width_ > 0;
+}
+
+s32 ZoneGraph::numZones() const
+{
+  return num_zones_;
+}
+
+s32 ZoneGraph::numPortals() const
+{
+  return static_cast<s32>(portals_.size());
+}
+
+s32 ZoneGraph::zone(const s32 x, const s32 y) const
+{
+  if (x < 0 || y < 0 || x >= width_ || y >= height_) return -1;
+  return zone_[x + y * width_];
+}
+
+s16 ZoneGraph::findCorridor(const s32 origin, const s32 dst, std::vector<u8>* corridor) const
+{
+  if (!corridor) return kErrorCode_InvalidPointer;
+  const s32 cells = width_ * height_;
+  if (origin < 0 || origin >= cells || zone_[origin] == -1) return kErrorCode_InvalidOrigin;
+  if (dst < 0 || dst >= cells || zone_[dst] == -1) return kErrorCode_InvalidDestination;
+
+  const s32 origin_zone = zone_[origin];
+  const s32 dst_zone = zone_[dst];
+  corridor->assign(num_zones_, 0);
+  (*corridor)[origin_zone] = 1;
+  (*corridor)[dst_zone] = 1;
+  if (origin_zone == dst_zone) return kErrorCode_Ok;
+
+  std::vector<u32> origin_costs;
+  std::vector<u32> dst_costs;
+  zoneCosts(origin, &origin_costs);
+  zoneCosts(dst, &dst_costs);
+
+  //A* over the portals, the last node is the destination
+  const s32 goal = static_cast<s32>(portals_.size());
+  std::vector<u32> g(portals_.size() + 1, kZoneUnreached);
+  std::vector<s32> parent(portals_.size() + 1, -1);
+  ZoneOpenList open;
+  auto heuristic = [this, goal, dst](const s32 portal) {
+    return portal == goal ? 0 : Octile(portals_[portal].cell, dst, width_);
+  };
+  for (u32 i = zone_portal_start_[origin_zone]; i < zone_portal_start_[origin_zone + 1]; ++i)
+  {
+    const s32 portal = zone_portals_[i];
+    const u32 cost = origin_costs[sectorIndex(portals_[portal].cell)];
+    if (cost == kZoneUnreached) continue;
+    g[portal] = cost;
+    open.push(ZoneOpenEntry(cost + heuristic(portal), portal));
+  }
+
+  while (!open.empty())
+  {
+    const ZoneOpenEntry current = open.top();
+    open.pop();
+    const s32 portal = current.second;
+    if (portal == goal) break;
+    //Entries of portals that were improved after being pushed are discarded
+    if (current.first != g[portal] + heuristic(portal)) continue;
+
+    if (portals_[portal].zone == dst_zone)
+    {
+      const u32 cost = dst_costs[sectorIndex(portals_[portal].cell)];
+      if (cost != kZoneUnreached && g[portal] + cost < g[goal])
+      {
+        g[goal] = g[portal] + cost;
+        parent[goal] = portal;
+        open.push(ZoneOpenEntry(g[goal], goal));
+      }
+    }
+    for (u32 i = edge_start_[portal]; i < edge_start_[portal + 1]; ++i)
+    {
+      const ZoneEdge& edge = edges_[i];
+      const u32 cost = g[portal] + edge.cost;
+      if (cost >= g[edge.portal]) continue;
+      g[edge.portal] = cost;
+      parent[edge.portal] = portal;
+      open.push(ZoneOpenEntry(cost + heuristic(edge.portal), edge.portal));
+    }
+  }
+
+  if (g[goal] == kZoneUnreached) return kErrorCode_PathNotFound;
+  for (s32 portal = parent[goal]; portal != -1; portal = parent[portal])
+  {
+    (*corridor)[portals_[portal].zone] = 1;
+  }
+  return kErrorCode_Ok;
+}
+
+void ZoneGraph::zoneCosts(const s32 cell, std::vector<u32>* costs) const
+{
+  costs->assign(sector_size_ * sector_size_, kZoneUnreached);
+  const s32 zone = zone_[cell];
+  ZoneOpenList open;
+  (*costs)[sectorIndex(cell)] = 0;
+  open.push(ZoneOpenEntry(0, cell));
+  while (!open.empty())
+  {
+    const ZoneOpenEntry current = open.top();
+    open.pop();
+    if (current.first != (*costs)[sectorIndex(current.second)]) continue;
+    for (s32 i = 0; i < 8; ++i)
+    {
+      const s32 x = current.second % width_ + g_offset_x[i];
+      const s32 y = current.second / width_ + g_offset_y[i];
+      if (x < 0 || y < 0 || x >= width_ || y >= height_ || zone_[x + y * width_] != zone) continue;
+      const s32 neighbour = x + y * width_;
+      const u32 cost = current.first + g_step_cost[i];
+      u32& best = (*costs)[sectorIndex(neighbour)];
+      if (cost >= best) continue;
+      best = cost;
+      open.push(ZoneOpenEntry(cost, neighbour));
+    }
+  }
+}
+
+s32 ZoneGraph::sectorIndex(const s32 cell) const
+{
+  return (cell % width_) % sector_size_ + ((cell / width_) % sector_size_) * sector_size_;
+}
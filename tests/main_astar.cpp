@@ -8,11 +8,16 @@
 #include "ESAT/input.h"
 #include "ESAT/draw.h"
 #include "path_finder.h"
+#include "asset_cache.h"
+#include "profiler.h"
+#include <cstring>
 
 GameState& g_game_state = GameState::instance();
 bool g_mouse_pressed = false;
 bool g_f1_pressed = false;
 bool g_f2_pressed = false;
+//Path asked with F1, calculated a bit every frame so the window doesn't freeze
+PathHandle g_path;
 /*
 * TESTS
 *  Not found(trying to go through water
@@ -49,7 +54,7 @@ Float2 g_dst = Float2{ 374.0f,448.0f };
 void Init() {
   printf("Environment initialized destiny is {374.0f,448.0}\n");
   printf("If you wish to change the destination press the left click mouse button\n");
-  printf("Press F1 to calculate the A* \n");
+  printf("Press F1 to calculate the A* and F2 to follow the path once it's ready \n");
   g_mouse_pressed = false;
   //game_state_.actual_command_ = kNothing;
   g_game_state.quit_game_ = false;
@@ -61,7 +66,11 @@ void Init() {
   //Maximum time in milliseconds for our frequency (1/frequency)
   g_game_state.time_step_ = static_cast<uint32_t>((1.0 / g_game_state.frequency_) * 1000);
 
+  //The sprite of the agents is decoded by the asset cache while the window opens
+  AssetCache::instance().preload(Agent::spritePath(AgentType::k_Hero));
+
   ESAT::WindowInit(960, 704);
+  g_game_state.ai_lod_.set_viewport(Float2(0.0f, 0.0f), Float2(960.0f, 704.0f));
   ESAT::WindowSetMouseVisibility(true);
 
 
@@ -71,9 +80,18 @@ void Init() {
   /*g_game_state.map_.loadMap("../../../data/gfx/maps/map_03_60x44_cost.png",
     "../../../data/gfx/maps/map_03_960x704_layout ABGS.png");*/
 
+  /*Full resolution map solved from coarse to fine, the coarser levels are derived
+  * so they never report a reachable position as unreachable
+  g_game_state.map_.loadMap("../../../data/gfx/maps/map_03_960x704_cost.png",
+    "../../../data/gfx/maps/map_03_960x704_layout ABGS.png");
+  g_game_state.map_.buildLevels(4);*/
+
 
   g_game_state.pf_agent_ = new PathFinder();
+  //This project tells when the path is ready, the searches don't print by default
+  g_game_state.pf_agent_->set_logging(true);
   g_game_state.num_agents_++;
+  //g_game_state.pf_agent_->set_mode(AStarMode::k_CoarseToFine);
   
 
   g_game_state.agents_.emplace_back(new Agent(AgentType::k_Hero, g_origin.x, g_origin.y, g_game_state.pf_agent_));
@@ -88,6 +106,7 @@ void Init() {
 */
 void InputService()
 {
+  PROFILE_ZONE("InputService");
   if (ESAT::IsSpecialKeyDown(ESAT::kSpecialKey_Escape))
   {
     //game_state_.actual_command_ = kExit;
@@ -96,6 +115,10 @@ void InputService()
   if (ESAT::MouseButtonDown(0)) g_mouse_pressed = true;
   if (ESAT::IsSpecialKeyDown(ESAT::kSpecialKey_F1)) g_f1_pressed = true;
   if (ESAT::IsSpecialKeyDown(ESAT::kSpecialKey_F2)) g_f2_pressed = true;
+  //F3 prints the zones measured since the last F3, F4 writes them for chrome://tracing
+  if (ESAT::IsSpecialKeyDown(ESAT::kSpecialKey_F3)) Profiler::instance().printSummary();
+  if (ESAT::IsSpecialKeyDown(ESAT::kSpecialKey_F4)) Profiler::instance().exportChromeTrace("profile_trace.json");
+  if (ESAT::IsSpecialKeyDown(ESAT::kSpecialKey_F5)) g_game_state.pf_agent_->stats().print();
 }
 
 /** @brief Update
@@ -107,6 +130,7 @@ void InputService()
 */
 void Update(uint32_t dt)
 {
+  PROFILE_ZONE("Update");
   if (!ESAT::WindowIsOpened()) g_game_state.quit_game_ = true;
   if (g_game_state.should_game_end_) g_game_state.quit_game_ = true;
   if (g_mouse_pressed) {
@@ -117,18 +141,22 @@ void Update(uint32_t dt)
   if(g_f1_pressed)
   {
     g_f1_pressed = false;
-    g_game_state.agents_[0]->prepareAStar(g_origin, g_dst);
+    g_path = g_game_state.agents_[0]->requestPath(g_origin, g_dst);
   }
   if(g_f2_pressed)
   {
     g_f2_pressed = false;
-    g_game_state.agents_[0]->startAStar();
-    
-  }
-  for (Agent* agent : g_game_state.agents_)
-  {
-    agent->update(dt);
+    if (g_path.poll() == PathHandleStatus::k_Ready)
+    {
+      g_game_state.agents_[0]->startAStar();
+    }
+    else
+    {
+      printf("The path is not ready\n");
+    }
   }
+  g_game_state.pf_agent_->update(dt);
+  g_game_state.updateAgents(dt);
   
 }
 
@@ -139,6 +167,7 @@ void Update(uint32_t dt)
 * @return void
 */
 void Draw() {
+  PROFILE_ZONE("Draw");
   ESAT::DrawBegin();
   ESAT::DrawClear(0, 0, 0);
   ESAT::DrawSetFillColor(255, 0, 0);
@@ -187,6 +216,12 @@ int ESAT::main(int argc, char **argv) {
 
 
   Init();
+  //--record file writes the session so the Headless project can replay it
+  if (argc > 2 && strcmp(argv[1], "--record") == 0 &&
+      g_game_state.recorder_.begin(argv[2], g_game_state, g_game_state.time_step_) != kErrorCode_Ok)
+  {
+    printf("Couldn't record the session at %s\n", argv[2]);
+  }
   //unsigned int frames = 0;
   double current_time = Time();
   //double loop_last_time = Time();
@@ -213,6 +248,7 @@ int ESAT::main(int argc, char **argv) {
     loop_last_time = loop_actual_time;
     }*/
   }
+  g_game_state.recorder_.end();
   Deinit();
   return 0;
 }
\ No newline at end of file
@@ -11,8 +11,11 @@
 #include <cstdint>
 #include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <agent.h>
 #include <gamestate.h>
+#include <asset_cache.h>
+#include <profiler.h>
 
 //typedef enum
 //{
@@ -43,7 +46,13 @@ void Init() {
   //Maximum time in milliseconds for our frequency (1/frequency)
   g_game_state.time_step_ = static_cast<uint32_t>((1.0 / g_game_state.frequency_) * 1000);
 
+  //The sprites of the agents are decoded by the asset cache while the window opens
+  AssetCache::instance().preload(Agent::spritePath(AgentType::k_Small));
+  AssetCache::instance().preload(Agent::spritePath(AgentType::k_Normal));
+  AssetCache::instance().preload(Agent::spritePath(AgentType::k_Huge));
+
   ESAT::WindowInit(1280, 720);
+  g_game_state.ai_lod_.set_viewport(Float2(0.0f, 0.0f), Float2(1280.0f, 720.0f));
 
 
   //g_game_state.agents_.emplace_back(new Agent(AgentType::k_Small, 1000, 500));
@@ -93,6 +102,7 @@ void Init() {
 * @return void
 */
 void Draw() {
+  PROFILE_ZONE("Draw");
   ESAT::DrawBegin();
   ESAT::DrawClear(0, 0, 0);
   ESAT::DrawSetFillColor(255, 0, 0);
@@ -116,11 +126,20 @@ void Draw() {
 */
 void InputService()
 {
+  PROFILE_ZONE("InputService");
   if (ESAT::IsSpecialKeyDown(ESAT::kSpecialKey_Escape))
   {
     //game_state_.actual_command_ = kExit;
     g_game_state.should_game_end_ = true;
   }
+  if (ESAT::IsSpecialKeyDown(ESAT::kSpecialKey_F2))
+  {
+    g_game_state.ai_lod_.printStats();
+    AssetCache::instance().printStats();
+  }
+  //F3 prints the zones measured since the last F3, F4 writes them for chrome://tracing
+  if (ESAT::IsSpecialKeyDown(ESAT::kSpecialKey_F3)) Profiler::instance().printSummary();
+  if (ESAT::IsSpecialKeyDown(ESAT::kSpecialKey_F4)) Profiler::instance().exportChromeTrace("profile_trace.json");
 }
 
 /** @brief Update
@@ -132,12 +151,10 @@ void InputService()
 */
 void Update(uint32_t dt)
 {
+  PROFILE_ZONE("Update");
   if (!ESAT::WindowIsOpened()) g_game_state.quit_game_ = true;
   if (g_game_state.should_game_end_) g_game_state.quit_game_ = true;
-  for (Agent* agent : g_game_state.agents_)
-  {
-    agent->update(dt);
-  }
+  g_game_state.updateAgents(dt);
 }
 
 /** @brief Deinit
@@ -169,6 +186,12 @@ int ESAT::main(int argc, char **argv) {
 
 
   Init();
+  //--record file writes the session so the Headless project can replay it
+  if (argc > 2 && strcmp(argv[1], "--record") == 0 &&
+      g_game_state.recorder_.begin(argv[2], g_game_state, g_game_state.time_step_) != kErrorCode_Ok)
+  {
+    printf("Couldn't record the session at %s\n", argv[2]);
+  }
   //unsigned int frames = 0;
   double current_time = Time();
   //double loop_last_time = Time();
@@ -195,6 +218,7 @@ int ESAT::main(int argc, char **argv) {
     loop_last_time = loop_actual_time;
     }*/
   }
+  g_game_state.recorder_.end();
   Deinit();
   return 0;
 }
\ No newline at end of file
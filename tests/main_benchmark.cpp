@@ -0,0 +1,467 @@
+// main_benchmark.cpp
+// Jose Maria Martinez
+// Benchmark of the path finding searches without window
+
+#include "ESAT/window.h"
+#include "ESAT/time.h"
+#include "astar.h"
+#include "map.h"
+#include "nav_mesh.h"
+#include "path.h"
+#include "path_store.h"
+#include "common_def.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+struct BenchmarkQuery
+{
+  Float2 origin;
+  Float2 dst;
+};
+
+/** @brief Generates random queries between free cells
+*
+* Uses a fixed seed so every run measures the same queries
+*
+* @param map map where the queries are generated
+* @param num_queries number of queries
+* @return std::vector<BenchmarkQuery> queries in map coordinates
+*/
+std::vector<BenchmarkQuery> GenerateQueries(const Map& map, const s32 num_queries)
+{
+  std::vector<BenchmarkQuery> queries;
+  srand(1234);
+  const Float2 ratio = map.ratio();
+  while (static_cast<s32>(queries.size()) < num_queries)
+  {
+    const s32 origin_x = rand() % map.width();
+    const s32 origin_y = rand() % map.height();
+    const s32 dst_x = rand() % map.width();
+    const s32 dst_y = rand() % map.height();
+    if (map.isBlocked(origin_x, origin_y, 1) || map.isBlocked(dst_x, dst_y, 1)) continue;
+    queries.push_back(BenchmarkQuery{ Float2(origin_x * ratio.x, origin_y * ratio.y),
+                                      Float2(dst_x * ratio.x, dst_y * ratio.y) });
+  }
+  return queries;
+}
+
+/** @brief Measures the hash distributed search with different threads
+*
+* Solves every query with each number of threads and prints the time, the
+* speedup against one thread, the expanded nodes and the balance between
+* threads. The cost of every path is checked against the one thread search.
+*
+* @param map map where the queries are solved
+* @param queries queries to solve
+* @param thread_counts numbers of threads to measure, the first one is the reference
+* @return void
+*/
+void BenchmarkHashDistributed(const Map& map, const std::vector<BenchmarkQuery>& queries,
+                              const std::vector<u32>& thread_counts)
+{
+  std::vector<u32> reference_costs;
+  double reference_time = 0.0;
+
+  printf("\nHDA* %d queries\n", static_cast<s32>(queries.size()));
+  printf("threads    total ms   ms/query   speedup   expanded   msg/exp   balance   wrong\n");
+  for (const u32 threads : thread_counts)
+  {
+    AStar a_star;
+    a_star.set_mode(AStarMode::k_HashDistributed);
+    a_star.set_num_threads(threads);
+
+    u64 expansions = 0;
+    u64 messages = 0;
+    double balance = 0.0;
+    s32 wrong_costs = 0;
+    double total_time = 0.0;
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+      Path path;
+      const double start_time = ESAT::Time();
+      a_star.generatePath(queries[i].origin, queries[i].dst, &path, map);
+      total_time += ESAT::Time() - start_time;
+
+      const AStarParallelStats stats = a_star.parallelStats();
+      expansions += stats.expansions;
+      messages += stats.messages;
+      if (stats.expansions > 0)
+      {
+        balance += static_cast<double>(stats.max_thread_expansions) * stats.threads / stats.expansions;
+      }
+      if (reference_costs.size() < queries.size()) reference_costs.push_back(stats.cost);
+      else if (reference_costs[i] != stats.cost) wrong_costs++;
+    }
+    if (reference_time == 0.0) reference_time = total_time;
+
+    printf("%7u %11.1f %10.2f %9.2f %10llu %9.3f %9.2f %7d\n", threads, total_time,
+           total_time / queries.size(), total_time > 0.0 ? reference_time / total_time : 0.0,
+           static_cast<unsigned long long>(expansions),
+           expansions ? static_cast<double>(messages) / expansions : 0.0,
+           balance / queries.size(), wrong_costs);
+  }
+}
+
+/** @brief returns the cost of a path in units of the A*
+*
+* @param map map of the path, the points are converted to cells with its ratio
+* @param path path calculated
+* @return u64 octile cost between the consecutive points of the path
+*/
+u64 PathCost(const Map& map, Path* path)
+{
+  const Float2 ratio = map.ratio();
+  u64 cost = 0;
+  const Float2* previous = nullptr;
+  for (u16 i = 0; i < path->total_points_; i++)
+  {
+    const Float2* point = path->nextPoint();
+    if (!point) break;
+    if (previous)
+    {
+      const s32 dx = abs(static_cast<s32>(lroundf((point->x - previous->x) / ratio.x)));
+      const s32 dy = abs(static_cast<s32>(lroundf((point->y - previous->y) / ratio.y)));
+      cost += std::min(dx, dy) * 15 + (std::max(dx, dy) - std::min(dx, dy)) * 10;
+    }
+    previous = point;
+  }
+  return cost;
+}
+
+/** @brief Measures the classic A* restricted to the corridor of zones
+*
+* Solves every query with the whole map and with the corridor found on the
+* zones, and prints the time, the expanded nodes, the biggest open list and
+* how much longer the paths of the corridor are.
+*
+* @param map map where the queries are solved, with its zones built
+* @param queries queries to solve
+* @return void
+*/
+void BenchmarkZones(const Map& map, const std::vector<BenchmarkQuery>& queries)
+{
+  printf("\nZones %d queries\n", static_cast<s32>(queries.size()));
+  printf("search       total ms   ms/query   expanded   peak open   not found   cost\n");
+  std::vector<u64> reference_costs(queries.size(), 0);
+  std::vector<u8> corridor;
+  const Float2 ratio = map.ratio();
+  for (s32 use_zones = 0; use_zones < 2; use_zones++)
+  {
+    AStar a_star;
+    u64 expanded = 0;
+    u64 peak_open = 0;
+    s32 not_found = 0;
+    u64 cost = 0;
+    u64 reference_cost = 0;
+    double total_time = 0.0;
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+      Path path;
+      const double start_time = ESAT::Time();
+      if (use_zones)
+      {
+        const s32 origin = static_cast<s32>(queries[i].origin.x / ratio.x) +
+                           static_cast<s32>(queries[i].origin.y / ratio.y) * map.width();
+        const s32 dst = static_cast<s32>(queries[i].dst.x / ratio.x) +
+                        static_cast<s32>(queries[i].dst.y / ratio.y) * map.width();
+        const bool found = map.zones().findCorridor(origin, dst, &corridor) == kErrorCode_Ok;
+        a_star.set_zone_corridor(found ? &corridor : nullptr);
+      }
+      const s16 result = a_star.generatePath(queries[i].origin, queries[i].dst, &path, map);
+      total_time += ESAT::Time() - start_time;
+
+      const PathQueryStats query = a_star.lastQuery();
+      expanded += query.expanded;
+      peak_open = std::max(peak_open, query.peak_open);
+      if (result != kErrorCode_Ok)
+      {
+        not_found++;
+        continue;
+      }
+      const u64 path_cost = PathCost(map, &path);
+      if (!use_zones) reference_costs[i] = path_cost;
+      if (reference_costs[i] == 0) continue;
+      cost += path_cost;
+      reference_cost += reference_costs[i];
+    }
+    printf("%-10s %10.1f %10.2f %10llu %11llu %11d %6.3f\n", use_zones ? "corridor" : "whole map", total_time,
+           total_time / queries.size(), static_cast<unsigned long long>(expanded),
+           static_cast<unsigned long long>(peak_open), not_found,
+           reference_cost ? static_cast<double>(cost) / reference_cost : 0.0);
+  }
+}
+
+/** @brief Measures a path in cells
+*
+* @param map map of the path, the points are converted to cells with its ratio
+* @param path path calculated
+* @param crosses_walls set to true if an agent of one cell following the lines overlaps a blocked cell
+* @return double length of the straight lines between the points of the path
+*/
+double PathLength(const Map& map, Path* path, bool* crosses_walls)
+{
+  const Float2 ratio = map.ratio();
+  double length = 0.0;
+  const Float2* previous = nullptr;
+  for (u16 i = 0; i < path->total_points_; i++)
+  {
+    const Float2* point = path->nextPoint();
+    if (!point) break;
+    if (previous)
+    {
+      //The points are the corners of the cells of the agent, its center is half a cell further
+      const Float2 from(previous->x / ratio.x + 0.5f, previous->y / ratio.y + 0.5f);
+      const Float2 to(point->x / ratio.x + 0.5f, point->y / ratio.y + 0.5f);
+      const float segment = (to - from).Length();
+      length += segment;
+      const s32 samples = static_cast<s32>(segment * 20.0f) + 1;
+      for (s32 j = 0; j <= samples; j++)
+      {
+        //The corners of the agent, a bit inside so touching a wall is not crossing it
+        const Float2 sample = from + (to - from) * (static_cast<float>(j) / samples);
+        for (s32 corner = 0; corner < 4; corner++)
+        {
+          const float corner_x = sample.x + ((corner & 1) ? 0.49f : -0.49f);
+          const float corner_y = sample.y + ((corner & 2) ? 0.49f : -0.49f);
+          if (map.isBlocked(static_cast<s32>(floorf(corner_x)), static_cast<s32>(floorf(corner_y)), 1))
+          {
+            *crosses_walls = true;
+          }
+        }
+      }
+    }
+    previous = point;
+  }
+  return length;
+}
+
+/** @brief Compares the classic A* with the navigation mesh
+*
+* Solves every query with both and prints the time, the nodes expanded, the
+* points and length of the paths and the paths whose agent would overlap a
+* wall. The A* moves in diagonal next to the corners, so it overlaps them.
+*
+* @param map map where the queries are solved
+* @param queries queries to solve
+* @return void
+*/
+void BenchmarkNavMesh(const Map& map, const std::vector<BenchmarkQuery>& queries)
+{
+  NavMesh mesh;
+  const double build_start = ESAT::Time();
+  if (mesh.build(map) != kErrorCode_Ok)
+  {
+    printf("Unable to build the navigation mesh\n");
+    return;
+  }
+  s32 free_cells = 0;
+  for (s32 y = 0; y < map.height(); y++)
+  {
+    for (s32 x = 0; x < map.width(); x++)
+    {
+      if (!map.isBlocked(x, y, 1)) free_cells++;
+    }
+  }
+  printf("Navigation mesh: %u polygons for %d free cells, %u links, built in %.2f ms\n", mesh.numPolygons(),
+         free_cells, mesh.numLinks(), ESAT::Time() - build_start);
+
+  printf("\nNavigation mesh %d queries\n", static_cast<s32>(queries.size()));
+  printf("search     total ms   ms/query   expanded   points   length   not found   overlap walls\n");
+  std::vector<double> reference_lengths(queries.size(), 0.0);
+  for (s32 use_mesh = 0; use_mesh < 2; use_mesh++)
+  {
+    AStar a_star;
+    u64 expanded = 0;
+    u64 points = 0;
+    s32 not_found = 0;
+    s32 cross_walls = 0;
+    double length = 0.0;
+    double reference_length = 0.0;
+    double total_time = 0.0;
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+      Path path;
+      const double start_time = ESAT::Time();
+      const s16 result = use_mesh ? mesh.generatePath(queries[i].origin, queries[i].dst, &path, map) :
+                                    a_star.generatePath(queries[i].origin, queries[i].dst, &path, map);
+      total_time += ESAT::Time() - start_time;
+
+      expanded += use_mesh ? mesh.lastExpanded() : a_star.lastQuery().expanded;
+      if (result != kErrorCode_Ok)
+      {
+        not_found++;
+        continue;
+      }
+      points += path.total_points_;
+      bool crosses_walls = false;
+      const double path_length = PathLength(map, &path, &crosses_walls);
+      if (crosses_walls) cross_walls++;
+      if (!use_mesh) reference_lengths[i] = path_length;
+      if (reference_lengths[i] == 0.0) continue;
+      length += path_length;
+      reference_length += reference_lengths[i];
+    }
+    printf("%-8s %10.1f %10.3f %10llu %8llu %8.3f %11d %15d\n", use_mesh ? "navmesh" : "A*", total_time,
+           total_time / queries.size(), static_cast<unsigned long long>(expanded),
+           static_cast<unsigned long long>(points), reference_length > 0.0 ? length / reference_length : 0.0,
+           not_found, cross_walls);
+  }
+}
+
+/** @brief Measures the paths served by a persistent store
+*
+* Solves the queries several rounds, taking the paths from the store and
+* searching with the A* the ones that are not stored. The routes become hot
+* and are written after kPathStoreHotRoute rounds, the next rounds and the
+* next runs with the same database don't search. The time of the first round
+* is stored as a result of the map.
+*
+* @param map map where the queries are solved
+* @param queries queries to solve
+* @param store open store
+* @return void
+*/
+void BenchmarkStore(const Map& map, const std::vector<BenchmarkQuery>& queries, PathStore* store)
+{
+  printf("\nPath store %d queries\n", static_cast<s32>(queries.size()));
+  printf("round   total ms   ms/query   from store   searched   not found\n");
+  double first_round = 0.0;
+  for (s32 round = 0; round <= kPathStoreHotRoute; round++)
+  {
+    AStar a_star;
+    s32 hits = 0;
+    s32 searched = 0;
+    s32 not_found = 0;
+    double total_time = 0.0;
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+      Path path;
+      const double start_time = ESAT::Time();
+      s16 result = store->findPath(map, queries[i].origin, queries[i].dst, &path);
+      if (result == kErrorCode_Ok)
+      {
+        hits++;
+      }
+      else
+      {
+        searched++;
+        result = a_star.generatePath(queries[i].origin, queries[i].dst, &path, map);
+        if (result == kErrorCode_Ok) store->recordPath(map, queries[i].origin, queries[i].dst, path);
+      }
+      total_time += ESAT::Time() - start_time;
+      if (result != kErrorCode_Ok) not_found++;
+    }
+    if (round == 0) first_round = total_time / queries.size();
+    printf("%5d %10.1f %10.3f %12d %10d %11d\n", round, total_time, total_time / queries.size(), hits, searched,
+           not_found);
+    //The writes are visible to the next round
+    store->flush();
+  }
+  store->storeResult(map.contentHash(), "store first round ms/query", first_round);
+  store->flush();
+  const PathStoreCounters counters = store->counters();
+  printf("%llu rows written in %llu transactions, %llu failed\n", static_cast<unsigned long long>(counters.writes),
+         static_cast<unsigned long long>(counters.transactions),
+         static_cast<unsigned long long>(counters.failed_writes));
+}
+
+/* Usage: Benchmark [map] [queries] [threads ...]
+*         Benchmark --zones <zones image|sectors> [map] [queries]
+*         Benchmark --navmesh [map] [queries]
+*         Benchmark --store <database> [map] [queries]
+*  The balance is the expansions of the busiest thread against a perfect split, 1 is perfect
+*  The cost of the zones is the one of the paths against the ones of the whole map, 1 is the same
+*  The length of the navigation mesh is the one of its paths against the ones of the A*
+*  Run --store twice with the same database to measure a warm restart
+*/
+int ESAT::main(int argc, char **argv) {
+  if (argc > 2 && strcmp(argv[1], "--store") == 0)
+  {
+    const char* map_src = argc > 3 ? argv[3] : "../../../data/gfx/maps/map_03_120x88_cost.png";
+    const s32 queries = argc > 4 ? atoi(argv[4]) : 200;
+    Map map;
+    if (map.loadCollision(map_src) != kErrorCode_Ok)
+    {
+      printf("Unable to load %s\n", map_src);
+      return 1;
+    }
+    PathStore store;
+    if (store.open(argv[2]) != kErrorCode_Ok) return 1;
+    printf("%s %dx%d, store %s\n", map_src, map.width(), map.height(), argv[2]);
+    BenchmarkStore(map, GenerateQueries(map, queries), &store);
+    return 0;
+  }
+  if (argc > 1 && strcmp(argv[1], "--navmesh") == 0)
+  {
+    const char* map_src = argc > 2 ? argv[2] : "../../../data/gfx/maps/map_03_120x88_cost.png";
+    const s32 queries = argc > 3 ? atoi(argv[3]) : 200;
+    Map map;
+    if (map.loadCollision(map_src) != kErrorCode_Ok)
+    {
+      printf("Unable to load %s\n", map_src);
+      return 1;
+    }
+    printf("%s %dx%d\n", map_src, map.width(), map.height());
+    BenchmarkNavMesh(map, GenerateQueries(map, queries));
+    return 0;
+  }
+  if (argc > 2 && strcmp(argv[1], "--zones") == 0)
+  {
+    const char* zones_src = argv[2];
+    const char* map_src = argc > 3 ? argv[3] : "../../../data/gfx/maps/map_03_120x88_cost.png";
+    const s32 queries = argc > 4 ? atoi(argv[4]) : 200;
+    Map map;
+    if (map.loadCollision(map_src) != kErrorCode_Ok)
+    {
+      printf("Unable to load %s\n", map_src);
+      return 1;
+    }
+    const double start_time = ESAT::Time();
+    //Without image the zones are only split by sectors
+    const bool sectors = strcmp(zones_src, "sectors") == 0;
+    if ((sectors ? map.buildZones() : map.loadZones(zones_src)) != kErrorCode_Ok)
+    {
+      printf("Unable to load the zones %s\n", zones_src);
+      return 1;
+    }
+    printf("%s %dx%d, %d zones, %d portals, built in %.2f ms\n", map_src, map.width(), map.height(),
+           map.zones().numZones(), map.zones().numPortals(), ESAT::Time() - start_time);
+    BenchmarkZones(map, GenerateQueries(map, queries));
+    return 0;
+  }
+
+  const char* src = argc > 1 ? argv[1] : "../../../data/gfx/maps/map_03_960x704_cost.png";
+  const s32 num_queries = argc > 2 ? atoi(argv[2]) : 20;
+
+  std::vector<u32> thread_counts;
+  for (s32 i = 3; i < argc; i++)
+  {
+    thread_counts.push_back(static_cast<u32>(atoi(argv[i])));
+  }
+  if (thread_counts.empty())
+  {
+    const u32 cores = std::max(1u, std::thread::hardware_concurrency());
+    for (u32 threads = 1; threads < cores; threads *= 2)
+    {
+      thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(cores);
+  }
+
+  Map map;
+  if (map.loadCollision(src) != kErrorCode_Ok)
+  {
+    printf("Unable to load %s\n", src);
+    return 1;
+  }
+  printf("%s %dx%d\n", src, map.width(), map.height());
+
+  const std::vector<BenchmarkQuery> queries = GenerateQueries(map, num_queries);
+  BenchmarkHashDistributed(map, queries, thread_counts);
+  return 0;
+}
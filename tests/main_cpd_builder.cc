@@ -0,0 +1,133 @@
+// main_cpd_builder.cc
+// Jose Maria Martinez
+// Offline builder of the compressed path databases of the maps
+
+#include "ESAT/window.h"
+#include "ESAT/time.h"
+#include "map.h"
+#include "compressed_path_database.h"
+#include "nav_mesh.h"
+#include "common_def.h"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+//Maps built when no map is given in the command line
+const char* g_default_maps[] = { "../../../data/gfx/maps/map_01_32x32_cost.txt",
+                                 "../../../data/gfx/maps/map_02_32x32_cost.txt",
+                                 "../../../data/gfx/maps/map_04_128x128_cost.png" };
+
+/** @brief Builds the database of a map
+*
+* Loads the collision data of the map and writes its database next to it
+*
+* @param src path of the collision data of the map
+* @param num_threads threads used to build the database, 0 uses one per core
+* @return s16 status of the operation
+*/
+s16 BuildDatabase(const char* src, u32 num_threads)
+{
+  Map map;
+  s16 status = map.loadCollision(src);
+  if (status != kErrorCode_Ok)
+  {
+    printf("Unable to load %s (%d)\n", src, status);
+    return status;
+  }
+
+  const std::string file = std::string(src) + ".cpd";
+  const double start_time = ESAT::Time();
+  status = CompressedPathDatabase::build(map, file.c_str(), num_threads);
+  if (status != kErrorCode_Ok)
+  {
+    printf("Unable to build %s (%d)\n", file.c_str(), status);
+    return status;
+  }
+
+  CompressedPathDatabase database;
+  status = database.load(file.c_str(), map);
+  if (status != kErrorCode_Ok)
+  {
+    printf("Unable to load the database %s (%d)\n", file.c_str(), status);
+    return status;
+  }
+  printf("%s: %dx%d built in %.0f ms\n", file.c_str(), map.width(), map.height(), ESAT::Time() - start_time);
+  return kErrorCode_Ok;
+}
+
+/** @brief Builds the navigation mesh of a map
+*
+* Loads the collision data of the map and writes its mesh next to it
+*
+* @param src path of the collision data of the map
+* @return s16 status of the operation
+*/
+s16 BuildNavMesh(const char* src)
+{
+  Map map;
+  s16 status = map.loadCollision(src);
+  if (status != kErrorCode_Ok)
+  {
+    printf("Unable to load %s (%d)\n", src, status);
+    return status;
+  }
+
+  const std::string file = std::string(src) + ".nav";
+  const double start_time = ESAT::Time();
+  NavMesh mesh;
+  status = mesh.build(map);
+  if (status == kErrorCode_Ok) status = mesh.save(file.c_str());
+  if (status != kErrorCode_Ok)
+  {
+    printf("Unable to build %s (%d)\n", file.c_str(), status);
+    return status;
+  }
+
+  status = mesh.load(file.c_str(), map);
+  if (status != kErrorCode_Ok)
+  {
+    printf("Unable to load the mesh %s (%d)\n", file.c_str(), status);
+    return status;
+  }
+  printf("%s: %dx%d, %u polygons and %u links built in %.0f ms\n", file.c_str(), map.width(), map.height(),
+         mesh.numPolygons(), mesh.numLinks(), ESAT::Time() - start_time);
+  return kErrorCode_Ok;
+}
+
+/* Usage: CPD_Builder [-t threads] [--navmesh] [map ...]
+*  Without maps the databases of the maps with a CPD backend are built
+*  With --navmesh the navigation meshes are built instead of the databases
+*/
+int ESAT::main(int argc, char **argv) {
+  u32 num_threads = 0;
+  s32 first_map = 1;
+  if (argc > 2 && std::string(argv[1]) == "-t")
+  {
+    num_threads = static_cast<u32>(atoi(argv[2]));
+    first_map = 3;
+  }
+  bool nav_mesh = false;
+  if (first_map < argc && std::string(argv[first_map]) == "--navmesh")
+  {
+    nav_mesh = true;
+    first_map++;
+  }
+  auto build = [&](const char* src) { return nav_mesh ? BuildNavMesh(src) : BuildDatabase(src, num_threads); };
+
+  s32 errors = 0;
+  if (first_map >= argc)
+  {
+    for (const char* src : g_default_maps)
+    {
+      if (build(src) != kErrorCode_Ok) errors++;
+    }
+  }
+  else
+  {
+    for (s32 i = first_map; i < argc; i++)
+    {
+      if (build(argv[i]) != kErrorCode_Ok) errors++;
+    }
+  }
+  return errors == 0 ? 0 : 1;
+}
@@ -8,10 +8,14 @@
 #include "ESAT/input.h"
 #include "ESAT/draw.h"
 #include "path_finder.h"
+#include "asset_cache.h"
+#include "profiler.h"
+#include <cstring>
 
 GameState& g_game_state = GameState::instance();
 bool g_mouse_pressed = false;
 bool g_f1_pressed = false;
+bool g_f2_pressed = false;
 
 Float2 g_origin = Float2{ 0.0f,0.0f };
 Float2 g_dst = Float2{ 374.0f,448.0f };
@@ -37,7 +41,11 @@ void Init() {
   //Maximum time in milliseconds for our frequency (1/frequency)
   g_game_state.time_step_ = static_cast<uint32_t>((1.0 / g_game_state.frequency_) * 1000);
 
+  //The sprite of the agents is decoded by the asset cache while the window opens
+  AssetCache::instance().preload(Agent::spritePath(AgentType::k_Hero));
+
   ESAT::WindowInit(960, 704);
+  g_game_state.ai_lod_.set_viewport(Float2(0.0f, 0.0f), Float2(960.0f, 704.0f));
   ESAT::WindowSetMouseVisibility(true);
 
   g_game_state.map_.loadMap("../../../data/gfx/maps/map_03_60x44_cost.png",
@@ -48,6 +56,8 @@ void Init() {
 
 
   g_game_state.pf_agent_ = new PathFinder();
+  //This project tells when the path is ready, the searches don't print by default
+  g_game_state.pf_agent_->set_logging(true);
   g_game_state.num_agents_++;
 
   g_game_state.agents_.emplace_back(new Agent(AgentType::k_Hero, g_origin2.x, g_origin2.y, g_game_state.pf_agent_));
@@ -59,6 +69,7 @@ void Init() {
   
 
   printf("Please press F1, to start to calculate the A* algorithm \n");
+  printf("F2 cancels the paths that are still being calculated \n");
 }
 
 /** @brief InputService
@@ -69,12 +80,18 @@ void Init() {
 */
 void InputService()
 {
+  PROFILE_ZONE("InputService");
   if (ESAT::IsSpecialKeyDown(ESAT::kSpecialKey_Escape))
   {
     g_game_state.should_game_end_ = true;
   }
   if (ESAT::MouseButtonDown(0)) g_mouse_pressed = true;
   if (ESAT::IsSpecialKeyDown(ESAT::kSpecialKey_F1)) g_f1_pressed = true;
+  if (ESAT::IsSpecialKeyDown(ESAT::kSpecialKey_F2)) g_f2_pressed = true;
+  //F3 prints the zones measured since the last F3, F4 writes them for chrome://tracing
+  if (ESAT::IsSpecialKeyDown(ESAT::kSpecialKey_F3)) Profiler::instance().printSummary();
+  if (ESAT::IsSpecialKeyDown(ESAT::kSpecialKey_F4)) Profiler::instance().exportChromeTrace("profile_trace.json");
+  if (ESAT::IsSpecialKeyDown(ESAT::kSpecialKey_F5)) g_game_state.pf_agent_->stats().print();
 }
 
 /** @brief Update
@@ -86,6 +103,7 @@ void InputService()
 */
 void Update(uint32_t dt)
 {
+  PROFILE_ZONE("Update");
   if (!ESAT::WindowIsOpened()) g_game_state.quit_game_ = true;
   if (g_game_state.should_game_end_) g_game_state.quit_game_ = true;
   if (g_mouse_pressed) {
@@ -100,11 +118,15 @@ void Update(uint32_t dt)
     g_game_state.agents_[1]->prepareAStarMessage(g_origin, g_dst);
    
   }
-  g_game_state.pf_agent_->update(dt);
-  for (Agent* agent : g_game_state.agents_)
+  if(g_f2_pressed)
   {
-    agent->update(dt);
+    g_f2_pressed = false;
+
+    g_game_state.agents_[0]->cancelPathRequest();
+    g_game_state.agents_[1]->cancelPathRequest();
   }
+  g_game_state.pf_agent_->update(dt);
+  g_game_state.updateAgents(dt);
   
 }
 
@@ -115,6 +137,7 @@ void Update(uint32_t dt)
 * @return void
 */
 void Draw() {
+  PROFILE_ZONE("Draw");
   ESAT::DrawBegin();
   ESAT::DrawClear(0, 0, 0);
   ESAT::DrawSetFillColor(255, 0, 0);
@@ -163,6 +186,12 @@ int ESAT::main(int argc, char **argv) {
 
 
   Init();
+  //--record file writes the session so the Headless project can replay it
+  if (argc > 2 && strcmp(argv[1], "--record") == 0 &&
+      g_game_state.recorder_.begin(argv[2], g_game_state, g_game_state.time_step_) != kErrorCode_Ok)
+  {
+    printf("Couldn't record the session at %s\n", argv[2]);
+  }
   //unsigned int frames = 0;
   double current_time = Time();
   //double loop_last_time = Time();
@@ -189,6 +218,7 @@ int ESAT::main(int argc, char **argv) {
     loop_last_time = loop_actual_time;
     }*/
   }
+  g_game_state.recorder_.end();
   Deinit();
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,556 @@
+// main_headless.cc
+// Jose Maria Martinez
+// Runs the simulation without window as fast as possible
+
+#include "ESAT/window.h"
+#include "ESAT/time.h"
+#include "agent.h"
+#include "gamestate.h"
+#include "path_finder.h"
+#include "session_replayer.h"
+#include "asset_cache.h"
+#include "profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+GameState& g_game_state = GameState::instance();
+
+//Files given with --trace and --stats, nullptr if they were not given
+const char* g_trace_file = nullptr;
+const char* g_stats_file = nullptr;
+//Collision map given with --chase, the chases search through it
+const char* g_chase_map = nullptr;
+
+//World the agents are spawned in, the size of the window of the base project
+const float kWorldWidth = 1280.0f;
+const float kWorldHeight = 720.0f;
+
+/** @brief returns the next number of the spawn sequence
+*
+* xorshift32 so the spawns only depend on the seed
+*
+* @param state state of the sequence
+* @return u32 random number
+*/
+u32 NextRandom(u32* state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+/** @brief Spawns the agents of a world
+*
+* A hero in the middle of the world and the rest of random types at random
+* positions, taken from the seed of the world
+*
+* @param world world where the agents are created
+* @param num_agents number of agents besides the hero
+* @return void
+*/
+void Spawn(World* world, const u32 num_agents)
+{
+  world->headless_ = true;
+  world->ai_lod_.set_viewport(Float2(0.0f, 0.0f), Float2(kWorldWidth, kWorldHeight));
+
+  u32 spawn_state = world->seed_ ? world->seed_ : 1;
+  world->agents_.emplace_back(new Agent(world, AgentType::k_Hero, kWorldWidth * 0.5f, kWorldHeight * 0.5f, nullptr));
+  for (u32 i = 0; i < num_agents; i++)
+  {
+    const AgentType type = static_cast<AgentType>(1 + NextRandom(&spawn_state) % 3);
+    const float x = static_cast<float>(NextRandom(&spawn_state) % static_cast<u32>(kWorldWidth));
+    const float y = static_cast<float>(NextRandom(&spawn_state) % static_cast<u32>(kWorldHeight));
+    world->agents_.emplace_back(new Agent(world, type, x, y, nullptr));
+  }
+}
+
+/** @brief Init
+*
+* Initializes the game state without window and spawns its agents
+*
+* @param num_agents number of agents besides the hero
+* @param seed seed of the spawns and of the random sequences of the agents
+* @param threads threads used to update the agents
+* @return void
+*/
+void Init(const u32 num_agents, const u32 seed, const u32 threads)
+{
+  g_game_state.quit_game_ = false;
+  g_game_state.should_game_end_ = false;
+  g_game_state.frequency_ = 60;
+  g_game_state.time_step_ = static_cast<uint32_t>((1.0 / g_game_state.frequency_) * 1000);
+  g_game_state.seed_ = seed;
+  g_game_state.update_threads_ = threads;
+  if (g_chase_map)
+  {
+    if (g_game_state.map_.loadCollision(g_chase_map) == kErrorCode_Ok)
+    {
+      g_game_state.map_.set_original_size(static_cast<s32>(kWorldWidth), static_cast<s32>(kWorldHeight));
+      g_game_state.chase_stats_.measure_savings = true;
+    }
+    else
+    {
+      printf("Couldn't load the map %s, chasing without it\n", g_chase_map);
+    }
+  }
+  Spawn(&g_game_state, num_agents);
+  g_game_state.num_agents_ = static_cast<uint32_t>(g_game_state.agents_.size());
+}
+
+/** @brief Update
+*
+* updates all the logic of our game.
+*
+* @return void
+* @param dt time that has passed in the game world
+*/
+void Update(uint32_t dt)
+{
+  PROFILE_ZONE("Update");
+  g_game_state.updateAgents(dt);
+}
+
+/** @brief Hashes the positions of the agents
+*
+* FNV-1a over the bits of the positions, two runs with the same arguments
+* must print the same hash
+*
+* @param world world whose agents are hashed
+* @return u64 hash of the positions
+*/
+u64 PositionsHash(const World& world)
+{
+  u64 hash = 14695981039346656037ULL;
+  for (const Agent* agent : world.agents_)
+  {
+    const float position[2] = { agent->x(), agent->y() };
+    u8 bytes[sizeof(position)];
+    memcpy(bytes, position, sizeof(position));
+    for (const u8 byte : bytes)
+    {
+      hash = (hash ^ byte) * 1099511628211ULL;
+    }
+  }
+  return hash;
+}
+
+/** @brief Prints the time of each phase of the update
+*
+* @param timings timings accumulated by the game state
+* @param wall_time total time of the run in ms
+* @return void
+*/
+void PrintTimings(const UpdateTimings& timings, const double wall_time)
+{
+  const struct { const char* name; double ms; } phases[] = {
+    { "grid", timings.grid_ms },
+    { "lod", timings.lod_ms },
+    { "wake", timings.wake_ms },
+    { "integrate", timings.integrate_ms },
+    { "occupancy", timings.occupancy_ms },
+    { "deliver", timings.deliver_ms },
+  };
+  printf("phase          total ms   us/tick     %%\n");
+  for (const auto& phase : phases)
+  {
+    printf("%-10s %12.1f %9.2f %5.1f\n", phase.name, phase.ms,
+           timings.ticks ? phase.ms * 1000.0 / timings.ticks : 0.0,
+           wall_time > 0.0 ? phase.ms * 100.0 / wall_time : 0.0);
+  }
+}
+
+/** @brief Destroys the agents and the path finder of a world
+*
+* @param world world emptied
+* @return void
+*/
+void DestroyAgents(World* world)
+{
+  while (!world->agents_.empty())
+  {
+    delete world->agents_.back();
+    world->agents_.pop_back();
+  }
+  delete world->pf_agent_;
+  world->pf_agent_ = nullptr;
+}
+
+/** @brief Prints and writes the statistics of the paths
+*
+* Writes the file given with --stats, as json if its extension is .json
+* and as csv otherwise.
+*
+* @param path_finder path finder of the run, nullptr if it had none
+* @return void
+*/
+void ReportPathStats(const PathFinder* path_finder)
+{
+  if (!path_finder)
+  {
+    if (g_stats_file) printf("No path finder in this run, %s not written\n", g_stats_file);
+    return;
+  }
+  const PathStats& stats = path_finder->stats();
+  stats.print();
+  const PathRequestCounters& requests = path_finder->requestCounters();
+  printf("Requests: %u received, %u answered, %u superseded, %u cancelled, %u expired, %u dropped\n",
+         requests.received, requests.answered, requests.superseded, requests.cancelled, requests.expired,
+         requests.dropped);
+  if (!g_stats_file) return;
+
+  const size_t length = strlen(g_stats_file);
+  const bool json = length > 5 && strcmp(g_stats_file + length - 5, ".json") == 0;
+  if ((json ? stats.writeJson(g_stats_file) : stats.writeCsv(g_stats_file)) != kErrorCode_Ok)
+  {
+    printf("Couldn't write the path statistics at %s\n", g_stats_file);
+  }
+}
+
+/** @brief Writes the trace given with --trace
+*
+* @return void
+*/
+void ReportTrace()
+{
+  if (g_trace_file && Profiler::instance().exportChromeTrace(g_trace_file) != kErrorCode_Ok)
+  {
+    printf("Couldn't write the trace at %s\n", g_trace_file);
+  }
+}
+
+/** @brief Deinit
+*
+* releases all the memory allocated at init
+*
+* @return void
+*/
+void Deinit()
+{
+  DestroyAgents(&g_game_state);
+}
+
+/** @brief Replays a recorded session
+*
+* Creates the map and the agents of the session, gives the agents the
+* commands of every tick and updates them with the recorded dt. Prints the
+* time of the whole session and of the slowest recorded ticks, recorded
+* and replayed, so a session that went slow can be used as a benchmark.
+* The searches of the path finder stop on a time budget, so a path can be
+* ready some ticks before or after than when it was recorded.
+*
+* @param file path of the session
+* @param threads threads used to update the agents
+* @return int 0 if the session was replayed
+*/
+int Replay(const char* file, const u32 threads)
+{
+  const u32 kSlowestTicks = 5;
+
+  SessionReplayer session;
+  if (session.load(file) != kErrorCode_Ok)
+  {
+    printf("Couldn't load the session %s\n", file);
+    return 1;
+  }
+
+  g_game_state.quit_game_ = false;
+  g_game_state.should_game_end_ = false;
+  g_game_state.time_step_ = session.timeStep();
+  g_game_state.headless_ = true;
+  g_game_state.seed_ = session.seed();
+  g_game_state.update_threads_ = threads;
+  g_game_state.ai_lod_.set_viewport(session.viewportMin(), session.viewportMax());
+  if (*session.mapSource())
+  {
+    if (g_game_state.map_.loadCollision(session.mapSource()) == kErrorCode_Ok)
+    {
+      g_game_state.map_.set_original_size(static_cast<s32>(session.mapSize().x + 0.5f),
+                                          static_cast<s32>(session.mapSize().y + 0.5f));
+    }
+    else
+    {
+      printf("Couldn't load the map %s, replaying without it\n", session.mapSource());
+    }
+  }
+
+  //Agents by the id they had when the session was recorded
+  std::vector<Agent*> recorded_agents;
+  for (const SessionSpawn& spawn : session.spawns())
+  {
+    PathFinder* pf = nullptr;
+    if (spawn.has_path_finder)
+    {
+      if (!g_game_state.pf_agent_) g_game_state.pf_agent_ = new PathFinder();
+      pf = g_game_state.pf_agent_;
+    }
+    Agent* agent = pf ? new Agent(static_cast<AgentType>(spawn.type), spawn.x, spawn.y, pf)
+                      : new Agent(static_cast<AgentType>(spawn.type), spawn.x, spawn.y);
+    agent->set_clearance(spawn.clearance);
+    if (agent->id() != spawn.id) printf("  agent %u was %u when recorded\n", agent->id(), spawn.id);
+    if (spawn.id >= recorded_agents.size()) recorded_agents.resize(spawn.id + 1, nullptr);
+    recorded_agents[spawn.id] = agent;
+    g_game_state.agents_.emplace_back(agent);
+  }
+  g_game_state.num_agents_ = static_cast<uint32_t>(g_game_state.agents_.size());
+  printf("Replaying %u ticks of %s with %u agents, seed %u, %u threads\n", session.numTicks(), file,
+         g_game_state.num_agents_, session.seed(), threads);
+
+  g_game_state.update_timings_ = UpdateTimings();
+  std::vector<float> replayed_ms(session.numTicks());
+  double recorded_time = 0.0;
+  const double start_time = ESAT::Time();
+  for (u32 i = 0; i < session.numTicks(); i++)
+  {
+    const SessionTick& tick = session.tick(i);
+    for (u32 e = tick.first_event; e < tick.first_event + tick.num_events; e++)
+    {
+      const SessionEvent& event = session.event(e);
+      Agent* agent = event.agent < recorded_agents.size() ? recorded_agents[event.agent] : nullptr;
+      if (!agent) continue;
+      switch (event.type)
+      {
+      case SessionEventType::k_PathRequest: agent->prepareAStarMessage(event.origin, event.dst, event.deadline); break;
+      case SessionEventType::k_PathCompute: agent->prepareAStar(event.origin, event.dst); break;
+      case SessionEventType::k_StartPath: agent->startAStar(); break;
+      case SessionEventType::k_CancelPath: agent->cancelPathRequest(); break;
+      case SessionEventType::k_PathHandle: agent->requestPath(event.origin, event.dst, event.deadline); break;
+      default: break;
+      }
+    }
+    if (g_game_state.pf_agent_) g_game_state.pf_agent_->update(tick.dt);
+    //Same span as the recorded time, only updateAgents
+    const double tick_start = ESAT::Time();
+    g_game_state.updateAgents(tick.dt);
+    replayed_ms[i] = static_cast<float>(ESAT::Time() - tick_start);
+    recorded_time += tick.update_ms;
+  }
+  const double wall_time = ESAT::Time() - start_time;
+
+  printf("%u ticks in %.1f ms, recorded updates took %.1f ms\n", session.numTicks(), wall_time, recorded_time);
+  std::vector<u32> slowest(session.numTicks());
+  for (u32 i = 0; i < slowest.size(); i++) slowest[i] = i;
+  const u32 num_slowest = std::min(kSlowestTicks, session.numTicks());
+  std::partial_sort(slowest.begin(), slowest.begin() + num_slowest, slowest.end(), [&session](u32 a, u32 b) {
+    return session.tick(a).update_ms > session.tick(b).update_ms;
+  });
+  printf("slowest ticks   recorded ms   replayed ms\n");
+  for (u32 i = 0; i < num_slowest; i++)
+  {
+    printf("%10u %13.3f %13.3f\n", slowest[i], session.tick(slowest[i]).update_ms, replayed_ms[slowest[i]]);
+  }
+  PrintTimings(g_game_state.update_timings_, wall_time);
+  g_game_state.ai_lod_.printStats();
+  printf("positions hash %016llx\n", static_cast<unsigned long long>(PositionsHash(g_game_state)));
+  ReportPathStats(g_game_state.pf_agent_);
+  ReportTrace();
+
+  Deinit();
+  return 0;
+}
+
+/** @brief Simulates several independent worlds
+*
+* Every world has its own agents and seed, seed + index of the world, and
+* is updated from start to end by one thread of a pool, the worlds are
+* spread between the threads. Each world ends with the same hash as a run
+* of a single world with its seed.
+*
+* @param num_worlds number of worlds
+* @param minutes game time simulated in every world
+* @param num_agents number of agents of each world besides the hero
+* @param seed seed of the first world
+* @param threads threads of the pool, 0 uses every core
+* @return int 0
+*/
+int RunWorlds(const u32 num_worlds, const u32 minutes, const u32 num_agents, const u32 seed, const u32 threads)
+{
+  const u32 time_step = static_cast<u32>((1.0 / 60) * 1000);
+  const u64 simulated_time = static_cast<u64>(minutes) * 60 * 1000;
+  const u32 ticks = static_cast<u32>((simulated_time + time_step - 1) / time_step);
+
+  std::vector<World*> worlds(num_worlds);
+  for (u32 i = 0; i < num_worlds; i++)
+  {
+    worlds[i] = new World();
+    worlds[i]->seed_ = seed + i;
+    Spawn(worlds[i], num_agents);
+  }
+  WorkStealingPool pool;
+  pool.start(threads);
+  printf("Simulating %u worlds of %u minutes with %u agents, seeds %u to %u, %u threads\n", num_worlds, minutes,
+         num_agents + 1, seed, seed + num_worlds - 1, pool.numThreads());
+
+  const double start_time = ESAT::Time();
+  pool.parallelFor(num_worlds, 1, [&worlds, ticks, time_step](u32 first, u32 last) {
+    for (u32 i = first; i < last; i++)
+    {
+      for (u32 tick = 0; tick < ticks; tick++)
+      {
+        worlds[i]->updateAgents(time_step);
+      }
+    }
+  });
+  const double wall_time = ESAT::Time() - start_time;
+
+  for (u32 i = 0; i < num_worlds; i++)
+  {
+    printf("  world %u seed %u positions hash %016llx\n", i, worlds[i]->seed_,
+           static_cast<unsigned long long>(PositionsHash(*worlds[i])));
+    DestroyAgents(worlds[i]);
+    delete worlds[i];
+  }
+  const double world_ticks = static_cast<double>(ticks) * num_worlds;
+  printf("%.0f world ticks in %.1f ms, %.0f world ticks/s\n", world_ticks, wall_time,
+         wall_time > 0.0 ? world_ticks * 1000.0 / wall_time : 0.0);
+  return 0;
+}
+
+/** @brief Creates a sprite of the stub backend
+*
+* Without window there are no sprites, the stub only keeps the size.
+*
+* @param width width of the image
+* @param height height of the image
+* @param data_RGBA pixels of the image, unused
+* @return ESAT::SpriteHandle stub sprite
+*/
+ESAT::SpriteHandle StubSpriteCreate(int width, int height, const unsigned char* /*data_RGBA*/)
+{
+  s32* size = new s32[2];
+  size[0] = width;
+  size[1] = height;
+  return size;
+}
+
+/** @brief Releases a sprite of the stub backend
+*
+* @param sprite stub sprite
+* @return void
+*/
+void StubSpriteRelease(ESAT::SpriteHandle sprite)
+{
+  delete[] static_cast<s32*>(sprite);
+}
+
+/** @brief Loads the sprites of the agents through the asset cache
+*
+* Uses the stub backend so it runs without window. The sprites of every
+* type are preloaded and the agents of random types are created with them.
+* Prints the time to create the agents and what the cache saved.
+*
+* @param num_agents number of agents created
+* @param seed seed of the types of the agents
+* @return int 0
+*/
+int LoadAssets(const u32 num_agents, const u32 seed)
+{
+  SpriteBackend stub;
+  stub.create = StubSpriteCreate;
+  stub.release = StubSpriteRelease;
+  AssetCache::instance().set_backend(stub);
+
+  const double start_time = ESAT::Time();
+  for (u32 type = static_cast<u32>(AgentType::k_Huge); type <= static_cast<u32>(AgentType::k_Hero); type++)
+  {
+    AssetCache::instance().preload(Agent::spritePath(static_cast<AgentType>(type)));
+  }
+  World world;
+  u32 spawn_state = seed ? seed : 1;
+  for (u32 i = 0; i < num_agents; i++)
+  {
+    const AgentType type = static_cast<AgentType>(1 + NextRandom(&spawn_state) % 4);
+    world.agents_.emplace_back(new Agent(&world, type, 0.0f, 0.0f, nullptr));
+  }
+  printf("Created %u agents with sprites in %.1f ms\n", num_agents, ESAT::Time() - start_time);
+  AssetCache::instance().printStats();
+
+  DestroyAgents(&world);
+  printf("After destroying the agents:\n");
+  AssetCache::instance().printStats();
+  return 0;
+}
+
+/* Usage: Headless [--trace file] [--stats file] [--chase map] [minutes] [agents] [seed] [threads]
+*         Headless [--trace file] [--stats file] --replay file [threads]
+*         Headless --worlds count [minutes] [agents] [seed] [threads]
+*         Headless --assets [agents] [seed]
+*  Simulates the minutes of game time with fixed steps and no window, 0 threads uses every core.
+*  --replay runs a session recorded with --record by the other projects.
+*  --worlds runs count independent worlds at the same time, one per thread.
+*  --assets creates agents with sprites of a stub backend to check the asset cache.
+*  --trace prints the profiler zones every minute and writes the last ones as a Chrome trace,
+*  the zones are only measured in Debug or with ENABLE_PROFILER.
+*  --stats writes the statistics of the paths of the path finder, json or csv by its extension.
+*  --chase loads a collision map, stretched over the world, for the chases to search through it
+*  and prints the expansions they saved against an A*.
+*/
+int ESAT::main(int argc, char **argv) {
+  while (argc > 2 && (strcmp(argv[1], "--trace") == 0 || strcmp(argv[1], "--stats") == 0 ||
+                      strcmp(argv[1], "--chase") == 0))
+  {
+    if (strcmp(argv[1], "--trace") == 0) g_trace_file = argv[2];
+    else if (strcmp(argv[1], "--stats") == 0) g_stats_file = argv[2];
+    else g_chase_map = argv[2];
+    argc -= 2;
+    argv += 2;
+  }
+  if (argc > 2 && strcmp(argv[1], "--replay") == 0)
+  {
+    return Replay(argv[2], argc > 3 ? static_cast<u32>(atoi(argv[3])) : 1);
+  }
+  if (argc > 1 && strcmp(argv[1], "--assets") == 0)
+  {
+    return LoadAssets(argc > 2 ? static_cast<u32>(atoi(argv[2])) : 1000,
+                      argc > 3 ? static_cast<u32>(atoi(argv[3])) : 1);
+  }
+  if (argc > 2 && strcmp(argv[1], "--worlds") == 0)
+  {
+    return RunWorlds(static_cast<u32>(atoi(argv[2])),
+                     argc > 3 ? static_cast<u32>(atoi(argv[3])) : 60,
+                     argc > 4 ? static_cast<u32>(atoi(argv[4])) : 1000,
+                     argc > 5 ? static_cast<u32>(atoi(argv[5])) : 1,
+                     argc > 6 ? static_cast<u32>(atoi(argv[6])) : 0);
+  }
+
+  const u32 minutes = argc > 1 ? static_cast<u32>(atoi(argv[1])) : 60;
+  const u32 num_agents = argc > 2 ? static_cast<u32>(atoi(argv[2])) : 1000;
+  const u32 seed = argc > 3 ? static_cast<u32>(atoi(argv[3])) : 1;
+  const u32 threads = argc > 4 ? static_cast<u32>(atoi(argv[4])) : 1;
+
+  Init(num_agents, seed, threads);
+  const u64 simulated_time = static_cast<u64>(minutes) * 60 * 1000;
+  printf("Simulating %u minutes with %u agents, seed %u, %u threads\n", minutes, num_agents + 1, seed, threads);
+
+  g_game_state.update_timings_ = UpdateTimings();
+  u64 game_time = 0;
+  u32 ticks = 0;
+  const double start_time = Time();
+  while (game_time < simulated_time)
+  {
+    Update(g_game_state.time_step_);
+    game_time += g_game_state.time_step_;
+    ticks++;
+    if (game_time / 60000 != (game_time - g_game_state.time_step_) / 60000)
+    {
+      printf("  minute %llu at %.0f ms\n", static_cast<unsigned long long>(game_time / 60000), Time() - start_time);
+      if (g_trace_file) Profiler::instance().printSummary();
+    }
+  }
+  const double wall_time = Time() - start_time;
+
+  printf("%u ticks in %.1f ms, %.0f ticks/s, %.1fx real time\n", ticks, wall_time,
+         wall_time > 0.0 ? ticks * 1000.0 / wall_time : 0.0,
+         wall_time > 0.0 ? game_time / wall_time : 0.0);
+  PrintTimings(g_game_state.update_timings_, wall_time);
+  g_game_state.ai_lod_.printStats();
+  printf("positions hash %016llx\n", static_cast<unsigned long long>(PositionsHash(g_game_state)));
+  ReportPathStats(g_game_state.pf_agent_);
+  if (g_chase_map) g_game_state.chase_stats_.print();
+  ReportTrace();
+
+  Deinit();
+  return 0;
+}